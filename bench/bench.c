@@ -0,0 +1,986 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * gatekeeper-bench - offline benchmark of the data paths.
+ *
+ * The benchmark runs the functional blocks of Gatekeeper, as
+ * configured by bench/lua, on DPDK ring devices instead of NICs.
+ * The master lcore plays the part of the network: it replays packets
+ * kept in memory into the RX queues of the front interface, or of
+ * the back interface with -b, steering them with the RSS hash as
+ * a NIC would, drains and counts the packets that Gatekeeper
+ * transmits, and answers the ARP requests of LLS.
+ * Run it from the root of the repository as:
+ *
+ *	gatekeeper-bench [EAL options] -- [-g | -b] [-f PCAP | -s FLOWS]
+ *		[-t SECS] [-w SECS] [-r PPS] [-x SCENARIO]
+ *
+ *	-g        benchmark a Grantor server instead of a Gatekeeper server
+ *	-b        replay outbound packets into the back interface of
+ *	          a Gatekeeper server instead of requests into the front
+ *	-f PCAP   replay the packets of PCAP, an Ethernet capture
+ *	-s FLOWS  replay synthetic packets of FLOWS flows (default: 1024)
+ *	-t SECS   replay for SECS seconds (default: 10)
+ *	-w SECS   warm up, e.g. resolve neighbors, for SECS seconds (default: 2)
+ *	-r PPS    replay at most PPS packets per second (default: unlimited)
+ *	-x SCENARIO  run SCENARIO, see usage()
+ *
+ * At the end, the benchmark reports the packet rate and the counters
+ * of each functional block, which include the reasons for which
+ * packets were dropped. Built with PROFILE=y, as the Makefile of
+ * Gatekeeper, it also reports the cycles that GK and GT spent per
+ * packet; profiling costs a few cycles per packet, so compare
+ * packet rates without it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <byteswap.h>
+
+#include <rte_log.h>
+#include <rte_ring.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_ethdev.h>
+#include <rte_eth_ring.h>
+#include <rte_ether.h>
+#include <rte_arp.h>
+#include <rte_ip.h>
+#include <rte_udp.h>
+#include <rte_cycles.h>
+#include <rte_memcpy.h>
+#include <rte_byteorder.h>
+
+#include "gatekeeper_main.h"
+#include "gatekeeper_net.h"
+#include "gatekeeper_flow.h"
+#include "gatekeeper_fib.h"
+#include "gatekeeper_gk.h"
+#include "gatekeeper_stats.h"
+#include "gatekeeper_bench.h"
+#include "bench.h"
+
+/* Directory of the Lua configuration of the benchmark. */
+#define BENCH_LUA_BASE_DIR "./bench/lua"
+
+/* Queues of each ring device; Gatekeeper may use fewer. */
+#define BENCH_MAX_QUEUES (16)
+#define BENCH_RING_SIZE (1024)
+#define BENCH_NUM_MBUFS ((1 << 16) - 1)
+#define BENCH_MBUF_CACHE_SIZE (256)
+#define BENCH_RETA_SIZE (ETH_RSS_RETA_SIZE_128)
+
+/* Priority of the synthetic packets sent to a Grantor server. */
+#define BENCH_GT_PRIORITY (2)
+
+/*
+ * Addresses of the synthetic packets. They must match bench/lua:
+ * the addresses of the interfaces, and the prefix whose FIB entry
+ * sends requests to a Grantor server.
+ */
+#define BENCH_FRONT_IP    IPv4(10, 0, 0, 1)
+#define BENCH_GK_IP       IPv4(10, 0, 0, 2)
+#define BENCH_SRC_IP_BASE IPv4(172, 16, 0, 0)
+#define BENCH_DST_IP      IPv4(192, 168, 0, 1)
+#define BENCH_DST_PREFIX  "192.168.0.0/16"
+
+/*
+ * Addresses of the outbound synthetic packets of -b, and the prefix
+ * whose FIB entry sends them to a gateway in the front network.
+ */
+#define BENCH_OUT_IP_BASE IPv4(198, 51, 100, 0)
+#define BENCH_OUT_PREFIX  "198.51.100.0/24"
+#define BENCH_FRONT_GW_IP "10.0.0.254"
+
+/* Smallest flow table of a GK instance, as in lua/gk.lua. */
+#define BENCH_MIN_FLOW_HT_SIZE (1024)
+
+/* Frames of the synthetic packets, without the CRC. */
+#define BENCH_FRAME_LEN (60)
+
+enum bench_port_id {
+	BENCH_FRONT = 0,
+	BENCH_BACK,
+	BENCH_NUM_PORTS
+};
+
+struct bench_port {
+	/* Name of the device, which bench/lua/if_map.lua refers to. */
+	const char          *name;
+	bool                created;
+	uint16_t            port_id;
+	struct ether_addr   mac;
+
+	struct rte_ring     *rx_rings[BENCH_MAX_QUEUES];
+	struct rte_ring     *tx_rings[BENCH_MAX_QUEUES];
+
+	/* The RETA that Gatekeeper set up for the device, if any. */
+	bool                has_reta;
+	struct gatekeeper_rss_config reta;
+
+	/* Packets that Gatekeeper transmitted on the device. */
+	uint64_t            num_tx;
+};
+
+/* A packet to replay. */
+struct bench_pkt {
+	uint8_t             *data;
+	uint16_t            len;
+	bool                has_hash;
+	uint32_t            rss_hash;
+	uint16_t            queue;
+};
+
+/* The statistics of a functional block at some instant. */
+struct bench_block_stats {
+	uint64_t            counters[STATS_NUM_COUNTERS];
+	/* Cycles spent in all phases but STATS_PHASE_IDLE. */
+	uint64_t            busy_cycles;
+};
+
+static struct bench_port ports[BENCH_NUM_PORTS] = {
+	[BENCH_FRONT] = { .name = "bench_front" },
+	[BENCH_BACK]  = { .name = "bench_back" },
+};
+
+/* The neighbor that answers all ARP requests. */
+static const struct ether_addr neighbor_mac = {
+	.addr_bytes = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 },
+};
+
+static bool grantor;
+/* The device into which the packets are replayed. */
+static enum bench_port_id replay_port = BENCH_FRONT;
+static const struct bench_scenario *scenario;
+static struct gk_config *gk_conf;
+static const char *pcap_path;
+static unsigned int num_flows = 1024;
+static unsigned int replay_secs = 10;
+static unsigned int warmup_secs = 2;
+static uint64_t rate_pps;
+
+static struct rte_mempool *pool;
+static struct bench_pkt *pkts;
+static unsigned int num_pkts;
+
+static uint64_t num_offered;
+static uint64_t num_no_mbufs;
+static uint64_t num_rx_full;
+static uint64_t num_arp_replies;
+static uint64_t started_at;
+static uint64_t stopped_at;
+static struct bench_block_stats stats_at_start[STATS_NUM_BLOCKS];
+
+/*
+ * Report the memory of the flow tables, whose entries are sized to
+ * a cache line so that large tables survive larger floods. Replay
+ * many flows, e.g. -s 1000000, to measure the packet rate when
+ * the flow entries do not fit in the caches.
+ */
+static void
+report_flows(__attribute__((unused)) double secs)
+{
+	size_t entry_size = gk_flow_entry_size();
+
+	if (gk_conf == NULL)
+		return;
+
+	printf("Flow tables: %d GK instances with %u entries of %zu bytes (%.1f MiB each), plus %zu bytes of key per entry in the hash tables\n",
+		gk_conf->num_lcores, gk_conf->flow_ht_size, entry_size,
+		(double)gk_conf->flow_ht_size * entry_size / (1 << 20),
+		sizeof(struct ip_flow));
+}
+
+static const struct bench_scenario bench_flows = {
+	.name = "flows",
+	.summary = "replay FLOWS flows and report the memory of the flow tables",
+	.report = report_flows,
+};
+
+static const struct bench_scenario *const scenarios[] = {
+	&bench_flows,
+	&bench_churn,
+	&bench_lpm,
+	&bench_softrss,
+	NULL,
+};
+
+bool
+bench_grantor(void)
+{
+	return grantor;
+}
+
+void
+bench_set_gk_conf(struct gk_config *conf)
+{
+	gk_conf = conf;
+}
+
+struct gk_config *
+bench_get_gk_conf(void)
+{
+	return gk_conf;
+}
+
+/*
+ * The flow table of each GK instance can hold all replayed flows,
+ * so that new flows are not refused however RSS spreads them.
+ * A capture has at most one flow per packet.
+ */
+unsigned int
+bench_flow_ht_size(void)
+{
+	return RTE_MAX((unsigned int)BENCH_MIN_FLOW_HT_SIZE,
+		pcap_path != NULL ? num_pkts : num_flows);
+}
+
+static struct bench_port *
+find_port(uint16_t port_id)
+{
+	unsigned int i;
+
+	for (i = 0; i < BENCH_NUM_PORTS; i++) {
+		if (ports[i].created && ports[i].port_id == port_id)
+			return &ports[i];
+	}
+	return NULL;
+}
+
+static int
+bench_setup_soft_rss(uint16_t port_id, uint16_t *queues,
+	uint16_t num_queues)
+{
+	struct bench_port *bp = find_port(port_id);
+	uint16_t i;
+
+	if (bp == NULL) {
+		RTE_LOG(ERR, PORT,
+			"bench: port %hu has no RETA, and it is not a device of the benchmark\n",
+			port_id);
+		return -1;
+	}
+
+	memset(&bp->reta, 0, sizeof(bp->reta));
+	bp->reta.reta_size = BENCH_RETA_SIZE;
+	for (i = 0; i < BENCH_RETA_SIZE; i++) {
+		struct rte_eth_rss_reta_entry64 *entry =
+			&bp->reta.reta_conf[i / RTE_RETA_GROUP_SIZE];
+		entry->mask = ~0ULL;
+		entry->reta[i % RTE_RETA_GROUP_SIZE] =
+			queues[i % num_queues];
+	}
+	bp->has_reta = true;
+	return 0;
+}
+
+static int
+bench_get_soft_rss(uint16_t port_id, struct gatekeeper_rss_config *rss_conf)
+{
+	struct bench_port *bp = find_port(port_id);
+
+	if (bp == NULL || !bp->has_reta) {
+		RTE_LOG(ERR, PORT,
+			"bench: port %hu has no RETA to query\n", port_id);
+		return -1;
+	}
+
+	*rss_conf = bp->reta;
+	return 0;
+}
+
+static int
+add_pkt(const uint8_t *data, uint16_t len)
+{
+	struct bench_pkt *new_pkts;
+	struct bench_pkt *pkt;
+
+	new_pkts = realloc(pkts, (num_pkts + 1) * sizeof(*pkts));
+	if (new_pkts == NULL)
+		return -1;
+	pkts = new_pkts;
+
+	pkt = &pkts[num_pkts];
+	memset(pkt, 0, sizeof(*pkt));
+	pkt->data = malloc(len);
+	if (pkt->data == NULL)
+		return -1;
+	memcpy(pkt->data, data, len);
+	pkt->len = len;
+	num_pkts++;
+	return 0;
+}
+
+struct pcap_file_hdr {
+	uint32_t magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	int32_t  thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t linktype;
+};
+
+struct pcap_rec_hdr {
+	uint32_t ts_sec;
+	uint32_t ts_frac;
+	uint32_t incl_len;
+	uint32_t orig_len;
+};
+
+#define PCAP_MAGIC         (0xa1b2c3d4)
+#define PCAP_MAGIC_NS      (0xa1b23c4d)
+#define PCAP_LINKTYPE_ETH  (1)
+
+/* Load the packets of the capture at @path in memory. */
+static int
+load_pcap(const char *path)
+{
+	struct pcap_file_hdr fh;
+	struct pcap_rec_hdr rh;
+	uint8_t data[RTE_MBUF_DEFAULT_DATAROOM];
+	unsigned int num_skipped = 0;
+	bool swapped;
+	int ret = -1;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		RTE_LOG(ERR, GATEKEEPER, "bench: cannot open %s\n", path);
+		return -1;
+	}
+
+	if (fread(&fh, sizeof(fh), 1, f) != 1)
+		goto bad_file;
+	if (fh.magic == PCAP_MAGIC || fh.magic == PCAP_MAGIC_NS)
+		swapped = false;
+	else if (fh.magic == bswap_32(PCAP_MAGIC) ||
+			fh.magic == bswap_32(PCAP_MAGIC_NS))
+		swapped = true;
+	else
+		goto bad_file;
+
+	if ((swapped ? bswap_32(fh.linktype) : fh.linktype) !=
+			PCAP_LINKTYPE_ETH) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"bench: %s is not a capture of Ethernet frames\n",
+			path);
+		goto out;
+	}
+
+	while (fread(&rh, sizeof(rh), 1, f) == 1) {
+		uint32_t len = swapped ? bswap_32(rh.incl_len) : rh.incl_len;
+
+		if (len > sizeof(data) || len < sizeof(struct ether_hdr)) {
+			if (fseek(f, len, SEEK_CUR) != 0)
+				goto bad_file;
+			num_skipped++;
+			continue;
+		}
+
+		if (fread(data, len, 1, f) != 1)
+			goto bad_file;
+		if (add_pkt(data, len) < 0) {
+			RTE_LOG(ERR, GATEKEEPER,
+				"bench: out of memory for the packets of %s\n",
+				path);
+			goto out;
+		}
+	}
+
+	if (num_skipped > 0) {
+		RTE_LOG(WARNING, GATEKEEPER,
+			"bench: skipped %u packets of %s that do not fit in an mbuf\n",
+			num_skipped, path);
+	}
+	ret = 0;
+	goto out;
+
+bad_file:
+	RTE_LOG(ERR, GATEKEEPER, "bench: %s is not a valid pcap file\n",
+		path);
+out:
+	fclose(f);
+	return ret;
+}
+
+static void
+fill_ipv4_hdr(struct ipv4_hdr *ip, uint8_t tos, uint16_t len,
+	uint8_t proto, uint32_t src, uint32_t dst)
+{
+	memset(ip, 0, sizeof(*ip));
+	ip->version_ihl = 0x45;
+	ip->type_of_service = tos;
+	ip->total_length = rte_cpu_to_be_16(len);
+	ip->time_to_live = 64;
+	ip->next_proto_id = proto;
+	ip->src_addr = rte_cpu_to_be_32(src);
+	ip->dst_addr = rte_cpu_to_be_32(dst);
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+}
+
+/*
+ * Build a synthetic packet of each of @num_flows flows. A Gatekeeper
+ * server receives them as the first packets of new flows, that is,
+ * as requests. A Grantor server receives them encapsulated, as the
+ * requests that a Gatekeeper server forwards. With -b, a Gatekeeper
+ * server receives them at the back interface, as outbound packets
+ * to the destinations of BENCH_OUT_PREFIX.
+ */
+static int
+make_synthetic_pkts(unsigned int num_flows)
+{
+	uint8_t data[BENCH_FRAME_LEN];
+	unsigned int i;
+
+	for (i = 0; i < num_flows; i++) {
+		struct ether_hdr *eth = (struct ether_hdr *)data;
+		struct ipv4_hdr *ip = (struct ipv4_hdr *)&eth[1];
+		struct udp_hdr *udp;
+		uint16_t ip_len = BENCH_FRAME_LEN - sizeof(*eth);
+
+		memset(data, 0, sizeof(data));
+		ether_addr_copy(&ports[replay_port].mac, &eth->d_addr);
+		ether_addr_copy(&neighbor_mac, &eth->s_addr);
+		eth->ether_type = rte_cpu_to_be_16(ETHER_TYPE_IPv4);
+
+		if (grantor) {
+			fill_ipv4_hdr(ip, BENCH_GT_PRIORITY << 2, ip_len,
+				IPPROTO_IPIP, BENCH_GK_IP, BENCH_FRONT_IP);
+			ip++;
+			ip_len -= sizeof(*ip);
+		}
+
+		fill_ipv4_hdr(ip, 0, ip_len, IPPROTO_UDP,
+			BENCH_SRC_IP_BASE + i, replay_port == BENCH_BACK ?
+			BENCH_OUT_IP_BASE + 1 + i % 254 : BENCH_DST_IP);
+		udp = (struct udp_hdr *)&ip[1];
+		udp->src_port = rte_cpu_to_be_16(1024 + i % 64512);
+		udp->dst_port = rte_cpu_to_be_16(80);
+		udp->dgram_len = rte_cpu_to_be_16(ip_len - sizeof(*ip));
+
+		if (add_pkt(data, sizeof(data)) < 0) {
+			RTE_LOG(ERR, GATEKEEPER,
+				"bench: out of memory for the synthetic packets\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int
+create_port(struct bench_port *bp)
+{
+	unsigned int socket_id = rte_socket_id();
+	char ring_name[RTE_RING_NAMESIZE];
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < BENCH_MAX_QUEUES; i++) {
+		snprintf(ring_name, sizeof(ring_name), "%s_rx%u",
+			bp->name, i);
+		bp->rx_rings[i] = rte_ring_create(ring_name, BENCH_RING_SIZE,
+			socket_id, RING_F_SP_ENQ | RING_F_SC_DEQ);
+		snprintf(ring_name, sizeof(ring_name), "%s_tx%u",
+			bp->name, i);
+		bp->tx_rings[i] = rte_ring_create(ring_name, BENCH_RING_SIZE,
+			socket_id, RING_F_SP_ENQ | RING_F_SC_DEQ);
+		if (bp->rx_rings[i] == NULL || bp->tx_rings[i] == NULL) {
+			RTE_LOG(ERR, GATEKEEPER,
+				"bench: cannot create the rings of %s (errno=%i: %s)\n",
+				bp->name, rte_errno, rte_strerror(rte_errno));
+			return -1;
+		}
+	}
+
+	ret = rte_eth_from_rings(bp->name, bp->rx_rings, BENCH_MAX_QUEUES,
+		bp->tx_rings, BENCH_MAX_QUEUES, socket_id);
+	if (ret < 0) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"bench: cannot create the device %s\n", bp->name);
+		return -1;
+	}
+
+	bp->port_id = ret;
+	bp->created = true;
+	rte_eth_macaddr_get(bp->port_id, &bp->mac);
+	return 0;
+}
+
+static void
+usage(const char *prog)
+{
+	const struct bench_scenario *const *scn;
+
+	fprintf(stderr,
+		"Usage: %s [EAL options] -- [-g | -b] [-f PCAP | -s FLOWS] [-t SECS] [-w SECS] [-r PPS] [-x SCENARIO]\n"
+		"  -g        benchmark a Grantor server\n"
+		"  -b        replay outbound packets into the back interface\n"
+		"  -f PCAP   replay the packets of PCAP\n"
+		"  -s FLOWS  replay synthetic packets of FLOWS flows (default: 1024)\n"
+		"  -t SECS   replay for SECS seconds (default: 10)\n"
+		"  -w SECS   warm up for SECS seconds (default: 2)\n"
+		"  -r PPS    replay at most PPS packets per second (default: unlimited)\n"
+		"  -x SCENARIO  run SCENARIO, one of:\n",
+		prog);
+	for (scn = scenarios; *scn != NULL; scn++)
+		fprintf(stderr, "    %-10s %s\n", (*scn)->name, (*scn)->summary);
+}
+
+static const struct bench_scenario *
+find_scenario(const char *name)
+{
+	const struct bench_scenario *const *scn;
+
+	for (scn = scenarios; *scn != NULL; scn++) {
+		if (strcmp((*scn)->name, name) == 0)
+			return *scn;
+	}
+	return NULL;
+}
+
+/*
+ * Parse the arguments of the benchmark, create its devices, and
+ * load the packets to replay. Called before the configuration
+ * of Gatekeeper, which looks the devices up by name.
+ */
+static int
+bench_init(int argc, char **argv)
+{
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "gbf:s:t:w:r:x:")) != -1) {
+		switch (opt) {
+		case 'g':
+			grantor = true;
+			break;
+		case 'b':
+			replay_port = BENCH_BACK;
+			break;
+		case 'f':
+			pcap_path = optarg;
+			break;
+		case 's':
+			num_flows = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			replay_secs = strtoul(optarg, NULL, 10);
+			break;
+		case 'w':
+			warmup_secs = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			rate_pps = strtoull(optarg, NULL, 10);
+			break;
+		case 'x':
+			scenario = find_scenario(optarg);
+			if (scenario == NULL) {
+				usage(argv[0]);
+				return -1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return -1;
+		}
+	}
+
+	/* A Grantor server has no back interface. */
+	if (replay_secs == 0 || (pcap_path == NULL && num_flows == 0) ||
+			(grantor && replay_port == BENCH_BACK)) {
+		usage(argv[0]);
+		return -1;
+	}
+
+	pool = rte_pktmbuf_pool_create("bench_pool", BENCH_NUM_MBUFS,
+		BENCH_MBUF_CACHE_SIZE, 0, RTE_MBUF_DEFAULT_BUF_SIZE,
+		rte_socket_id());
+	if (pool == NULL) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"bench: cannot create the pool of mbufs (errno=%i: %s)\n",
+			rte_errno, rte_strerror(rte_errno));
+		return -1;
+	}
+
+	/* A Grantor server has no back interface. */
+	for (i = 0; i < (grantor ? 1 : BENCH_NUM_PORTS); i++) {
+		if (create_port(&ports[i]) < 0)
+			return -1;
+	}
+
+	if (pcap_path != NULL)
+		return load_pcap(pcap_path);
+	return make_synthetic_pkts(num_flows);
+}
+
+/*
+ * Compute the RSS hash of each packet, and the RX queue of the replay
+ * device to which a NIC would deliver it. Non-IP packets go to
+ * queue 0, as the NICs do.
+ */
+static void
+steer_pkts(void)
+{
+	struct bench_port *bp = &ports[replay_port];
+	unsigned int i;
+
+	for (i = 0; i < num_pkts; i++) {
+		struct bench_pkt *pkt = &pkts[i];
+		struct ether_hdr *eth = (struct ether_hdr *)pkt->data;
+		uint16_t ether_type = rte_be_to_cpu_16(eth->ether_type);
+		struct ip_flow flow;
+		uint16_t idx;
+
+		memset(&flow, 0, sizeof(flow));
+		if (ether_type == ETHER_TYPE_IPv4 && pkt->len >=
+				sizeof(*eth) + sizeof(struct ipv4_hdr)) {
+			struct ipv4_hdr *ip = (struct ipv4_hdr *)&eth[1];
+			flow.proto = ETHER_TYPE_IPv4;
+			flow.f.v4.src = ip->src_addr;
+			flow.f.v4.dst = ip->dst_addr;
+		} else if (ether_type == ETHER_TYPE_IPv6 && pkt->len >=
+				sizeof(*eth) + sizeof(struct ipv6_hdr)) {
+			struct ipv6_hdr *ip = (struct ipv6_hdr *)&eth[1];
+			flow.proto = ETHER_TYPE_IPv6;
+			rte_memcpy(flow.f.v6.src, ip->src_addr,
+				sizeof(flow.f.v6.src));
+			rte_memcpy(flow.f.v6.dst, ip->dst_addr,
+				sizeof(flow.f.v6.dst));
+		} else {
+			pkt->has_hash = false;
+			pkt->queue = 0;
+			continue;
+		}
+
+		pkt->has_hash = true;
+		pkt->rss_hash = rss_ip_flow_hf(&flow, 0, 0);
+		if (!bp->has_reta) {
+			pkt->queue = 0;
+			continue;
+		}
+		idx = pkt->rss_hash % bp->reta.reta_size;
+		pkt->queue = bp->reta.reta_conf[idx / RTE_RETA_GROUP_SIZE]
+			.reta[idx % RTE_RETA_GROUP_SIZE];
+	}
+}
+
+/* Replay the next burst of packets into the RX queues of @replay_port. */
+static void
+inject_burst(unsigned int *next_pkt)
+{
+	struct bench_port *bp = &ports[replay_port];
+	struct rte_mbuf *mbufs[GATEKEEPER_MAX_PKT_BURST];
+	struct rte_mbuf *queued[BENCH_MAX_QUEUES][GATEKEEPER_MAX_PKT_BURST];
+	unsigned int num_queued[BENCH_MAX_QUEUES] = { 0 };
+	unsigned int i;
+
+	/* The packets that are not replayed would skew the results. */
+	if (rte_pktmbuf_alloc_bulk(pool, mbufs,
+			GATEKEEPER_MAX_PKT_BURST) != 0) {
+		num_no_mbufs += GATEKEEPER_MAX_PKT_BURST;
+		return;
+	}
+
+	for (i = 0; i < GATEKEEPER_MAX_PKT_BURST; i++) {
+		const struct bench_pkt *pkt = &pkts[*next_pkt];
+		struct rte_mbuf *m = mbufs[i];
+		uint16_t queue = pkt->queue % BENCH_MAX_QUEUES;
+
+		rte_memcpy(rte_pktmbuf_mtod(m, void *), pkt->data, pkt->len);
+		m->data_len = pkt->len;
+		m->pkt_len = pkt->len;
+		m->port = bp->port_id;
+		if (pkt->has_hash) {
+			m->hash.rss = pkt->rss_hash;
+			m->ol_flags |= PKT_RX_RSS_HASH;
+		}
+		queued[queue][num_queued[queue]++] = m;
+
+		if (++*next_pkt >= num_pkts)
+			*next_pkt = 0;
+	}
+	num_offered += GATEKEEPER_MAX_PKT_BURST;
+
+	for (i = 0; i < BENCH_MAX_QUEUES; i++) {
+		unsigned int num_enq, j;
+
+		if (num_queued[i] == 0)
+			continue;
+
+		num_enq = rte_ring_sp_enqueue_burst(bp->rx_rings[i],
+			(void **)queued[i], num_queued[i], NULL);
+		for (j = num_enq; j < num_queued[i]; j++)
+			rte_pktmbuf_free(queued[i][j]);
+		num_rx_full += num_queued[i] - num_enq;
+	}
+}
+
+/*
+ * If @m is an ARP request for another host, turn it into the reply
+ * of the neighbor and deliver it to @bp. Return whether @m is consumed.
+ */
+static bool
+answer_arp(struct bench_port *bp, struct rte_mbuf *m)
+{
+	struct ether_hdr *eth = rte_pktmbuf_mtod(m, struct ether_hdr *);
+	struct arp_hdr *arp = (struct arp_hdr *)&eth[1];
+	uint32_t target;
+
+	if (m->data_len < sizeof(*eth) + sizeof(*arp) ||
+			eth->ether_type != rte_cpu_to_be_16(ETHER_TYPE_ARP) ||
+			arp->arp_op != rte_cpu_to_be_16(ARP_OP_REQUEST) ||
+			arp->arp_data.arp_sip == arp->arp_data.arp_tip)
+		return false;
+
+	target = arp->arp_data.arp_tip;
+	ether_addr_copy(&eth->s_addr, &eth->d_addr);
+	ether_addr_copy(&neighbor_mac, &eth->s_addr);
+	arp->arp_op = rte_cpu_to_be_16(ARP_OP_REPLY);
+	ether_addr_copy(&arp->arp_data.arp_sha, &arp->arp_data.arp_tha);
+	arp->arp_data.arp_tip = arp->arp_data.arp_sip;
+	ether_addr_copy(&neighbor_mac, &arp->arp_data.arp_sha);
+	arp->arp_data.arp_sip = target;
+
+	m->port = bp->port_id;
+	m->ol_flags = 0;
+	if (rte_ring_sp_enqueue(bp->rx_rings[0], m) != 0) {
+		rte_pktmbuf_free(m);
+		num_rx_full++;
+	} else {
+		num_arp_replies++;
+	}
+	return true;
+}
+
+/* Count and free the packets that Gatekeeper transmitted. */
+static void
+drain_tx(void)
+{
+	struct rte_mbuf *mbufs[GATEKEEPER_MAX_PKT_BURST];
+	unsigned int i, j, k;
+
+	for (i = 0; i < BENCH_NUM_PORTS; i++) {
+		struct bench_port *bp = &ports[i];
+
+		if (!bp->created)
+			continue;
+
+		for (j = 0; j < BENCH_MAX_QUEUES; j++) {
+			unsigned int num_deq = rte_ring_sc_dequeue_burst(
+				bp->tx_rings[j], (void **)mbufs,
+				GATEKEEPER_MAX_PKT_BURST, NULL);
+			for (k = 0; k < num_deq; k++) {
+				if (answer_arp(bp, mbufs[k]))
+					continue;
+				bp->num_tx++;
+				rte_pktmbuf_free(mbufs[k]);
+			}
+		}
+	}
+}
+
+/* Add up the statistics of the lcores of each functional block. */
+static void
+read_block_stats(struct bench_block_stats stats[STATS_NUM_BLOCKS])
+{
+	const struct stats_shm *shm = stats_attach();
+	unsigned int i, j;
+
+	memset(stats, 0, sizeof(*stats) * STATS_NUM_BLOCKS);
+	if (shm == NULL)
+		return;
+
+	for (i = 0; i < RTE_MAX_LCORE; i++) {
+		const struct stats_lcore *lcore = &shm->lcores[i];
+		uint32_t block = lcore->block;
+
+		if (block == STATS_BLOCK_NONE || block >= STATS_NUM_BLOCKS)
+			continue;
+
+		for (j = 0; j < STATS_NUM_COUNTERS; j++)
+			stats[block].counters[j] += lcore->counters[j];
+		for (j = 0; j < STATS_NUM_PHASES; j++) {
+			if (j != STATS_PHASE_IDLE)
+				stats[block].busy_cycles +=
+					lcore->phases[j].tsc_cycles;
+		}
+	}
+}
+
+/*
+ * Replay the packets at the master lcore until the time is up
+ * or Gatekeeper is stopped.
+ */
+static int
+bench_run(void)
+{
+	uint64_t hz = rte_get_tsc_hz();
+	uint64_t now = rte_rdtsc();
+	uint64_t warmup_end = now + warmup_secs * hz;
+	uint64_t cycles_per_burst = rate_pps == 0 ? 0 :
+		GATEKEEPER_MAX_PKT_BURST * hz / rate_pps;
+	uint64_t next_burst_at;
+	uint64_t end;
+	unsigned int next_pkt = 0;
+
+	/* Microbenchmarks replace the replay. */
+	if (scenario != NULL && scenario->run != NULL)
+		return scenario->run();
+
+	/*
+	 * The FIB of the GK blocks only exists once they are running.
+	 * Its gateways are resolved during the warm up.
+	 */
+	if (!grantor) {
+		if (gk_conf == NULL) {
+			RTE_LOG(ERR, GATEKEEPER,
+				"bench: the configuration did not call bench_set_gk_conf()\n");
+			return -1;
+		}
+		if (add_fib_entry(BENCH_DST_PREFIX, BENCH_GT_IP, BENCH_GW_IP,
+				GK_FWD_GRANTOR, gk_conf) < 0) {
+			RTE_LOG(ERR, GATEKEEPER,
+				"bench: cannot add the FIB entry of %s\n",
+				BENCH_DST_PREFIX);
+			return -1;
+		}
+		if (replay_port == BENCH_BACK && add_fib_entry(
+				BENCH_OUT_PREFIX, NULL, BENCH_FRONT_GW_IP,
+				GK_FWD_GATEWAY_FRONT_NET, gk_conf) < 0) {
+			RTE_LOG(ERR, GATEKEEPER,
+				"bench: cannot add the FIB entry of %s\n",
+				BENCH_OUT_PREFIX);
+			return -1;
+		}
+	}
+
+	RTE_LOG(NOTICE, GATEKEEPER,
+		"bench: warming up for %u seconds\n", warmup_secs);
+	while (!exiting && rte_rdtsc() < warmup_end)
+		drain_tx();
+
+	steer_pkts();
+	read_block_stats(stats_at_start);
+
+	RTE_LOG(NOTICE, GATEKEEPER,
+		"bench: replaying %u packets for %u seconds\n",
+		num_pkts, replay_secs);
+	started_at = rte_rdtsc();
+	next_burst_at = started_at;
+	end = started_at + replay_secs * hz;
+	while (!exiting) {
+		now = rte_rdtsc();
+		if (now >= end)
+			break;
+
+		if (now >= next_burst_at) {
+			if (scenario != NULL && scenario->step != NULL &&
+					scenario->step(now) < 0)
+				break;
+			inject_burst(&next_pkt);
+			next_burst_at += cycles_per_burst;
+		}
+		drain_tx();
+	}
+	stopped_at = rte_rdtsc();
+
+	return 0;
+}
+
+static void
+bench_report(void)
+{
+	struct bench_block_stats stats_at_end[STATS_NUM_BLOCKS];
+	double secs = (double)(stopped_at - started_at) / rte_get_tsc_hz();
+	unsigned int i, j;
+
+	if (secs <= 0)
+		return;
+
+	read_block_stats(stats_at_end);
+
+	printf("Replayed into %s for %.2f s: %" PRIu64 " packets offered (%.3f Mpps), %" PRIu64 " not offered for lack of mbufs, %" PRIu64 " refused by full RX queues, %" PRIu64 " ARP replies\n",
+		ports[replay_port].name, secs, num_offered,
+		num_offered / secs / 1e6, num_no_mbufs, num_rx_full,
+		num_arp_replies);
+
+	for (i = 0; i < BENCH_NUM_PORTS; i++) {
+		if (!ports[i].created)
+			continue;
+		printf("%s: %" PRIu64 " packets transmitted (%.3f Mpps)\n",
+			ports[i].name, ports[i].num_tx,
+			ports[i].num_tx / secs / 1e6);
+	}
+
+	for (i = 0; i < STATS_NUM_BLOCKS; i++) {
+		const struct bench_block_stats *start = &stats_at_start[i];
+		const struct bench_block_stats *end = &stats_at_end[i];
+		uint64_t num_rx = end->counters[STATS_PKTS_RX] -
+			start->counters[STATS_PKTS_RX];
+		uint64_t busy_cycles = end->busy_cycles - start->busy_cycles;
+
+		if (i == STATS_BLOCK_NONE || num_rx == 0)
+			continue;
+
+		printf("%s: %" PRIu64 " packets received (%.3f Mpps)",
+			stats_block_names[i], num_rx, num_rx / secs / 1e6);
+		if (busy_cycles > 0)
+			printf(", %.1f busy cycles/packet",
+				(double)busy_cycles / num_rx);
+		printf("\n");
+
+		for (j = 0; j < STATS_NUM_COUNTERS; j++) {
+			uint64_t value = end->counters[j];
+
+			if (!stats_counters[j].gauge)
+				value -= start->counters[j];
+			if (j == STATS_PKTS_RX || value == 0)
+				continue;
+
+			printf("  %-20s %20" PRIu64 "\n",
+				stats_counters[j].name, value);
+		}
+	}
+
+	if (scenario != NULL && scenario->report != NULL)
+		scenario->report(secs);
+
+	fflush(stdout);
+}
+
+static const struct bench_hooks hooks = {
+	.lua_base_dir = BENCH_LUA_BASE_DIR,
+	.init = bench_init,
+	.run = bench_run,
+	.report = bench_report,
+	.setup_soft_rss = bench_setup_soft_rss,
+	.get_soft_rss = bench_get_soft_rss,
+};
+
+/* Run Gatekeeper as the benchmark; see include/gatekeeper_bench.h. */
+static void __attribute__((constructor))
+bench_register_hooks(void)
+{
+	bench_hooks = &hooks;
+}
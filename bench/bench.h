@@ -0,0 +1,62 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GATEKEEPER_BENCH_BENCH_H_
+#define _GATEKEEPER_BENCH_BENCH_H_
+
+#include <stdint.h>
+
+struct gk_config;
+
+/*
+ * The Grantor server of the FIB entries of the benchmark,
+ * and the gateway in the back network through which it is reached.
+ */
+#define BENCH_GT_IP "10.0.1.2"
+#define BENCH_GW_IP "10.0.1.254"
+
+/*
+ * A scenario of the benchmark, chosen with -x. A scenario either
+ * replaces the replay with a microbenchmark at the master lcore,
+ * or adds work between the bursts of the replay.
+ */
+struct bench_scenario {
+	const char *name;
+	const char *summary;
+
+	/* Run instead of the replay, if not NULL. */
+	int  (*run)(void);
+
+	/* Called before each burst of the replay, if not NULL. */
+	int  (*step)(uint64_t now);
+
+	/* Print the results of the replay, if not NULL. */
+	void (*report)(double secs);
+};
+
+/* NULL for a Grantor server. */
+struct gk_config *bench_get_gk_conf(void);
+
+/* See bench/churn.c. */
+extern const struct bench_scenario bench_churn;
+
+/* See bench/micro.c. */
+extern const struct bench_scenario bench_lpm;
+extern const struct bench_scenario bench_softrss;
+
+#endif /* _GATEKEEPER_BENCH_BENCH_H_ */
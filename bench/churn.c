@@ -0,0 +1,118 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Route churn: while packets are replayed, add and then delete
+ * the FIB entries of CHURN_NUM_PREFIXES prefixes, over and over,
+ * at CHURN_RATE updates per second, and measure how long each
+ * update takes. Updates never wait for the GK blocks; the entries
+ * that they delete are released by the following updates.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <rte_log.h>
+#include <rte_cycles.h>
+
+#include "gatekeeper_gk.h"
+#include "gatekeeper_fib.h"
+#include "gatekeeper_main.h"
+#include "bench.h"
+
+/*
+ * The prefixes 100.64.0.0/24 to 100.64.127.0/24. They must fit in
+ * the FIB next to the entries of the interfaces and of the replay;
+ * see gk_max_num_ipv4_fib_entries in bench/lua/gk.lua.
+ */
+#define CHURN_NUM_PREFIXES (128)
+
+/* FIB updates per second. */
+#define CHURN_RATE (1000)
+
+static unsigned int next_prefix;
+static bool deleting;
+static uint64_t next_update_at;
+
+static uint64_t num_updates;
+static uint64_t num_failed_updates;
+static uint64_t update_cycles;
+static uint64_t max_update_cycles;
+
+static int
+churn_step(uint64_t now)
+{
+	struct gk_config *gk_conf = bench_get_gk_conf();
+	char prefix[32];
+	uint64_t start, cycles;
+	int ret;
+
+	if (gk_conf == NULL) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"bench: route churn needs a Gatekeeper server\n");
+		return -1;
+	}
+
+	if (now < next_update_at)
+		return 0;
+	next_update_at = now + rte_get_tsc_hz() / CHURN_RATE;
+
+	snprintf(prefix, sizeof(prefix), "100.64.%u.0/24", next_prefix);
+	start = rte_rdtsc();
+	if (deleting)
+		ret = del_fib_entry(prefix, gk_conf);
+	else
+		ret = add_fib_entry(prefix, BENCH_GT_IP, BENCH_GW_IP,
+			GK_FWD_GRANTOR, gk_conf);
+	cycles = rte_rdtsc() - start;
+
+	if (ret < 0)
+		num_failed_updates++;
+	num_updates++;
+	update_cycles += cycles;
+	if (cycles > max_update_cycles)
+		max_update_cycles = cycles;
+
+	if (++next_prefix == CHURN_NUM_PREFIXES) {
+		next_prefix = 0;
+		deleting = !deleting;
+	}
+	return 0;
+}
+
+static void
+churn_report(double secs)
+{
+	double us_per_cycle = 1e6 / rte_get_tsc_hz();
+
+	if (num_updates == 0)
+		return;
+
+	printf("Route churn: %" PRIu64 " FIB updates (%.0f/s), %" PRIu64 " failed, %.1f us per update on average, %.1f us at most\n",
+		num_updates, num_updates / secs, num_failed_updates,
+		(double)update_cycles / num_updates * us_per_cycle,
+		max_update_cycles * us_per_cycle);
+}
+
+const struct bench_scenario bench_churn = {
+	.name = "churn",
+	.summary = "add and delete FIB entries while replaying packets",
+	.step = churn_step,
+	.report = churn_report,
+};
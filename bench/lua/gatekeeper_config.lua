@@ -0,0 +1,53 @@
+-- The configuration of gatekeeper-bench; see bench/bench.c.
+-- It follows lua/gatekeeper_config.lua, but leaves out the CPS block,
+-- which needs KNI, and the dynamic configuration. The modules not
+-- found in bench/lua are loaded from lua/.
+package.loaded["gatekeeper"] = nil
+require "gatekeeper"
+
+local ffi = require("ffi")
+
+ffi.cdef[[
+bool bench_grantor(void);
+void bench_set_gk_conf(struct gk_config *conf);
+]]
+
+function gatekeeper_init()
+
+	-- The command line of the benchmark chooses the server.
+	local gatekeeper_server = not ffi.C.bench_grantor()
+
+	local netf = require("net")
+	local net_conf = netf(gatekeeper_server)
+
+	local numa_table = gatekeeper.get_numa_table(net_conf)
+
+	-- LLS must be the first block, so it gets queue 0 of
+	-- the ring devices, where the benchmark delivers ARP replies.
+	local llsf = require("lls")
+	local lls_conf = llsf(net_conf, numa_table)
+
+	if gatekeeper_server == true then
+		local n_lcores = 2
+		local gk_lcores =
+			gatekeeper.alloc_lcores_from_same_numa(numa_table,
+				n_lcores + 2)
+		local sol_lcores = { table.remove(gk_lcores) }
+		local ggu_lcore = table.remove(gk_lcores)
+
+		local solf = require("sol")
+		local sol_conf = solf(net_conf, sol_lcores)
+
+		local gkf = require("gk")
+		local gk_conf = gkf(net_conf, sol_conf, gk_lcores)
+		ffi.C.bench_set_gk_conf(gk_conf)
+
+		local gguf = require("ggu")
+		local ggu_conf = gguf(net_conf, gk_conf, ggu_lcore)
+	else
+		local gtf = require("gt")
+		local gt_conf = gtf(net_conf, numa_table)
+	end
+
+	return 0
+end
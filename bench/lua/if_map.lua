@@ -0,0 +1,5 @@
+-- The ring devices that gatekeeper-bench creates.
+return {
+	["bench_front"] = "bench_front",
+	["bench_back"] = "bench_back",
+}
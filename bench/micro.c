@@ -0,0 +1,379 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks of single functions of the data paths. They run
+ * at the master lcore instead of the replay, and print how many
+ * million calls per second and how many cycles per call each
+ * variant of a function takes. Each variant is checked against
+ * the reference one before it is timed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <arpa/inet.h>
+
+#include <rte_log.h>
+#include <rte_lcore.h>
+#include <rte_cycles.h>
+#include <rte_random.h>
+#include <rte_malloc.h>
+#include <rte_thash.h>
+#include <rte_ether.h>
+
+#include "gatekeeper_lpm.h"
+#include "gatekeeper_net.h"
+#include "gatekeeper_flow.h"
+#include "gatekeeper_main.h"
+#include "bench.h"
+
+/* Addresses looked up by each round of a microbenchmark. */
+#define MICRO_NUM_ADDRS (1 << 16)
+
+/* Rounds of each microbenchmark. */
+#define MICRO_NUM_ROUNDS (64)
+
+/* Prefixes of the LPM tables, and the range of their lengths. */
+#define MICRO_NUM_IPV4_PREFIXES (100000)
+#define MICRO_MIN_IPV4_DEPTH    (8)
+#define MICRO_MAX_IPV4_DEPTH    (28)
+#define MICRO_NUM_IPV6_PREFIXES (10000)
+#define MICRO_MIN_IPV6_DEPTH    (16)
+#define MICRO_MAX_IPV6_DEPTH    (64)
+
+/* Keeps the compiler from dropping the results of the calls. */
+static volatile int32_t sink;
+
+static void
+print_result(const char *name, uint64_t cycles, uint64_t num_calls)
+{
+	double secs = (double)cycles / rte_get_tsc_hz();
+
+	printf("  %-28s %8.2f Mcalls/s %8.1f cycles/call\n", name,
+		num_calls / secs / 1e6, (double)cycles / num_calls);
+}
+
+/*
+ * Look up the destinations of bursts of packets in an LPM table
+ * one at a time, as look_up_fib() did, and in bulk, as the GK
+ * paths now do. The tables are filled with random prefixes and
+ * two prefixes of length 1, so that no lookup misses.
+ */
+static int
+micro_lpm4(uint32_t *ips, int32_t *single_hops, int32_t *bulk_hops)
+{
+	struct rte_lpm_config lpm_conf = {
+		.max_rules = MICRO_NUM_IPV4_PREFIXES + 2,
+		.number_tbl8s = 1 << 12,
+	};
+	struct rte_lpm *lpm;
+	uint64_t start, single_cycles = 0, bulk_cycles = 0;
+	unsigned int i, j, k;
+	int32_t sum = 0;
+	int ret = -1;
+
+	lpm = init_ipv4_lpm("bench", &lpm_conf, rte_socket_id(),
+		rte_lcore_id(), 0);
+	if (lpm == NULL)
+		return -1;
+
+	if (rte_lpm_add(lpm, 0, 1, 0) < 0 ||
+			rte_lpm_add(lpm, 0x80000000, 1, 0) < 0)
+		goto out;
+	for (i = 0; i < MICRO_NUM_IPV4_PREFIXES; i++) {
+		uint8_t depth = MICRO_MIN_IPV4_DEPTH + rte_rand() %
+			(MICRO_MAX_IPV4_DEPTH - MICRO_MIN_IPV4_DEPTH + 1);
+		/* Running out of tbl8s only leaves the prefix out. */
+		rte_lpm_add(lpm, (uint32_t)rte_rand(), depth, i + 1);
+	}
+
+	for (i = 0; i < MICRO_NUM_ROUNDS; i++) {
+		for (j = 0; j < MICRO_NUM_ADDRS; j++)
+			ips[j] = (uint32_t)rte_rand();
+
+		start = rte_rdtsc();
+		for (j = 0; j < MICRO_NUM_ADDRS; j++)
+			single_hops[j] = lpm_lookup_ipv4(lpm, ips[j]);
+		single_cycles += rte_rdtsc() - start;
+
+		start = rte_rdtsc();
+		for (j = 0; j < MICRO_NUM_ADDRS;
+				j += GATEKEEPER_MAX_PKT_BURST) {
+			lpm_lookup_ipv4_bulk(lpm, &ips[j], &bulk_hops[j],
+				GATEKEEPER_MAX_PKT_BURST);
+		}
+		bulk_cycles += rte_rdtsc() - start;
+
+		for (k = 0; k < MICRO_NUM_ADDRS; k++) {
+			if (single_hops[k] != bulk_hops[k]) {
+				RTE_LOG(ERR, GATEKEEPER,
+					"bench: bulk IPv4 lookup of 0x%08x gives %d instead of %d\n",
+					ntohl(ips[k]), bulk_hops[k],
+					single_hops[k]);
+				goto out;
+			}
+			sum += bulk_hops[k];
+		}
+	}
+	sink = sum;
+
+	printf("IPv4 LPM lookups, %u prefixes, bursts of %u:\n",
+		MICRO_NUM_IPV4_PREFIXES, GATEKEEPER_MAX_PKT_BURST);
+	print_result("lpm_lookup_ipv4()", single_cycles,
+		(uint64_t)MICRO_NUM_ROUNDS * MICRO_NUM_ADDRS);
+	print_result("lpm_lookup_ipv4_bulk()", bulk_cycles,
+		(uint64_t)MICRO_NUM_ROUNDS * MICRO_NUM_ADDRS);
+	ret = 0;
+out:
+	destroy_ipv4_lpm(lpm);
+	return ret;
+}
+
+static void
+rand_ipv6(uint8_t *ip)
+{
+	unsigned int i;
+
+	for (i = 0; i < RTE_LPM6_IPV6_ADDR_SIZE; i += sizeof(uint64_t)) {
+		uint64_t r = rte_rand();
+		memcpy(&ip[i], &r, sizeof(r));
+	}
+}
+
+/* Similar to micro_lpm4(), see above. */
+static int
+micro_lpm6(uint8_t (*ips)[RTE_LPM6_IPV6_ADDR_SIZE],
+	int32_t *single_hops, int32_t *bulk_hops)
+{
+	struct rte_lpm6_config lpm6_conf = {
+		.max_rules = MICRO_NUM_IPV6_PREFIXES + 2,
+		.number_tbl8s = 1 << 16,
+	};
+	uint8_t half[RTE_LPM6_IPV6_ADDR_SIZE] = { 0x80 };
+	uint8_t zero[RTE_LPM6_IPV6_ADDR_SIZE] = { 0 };
+	struct rte_lpm6 *lpm;
+	uint64_t start, single_cycles = 0, bulk_cycles = 0;
+	unsigned int i, j, k;
+	int32_t sum = 0;
+	int ret = -1;
+
+	lpm = init_ipv6_lpm("bench", &lpm6_conf, rte_socket_id(),
+		rte_lcore_id(), 0);
+	if (lpm == NULL)
+		return -1;
+
+	if (rte_lpm6_add(lpm, zero, 1, 0) < 0 ||
+			rte_lpm6_add(lpm, half, 1, 0) < 0)
+		goto out;
+	for (i = 0; i < MICRO_NUM_IPV6_PREFIXES; i++) {
+		uint8_t prefix[RTE_LPM6_IPV6_ADDR_SIZE];
+		uint8_t depth = MICRO_MIN_IPV6_DEPTH + rte_rand() %
+			(MICRO_MAX_IPV6_DEPTH - MICRO_MIN_IPV6_DEPTH + 1);
+		rand_ipv6(prefix);
+		/* Running out of tbl8s only leaves the prefix out. */
+		rte_lpm6_add(lpm, prefix, depth, i + 1);
+	}
+
+	for (i = 0; i < MICRO_NUM_ROUNDS; i++) {
+		for (j = 0; j < MICRO_NUM_ADDRS; j++)
+			rand_ipv6(ips[j]);
+
+		start = rte_rdtsc();
+		for (j = 0; j < MICRO_NUM_ADDRS; j++)
+			single_hops[j] = lpm_lookup_ipv6(lpm, ips[j]);
+		single_cycles += rte_rdtsc() - start;
+
+		start = rte_rdtsc();
+		for (j = 0; j < MICRO_NUM_ADDRS;
+				j += GATEKEEPER_MAX_PKT_BURST) {
+			lpm_lookup_ipv6_bulk(lpm, &ips[j], &bulk_hops[j],
+				GATEKEEPER_MAX_PKT_BURST);
+		}
+		bulk_cycles += rte_rdtsc() - start;
+
+		for (k = 0; k < MICRO_NUM_ADDRS; k++) {
+			if (single_hops[k] != bulk_hops[k]) {
+				RTE_LOG(ERR, GATEKEEPER,
+					"bench: bulk IPv6 lookup %u gives %d instead of %d\n",
+					k, bulk_hops[k], single_hops[k]);
+				goto out;
+			}
+			sum += bulk_hops[k];
+		}
+	}
+	sink = sum;
+
+	printf("IPv6 LPM lookups, %u prefixes, bursts of %u:\n",
+		MICRO_NUM_IPV6_PREFIXES, GATEKEEPER_MAX_PKT_BURST);
+	print_result("lpm_lookup_ipv6()", single_cycles,
+		(uint64_t)MICRO_NUM_ROUNDS * MICRO_NUM_ADDRS);
+	print_result("lpm_lookup_ipv6_bulk()", bulk_cycles,
+		(uint64_t)MICRO_NUM_ROUNDS * MICRO_NUM_ADDRS);
+	ret = 0;
+out:
+	destroy_ipv6_lpm(lpm);
+	return ret;
+}
+
+static int
+micro_lpm(void)
+{
+	uint8_t (*ips)[RTE_LPM6_IPV6_ADDR_SIZE];
+	int32_t *single_hops;
+	int32_t *bulk_hops;
+	int ret = -1;
+
+	ips = rte_malloc("bench", MICRO_NUM_ADDRS * sizeof(*ips), 0);
+	single_hops = rte_malloc("bench",
+		MICRO_NUM_ADDRS * sizeof(*single_hops), 0);
+	bulk_hops = rte_malloc("bench",
+		MICRO_NUM_ADDRS * sizeof(*bulk_hops), 0);
+	if (ips == NULL || single_hops == NULL || bulk_hops == NULL) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"bench: out of memory for the LPM microbenchmark\n");
+		goto out;
+	}
+
+	/* The IPv4 addresses use the first bytes of @ips. */
+	if (micro_lpm4((uint32_t *)ips, single_hops, bulk_hops) < 0)
+		goto out;
+	ret = micro_lpm6(ips, single_hops, bulk_hops);
+out:
+	rte_free(bulk_hops);
+	rte_free(single_hops);
+	rte_free(ips);
+	fflush(stdout);
+	return ret;
+}
+
+/*
+ * The RSS hash of @flow as the NIC computes it: rte_softrss() takes
+ * the words of the input in host order, and the key as configured.
+ */
+static uint32_t
+softrss_ref(const struct ip_flow *flow)
+{
+	uint32_t input[sizeof(flow->f.v6) / sizeof(uint32_t)];
+	uint32_t input_len = flow->proto == ETHER_TYPE_IPv4 ?
+		sizeof(flow->f.v4) / sizeof(uint32_t) : RTE_DIM(input);
+	uint32_t i;
+
+	for (i = 0; i < input_len; i++) {
+		uint32_t word;
+		memcpy(&word, (const uint8_t *)&flow->f + i * sizeof(word),
+			sizeof(word));
+		input[i] = rte_be_to_cpu_32(word);
+	}
+
+	return rte_softrss(input, input_len, default_rss_key);
+}
+
+/*
+ * Check that rss_ip_flow_hf() gives the same hashes as rte_softrss()
+ * on random flows of @proto, and time both.
+ */
+static int
+micro_softrss_proto(struct ip_flow *flows, uint32_t *hashes, uint16_t proto)
+{
+	uint64_t start, lut_cycles = 0, ref_cycles = 0;
+	unsigned int i, j;
+	uint32_t sum = 0;
+
+	for (i = 0; i < MICRO_NUM_ROUNDS; i++) {
+		for (j = 0; j < MICRO_NUM_ADDRS; j++) {
+			memset(&flows[j], 0, sizeof(flows[j]));
+			flows[j].proto = proto;
+			if (proto == ETHER_TYPE_IPv4) {
+				flows[j].f.v4.src = (uint32_t)rte_rand();
+				flows[j].f.v4.dst = (uint32_t)rte_rand();
+			} else {
+				rand_ipv6(flows[j].f.v6.src);
+				rand_ipv6(flows[j].f.v6.dst);
+			}
+		}
+
+		start = rte_rdtsc();
+		for (j = 0; j < MICRO_NUM_ADDRS; j++)
+			hashes[j] = rss_ip_flow_hf(&flows[j], 0, 0);
+		lut_cycles += rte_rdtsc() - start;
+
+		start = rte_rdtsc();
+		for (j = 0; j < MICRO_NUM_ADDRS; j++)
+			sum += softrss_ref(&flows[j]);
+		ref_cycles += rte_rdtsc() - start;
+
+		for (j = 0; j < MICRO_NUM_ADDRS; j++) {
+			uint32_t expected = softrss_ref(&flows[j]);
+			if (hashes[j] != expected) {
+				RTE_LOG(ERR, GATEKEEPER,
+					"bench: rss_ip_flow_hf() gives 0x%08x instead of 0x%08x for an IPv%d flow\n",
+					hashes[j], expected,
+					proto == ETHER_TYPE_IPv4 ? 4 : 6);
+				return -1;
+			}
+		}
+	}
+	sink = sum;
+
+	printf("RSS hashes of IPv%d flows, checked against rte_softrss():\n",
+		proto == ETHER_TYPE_IPv4 ? 4 : 6);
+	print_result("rss_ip_flow_hf()", lut_cycles,
+		(uint64_t)MICRO_NUM_ROUNDS * MICRO_NUM_ADDRS);
+	print_result("rte_softrss()", ref_cycles,
+		(uint64_t)MICRO_NUM_ROUNDS * MICRO_NUM_ADDRS);
+	return 0;
+}
+
+static int
+micro_softrss(void)
+{
+	struct ip_flow *flows;
+	uint32_t *hashes;
+	int ret = -1;
+
+	flows = rte_malloc("bench", MICRO_NUM_ADDRS * sizeof(*flows), 0);
+	hashes = rte_malloc("bench", MICRO_NUM_ADDRS * sizeof(*hashes), 0);
+	if (flows == NULL || hashes == NULL) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"bench: out of memory for the RSS microbenchmark\n");
+		goto out;
+	}
+
+	if (micro_softrss_proto(flows, hashes, ETHER_TYPE_IPv4) < 0)
+		goto out;
+	ret = micro_softrss_proto(flows, hashes, ETHER_TYPE_IPv6);
+out:
+	rte_free(hashes);
+	rte_free(flows);
+	fflush(stdout);
+	return ret;
+}
+
+const struct bench_scenario bench_softrss = {
+	.name = "softrss",
+	.summary = "check and time the software RSS hash",
+	.run = micro_softrss,
+};
+
+const struct bench_scenario bench_lpm = {
+	.name = "lpm",
+	.summary = "compare single and bulk LPM lookups",
+	.run = micro_lpm,
+};
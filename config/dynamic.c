@@ -30,6 +30,8 @@
 #include <rte_cycles.h>
 #include <rte_malloc.h>
 
+#include "gatekeeper_gk.h"
+#include "gatekeeper_fib.h"
 #include "gatekeeper_net.h"
 #include "gatekeeper_main.h"
 #include "gatekeeper_config.h"
@@ -409,6 +411,15 @@ dyn_cfg_proc(void *arg)
 	while (likely(!exiting)) {
 		fd_set fds;
 		struct timeval stv;
+
+		/*
+		 * Release the FIB entries that earlier updates deleted
+		 * once their grace periods are over, so that neither
+		 * the GK blocks nor the next update have to.
+		 */
+		if (dy_conf->gk != NULL &&
+				qsbr_has_deferred(&dy_conf->gk->qsbr))
+			reclaim_fib_entries(dy_conf->gk);
  
 		FD_ZERO(&fds);
 		FD_SET(dy_conf->sock_fd, &fds);
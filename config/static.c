@@ -30,6 +30,8 @@
 #include "gatekeeper_main.h"
 #include "gatekeeper_gk.h"
 #include "gatekeeper_gt.h"
+#include "gatekeeper_sol.h"
+#include "gatekeeper_bench.h"
 #include "luajit-ffi-cdata.h"
 
 /* TODO Get the install-path via Makefile. */
@@ -50,6 +52,9 @@ l_list_lcores(lua_State *l)
 
 	/* Only list slave lcores because the master lcore is special. */
 	RTE_LCORE_FOREACH(i) {
+		/* The benchmark replays packets at the master lcore. */
+		if (bench_hooks != NULL && i == rte_get_master_lcore())
+			continue;
 		/* Push lcore id into Lua stack. */
 		lua_pushinteger(l, i);
 		/* Add lcore id to the table at @lua_index position. */
@@ -229,11 +234,91 @@ l_gt_assign_lcores(lua_State *l)
 	return 0;
 }
 
+#define CTYPE_STRUCT_SOL_CONFIG_PTR "struct sol_config *"
+
+static int
+protected_sol_assign_lcores(lua_State *l)
+{
+	uint32_t ctypeid;
+	struct sol_config *sol_conf;
+	lua_Integer i, n;
+	unsigned int *lcores;
+
+	sol_conf = *(struct sol_config **)
+		luaL_checkcdata(l, 1, &ctypeid, CTYPE_STRUCT_SOL_CONFIG_PTR);
+	n = lua_objlen(l, 2);
+	lcores = *(unsigned int **)lua_touserdata(l, 3);
+
+	for (i = 1; i <= n; i++) {
+		lua_pushinteger(l, i);	/* Push i. */
+		lua_gettable(l, 2);	/* Pop i, Push t[i]. */
+
+		/* Check that t[i] is a number. */
+		if (!lua_isnumber(l, -1))
+			luaL_error(l, "Index %i is not a number", i);
+		lcores[i - 1] = lua_tointeger(l, -1);
+
+		lua_pop(l, 1);		/* Pop t[i]. */
+	}
+
+	sol_conf->lcores = lcores;
+	sol_conf->num_lcores = n;
+	return 0; /* No results. */
+}
+
+static int
+l_sol_assign_lcores(lua_State *l)
+{
+	static bool assigned_type = false;
+	static uint32_t correct_ctypeid;
+
+	uint32_t ctypeid;
+	lua_Integer n;
+	unsigned int *lcores, **ud;
+
+	if (!assigned_type) {
+		correct_ctypeid = luaL_get_ctypeid(l,
+			CTYPE_STRUCT_SOL_CONFIG_PTR);
+		assigned_type = true;
+	}
+
+	/* First argument must be of type CTYPE_STRUCT_SOL_CONFIG_PTR. */
+	luaL_checkcdata(l, 1, &ctypeid, CTYPE_STRUCT_SOL_CONFIG_PTR);
+	if (ctypeid != correct_ctypeid)
+		luaL_error(l, "Expected `%s' as first argument",
+			CTYPE_STRUCT_SOL_CONFIG_PTR);
+
+	/* Second argument must be a table. */
+	luaL_checktype(l, 2, LUA_TTABLE);
+
+	n = lua_objlen(l, 2); /* Get size of the table. */
+	if (n <= 0)
+		return 0; /* No results. */
+
+	ud = lua_newuserdata(l, sizeof(lcores));
+
+	lua_pushcfunction(l, protected_sol_assign_lcores);
+	lua_insert(l, 1);
+
+	lcores = rte_malloc("sol_conf.lcores", n * sizeof(*lcores), 0);
+	if (lcores == NULL)
+		luaL_error(l, "DPDK has run out memory");
+	*ud = lcores;
+
+	/* lua_pcall() is used here to avoid leaking @lcores. */
+	if (lua_pcall(l, 3, 0, 0)) {
+		rte_free(lcores);
+		lua_error(l);
+	}
+	return 0;
+}
+
 static const struct luaL_reg gatekeeper [] = {
 	{"list_lcores",			l_list_lcores},
 	{"rte_lcore_to_socket_id",	l_rte_lcore_to_socket_id},
 	{"gk_assign_lcores",		l_gk_assign_lcores},
 	{"gt_assign_lcores",		l_gt_assign_lcores},
+	{"sol_assign_lcores",		l_sol_assign_lcores},
 	{NULL,				NULL}	/* Sentinel. */
 };
 
@@ -265,8 +350,11 @@ config_gatekeeper(void)
 	char lua_entry_path[128];
 	lua_State *lua_state;
 
+	/* The configuration of the benchmark overrides the regular one. */
 	ret = snprintf(lua_entry_path, sizeof(lua_entry_path), \
-			"%s/%s", LUA_BASE_DIR, GATEKEEPER_CONFIG_FILE);
+			"%s/%s", bench_hooks != NULL ?
+			bench_hooks->lua_base_dir : LUA_BASE_DIR,
+			GATEKEEPER_CONFIG_FILE);
 	RTE_VERIFY(ret > 0 && ret < (int)sizeof(lua_entry_path));
 
 	lua_state = luaL_newstate();
@@ -278,6 +366,8 @@ config_gatekeeper(void)
 
 	luaL_openlibs(lua_state);
 	luaL_register(lua_state, "gatekeeper", gatekeeper);
+	if (bench_hooks != NULL)
+		set_lua_path(lua_state, bench_hooks->lua_base_dir);
 	set_lua_path(lua_state, LUA_BASE_DIR);
 	ret = luaL_loadfile(lua_state, lua_entry_path);
 	if (ret != 0) {
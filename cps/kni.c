@@ -699,7 +699,10 @@ new_route(struct route_update *update, struct cps_config *cps_conf)
 
 	if (update->family == AF_INET) {
 		proto = ETHER_TYPE_IPv4;
+		/* A bulk load may replace the LPM table. */
+		rte_spinlock_lock_tm(&ltbl->lock);
 		gw_fib_id = lpm_lookup_ipv4(ltbl->lpm, update->gw.v4.s_addr);
+		rte_spinlock_unlock_tm(&ltbl->lock);
 		if (gw_fib_id < 0)
 			return -1;
 		gw_fib = &ltbl->fib_tbl[gw_fib_id];
@@ -713,7 +716,9 @@ new_route(struct route_update *update, struct cps_config *cps_conf)
 		RTE_VERIFY(ret > 0 && ret < (int)sizeof(ipp_buf));
 	} else if (likely(update->family == AF_INET6)) {
 		proto = ETHER_TYPE_IPv6;
+		rte_spinlock_lock_tm(&ltbl->lock);
 		gw_fib_id = lpm_lookup_ipv6(ltbl->lpm6, update->gw.v6.s6_addr);
+		rte_spinlock_unlock_tm(&ltbl->lock);
 		if (gw_fib_id < 0)
 			return -1;
 		gw_fib = &ltbl->fib_tbl6[gw_fib_id];
@@ -24,6 +24,7 @@
 #include "gatekeeper_cps.h"
 #include "gatekeeper_launch.h"
 #include "gatekeeper_lls.h"
+#include "gatekeeper_log_ratelimit.h"
 #include "gatekeeper_varip.h"
 #include "kni.h"
 
@@ -302,8 +303,8 @@ process_kni_request(struct rte_kni *kni)
 }
 
 static void
-process_ingress(struct gatekeeper_if *iface, struct rte_kni *kni,
-	uint16_t rx_queue)
+process_ingress(struct cps_config *cps_conf, struct gatekeeper_if *iface,
+	struct rte_kni *kni, uint16_t rx_queue)
 {
 	struct rte_mbuf *rx_bufs[GATEKEEPER_MAX_PKT_BURST];
 	uint16_t num_rx = rte_eth_rx_burst(iface->id, rx_queue, rx_bufs,
@@ -312,6 +313,8 @@ process_ingress(struct gatekeeper_if *iface, struct rte_kni *kni,
 	uint16_t num_tx;
 	uint16_t i;
 
+	stats_add(cps_conf->stats, STATS_PKTS_RX, num_rx);
+
 	if (!iface->vlan_insert) {
 		num_kni = num_rx;
 		goto kni_tx;
@@ -328,7 +331,7 @@ process_ingress(struct gatekeeper_if *iface, struct rte_kni *kni,
 
 		if (unlikely(eth_hdr->ether_type !=
 				rte_cpu_to_be_16(ETHER_TYPE_VLAN))) {
-			RTE_LOG(WARNING, GATEKEEPER,
+			LOG_RATELIMIT(WARNING, GATEKEEPER,
 				"cps: %s iface is configured for VLAN but received a non-VLAN packet\n",
 				iface->name);
 			goto to_kni;
@@ -355,6 +358,7 @@ to_kni:
 
 kni_tx:
 	num_tx = rte_kni_tx_burst(kni, rx_bufs, num_kni);
+	stats_add(cps_conf->stats, STATS_CPS_PKTS_TO_KNI, num_tx);
 	if (unlikely(num_tx < num_kni)) {
 		for (i = num_tx; i < num_kni; i++)
 			rte_pktmbuf_free(rx_bufs[i]);
@@ -396,18 +400,19 @@ pkt_is_nd(struct gatekeeper_if *iface, struct ether_hdr *eth_hdr,
 
 static void
 process_egress(struct cps_config *cps_conf, struct gatekeeper_if *iface,
-	struct rte_kni *kni, uint16_t tx_queue)
+	struct rte_kni *kni, struct tx_buffer *txb)
 {
 	struct rte_mbuf *bufs[GATEKEEPER_MAX_PKT_BURST];
 	struct rte_mbuf *forward_bufs[GATEKEEPER_MAX_PKT_BURST];
 	uint16_t num_rx = rte_kni_rx_burst(kni, bufs, GATEKEEPER_MAX_PKT_BURST);
 	uint16_t num_forward = 0;
-	unsigned int num_tx;
 	unsigned int i;
 
 	if (num_rx == 0)
 		return;
 
+	stats_add(cps_conf->stats, STATS_CPS_PKTS_FROM_KNI, num_rx);
+
 	for (i = 0; i < num_rx; i++) {
 		/* Packets sent by the KNI do not have VLAN headers. */
 		struct ether_hdr *eth_hdr = rte_pktmbuf_mtod(bufs[i],
@@ -458,12 +463,8 @@ to_eth:
 		}
 	}
 
-	num_tx = rte_eth_tx_burst(iface->id, tx_queue,
-		forward_bufs, num_forward);
-	if (unlikely(num_tx < num_forward)) {
-		for (i = num_tx; i < num_forward; i++)
-			rte_pktmbuf_free(forward_bufs[i]);
-	}
+	txb_add_bulk(txb, forward_bufs, num_forward);
+	txb_flush(txb);
 }
 
 static int
@@ -481,20 +482,31 @@ cps_proc(void *arg)
 		"cps: the CPS block is running at lcore = %u\n",
 		cps_conf->lcore_id);
 
+	cps_conf->stats = stats_register(cps_conf->lcore_id, STATS_BLOCK_CPS);
+
+	txb_init(&cps_conf->tx_front, front_iface->id,
+		cps_conf->tx_queue_front);
+	if (net_conf->back_iface_enabled) {
+		txb_init(&cps_conf->tx_back, back_iface->id,
+			cps_conf->tx_queue_back);
+	}
+
 	while (likely(!exiting)) {
+		uint64_t now;
+
 		/*
 		 * Read in IPv4 BGP packets that arrive directly
 		 * on the Gatekeeper interfaces.
 		 */
 		if (front_iface->hw_filter_ntuple) {
-			process_ingress(front_iface, front_kni,
+			process_ingress(cps_conf, front_iface, front_kni,
 				cps_conf->rx_queue_front);
 		}
 		process_kni_request(front_kni);
 
 		if (net_conf->back_iface_enabled) {
 			if (back_iface->hw_filter_ntuple) {
-				process_ingress(back_iface, back_kni,
+				process_ingress(cps_conf, back_iface, back_kni,
 					cps_conf->rx_queue_back);
 			}
 			process_kni_request(back_kni);
@@ -511,10 +523,19 @@ cps_proc(void *arg)
 		 * transmit to respective Gatekeeper interfaces.
 		 */
 		process_egress(cps_conf, front_iface, front_kni,
-			cps_conf->tx_queue_front);
+			&cps_conf->tx_front);
 		if (net_conf->back_iface_enabled)
 			process_egress(cps_conf, back_iface, back_kni,
-				cps_conf->tx_queue_back);
+				&cps_conf->tx_back);
+
+		now = rte_rdtsc();
+		txb_drain(&cps_conf->tx_front, now);
+		if (net_conf->back_iface_enabled)
+			txb_drain(&cps_conf->tx_back, now);
+		log_ratelimit_flush(now);
+		stats_set(cps_conf->stats, STATS_TX_DROPS,
+			cps_conf->tx_front.num_dropped +
+			cps_conf->tx_back.num_dropped);
 
 		/* Periodically scan resolution requests from KNIs. */
 		rte_timer_manage();
@@ -523,6 +544,10 @@ cps_proc(void *arg)
 		kni_cps_route_event(cps_conf);
 	}
 
+	txb_free(&cps_conf->tx_front, "cps");
+	if (net_conf->back_iface_enabled)
+		txb_free(&cps_conf->tx_back, "cps");
+
 	RTE_LOG(NOTICE, GATEKEEPER,
 		"cps: the CPS block at lcore = %u is exiting\n",
 		cps_conf->lcore_id);
@@ -837,7 +862,7 @@ match_bgp4(struct rte_mbuf *pkt, struct gatekeeper_if *iface)
 		return -ENOENT;
 
 	if (pkt->data_len < minimum_size) {
-		RTE_LOG(NOTICE, GATEKEEPER, "cps: IPv4 BGP packet received is %"PRIx16" bytes but should be at least %hu bytes\n",
+		LOG_RATELIMIT(NOTICE, GATEKEEPER, "cps: IPv4 BGP packet received is %"PRIx16" bytes but should be at least %hu bytes\n",
 			pkt->data_len, minimum_size);
 		return -ENOENT;
 	}
@@ -851,7 +876,7 @@ match_bgp4(struct rte_mbuf *pkt, struct gatekeeper_if *iface)
 	minimum_size = sizeof(*eth_hdr) + ipv4_hdr_len(ip4hdr) +
 		sizeof(*tcp_hdr);
 	if (pkt->data_len < minimum_size) {
-		RTE_LOG(NOTICE, GATEKEEPER, "cps: IPv4 BGP packet received is %"PRIx16" bytes but should be at least %hu bytes\n",
+		LOG_RATELIMIT(NOTICE, GATEKEEPER, "cps: IPv4 BGP packet received is %"PRIx16" bytes but should be at least %hu bytes\n",
 			pkt->data_len, minimum_size);
 		return -ENOENT;
 	}
@@ -894,7 +919,7 @@ match_bgp6(struct rte_mbuf *pkt, struct gatekeeper_if *iface)
 		return -ENOENT;
 
 	if (pkt->data_len < minimum_size) {
-		RTE_LOG(NOTICE, GATEKEEPER, "cps: IPv6 BGP packet received is %"PRIx16" bytes but should be at least %hu bytes\n",
+		LOG_RATELIMIT(NOTICE, GATEKEEPER, "cps: IPv6 BGP packet received is %"PRIx16" bytes but should be at least %hu bytes\n",
 			pkt->data_len, minimum_size);
 		return -ENOENT;
 	}
@@ -909,7 +934,7 @@ match_bgp6(struct rte_mbuf *pkt, struct gatekeeper_if *iface)
 
 	minimum_size += tcp_offset - sizeof(*ip6hdr);
 	if (pkt->data_len < minimum_size) {
-		RTE_LOG(NOTICE, GATEKEEPER, "cps: IPv6 BGP packet received is %"PRIx16" bytes but should be at least %hu bytes\n",
+		LOG_RATELIMIT(NOTICE, GATEKEEPER, "cps: IPv6 BGP packet received is %"PRIx16" bytes but should be at least %hu bytes\n",
 			pkt->data_len, minimum_size);
 		return -ENOENT;
 	}
@@ -24,6 +24,7 @@
 #include <rte_lcore.h>
 #include <rte_malloc.h>
 #include <rte_ethdev.h>
+#include <rte_cycles.h>
 #include <rte_atomic.h>
 
 #include "gatekeeper_acl.h"
@@ -34,6 +35,7 @@
 #include "gatekeeper_launch.h"
 #include "gatekeeper_l2.h"
 #include "gatekeeper_varip.h"
+#include "gatekeeper_log_ratelimit.h"
 
 /* XXX Sample parameter, needs to be tested for better performance. */
 #define GGU_REQ_BURST_SIZE (32)
@@ -57,6 +59,8 @@ process_single_policy(const struct ggu_policy *policy, const struct ggu_config *
 	struct mailbox *mb =
 		get_responsible_gk_mailbox(&policy->flow, ggu_conf->gk);
 
+	stats_inc(ggu_conf->stats, STATS_GGU_POLICIES);
+
 	if (mb == NULL)
 		return;
 
@@ -90,7 +94,7 @@ process_single_policy(const struct ggu_policy *policy, const struct ggu_config *
 		break;
 
 	default:
-		RTE_LOG(ERR, GATEKEEPER, "ggu: impossible policy state %hhu\n",
+		LOG_RATELIMIT(ERR, GATEKEEPER, "ggu: impossible policy state %hhu\n",
 			policy->state);
 		mb_free_entry(mb, entry);
 		return;
@@ -114,10 +118,13 @@ process_single_packet(struct rte_mbuf *pkt, const struct ggu_config *ggu_conf)
 	uint16_t real_payload_len;
 	uint16_t expected_payload_len;
 	struct ggu_policy policy;
+	struct ipaddr gt_addr;
 	struct gatekeeper_if *back = &ggu_conf->net->back;
 	uint16_t minimum_size;
 	size_t l2_len;
 
+	stats_inc(ggu_conf->stats, STATS_PKTS_RX);
+
 	eth_hdr = rte_pktmbuf_mtod(pkt, struct ether_hdr *);
 	ether_type = rte_be_to_cpu_16(pkt_in_skip_l2(pkt, eth_hdr, &l3_hdr));
 	l2_len = pkt_in_l2_hdr_len(pkt);
@@ -128,7 +135,7 @@ process_single_packet(struct rte_mbuf *pkt, const struct ggu_config *ggu_conf)
 		minimum_size += sizeof(struct ipv4_hdr) +
 			sizeof(struct udp_hdr) + sizeof(struct ggu_common_hdr);
 		if (pkt->data_len < minimum_size) {
-			RTE_LOG(NOTICE, GATEKEEPER,
+			LOG_RATELIMIT(NOTICE, GATEKEEPER,
 				"ggu: the IPv4 packet's actual size is %hu, which doesn't have the minimum expected size %hu\n",
 				pkt->data_len, minimum_size);
 			goto free_packet;
@@ -136,14 +143,14 @@ process_single_packet(struct rte_mbuf *pkt, const struct ggu_config *ggu_conf)
 
 		ip4hdr = l3_hdr;
 		if (ip4hdr->next_proto_id != IPPROTO_UDP) {
-			RTE_LOG(ERR, GATEKEEPER,
+			LOG_RATELIMIT(ERR, GATEKEEPER,
 				"ggu: received non-UDP packets, IPv4 %s bug!\n",
 				filter_name(back));
 			goto free_packet;
 		}
 
 		if (ip4hdr->dst_addr != back->ip4_addr.s_addr) {
-			RTE_LOG(ERR, GATEKEEPER,
+			LOG_RATELIMIT(ERR, GATEKEEPER,
 				"ggu: received packets not destined to the Gatekeeper server, IPv4 %s bug!\n",
 				filter_name(back));
 			goto free_packet;
@@ -151,7 +158,7 @@ process_single_packet(struct rte_mbuf *pkt, const struct ggu_config *ggu_conf)
 
 		minimum_size += ipv4_hdr_len(ip4hdr) - sizeof(*ip4hdr);
 		if (pkt->data_len < minimum_size) {
-			RTE_LOG(NOTICE, GATEKEEPER,
+			LOG_RATELIMIT(NOTICE, GATEKEEPER,
 				"ggu: the IPv4 packet's actual size is %hu, which doesn't have the minimum expected size %hu\n",
 				pkt->data_len, minimum_size);
 			goto free_packet;
@@ -162,6 +169,9 @@ process_single_packet(struct rte_mbuf *pkt, const struct ggu_config *ggu_conf)
 		 * The following code parses IPv4 variable headers.
 		 */
 		udphdr = (struct udp_hdr *)ipv4_skip_exthdr(ip4hdr);
+
+		gt_addr.proto = ETHER_TYPE_IPv4;
+		gt_addr.ip.v4.s_addr = ip4hdr->src_addr;
 		break;
 
 	case ETHER_TYPE_IPv6: {
@@ -175,7 +185,7 @@ process_single_packet(struct rte_mbuf *pkt, const struct ggu_config *ggu_conf)
 		minimum_size += sizeof(struct ipv6_hdr) +
 			sizeof(struct udp_hdr) + sizeof(struct ggu_common_hdr);
 		if (pkt->data_len < minimum_size) {
-			RTE_LOG(NOTICE, GATEKEEPER,
+			LOG_RATELIMIT(NOTICE, GATEKEEPER,
 				"ggu: the IPv6 packet's actual size is %hu, which doesn't have the minimum expected size %hu\n",
 				pkt->data_len, minimum_size);
 			goto free_packet;
@@ -196,7 +206,7 @@ process_single_packet(struct rte_mbuf *pkt, const struct ggu_config *ggu_conf)
 		if (back->hw_filter_ntuple && memcmp(ip6hdr->dst_addr,
 				back->ip6_addr.s6_addr,
 				sizeof(ip6hdr->dst_addr)) != 0) {
-			RTE_LOG(NOTICE, GATEKEEPER,
+			LOG_RATELIMIT(NOTICE, GATEKEEPER,
 				"ggu: received an IPv6 packet destinated to other host!\n");
 			return;
 		}
@@ -204,13 +214,13 @@ process_single_packet(struct rte_mbuf *pkt, const struct ggu_config *ggu_conf)
 		udp_offset = ipv6_skip_exthdr(ip6hdr, pkt->data_len - l2_len,
 			&nexthdr);
 		if (udp_offset < 0) {
-			RTE_LOG(ERR, GATEKEEPER,
+			LOG_RATELIMIT(ERR, GATEKEEPER,
 				"ggu: failed to parse the IPv6 packet's extension headers!\n");
 			goto free_packet;
 		}
 
 		if (nexthdr != IPPROTO_UDP) {
-			RTE_LOG(ERR, GATEKEEPER,
+			LOG_RATELIMIT(ERR, GATEKEEPER,
 				"ggu: received non-UDP packets, IPv6 %s bug!\n",
 				filter_name(back));
 			goto free_packet;
@@ -218,18 +228,22 @@ process_single_packet(struct rte_mbuf *pkt, const struct ggu_config *ggu_conf)
 
 		minimum_size += udp_offset - sizeof(*ip6hdr);
 		if (pkt->data_len < minimum_size) {
-			RTE_LOG(NOTICE, GATEKEEPER,
+			LOG_RATELIMIT(NOTICE, GATEKEEPER,
 				"ggu: the IPv6 packet's actual size is %hu, which doesn't have the minimum expected size %hu\n",
 				pkt->data_len, minimum_size);
 			goto free_packet;
 		}
 
 		udphdr = (struct udp_hdr *)((uint8_t *)ip6hdr + udp_offset);
+
+		gt_addr.proto = ETHER_TYPE_IPv6;
+		rte_memcpy(gt_addr.ip.v6.s6_addr, ip6hdr->src_addr,
+			sizeof(gt_addr.ip.v6.s6_addr));
 		break;
 	}
 
 	default:
-		RTE_LOG(NOTICE, GATEKEEPER,
+		LOG_RATELIMIT(NOTICE, GATEKEEPER,
 			"ggu: unknown network layer protocol %hu\n",
 			ether_type);
 		goto free_packet;
@@ -238,7 +252,7 @@ process_single_packet(struct rte_mbuf *pkt, const struct ggu_config *ggu_conf)
 
 	if (udphdr->src_port != ggu_conf->ggu_src_port ||
 			udphdr->dst_port != ggu_conf->ggu_dst_port) {
-		RTE_LOG(ERR, GATEKEEPER,
+		LOG_RATELIMIT(ERR, GATEKEEPER,
 			"ggu: unknown udp src port %hu, dst port %hu, %s bug!\n",
 			rte_be_to_cpu_16(udphdr->src_port),
 			rte_be_to_cpu_16(udphdr->dst_port),
@@ -250,7 +264,7 @@ process_single_packet(struct rte_mbuf *pkt, const struct ggu_config *ggu_conf)
 
 	gguhdr = (struct ggu_common_hdr *)&udphdr[1];
 	if (gguhdr->v1 != GGU_PD_VER1) {
-		RTE_LOG(NOTICE, GATEKEEPER,
+		LOG_RATELIMIT(NOTICE, GATEKEEPER,
 			"ggu: unknown policy decision format %hhu\n",
 			gguhdr->v1);
 		goto free_packet;
@@ -265,12 +279,17 @@ process_single_packet(struct rte_mbuf *pkt, const struct ggu_config *ggu_conf)
 		(gguhdr->n1 + gguhdr->n2) * sizeof(policy.params.u.declined) + 
 		(gguhdr->n3 + gguhdr->n4) * sizeof(policy.params.u.granted);
 	if (real_payload_len < expected_payload_len) {
-		RTE_LOG(NOTICE, GATEKEEPER,
+		LOG_RATELIMIT(NOTICE, GATEKEEPER,
 			"ggu: the size (%hu) of the payload available in the UDP header doesn't match the expected size (%hu)!\n",
 			real_payload_len, expected_payload_len);
 		goto free_packet;
 	}
 
+	if (gguhdr->flags & GGU_FLAG_HEADROOM) {
+		sol_report_grantor_headroom(ggu_conf->gk->sol_conf,
+			&gt_addr, gguhdr->headroom);
+	}
+
 	/* Loop over each policy decision on the packet. */
 
 	/* Process the IPv4 decline decisions. */
@@ -348,7 +367,7 @@ submit_ggu(struct rte_mbuf **pkts, unsigned int num_pkts,
 	RTE_VERIFY(num_pkts <= RTE_DIM(req->pkts));
 
 	if (req == NULL) {
-		RTE_LOG(ERR, GATEKEEPER,
+		LOG_RATELIMIT(ERR, GATEKEEPER,
 			"ggu: %s: allocation of mailbox message failed\n",
 			__func__);
 		ret = -ENOMEM;
@@ -360,7 +379,7 @@ submit_ggu(struct rte_mbuf **pkts, unsigned int num_pkts,
 
 	ret = mb_send_entry(&ggu_conf->mailbox, req);
 	if (ret < 0) {
-		RTE_LOG(ERR, GATEKEEPER,
+		LOG_RATELIMIT(ERR, GATEKEEPER,
 			"ggu: %s: failed to enqueue message to mailbox\n",
 			__func__);
 		goto free_pkts;
@@ -386,6 +405,8 @@ ggu_proc(void *arg)
 	RTE_LOG(NOTICE, GATEKEEPER,
 		"ggu: the GK-GT unit is running at lcore = %u\n", lcore);
 
+	ggu_conf->stats = stats_register(lcore, STATS_BLOCK_GGU);
+
 	/*
 	 * Load a set of GK-GT packets from the back NIC
 	 * or from the GGU mailbox.
@@ -396,6 +417,7 @@ ggu_proc(void *arg)
 			uint16_t num_rx = rte_eth_rx_burst(port_in, rx_queue,
 				bufs, GATEKEEPER_MAX_PKT_BURST);
 
+			log_ratelimit_flush(rte_rdtsc());
 			if (unlikely(num_rx == 0))
 				continue;
 
@@ -409,6 +431,7 @@ ggu_proc(void *arg)
 				mb_dequeue_burst(&ggu_conf->mailbox,
 				(void **)reqs, GGU_REQ_BURST_SIZE);
 
+			log_ratelimit_flush(rte_rdtsc());
 			if (unlikely(num_reqs == 0))
 				continue;
 
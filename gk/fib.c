@@ -16,8 +16,11 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
 #include <stddef.h>
 
+#include <rte_malloc.h>
+
 #include "gatekeeper_fib.h"
 #include "gatekeeper_gk.h"
 #include "gatekeeper_l2.h"
@@ -40,18 +43,35 @@ destroy_neigh_hash_table(struct neighbor_hash_table *neigh)
 	neigh->tbl_size = 0;
 }
 
+/*
+ * The LPM tables that writers update. During a bulk load,
+ * these are the shadow LPM tables, which the GK blocks do not read.
+ */
+static inline struct rte_lpm *
+writable_lpm_locked(struct gk_lpm *ltbl)
+{
+	return ltbl->bulk_loading ? ltbl->shadow_lpm : ltbl->lpm;
+}
+
+static inline struct rte_lpm6 *
+writable_lpm6_locked(struct gk_lpm *ltbl)
+{
+	return ltbl->bulk_loading ? ltbl->shadow_lpm6 : ltbl->lpm6;
+}
+
 static inline int
 gk_lpm_add_ipv4_route(uint32_t ip,
 	uint8_t depth, uint32_t nexthop, struct gk_lpm *ltbl)
 {
-	return rte_lpm_add(ltbl->lpm, ntohl(ip), depth, nexthop);
+	return rte_lpm_add(writable_lpm_locked(ltbl),
+		ntohl(ip), depth, nexthop);
 }
 
 static inline int
 gk_lpm_add_ipv6_route(uint8_t *ip,
 	uint8_t depth, uint32_t nexthop, struct gk_lpm *ltbl)
 {
-	return rte_lpm6_add(ltbl->lpm6, ip, depth, nexthop);
+	return rte_lpm6_add(writable_lpm6_locked(ltbl), ip, depth, nexthop);
 }
 
 /*
@@ -200,81 +220,6 @@ eth_cache_cleanup:
 	return NULL;
 }
 
-static int
-parse_ip_prefix(const char *ip_prefix, struct ipaddr *res)
-{
-	/* Need to make copy to tokenize. */
-	size_t ip_prefix_len = ip_prefix != NULL ? strlen(ip_prefix) : 0;
-	char ip_prefix_copy[ip_prefix_len + 1];
-	char *ip_addr;
-
-	char *saveptr;
-	char *prefix_len_str;
-	char *end;
-	long prefix_len;
-	int ip_type;
-
-	if (ip_prefix == NULL)
-		return -1;
-
-	strncpy(ip_prefix_copy, ip_prefix, ip_prefix_len + 1);
-
-	ip_addr = strtok_r(ip_prefix_copy, "/", &saveptr);
-	if (ip_addr == NULL) {
-		RTE_LOG(ERR, GATEKEEPER,
-			"gk: failed to parse IP address in IP prefix %s at %s\n",
-			ip_prefix, __func__);
-		return -1;
-	}
-
-	ip_type = get_ip_type(ip_addr);
-	if (ip_type != AF_INET && ip_type != AF_INET6)
-		return -1;
-
-	prefix_len_str = strtok_r(NULL, "\0", &saveptr);
-	if (prefix_len_str == NULL) {
-		RTE_LOG(ERR, GATEKEEPER,
-			"gk: failed to parse prefix length in IP prefix %s at %s\n",
-			ip_prefix, __func__);
-		return -1;
-	}
-
-	prefix_len = strtol(prefix_len_str, &end, 10);
-	if (prefix_len_str == end || !*prefix_len_str || *end) {
-		RTE_LOG(ERR, GATEKEEPER,
-			"gk: prefix length \"%s\" is not a number\n",
-			prefix_len_str);
-		return -1;
-	}
-
-	if ((prefix_len == LONG_MAX || prefix_len == LONG_MIN) &&
-			errno == ERANGE) {
-		RTE_LOG(ERR, GATEKEEPER,
-			"gk: prefix length \"%s\" caused underflow or overflow\n",
-			prefix_len_str);
-		return -1;
-	}
-
-	if (prefix_len < 0 || prefix_len > max_prefix_len(ip_type)) {
-		RTE_LOG(ERR, GATEKEEPER,
-			"gk: prefix length \"%s\" is out of range\n",
-			prefix_len_str);
-		return -1;
-	}
-
-	if (convert_str_to_ip(ip_addr, res) < 0) {
-		RTE_LOG(ERR, GATEKEEPER,
-			"gk: the IP address part of the IP prefix %s is not valid\n",
-			ip_prefix);
-		return -1;
-	}
-
-	RTE_VERIFY((ip_type == AF_INET && res->proto == ETHER_TYPE_IPv4) ||
-		(ip_type == AF_INET6 && res->proto == ETHER_TYPE_IPv6));
-
-	return prefix_len;
-}
-
 /* Warning: avoid calling this function directly, prefer get_empty_fib_id(). */
 static int
 __get_empty_fib_id(struct gk_fib *fib_tbl,
@@ -350,12 +295,12 @@ static inline int
 lpm_del_route(struct ipaddr *ip_addr, int prefix_len, struct gk_lpm *ltbl)
 {
 	if (ip_addr->proto == ETHER_TYPE_IPv4) {
-		return rte_lpm_delete(ltbl->lpm,
+		return rte_lpm_delete(writable_lpm_locked(ltbl),
 			ntohl(ip_addr->ip.v4.s_addr), prefix_len);
 	}
 
 	if (likely(ip_addr->proto == ETHER_TYPE_IPv6)) {
-		return rte_lpm6_delete(ltbl->lpm6,
+		return rte_lpm6_delete(writable_lpm6_locked(ltbl),
 			ip_addr->ip.v6.s6_addr, prefix_len);
 	}
 
@@ -611,25 +556,48 @@ out:
 	return ret;
 }
 
+/*
+ * The GK blocks only need one IPv4 LPM table on the @socket_id
+ * at a time, so the @lcore is set to 0. The @identifier tells apart
+ * the generations of LPM tables created by bulk loads.
+ */
+static struct rte_lpm *
+new_ipv4_lpm(struct gk_config *gk_conf, unsigned int socket_id,
+	unsigned int identifier)
+{
+	struct rte_lpm_config ipv4_lpm_config;
+
+	ipv4_lpm_config.max_rules = gk_conf->max_num_ipv4_rules;
+	ipv4_lpm_config.number_tbl8s = gk_conf->num_ipv4_tbl8s;
+	ipv4_lpm_config.flags = 0;
+
+	return init_ipv4_lpm("gk", &ipv4_lpm_config, socket_id, 0,
+		identifier);
+}
+
+/* Similar to new_ipv4_lpm(), see above. */
+static struct rte_lpm6 *
+new_ipv6_lpm(struct gk_config *gk_conf, unsigned int socket_id,
+	unsigned int identifier)
+{
+	struct rte_lpm6_config ipv6_lpm_config;
+
+	ipv6_lpm_config.max_rules = gk_conf->max_num_ipv6_rules;
+	ipv6_lpm_config.number_tbl8s = gk_conf->num_ipv6_tbl8s;
+	ipv6_lpm_config.flags = 0;
+
+	return init_ipv6_lpm("gk", &ipv6_lpm_config, socket_id, 0,
+		identifier);
+}
+
 int
 setup_gk_lpm(struct gk_config *gk_conf, unsigned int socket_id)
 {
 	int ret;
-	struct rte_lpm_config ipv4_lpm_config;
-	struct rte_lpm6_config ipv6_lpm_config;
 	struct gk_lpm *ltbl = &gk_conf->lpm_tbl;
 
 	if (ipv4_configured(gk_conf->net)) {
-		ipv4_lpm_config.max_rules = gk_conf->max_num_ipv4_rules;
-		ipv4_lpm_config.number_tbl8s = gk_conf->num_ipv4_tbl8s;
-
-		/*
-		 * The GK blocks only need to create one single
-		 * IPv4 LPM table on the @socket_id, so the
-		 * @lcore and @identifier are set to 0.
-		 */
-		ltbl->lpm = init_ipv4_lpm(
-			"gk", &ipv4_lpm_config, socket_id, 0, 0);
+		ltbl->lpm = new_ipv4_lpm(gk_conf, socket_id, 0);
 		if (ltbl->lpm == NULL) {
 			RTE_LOG(ERR, GATEKEEPER,
 				"gk: failed to initialize the IPv4 LPM table at %s\n",
@@ -651,16 +619,7 @@ setup_gk_lpm(struct gk_config *gk_conf, unsigned int socket_id)
 	}
 
 	if (ipv6_configured(gk_conf->net)) {
-		ipv6_lpm_config.max_rules = gk_conf->max_num_ipv6_rules;
-		ipv6_lpm_config.number_tbl8s = gk_conf->num_ipv6_tbl8s;
-
-		/*
-		 * The GK blocks only need to create one single
-		 * IPv6 LPM table on the @socket_id, so the
-		 * @lcore and @identifier are set to 0.
-		 */
-		ltbl->lpm6 = init_ipv6_lpm(
-			"gk", &ipv6_lpm_config, socket_id, 0, 0);
+		ltbl->lpm6 = new_ipv6_lpm(gk_conf, socket_id, 0);
 		if (ltbl->lpm6 == NULL) {
 			RTE_LOG(ERR, GATEKEEPER,
 				"gk: failed to initialize the IPv6 LPM table at %s\n",
@@ -718,83 +677,6 @@ out:
 	return ret;
 }
 
-static int
-notify_gk_instance(struct gk_fib *fib, struct gk_instance *instance)
-{
-	int ret;
-	struct mailbox *mb = &instance->mb;
-	struct gk_cmd_entry *entry = mb_alloc_entry(mb);
-	if (entry == NULL) {
-		RTE_LOG(ERR, GATEKEEPER,
-			"gk: failed to allocate a `struct gk_cmd_entry` entry at %s\n",
-			__func__);
-		return -1;
-	}
-
-	entry->op = GK_SYNCH_WITH_LPM;
-	entry->u.fib = fib;
-
-	ret = mb_send_entry(mb, entry);
-	if (ret < 0) {
-		RTE_LOG(ERR, GATEKEEPER,
-			"gk: failed to send a `struct gk_cmd_entry` entry at %s\n",
-			__func__);
-		return -1;
-	}
-
-	return 0;
-}
-
-/*
- * XXX What we are doing here is analogous to RCU's synchronize_rcu(),
- * what suggests that we may be able to profit from RCU. But we are going
- * to postpone that until we have a better case to bring RCU to Gatekeeper.
- */
-static void
-synchronize_gk_instances(struct gk_fib *fib, struct gk_config *gk_conf)
-{
-	int i, loop;
-	int num_succ_notified_inst = 0;
-	bool is_succ_notified[gk_conf->num_lcores];
-
-	/* The maximum number of times to try to notify the GK instances. */
-	const int MAX_NUM_NOTIFY_TRY = 3;
-
-	rte_atomic16_init(&fib->num_updated_instances);
-
-	memset(is_succ_notified, false, sizeof(is_succ_notified));
-
-	for (loop = 0; loop < MAX_NUM_NOTIFY_TRY; loop++) {
-		/* Send the FIB entry to the GK mailboxes. */
-		for (i = 0; i < gk_conf->num_lcores; i++) {
-			if (!is_succ_notified[i]) {
-				int ret = notify_gk_instance(fib,
-					&gk_conf->instances[i]);
-				if (ret == 0) {
-					is_succ_notified[i] = true;
-					num_succ_notified_inst++;
-					if (num_succ_notified_inst >=
-							gk_conf->num_lcores)
-						goto finish_notify;
-				}
-			}
-		}
-	}
-
-finish_notify:
-
-	if (num_succ_notified_inst != gk_conf->num_lcores) {
-		RTE_LOG(WARNING, GATEKEEPER,
-			"gk: %s successfully notifies only %d/%d instances\n",
-			__func__, num_succ_notified_inst, gk_conf->num_lcores);
-	}
-
-	/* Wait for all GK instances to synchronize. */
-	while (rte_atomic16_read(&fib->num_updated_instances)
-			< num_succ_notified_inst)
-		rte_pause();
-}
-
 /*
  * This function is called by del_fib_entry_locked().
  * Notice that, it doesn't stand on its own, and it's only
@@ -813,7 +695,8 @@ remove_prefix_from_lpm_locked(
 		uint32_t fib_id;
 
 		ip_prefix_present = rte_lpm_is_rule_present(
-			ltbl->lpm, ntohl(ip_prefix->addr.ip.v4.s_addr),
+			writable_lpm_locked(ltbl),
+			ntohl(ip_prefix->addr.ip.v4.s_addr),
 			ip_prefix->len, &fib_id);
 		if (!ip_prefix_present) {
 			RTE_LOG(WARNING, GATEKEEPER,
@@ -827,7 +710,8 @@ remove_prefix_from_lpm_locked(
 		uint32_t fib_id;
 
 		ip_prefix_present = rte_lpm6_is_rule_present(
-			ltbl->lpm6, ip_prefix->addr.ip.v6.s6_addr,
+			writable_lpm6_locked(ltbl),
+			ip_prefix->addr.ip.v6.s6_addr,
 			ip_prefix->len, &fib_id);
 		if (!ip_prefix_present) {
 			RTE_LOG(WARNING, GATEKEEPER,
@@ -855,6 +739,13 @@ remove_prefix_from_lpm_locked(
 	return ip_prefix_fib;
 }
 
+static inline bool
+is_neighbor_fib(const struct gk_fib *fib)
+{
+	return fib->action == GK_FWD_NEIGHBOR_FRONT_NET ||
+		fib->action == GK_FWD_NEIGHBOR_BACK_NET;
+}
+
 /*
  * Note that, @action should be either GK_FWD_GATEWAY_FRONT_NET
  * or GK_FWD_GATEWAY_BACK_NET.
@@ -881,7 +772,8 @@ find_fib_entry_for_neighbor_locked(struct ipaddr *gw_addr,
 
 	if (gw_addr->proto == ETHER_TYPE_IPv4 &&
 			ipv4_if_configured(iface)) {
-		fib_id = lpm_lookup_ipv4(ltbl->lpm, gw_addr->ip.v4.s_addr);
+		fib_id = lpm_lookup_ipv4(writable_lpm_locked(ltbl),
+			gw_addr->ip.v4.s_addr);
 		/*
 		 * Invalid gateway entry, since at least we should
 		 * obtain the FIB entry for the neighbor table.
@@ -892,7 +784,8 @@ find_fib_entry_for_neighbor_locked(struct ipaddr *gw_addr,
 		neigh_fib = &ltbl->fib_tbl[fib_id];
 	} else if (likely(gw_addr->proto == ETHER_TYPE_IPv6)
 			&& ipv6_if_configured(iface)) {
-		fib_id = lpm_lookup_ipv6(ltbl->lpm6, gw_addr->ip.v6.s6_addr);
+		fib_id = lpm_lookup_ipv6(writable_lpm6_locked(ltbl),
+			gw_addr->ip.v6.s6_addr);
 		/*
 		 * Invalid gateway entry, since at least we should
 		 * obtain the FIB entry for the neighbor table.
@@ -922,6 +815,122 @@ find_fib_entry_for_neighbor_locked(struct ipaddr *gw_addr,
 	return neigh_fib;
 }
 
+struct ether_cache_release {
+	struct ether_cache *eth_cache;
+	struct gk_config   *gk_conf;
+};
+
+/* Called by qsbr_reclaim() with the LPM table lock held. */
+static int
+release_ether_cache(void *arg)
+{
+	int ret;
+	struct ether_cache_release *rel = arg;
+	struct ipaddr *addr = &rel->eth_cache->ip_addr;
+
+	/*
+	 * The LLS block will call gk_arp_and_nd_req_cb(), which,
+	 * in turn, will call clear_ether_cache() to make @eth_cache
+	 * available again.
+	 */
+	if (addr->proto == ETHER_TYPE_IPv4) {
+		ret = put_arp((struct in_addr *)
+			&addr->ip.v4, rel->gk_conf->lcores[0]);
+	} else {
+		ret = put_nd((struct in6_addr *)
+			&addr->ip.v6, rel->gk_conf->lcores[0]);
+	}
+
+	/* Try again at the next reclamation. */
+	if (ret < 0)
+		return -EAGAIN;
+
+	rte_free(rel);
+	return 0;
+}
+
+static void
+defer_ether_cache_release_locked(struct ether_cache *eth_cache,
+	struct gk_config *gk_conf)
+{
+	struct ether_cache_release *rel =
+		rte_malloc("ether_cache_release", sizeof(*rel), 0);
+	if (rel == NULL)
+		goto leak;
+
+	rel->eth_cache = eth_cache;
+	rel->gk_conf = gk_conf;
+
+	if (qsbr_defer(&gk_conf->qsbr, release_ether_cache, rel) < 0) {
+		rte_free(rel);
+		goto leak;
+	}
+
+	return;
+
+leak:
+	RTE_LOG(CRIT, GATEKEEPER,
+		"gk: failed to defer the release of an Ethernet cache entry at %s, the entry will not be reused!\n",
+		__func__);
+}
+
+/* Whether the neighbor table of @neigh_fib holds @eth_cache. */
+static bool
+neighbor_fib_holds(struct gk_fib *neigh_fib, struct ether_cache *eth_cache)
+{
+	struct ipaddr *addr = &eth_cache->ip_addr;
+	void *data;
+	int ret;
+
+	if (!is_neighbor_fib(neigh_fib))
+		return false;
+
+	if (addr->proto == ETHER_TYPE_IPv4) {
+		ret = rte_hash_lookup_data(neigh_fib->u.neigh.hash_table,
+			&addr->ip.v4.s_addr, &data);
+	} else {
+		ret = rte_hash_lookup_data(neigh_fib->u.neigh6.hash_table,
+			addr->ip.v6.s6_addr, &data);
+	}
+
+	return ret >= 0 && data == eth_cache;
+}
+
+/*
+ * Find the neighbor FIB entry that holds @eth_cache without the LPM
+ * tables. A bulk load may have replaced the LPM tables since FIB
+ * entries that share @eth_cache were deleted, so the prefix of the
+ * neighbor FIB entry may no longer be in the LPM tables, or it may
+ * lead to another neighbor FIB entry.
+ */
+static struct gk_fib *
+find_neighbor_fib_of_ether_cache_locked(struct ether_cache *eth_cache,
+	struct gk_config *gk_conf)
+{
+	struct gk_lpm *ltbl = &gk_conf->lpm_tbl;
+	struct gk_fib *fib_tbl;
+	unsigned int num_fib_entries;
+	unsigned int i;
+
+	if (eth_cache->ip_addr.proto == ETHER_TYPE_IPv4) {
+		fib_tbl = ltbl->fib_tbl;
+		num_fib_entries = gk_conf->gk_max_num_ipv4_fib_entries;
+	} else {
+		fib_tbl = ltbl->fib_tbl6;
+		num_fib_entries = gk_conf->gk_max_num_ipv6_fib_entries;
+	}
+
+	if (fib_tbl == NULL)
+		return NULL;
+
+	for (i = 0; i < num_fib_entries; i++) {
+		if (neighbor_fib_holds(&fib_tbl[i], eth_cache))
+			return &fib_tbl[i];
+	}
+
+	return NULL;
+}
+
 static int
 ether_cache_put(struct gk_fib *neigh_fib,
 	enum gk_fib_action action, struct ether_cache *eth_cache,
@@ -947,67 +956,67 @@ ether_cache_put(struct gk_fib *neigh_fib,
 	if (neighbor_fib == NULL) {
 		neighbor_fib = find_fib_entry_for_neighbor_locked(
 			addr, action, gk_conf);
+		if (neighbor_fib == NULL ||
+				!neighbor_fib_holds(neighbor_fib, eth_cache)) {
+			neighbor_fib = find_neighbor_fib_of_ether_cache_locked(
+				eth_cache, gk_conf);
+		}
 		if (neighbor_fib == NULL)
 			return -1;
 	}
 
 	if (addr->proto == ETHER_TYPE_IPv4) {
-		ret = put_arp((struct in_addr *)
-			&addr->ip.v4, gk_conf->lcores[0]);
-		if (ret < 0)
-			return ret;
-
 		ret = rte_hash_del_key(neighbor_fib->u.neigh.hash_table,
 			&addr->ip.v4.s_addr);
-		if (ret < 0) {
-			RTE_LOG(CRIT, GATEKEEPER,
-				"gk: failed to delete an Ethernet cache entry from the IPv4 neighbor table at %s, we are not trying to recover from this failure!",
-				__func__);
-		}
-		return ret;
-	}
-
-	if (likely(addr->proto == ETHER_TYPE_IPv6)) {
-		ret = put_nd((struct in6_addr *)
-			&addr->ip.v6, gk_conf->lcores[0]);
-		if (ret < 0)
-			return ret;
-
+	} else if (likely(addr->proto == ETHER_TYPE_IPv6)) {
 		ret = rte_hash_del_key(neighbor_fib->u.neigh6.hash_table,
 			addr->ip.v6.s6_addr);
-		if (ret < 0) {
-			RTE_LOG(CRIT, GATEKEEPER,
-				"gk: failed to delete an Ethernet cache entry from the IPv6 neighbor table at %s, we are not trying to recover from this failure!",
-				__func__);
-		}
-		return ret;
+	} else {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gk: remove an invalid FIB entry with IP type %hu at %s",
+			addr->proto, __func__);
+		return -1;
 	}
 
-	RTE_LOG(ERR, GATEKEEPER,
-		"gk: remove an invalid FIB entry with IP type %hu at %s",
-		addr->proto, __func__);
+	if (ret < 0) {
+		RTE_LOG(CRIT, GATEKEEPER,
+			"gk: failed to delete an Ethernet cache entry from the IPv%d neighbor table at %s, we are not trying to recover from this failure!",
+			addr->proto == ETHER_TYPE_IPv4 ? 4 : 6, __func__);
+	}
 
-	return -1;
+	/*
+	 * GK blocks can no longer find @eth_cache, but they may still
+	 * hold references to it. Keep @eth_cache reserved until they
+	 * go through a quiescent state, and only then release it
+	 * to the LLS block. Function clear_ether_cache() expects
+	 * @ref_cnt to be 1.
+	 */
+	rte_atomic32_set(&eth_cache->ref_cnt, 1);
+	defer_ether_cache_release_locked(eth_cache, gk_conf);
+	return ret;
 }
 
-/*
- * This function is called by del_fib_entry_locked().
- * Notice that, it doesn't stand on its own, and it's only
- * a construct to make del_fib_entry_locked() readable.
- */
 static int
-del_gateway_from_neigh_table_locked(
-	struct ip_prefix *ip_prefix, enum gk_fib_action action,
-	struct ether_cache *eth_cache, struct gk_config *gk_conf)
+notify_gk_instance(struct gk_fib *fib, struct gk_instance *instance)
 {
 	int ret;
-	struct ipaddr *gw_addr = &eth_cache->ip_addr;
+	struct mailbox *mb = &instance->mb;
+	struct gk_cmd_entry *entry = mb_alloc_entry(mb);
+	if (entry == NULL) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gk: failed to allocate a `struct gk_cmd_entry` entry at %s\n",
+			__func__);
+		return -1;
+	}
 
-	ret = ether_cache_put(NULL, action, eth_cache, gw_addr, gk_conf);
+	entry->op = GK_SYNCH_WITH_LPM;
+	entry->u.fib = fib;
+
+	ret = mb_send_entry(mb, entry);
 	if (ret < 0) {
 		RTE_LOG(ERR, GATEKEEPER,
-			"gk: failed to release the Ethernet cached header of the Grantor FIB entry for the IP prefix %s at %s\n",
-			ip_prefix->str, __func__);
+			"gk: failed to send a `struct gk_cmd_entry` entry at %s\n",
+			__func__);
 		return -1;
 	}
 
@@ -1015,53 +1024,196 @@ del_gateway_from_neigh_table_locked(
 }
 
 /*
- * For removing FIB entries, it needs to notify the GK instances
- * about the removal of the FIB entry.
+ * A FIB entry removed from the LPM table, but that
+ * GK blocks may still refer to.
  */
-static int
-del_fib_entry_locked(struct ip_prefix *ip_prefix, struct gk_config *gk_conf)
-{
-	int ret = 0;
-	struct gk_fib *ip_prefix_fib;
+struct fib_release {
+	struct gk_fib    *fib;
+	struct gk_config *gk_conf;
 
-	ip_prefix_fib = remove_prefix_from_lpm_locked(ip_prefix, gk_conf);
-	if (ip_prefix_fib == NULL)
-		return -1;
+	/* Whether each GK instance has been asked to flush @fib. */
+	bool             notified[];
+};
 
-	/*
-	 * We need to notify the GK blocks whenever we remove
-	 * a FIB entry that is accessible through a prefix.
-	 */
-	synchronize_gk_instances(ip_prefix_fib, gk_conf);
+/*
+ * Ask the GK instances that have not been notified yet
+ * to flush the flow entries of the Grantor FIB entry.
+ *
+ * Returns true if all GK instances have flushed them.
+ */
+static bool
+flush_grantor_fib(struct fib_release *rel)
+{
+	int i;
+	struct gk_config *gk_conf = rel->gk_conf;
 
-	/*
-	 * From now on, GK blocks must not have a reference
-	 * to @ip_prefix_fib.
-	 */
+	for (i = 0; i < gk_conf->num_lcores; i++) {
+		if (!rel->notified[i] && notify_gk_instance(rel->fib,
+				&gk_conf->instances[i]) == 0)
+			rel->notified[i] = true;
+	}
 
-	switch (ip_prefix_fib->action) {
-	case GK_FWD_GRANTOR: {
-		ret = del_gateway_from_neigh_table_locked(
-			ip_prefix, GK_FWD_GATEWAY_BACK_NET,
-			ip_prefix_fib->u.grantor.eth_cache, gk_conf);
+	return rte_atomic16_read(&rel->fib->num_updated_instances) >=
+		gk_conf->num_lcores;
+}
+
+/*
+ * Release the resources of @fib and reset it.
+ * The GK blocks must not be able to refer to @fib anymore.
+ */
+static void
+put_fib_entry_locked(struct gk_fib *fib, struct gk_config *gk_conf)
+{
+	int ret = 0;
+	struct ether_cache *eth_cache;
 
+	switch (fib->action) {
+	case GK_FWD_GRANTOR:
+		sol_put_grantor(gk_conf->sol_conf,
+			fib->u.grantor.sol_grantor_id);
+		eth_cache = fib->u.grantor.eth_cache;
+		ret = ether_cache_put(NULL, GK_FWD_GATEWAY_BACK_NET,
+			eth_cache, &eth_cache->ip_addr, gk_conf);
 		break;
-	}
 
 	case GK_FWD_GATEWAY_FRONT_NET:
 		/* FALLTHROUGH */
-	case GK_FWD_GATEWAY_BACK_NET: {
-		ret = del_gateway_from_neigh_table_locked(
-			ip_prefix, ip_prefix_fib->action,
-			ip_prefix_fib->u.gateway.eth_cache, gk_conf);
+	case GK_FWD_GATEWAY_BACK_NET:
+		eth_cache = fib->u.gateway.eth_cache;
+		ret = ether_cache_put(NULL, fib->action,
+			eth_cache, &eth_cache->ip_addr, gk_conf);
+		break;
 
+	default:
 		break;
 	}
 
-	case GK_DROP:
-		break;
+	if (ret < 0) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gk: failed to release the Ethernet cached header of a deleted FIB entry with action %u at %s\n",
+			fib->action, __func__);
+	}
 
-	/*
+	/* Reset the fields of the deleted FIB entry. */
+	initialize_fib_entry(fib);
+}
+
+/* Called by qsbr_reclaim() with the LPM table lock held. */
+static int
+release_fib_entry(void *arg)
+{
+	struct fib_release *rel = arg;
+
+	/*
+	 * Flow entries refer to Grantor FIB entries across
+	 * quiescent states, so all of them must be flushed
+	 * before the FIB entry can be released.
+	 */
+	if (rel->fib->action == GK_FWD_GRANTOR && !flush_grantor_fib(rel))
+		return -EAGAIN;
+
+	put_fib_entry_locked(rel->fib, rel->gk_conf);
+	rte_free(rel);
+	return 0;
+}
+
+/*
+ * Release @fib once the GK blocks can no longer refer to it.
+ * The LPM tables that the GK blocks read must not refer to @fib.
+ *
+ * The FIB entry is not reused before it is released
+ * because its action is only reset then.
+ */
+static void
+defer_fib_entry_release_locked(struct gk_fib *fib, struct gk_config *gk_conf)
+{
+	int i;
+	struct fib_release *rel = rte_malloc("fib_release", sizeof(*rel) +
+		gk_conf->num_lcores * sizeof(rel->notified[0]), 0);
+	if (rel == NULL)
+		goto leak;
+
+	rel->fib = fib;
+	rel->gk_conf = gk_conf;
+	for (i = 0; i < gk_conf->num_lcores; i++)
+		rel->notified[i] = false;
+
+	if (fib->action == GK_FWD_GRANTOR) {
+		/* Start flushing the flow entries of @fib now. */
+		rte_atomic16_init(&fib->num_updated_instances);
+		flush_grantor_fib(rel);
+	}
+
+	if (qsbr_defer(&gk_conf->qsbr, release_fib_entry, rel) < 0) {
+		rte_free(rel);
+		goto leak;
+	}
+
+	return;
+
+leak:
+	RTE_LOG(CRIT, GATEKEEPER,
+		"gk: failed to defer the release of a FIB entry with action %u at %s, the FIB entry will not be reused!\n",
+		fib->action, __func__);
+}
+
+/*
+ * Return the FIB entry that the LPM tables read by the GK blocks
+ * associate to @prefix, or NULL if there is none.
+ */
+static struct gk_fib *
+get_published_fib_entry_locked(struct ip_prefix *prefix,
+	struct gk_config *gk_conf)
+{
+	uint32_t fib_id;
+	struct gk_lpm *ltbl = &gk_conf->lpm_tbl;
+
+	if (prefix->addr.proto == ETHER_TYPE_IPv4) {
+		if (!rte_lpm_is_rule_present(ltbl->lpm,
+				ntohl(prefix->addr.ip.v4.s_addr),
+				prefix->len, &fib_id))
+			return NULL;
+		return &ltbl->fib_tbl[fib_id];
+	}
+
+	if (likely(prefix->addr.proto == ETHER_TYPE_IPv6)) {
+		if (!rte_lpm6_is_rule_present(ltbl->lpm6,
+				prefix->addr.ip.v6.s6_addr,
+				prefix->len, &fib_id))
+			return NULL;
+		return &ltbl->fib_tbl6[fib_id];
+	}
+
+	return NULL;
+}
+
+/*
+ * For removing FIB entries, the LPM table stops referring to them
+ * right away, and they are released once GK blocks can no longer
+ * refer to them. Writers never wait for the GK blocks.
+ *
+ * During a bulk load, only the shadow LPM table is updated.
+ */
+static int
+del_fib_entry_locked(struct ip_prefix *ip_prefix, struct gk_config *gk_conf)
+{
+	struct gk_fib *ip_prefix_fib;
+
+	ip_prefix_fib = remove_prefix_from_lpm_locked(ip_prefix, gk_conf);
+	if (ip_prefix_fib == NULL)
+		return -1;
+
+	switch (ip_prefix_fib->action) {
+	case GK_FWD_GRANTOR:
+		/* FALLTHROUGH */
+	case GK_FWD_GATEWAY_FRONT_NET:
+		/* FALLTHROUGH */
+	case GK_FWD_GATEWAY_BACK_NET:
+		/* FALLTHROUGH */
+	case GK_DROP:
+		break;
+
+	/*
 	 * For GK_FWD_NEIGHBOR_*_NET FIB entries, they are initialized
 	 * when the Gatekeeper starts. These FIB entries are only reserved
 	 * for the network prefixes, for which the Gatekeeper is responsible.
@@ -1075,14 +1227,77 @@ del_fib_entry_locked(struct ip_prefix *ip_prefix, struct gk_config *gk_conf)
 	default:
 		rte_panic("Unexpected condition at %s: unsupported prefix action %u\n",
 			__func__, ip_prefix_fib->action);
-		ret = -1;
+		return -1;
+	}
+
+	if (gk_conf->lpm_tbl.bulk_loading) {
+		/*
+		 * FIB entries that the current LPM table refers to are
+		 * released when the bulk load is committed. The other ones
+		 * have only been added to the shadow LPM table, so
+		 * the GK blocks have never seen them.
+		 */
+		if (get_published_fib_entry_locked(ip_prefix, gk_conf) !=
+				ip_prefix_fib)
+			put_fib_entry_locked(ip_prefix_fib, gk_conf);
+		return 0;
+	}
+
+	defer_fib_entry_release_locked(ip_prefix_fib, gk_conf);
+	qsbr_reclaim(&gk_conf->qsbr);
+	return 0;
+}
+
+/*
+ * During a bulk load, a prefix whose FIB entry is unchanged keeps
+ * its FIB entry, so flow entries of its Grantor are not flushed
+ * when the bulk load is committed.
+ *
+ * Returns 0 if the FIB entry of the current LPM table was reused.
+ */
+static int
+reuse_published_fib_entry_locked(struct ip_prefix *prefix,
+	struct ipaddr *gt_addr, struct ipaddr *gw_addr,
+	enum gk_fib_action action, struct gk_config *gk_conf)
+{
+	struct gk_lpm *ltbl = &gk_conf->lpm_tbl;
+	struct gk_fib *fib = get_published_fib_entry_locked(prefix, gk_conf);
+	int fib_id;
+
+	if (fib == NULL || fib->action != action)
+		return -1;
+
+	switch (action) {
+	case GK_FWD_GRANTOR:
+		if (gt_addr == NULL || gw_addr == NULL)
+			return -1;
+		if (!ipaddr_equal(&fib->u.grantor.gt_addr, gt_addr) ||
+				!ipaddr_equal(
+				&fib->u.grantor.eth_cache->ip_addr, gw_addr))
+			return -1;
+		break;
+
+	case GK_FWD_GATEWAY_FRONT_NET:
+		/* FALLTHROUGH */
+	case GK_FWD_GATEWAY_BACK_NET:
+		if (gw_addr == NULL || !ipaddr_equal(
+				&fib->u.gateway.eth_cache->ip_addr, gw_addr))
+			return -1;
 		break;
+
+	case GK_DROP:
+		break;
+
+	default:
+		return -1;
 	}
 
-	/* Reset the fields of the deleted FIB entry. */
-	initialize_fib_entry(ip_prefix_fib);
+	if (prefix->addr.proto == ETHER_TYPE_IPv4)
+		fib_id = fib - ltbl->fib_tbl;
+	else
+		fib_id = fib - ltbl->fib_tbl6;
 
-	return ret;
+	return lpm_add_route(&prefix->addr, prefix->len, fib_id, ltbl);
 }
 
 /*
@@ -1166,7 +1381,7 @@ init_grantor_fib_locked(
 	struct ip_prefix *ip_prefix, struct ipaddr *gt_addr,
 	struct ipaddr *gw_addr, struct gk_config *gk_conf)
 {
-	int ret, fib_id;
+	int ret, fib_id, sol_grantor_id;
 	struct gk_fib *gt_fib;
 	struct ether_cache *eth_cache;
 	struct neighbor_hash_table *neigh_ht = NULL;
@@ -1199,9 +1414,13 @@ init_grantor_fib_locked(
 	if (eth_cache == NULL)
 		return NULL;
 
+	sol_grantor_id = sol_register_grantor(gk_conf->sol_conf, gt_addr);
+	if (sol_grantor_id < 0)
+		goto put_ether_cache;
+
 	fib_id = get_empty_fib_id(ip_prefix->addr.proto, gk_conf);
 	if (fib_id < 0)
-		goto put_ether_cache;
+		goto put_grantor;
 
 	if (ip_prefix->addr.proto == ETHER_TYPE_IPv4)
 		gt_fib = &ltbl->fib_tbl[fib_id];
@@ -1211,6 +1430,7 @@ init_grantor_fib_locked(
 	gt_fib->action = GK_FWD_GRANTOR;
 	rte_memcpy(&gt_fib->u.grantor.gt_addr,
 		gt_addr, sizeof(gt_fib->u.grantor.gt_addr));
+	gt_fib->u.grantor.sol_grantor_id = sol_grantor_id;
 	gt_fib->u.grantor.eth_cache = eth_cache;
 
 	ret = lpm_add_route(&ip_prefix->addr, ip_prefix->len, fib_id, ltbl);
@@ -1222,6 +1442,9 @@ init_grantor_fib_locked(
 init_fib:
 	initialize_fib_entry(gt_fib);
 
+put_grantor:
+	sol_put_grantor(gk_conf->sol_conf, sol_grantor_id);
+
 put_ether_cache:
 	ether_cache_put(neigh_fib,
 		GK_FWD_GATEWAY_BACK_NET, eth_cache, gw_addr, gk_conf);
@@ -1265,6 +1488,10 @@ add_fib_entry_locked(struct ip_prefix *prefix,
 	struct ipaddr *gt_addr, struct ipaddr *gw_addr,
 	enum gk_fib_action action, struct gk_config *gk_conf)
 {
+	if (gk_conf->lpm_tbl.bulk_loading && reuse_published_fib_entry_locked(
+			prefix, gt_addr, gw_addr, action, gk_conf) == 0)
+		return 0;
+
 	switch (action) {
 	case GK_FWD_GRANTOR: {
 		struct gk_fib *gt_fib;
@@ -1385,7 +1612,8 @@ check_prefix_locked(struct ip_prefix *prefix,
 		if (prefix->addr.proto == ETHER_TYPE_IPv4) {
 			struct rte_lpm_iterator_state state;
 			const struct rte_lpm_rule *re;
-			int ret = rte_lpm_iterator_state_init(ltbl->lpm,
+			int ret = rte_lpm_iterator_state_init(
+				writable_lpm_locked(ltbl),
 				ntohl(prefix->addr.ip.v4.s_addr),
 				prefix->len, &state);
 			if (ret < 0) {
@@ -1412,7 +1640,8 @@ check_prefix_locked(struct ip_prefix *prefix,
 		} else if (likely(prefix->addr.proto == ETHER_TYPE_IPv6)) {
 			struct rte_lpm6_iterator_state state;
 			const struct rte_lpm6_rule *re;
-			int ret = rte_lpm6_iterator_state_init(ltbl->lpm6,
+			int ret = rte_lpm6_iterator_state_init(
+				writable_lpm6_locked(ltbl),
 				prefix->addr.ip.v6.s6_addr,
 				prefix->len, &state);
 			if (ret < 0) {
@@ -1453,7 +1682,8 @@ check_prefix_locked(struct ip_prefix *prefix,
 		for (i = 0; i < prefix->len; i++) {
 			uint32_t fib_id;
 			ip_prefix_present = rte_lpm_is_rule_present(
-				ltbl->lpm, prefix_ip4, i, &fib_id);
+				writable_lpm_locked(ltbl), prefix_ip4, i,
+				&fib_id);
 			if (!ip_prefix_present)
 				continue;
 
@@ -1470,8 +1700,8 @@ check_prefix_locked(struct ip_prefix *prefix,
 		for (i = 0; i < prefix->len; i++) {
 			uint32_t fib_id;
 			ip_prefix_present = rte_lpm6_is_rule_present(
-				ltbl->lpm6, prefix->addr.ip.v6.s6_addr,
-				i, &fib_id);
+				writable_lpm6_locked(ltbl),
+				prefix->addr.ip.v6.s6_addr, i, &fib_id);
 			if (!ip_prefix_present)
 				continue;
 
@@ -1512,25 +1742,6 @@ add_fib_entry_numerical(struct ip_prefix *prefix_info,
 		return -1;
 	}
 
-	/*
-	 * One can only look up, without the lock, the LPM table to verify that
-	 * the adding prefix does not lead to a GK_FWD_NEIGHBOR_*_NET FIB entry
-	 * because GK_FWD_NEIGHBOR_*_NET entries can only be added through
-	 * a network interface.
-	 * Otherwise, after the lookup, but before acquiring the lock,
-	 * a concurrent thread could add a GK_FWD_NEIGHBOR_*_NET entry that
-	 * would break the test.
-	 */
-	neigh_fib = find_fib_entry_for_neighbor_locked(
-		&prefix_info->addr, GK_FWD_GATEWAY_FRONT_NET, gk_conf);
-	if (neigh_fib != NULL)
-		return -1;
-
-	neigh_fib = find_fib_entry_for_neighbor_locked(
-		&prefix_info->addr, GK_FWD_GATEWAY_BACK_NET, gk_conf);
-	if (neigh_fib != NULL)
-		return -1;
-
 	if (gw_addr != NULL) {
 		/*
 		 * Verify that the IP addresses of gateways FIB entries
@@ -1541,23 +1752,42 @@ add_fib_entry_numerical(struct ip_prefix *prefix_info,
 			return -1;
 	}
 
+	rte_spinlock_lock_tm(&gk_conf->lpm_tbl.lock);
+
+	/*
+	 * Verify that the adding prefix does not lead to
+	 * a GK_FWD_NEIGHBOR_*_NET FIB entry. The lock is needed because
+	 * a bulk load may replace the LPM table being looked up.
+	 */
+	neigh_fib = find_fib_entry_for_neighbor_locked(
+		&prefix_info->addr, GK_FWD_GATEWAY_FRONT_NET, gk_conf);
+	if (neigh_fib != NULL)
+		goto unlock;
+
+	neigh_fib = find_fib_entry_for_neighbor_locked(
+		&prefix_info->addr, GK_FWD_GATEWAY_BACK_NET, gk_conf);
+	if (neigh_fib != NULL)
+		goto unlock;
+
 	/*
 	 * Only a drop or another grantor entry must be able to be longer than
 	 * a grantor or a drop prefix. This way we protect network operators of
 	 * accidentally create a security hole.
 	 */
-	rte_spinlock_lock_tm(&gk_conf->lpm_tbl.lock);
 	ret = check_prefix_locked(prefix_info, action, gk_conf);
-	if (ret < 0) {
-		rte_spinlock_unlock_tm(&gk_conf->lpm_tbl.lock);
-		return -1;
-	}
+	if (ret < 0)
+		goto unlock;
 
 	ret = add_fib_entry_locked(
 		prefix_info, gt_addr, gw_addr, action, gk_conf);
+	qsbr_reclaim(&gk_conf->qsbr);
 	rte_spinlock_unlock_tm(&gk_conf->lpm_tbl.lock);
 
 	return ret;
+
+unlock:
+	rte_spinlock_unlock_tm(&gk_conf->lpm_tbl.lock);
+	return -1;
 }
 
 int
@@ -1623,3 +1853,290 @@ del_fib_entry(const char *ip_prefix, struct gk_config *gk_conf)
 
 	return del_fib_entry_numerical(&prefix_info, gk_conf);
 }
+
+/*
+ * Add the network prefixes of @iface to the shadow LPM tables.
+ * Their FIB entries are shared with the current LPM tables.
+ */
+static int
+copy_net_prefixes_locked(struct gatekeeper_if *iface, struct gk_lpm *ltbl)
+{
+	uint32_t fib_id;
+
+	if (ipv4_if_configured(iface)) {
+		uint32_t ip = ntohl(iface->ip4_addr.s_addr);
+		if (!rte_lpm_is_rule_present(ltbl->lpm, ip,
+				iface->ip4_addr_plen, &fib_id) ||
+				rte_lpm_add(ltbl->shadow_lpm, ip,
+				iface->ip4_addr_plen, fib_id) < 0)
+			return -1;
+	}
+
+	if (ipv6_if_configured(iface)) {
+		if (!rte_lpm6_is_rule_present(ltbl->lpm6,
+				iface->ip6_addr.s6_addr,
+				iface->ip6_addr_plen, &fib_id) ||
+				rte_lpm6_add(ltbl->shadow_lpm6,
+				iface->ip6_addr.s6_addr,
+				iface->ip6_addr_plen, fib_id) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+int
+begin_fib_bulk_load(struct gk_config *gk_conf)
+{
+	int ret = -1;
+	struct gk_lpm *ltbl = &gk_conf->lpm_tbl;
+	unsigned int socket_id = rte_lcore_to_socket_id(gk_conf->lcores[0]);
+
+	rte_spinlock_lock_tm(&ltbl->lock);
+
+	if (ltbl->bulk_loading) {
+		RTE_LOG(WARNING, GATEKEEPER,
+			"gk: a bulk load of the FIB is already in progress at %s\n",
+			__func__);
+		goto out;
+	}
+
+	ltbl->num_lpm_gens++;
+
+	if (ltbl->lpm != NULL) {
+		ltbl->shadow_lpm = new_ipv4_lpm(gk_conf, socket_id,
+			ltbl->num_lpm_gens);
+		if (ltbl->shadow_lpm == NULL)
+			goto out;
+	}
+
+	if (ltbl->lpm6 != NULL) {
+		ltbl->shadow_lpm6 = new_ipv6_lpm(gk_conf, socket_id,
+			ltbl->num_lpm_gens);
+		if (ltbl->shadow_lpm6 == NULL)
+			goto free_lpm;
+	}
+
+	if (copy_net_prefixes_locked(&gk_conf->net->front, ltbl) < 0 ||
+			copy_net_prefixes_locked(&gk_conf->net->back,
+			ltbl) < 0) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gk: failed to add the network prefixes to the shadow LPM table at %s\n",
+			__func__);
+		goto free_lpm6;
+	}
+
+	ltbl->bulk_loading = true;
+	ret = 0;
+	goto out;
+
+free_lpm6:
+	destroy_ipv6_lpm(ltbl->shadow_lpm6);
+	ltbl->shadow_lpm6 = NULL;
+free_lpm:
+	destroy_ipv4_lpm(ltbl->shadow_lpm);
+	ltbl->shadow_lpm = NULL;
+out:
+	rte_spinlock_unlock_tm(&ltbl->lock);
+	return ret;
+}
+
+/*
+ * Release the FIB entries that the rules of @from refer to,
+ * but the rules of @to do not.
+ *
+ * If @defer is true, the GK blocks may still refer to these FIB entries,
+ * so they are released once the GK blocks can no longer refer to them.
+ */
+static void
+release_fib_entries_not_in_locked(struct rte_lpm *from, struct rte_lpm *to,
+	struct rte_lpm6 *from6, struct rte_lpm6 *to6, bool defer,
+	struct gk_config *gk_conf)
+{
+	int ret;
+	uint32_t fib_id;
+	struct gk_fib *fib;
+	struct gk_lpm *ltbl = &gk_conf->lpm_tbl;
+
+	if (from != NULL) {
+		struct rte_lpm_iterator_state state;
+		const struct rte_lpm_rule *re;
+
+		ret = rte_lpm_iterator_state_init(from, 0, 0, &state);
+		if (ret < 0) {
+			RTE_LOG(ERR, GATEKEEPER,
+				"gk: failed to initialize the lpm rule iterator state at %s!\n",
+				__func__);
+			goto ipv6;
+		}
+
+		ret = rte_lpm_rule_iterate(&state, &re);
+		while (ret >= 0) {
+			fib = &ltbl->fib_tbl[re->next_hop];
+			if (!is_neighbor_fib(fib) &&
+					(!rte_lpm_is_rule_present(to, re->ip,
+					state.depth, &fib_id) ||
+					fib_id != re->next_hop)) {
+				if (defer)
+					defer_fib_entry_release_locked(fib,
+						gk_conf);
+				else
+					put_fib_entry_locked(fib, gk_conf);
+			}
+			ret = rte_lpm_rule_iterate(&state, &re);
+		}
+	}
+
+ipv6:
+	if (from6 != NULL) {
+		struct rte_lpm6_iterator_state state;
+		const struct rte_lpm6_rule *re;
+		uint8_t ip[RTE_LPM6_IPV6_ADDR_SIZE];
+
+		memset(ip, 0, sizeof(ip));
+		ret = rte_lpm6_iterator_state_init(from6, ip, 0, &state);
+		if (ret < 0) {
+			RTE_LOG(ERR, GATEKEEPER,
+				"gk: failed to initialize the lpm6 rule iterator state at %s!\n",
+				__func__);
+			return;
+		}
+
+		ret = rte_lpm6_rule_iterate(&state, &re);
+		while (ret >= 0) {
+			fib = &ltbl->fib_tbl6[re->next_hop];
+			rte_memcpy(ip, re->ip, sizeof(ip));
+			if (!is_neighbor_fib(fib) &&
+					(!rte_lpm6_is_rule_present(to6,
+					ip, re->depth, &fib_id) ||
+					fib_id != re->next_hop)) {
+				if (defer)
+					defer_fib_entry_release_locked(fib,
+						gk_conf);
+				else
+					put_fib_entry_locked(fib, gk_conf);
+			}
+			ret = rte_lpm6_rule_iterate(&state, &re);
+		}
+	}
+}
+
+struct lpm_release {
+	struct rte_lpm  *lpm;
+	struct rte_lpm6 *lpm6;
+};
+
+/* Called by qsbr_reclaim() with the LPM table lock held. */
+static int
+release_lpm_tables(void *arg)
+{
+	struct lpm_release *rel = arg;
+
+	destroy_ipv4_lpm(rel->lpm);
+	destroy_ipv6_lpm(rel->lpm6);
+	rte_free(rel);
+	return 0;
+}
+
+int
+commit_fib_bulk_load(struct gk_config *gk_conf)
+{
+	int ret = -1;
+	struct gk_lpm *ltbl = &gk_conf->lpm_tbl;
+	struct lpm_release *rel;
+
+	rte_spinlock_lock_tm(&ltbl->lock);
+
+	if (!ltbl->bulk_loading) {
+		RTE_LOG(WARNING, GATEKEEPER,
+			"gk: there is no bulk load of the FIB in progress at %s\n",
+			__func__);
+		goto out;
+	}
+
+	rel = rte_malloc("lpm_release", sizeof(*rel), 0);
+	if (rel == NULL) {
+		RTE_LOG(ERR, MALLOC,
+			"gk: failed to allocate a `struct lpm_release` at %s\n",
+			__func__);
+		goto out;
+	}
+	rel->lpm = ltbl->lpm;
+	rel->lpm6 = ltbl->lpm6;
+
+	/*
+	 * Publish the shadow LPM tables. The GK blocks must see
+	 * the complete shadow LPM tables and FIB entries once they
+	 * see the new pointers.
+	 */
+	rte_smp_wmb();
+	ltbl->lpm = ltbl->shadow_lpm;
+	ltbl->lpm6 = ltbl->shadow_lpm6;
+	ltbl->shadow_lpm = NULL;
+	ltbl->shadow_lpm6 = NULL;
+	ltbl->bulk_loading = false;
+
+	release_fib_entries_not_in_locked(rel->lpm, ltbl->lpm,
+		rel->lpm6, ltbl->lpm6, true, gk_conf);
+
+	if (qsbr_defer(&gk_conf->qsbr, release_lpm_tables, rel) < 0) {
+		RTE_LOG(CRIT, GATEKEEPER,
+			"gk: failed to defer the release of the previous LPM tables at %s, they will not be freed!\n",
+			__func__);
+		rte_free(rel);
+	}
+
+	qsbr_reclaim(&gk_conf->qsbr);
+
+	RTE_LOG(NOTICE, GATEKEEPER,
+		"gk: committed a bulk load of the FIB\n");
+	ret = 0;
+out:
+	rte_spinlock_unlock_tm(&ltbl->lock);
+	return ret;
+}
+
+int
+abort_fib_bulk_load(struct gk_config *gk_conf)
+{
+	struct gk_lpm *ltbl = &gk_conf->lpm_tbl;
+
+	rte_spinlock_lock_tm(&ltbl->lock);
+
+	if (!ltbl->bulk_loading) {
+		RTE_LOG(WARNING, GATEKEEPER,
+			"gk: there is no bulk load of the FIB in progress at %s\n",
+			__func__);
+		rte_spinlock_unlock_tm(&ltbl->lock);
+		return -1;
+	}
+
+	/* The GK blocks have never seen the shadow LPM tables. */
+	release_fib_entries_not_in_locked(ltbl->shadow_lpm, ltbl->lpm,
+		ltbl->shadow_lpm6, ltbl->lpm6, false, gk_conf);
+
+	ltbl->bulk_loading = false;
+	destroy_ipv4_lpm(ltbl->shadow_lpm);
+	ltbl->shadow_lpm = NULL;
+	destroy_ipv6_lpm(ltbl->shadow_lpm6);
+	ltbl->shadow_lpm6 = NULL;
+
+	rte_spinlock_unlock_tm(&ltbl->lock);
+	return 0;
+}
+
+/*
+ * Release the deleted FIB entries and Ethernet cache entries
+ * whose grace periods are over. The Dynamic Config block calls
+ * this function periodically, so releases do not depend on further
+ * updates of the FIB. GK blocks must not call it: the releases
+ * notify GK instances through their mailboxes, and take the lock
+ * of the LPM tables, which the CPS block also takes.
+ */
+void
+reclaim_fib_entries(struct gk_config *gk_conf)
+{
+	rte_spinlock_lock_tm(&gk_conf->lpm_tbl.lock);
+	qsbr_reclaim(&gk_conf->qsbr);
+	rte_spinlock_unlock_tm(&gk_conf->lpm_tbl.lock);
+}
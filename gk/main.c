@@ -18,7 +18,6 @@
 
 #include <string.h>
 #include <stdbool.h>
-#include <math.h>
 
 #include <rte_ip.h>
 #include <rte_log.h>
@@ -28,6 +27,7 @@
 #include <rte_memcpy.h>
 #include <rte_cycles.h>
 #include <rte_malloc.h>
+#include <rte_prefetch.h>
 
 #include "gatekeeper_acl.h"
 #include "gatekeeper_gk.h"
@@ -37,6 +37,8 @@
 #include "gatekeeper_launch.h"
 #include "gatekeeper_l2.h"
 #include "gatekeeper_sol.h"
+#include "gatekeeper_profile.h"
+#include "gatekeeper_log_ratelimit.h"
 
 #define	START_PRIORITY		 (38)
 /* Set @START_ALLOWANCE as the double size of a large DNS reply. */
@@ -53,6 +55,14 @@
 
 /* XXX Sample parameters, need to be tested for better performance. */
 #define GK_CMD_BURST_SIZE        (32)
+#define GK_FLOW_EXPIRY_BURST_SIZE (32)
+#define GK_FLOW_FLUSH_BURST_SIZE  (32)
+
+/*
+ * Number of times that the removal of an expired flow entry is
+ * retried, each time twice as late, before its slot is reclaimed.
+ */
+#define GK_FLOW_EXPIRY_MAX_RETRIES (8)
 
 /* Store information about a packet. */
 struct ipacket {
@@ -62,29 +72,37 @@ struct ipacket {
 	struct rte_mbuf *pkt;
 };
 
+/*
+ * A flow entry only holds the state needed to process the packets
+ * of its flow, so that it fits in a single cache line.
+ *
+ * The IP flow of an entry is not stored here, it is only kept
+ * as the key of the entry in the flow hash table.
+ */
 struct flow_entry {
-	/* IP flow information. */
-	struct ip_flow flow;
+	/* The state of the entry, see enum gk_flow_state. */
+	uint8_t state;
 
-	/* The state of the entry. */
-	enum gk_flow_state state;
+	/* Failed attempts to remove the entry once it expired. */
+	uint8_t expiry_retries;
 
 	/*
-	 * The fib entry that instructs where
+	 * The ID of the fib entry that instructs where
 	 * to send the packets for this flow entry.
+	 * See grantor_id_to_fib().
 	 */
-	struct gk_fib *grantor_fib;
+	uint32_t grantor_id;
 
 	union {
 		struct {
 			/* The time the last packet of the entry was seen. */
 			uint64_t last_packet_seen_at;
-			/* 
+			/*
 			 * The priority associated to
 			 * the last packet of the entry.
 			 */
 			uint8_t last_priority;
-			/* 
+			/*
 			 * The number of packets that the entry is allowed
 			 * to send with @last_priority without waiting
 			 * the amount of time necessary to be granted
@@ -98,7 +116,7 @@ struct flow_entry {
 			uint64_t cap_expire_at;
 			/* When @budget_byte is reset. */
 			uint64_t budget_renew_at;
-			/* 
+			/*
 			 * When @budget_byte is reset, reset it to
 			 * @tx_rate_kb_cycle * 1024 bytes.
 			 */
@@ -125,7 +143,13 @@ struct flow_entry {
 			uint64_t expire_at;
 		} declined;
 	} u;
-};
+
+	/* Link of the entry in the timing wheel of its GK instance. */
+	struct index_link expiry_link;
+
+	/* Link of the entry in the list of flow entries of its grantor. */
+	struct index_link grantor_link;
+} __rte_cache_aligned;
 
 /* We should avoid calling integer_log_base_2() with zero. */
 static inline uint8_t
@@ -165,6 +189,30 @@ priority_from_delta_time(uint64_t present, uint64_t past)
 	return integer_log_base_2(delta_time);
 }
 
+/*
+ * The IPv4 and IPv6 FIB entries share a single ID space
+ * for the flow entries: the IPv4 FIB entries come first.
+ */
+static inline uint32_t
+fib_to_grantor_id(struct gk_config *gk_conf, struct gk_fib *fib)
+{
+	struct gk_lpm *ltbl = &gk_conf->lpm_tbl;
+
+	if (fib >= ltbl->fib_tbl &&
+			fib < ltbl->fib_tbl + gk_conf->gk_max_num_ipv4_fib_entries)
+		return fib - ltbl->fib_tbl;
+	return gk_conf->gk_max_num_ipv4_fib_entries + (fib - ltbl->fib_tbl6);
+}
+
+static inline struct gk_fib *
+grantor_id_to_fib(struct gk_config *gk_conf, uint32_t grantor_id)
+{
+	if (grantor_id < gk_conf->gk_max_num_ipv4_fib_entries)
+		return &gk_conf->lpm_tbl.fib_tbl[grantor_id];
+	return &gk_conf->lpm_tbl.fib_tbl6[grantor_id -
+		gk_conf->gk_max_num_ipv4_fib_entries];
+}
+
 static struct gk_fib *
 look_up_fib(struct gk_lpm *ltbl, struct ip_flow *flow)
 {
@@ -190,6 +238,59 @@ look_up_fib(struct gk_lpm *ltbl, struct ip_flow *flow)
 	return NULL; /* Unreachable. */
 }
 
+/*
+ * Look up the destinations of @flows in the LPM table at once.
+ * @fibs[i] receives the FIB entry of @flows[i], or NULL if none.
+ *
+ * @n must not be greater than GATEKEEPER_MAX_PKT_BURST.
+ */
+static void
+look_up_fib_bulk(struct gk_lpm *ltbl, struct ip_flow **flows,
+	struct gk_fib **fibs, unsigned int n)
+{
+	unsigned int i;
+	unsigned int num_ip4 = 0;
+	unsigned int num_ip6 = 0;
+	uint32_t ip4s[GATEKEEPER_MAX_PKT_BURST];
+	uint8_t ip6s[GATEKEEPER_MAX_PKT_BURST][RTE_LPM6_IPV6_ADDR_SIZE];
+	int32_t fib_ids4[GATEKEEPER_MAX_PKT_BURST];
+	int32_t fib_ids6[GATEKEEPER_MAX_PKT_BURST];
+	uint16_t idx4[GATEKEEPER_MAX_PKT_BURST];
+	uint16_t idx6[GATEKEEPER_MAX_PKT_BURST];
+
+	for (i = 0; i < n; i++) {
+		struct ip_flow *flow = flows[i];
+
+		if (flow->proto == ETHER_TYPE_IPv4) {
+			ip4s[num_ip4] = flow->f.v4.dst;
+			idx4[num_ip4++] = i;
+		} else if (likely(flow->proto == ETHER_TYPE_IPv6)) {
+			rte_memcpy(ip6s[num_ip6], flow->f.v6.dst,
+				sizeof(ip6s[num_ip6]));
+			idx6[num_ip6++] = i;
+		} else {
+			rte_panic("Unexpected condition at %s: unknown flow type %hu\n",
+				__func__, flow->proto);
+		}
+	}
+
+	if (num_ip4 > 0) {
+		lpm_lookup_ipv4_bulk(ltbl->lpm, ip4s, fib_ids4, num_ip4);
+		for (i = 0; i < num_ip4; i++) {
+			fibs[idx4[i]] = fib_ids4[i] < 0 ?
+				NULL : &ltbl->fib_tbl[fib_ids4[i]];
+		}
+	}
+
+	if (num_ip6 > 0) {
+		lpm_lookup_ipv6_bulk(ltbl->lpm6, ip6s, fib_ids6, num_ip6);
+		for (i = 0; i < num_ip6; i++) {
+			fibs[idx6[i]] = fib_ids6[i] < 0 ?
+				NULL : &ltbl->fib_tbl6[fib_ids6[i]];
+		}
+	}
+}
+
 static int
 extract_packet_info(struct rte_mbuf *pkt, struct ipacket *packet)
 {
@@ -208,7 +309,7 @@ extract_packet_info(struct rte_mbuf *pkt, struct ipacket *packet)
 	case ETHER_TYPE_IPv4:
 		if (pkt_len < sizeof(*eth_hdr) + sizeof(*ip4_hdr)) {
 			packet->flow.proto = 0;
-			RTE_LOG(NOTICE, GATEKEEPER,
+			LOG_RATELIMIT(NOTICE, GATEKEEPER,
 				"gk: packet is too short to be IPv4 (%" PRIu16 ")!\n",
 				pkt_len);
 			ret = -1;
@@ -224,7 +325,7 @@ extract_packet_info(struct rte_mbuf *pkt, struct ipacket *packet)
 	case ETHER_TYPE_IPv6:
 		if (pkt_len < sizeof(*eth_hdr) + sizeof(*ip6_hdr)) {
 			packet->flow.proto = 0;
-			RTE_LOG(NOTICE, GATEKEEPER,
+			LOG_RATELIMIT(NOTICE, GATEKEEPER,
 				"gk: packet is too short to be IPv6 (%" PRIu16 ")!\n",
 				pkt_len);
 			ret = -1;
@@ -246,7 +347,7 @@ extract_packet_info(struct rte_mbuf *pkt, struct ipacket *packet)
 
 	default:
 		packet->flow.proto = 0;
-		RTE_LOG(NOTICE, GATEKEEPER,
+		LOG_RATELIMIT(NOTICE, GATEKEEPER,
 			"gk: unknown network layer protocol %" PRIu16 "!\n",
 			ether_type);
 		ret = -1;
@@ -258,16 +359,14 @@ out:
 }
 
 static inline void
-initialize_flow_entry(struct flow_entry *fe,
-	struct ip_flow *flow, struct gk_fib *grantor_fib)
+initialize_flow_entry(struct flow_entry *fe, uint32_t grantor_id)
 {
-	rte_memcpy(&fe->flow, flow, sizeof(*flow));
-
 	fe->state = GK_REQUEST;
 	fe->u.request.last_packet_seen_at = rte_rdtsc();
 	fe->u.request.last_priority = START_PRIORITY;
 	fe->u.request.allowance = START_ALLOWANCE - 1;
-	fe->grantor_fib = grantor_fib;
+	fe->grantor_id = grantor_id;
+	fe->expiry_retries = 0;
 }
 
 static inline void
@@ -316,21 +415,20 @@ pkt_copy_cached_eth_header(struct rte_mbuf *pkt, struct ether_cache *eth_cache,
  * that entry does is to:
  * (1) compute the priority of the packet.
  * (2) encapsulate the packet as a request.
- * (3) put this encapsulated packet in the request queue.
+ * (3) tag this encapsulated packet with its priority.
  *
  * Returns a negative integer on error, or EINPROGRESS to indicate
- * that the request is being processed by another lcore, and should
- * not be forwarded or dropped on returning from this function.
+ * that the packet is now a request, which the caller must hand over
+ * to the Solicitor instead of forwarding or dropping it.
  */
 static int
-gk_process_request(struct flow_entry *fe, struct ipacket *packet,
-	struct sol_config *sol_conf)
+gk_process_request(struct flow_entry *fe, struct gk_fib *fib,
+	struct ipacket *packet, struct sol_config *sol_conf)
 {
 	int ret;
 	uint64_t now = rte_rdtsc();
 	uint8_t priority = priority_from_delta_time(now,
 			fe->u.request.last_packet_seen_at);
-	struct gk_fib *fib = fe->grantor_fib;
 	struct ether_cache *eth_cache;
 
 	fe->u.request.last_packet_seen_at = now;
@@ -373,8 +471,9 @@ gk_process_request(struct flow_entry *fe, struct ipacket *packet,
 			sol_conf->net->back.l2_len_out))
 		return -1;
 
-	ret = gk_solicitor_enqueue(sol_conf, packet->pkt, priority);
-	return ret < 0 ? ret : EINPROGRESS;
+	sol_set_req_priority(packet->pkt, priority);
+	sol_set_req_grantor(packet->pkt, fib->u.grantor.sol_grantor_id);
+	return EINPROGRESS;
 }
 
 static inline uint64_t
@@ -389,24 +488,23 @@ cycle_from_second(uint64_t time)
  *   * a negative number on error or when the packet needs to be
  *     otherwise dropped because it has exceeded its budget
  *   * EINPROGRESS to indicate that the packet is now a request that
- *     is being processed by another lcore, and should not
+ *     must be handed over to the Solicitor, and should not
  *     be forwarded or dropped on returning from this function.
  */
 static int
-gk_process_granted(struct flow_entry *fe, struct ipacket *packet,
-	struct sol_config *sol_conf)
+gk_process_granted(struct flow_entry *fe, struct gk_fib *fib,
+	struct ipacket *packet, struct sol_config *sol_conf)
 {
 	int ret;
 	bool renew_cap;
 	uint8_t priority = PRIORITY_GRANTED;
 	uint64_t now = rte_rdtsc();
 	struct rte_mbuf *pkt = packet->pkt;
-	struct gk_fib *fib = fe->grantor_fib;
 	struct ether_cache *eth_cache;
 
 	if (now >= fe->u.granted.cap_expire_at) {
 		reinitialize_flow_entry(fe, now);
-		return gk_process_request(fe, packet, sol_conf);
+		return gk_process_request(fe, fib, packet, sol_conf);
 	}
 
 	if (now >= fe->u.granted.budget_renew_at) {
@@ -428,7 +526,7 @@ gk_process_granted(struct flow_entry *fe, struct ipacket *packet,
 	/*
 	 * Encapsulate packet as a granted packet,
 	 * mark it as a capability renewal request if @renew_cap is true,
-	 * enter destination according to @fe->grantor_fib.
+	 * enter destination according to @fib.
 	 */
 	ret = encapsulate(packet->pkt, priority,
 		&sol_conf->net->back, &fib->u.grantor.gt_addr);
@@ -450,18 +548,18 @@ gk_process_granted(struct flow_entry *fe, struct ipacket *packet,
  *   * a negative number on error or when the packet needs to be
  *     otherwise dropped because it is declined
  *   * EINPROGRESS to indicate that the packet is now a request that
- *     is being processed by another lcore, and should not
+ *     must be handed over to the Solicitor, and should not
  *     be forwarded or dropped on returning from this function.
  */
 static int
-gk_process_declined(struct flow_entry *fe, struct ipacket *packet,
-	struct sol_config *sol_conf)
+gk_process_declined(struct flow_entry *fe, struct gk_fib *fib,
+	struct ipacket *packet, struct sol_config *sol_conf)
 {
 	uint64_t now = rte_rdtsc();
 
 	if (unlikely(now >= fe->u.declined.expire_at)) {
 		reinitialize_flow_entry(fe, now);
-		return gk_process_request(fe, packet, sol_conf);
+		return gk_process_request(fe, fib, packet, sol_conf);
 	}
 
 	return -1;
@@ -479,8 +577,30 @@ get_block_idx(struct gk_config *gk_conf, unsigned int lcore_id)
 	return 0;
 }
 
+/*
+ * Returns when @fe expires. The deadline of a flow entry in request
+ * state is postponed at each packet of the flow, so it is not kept
+ * up to date in the timing wheel; the timing wheel only holds
+ * a lower bound of the deadline of each flow entry.
+ */
+static uint64_t
+flow_entry_expire_at(struct flow_entry *fe, uint64_t request_timeout_cycles)
+{
+	switch (fe->state) {
+	case GK_REQUEST:
+		return fe->u.request.last_packet_seen_at +
+			request_timeout_cycles;
+	case GK_GRANTED:
+		return fe->u.granted.cap_expire_at;
+	case GK_DECLINED:
+		return fe->u.declined.expire_at;
+	default:
+		return 0;
+	}
+}
+
 static bool
-is_flow_expired(struct flow_entry *fe,
+is_flow_expired(const struct ip_flow *flow, struct flow_entry *fe,
 	uint64_t now, uint64_t request_timeout_cycles)
 {
 	switch(fe->state) {
@@ -491,7 +611,7 @@ is_flow_expired(struct flow_entry *fe,
 				"gk: buggy condition at %s: wrong timestamp",
 				__func__);
 			RTE_VERIFY(ret > 0 && ret < (int)sizeof(err_msg));
-			print_flow_err_msg(&fe->flow, err_msg);
+			print_flow_err_msg(flow, err_msg);
 			return true;
 		}
 
@@ -507,13 +627,22 @@ is_flow_expired(struct flow_entry *fe,
 }
 
 static int
-gk_del_flow_entry_from_hash(struct rte_hash *h, struct flow_entry *fe)
+gk_del_flow_entry_from_hash(struct gk_instance *instance,
+	const struct ip_flow *flow, struct flow_entry *fe)
 {
-	int ret = rte_hash_del_key(h, &fe->flow);
-	if (likely(ret >= 0))
+	int ret = rte_hash_del_key(instance->ip_flow_hash_table, flow);
+	if (likely(ret >= 0)) {
+		uint32_t index = fe - instance->ip_flow_entry_table;
+
+		stats_dec(instance->stats, STATS_GK_FLOWS);
+
+		tw_cancel(&instance->flow_expiry_tw, index);
+		if (il_is_linked(&instance->grantor_flows, index))
+			il_del(&instance->grantor_flows, index);
 		memset(fe, 0, sizeof(*fe));
+	}
 	else {
-		RTE_LOG(ERR, HASH,
+		LOG_RATELIMIT(ERR, HASH,
 			"The GK block failed to delete a key from hash table at %s: %s!\n",
 			__func__, strerror(-ret));
 	}
@@ -521,27 +650,87 @@ gk_del_flow_entry_from_hash(struct rte_hash *h, struct flow_entry *fe)
 	return ret;
 }
 
+/* Add the flow entry @index to the list of its grantor. */
+static inline void
+link_flow_entry_to_grantor(struct gk_instance *instance, uint32_t index)
+{
+	struct flow_entry *fe = &instance->ip_flow_entry_table[index];
+
+	if (il_is_linked(&instance->grantor_flows, index))
+		il_del(&instance->grantor_flows, index);
+	il_add_tail(&instance->grantor_flows, fe->grantor_id, index);
+}
+
+/*
+ * Remove the flow entries whose deadlines have passed.
+ *
+ * At most GK_FLOW_EXPIRY_BURST_SIZE entries are examined at each call,
+ * so a large number of flows expiring at once does not hold up
+ * packet processing.
+ */
 static void
-gk_flow_tbl_bucket_scan(uint32_t *bidx,
-	uint64_t request_timeout_cycles, struct gk_instance *instance)
+gk_expire_flow_entries(struct gk_instance *instance,
+	uint64_t request_timeout_cycles)
 {
-	int32_t index;
-	const struct ip_flow *key;
-	void *data;
-	uint32_t next = 0;
+	int i;
 	uint64_t now = rte_rdtsc();
+	struct timer_wheel *tw = &instance->flow_expiry_tw;
 
-	index = rte_hash_bucket_iterate(instance->ip_flow_hash_table,
-		(void *)&key, &data, bidx, &next);
-	while (index >= 0) {
-		struct flow_entry *fe = &instance->ip_flow_entry_table[index];
-		if (is_flow_expired(fe, now, request_timeout_cycles)) {
-			gk_del_flow_entry_from_hash(
-				instance->ip_flow_hash_table, fe);
+	tw_advance(tw, now);
+
+	for (i = 0; i < GK_FLOW_EXPIRY_BURST_SIZE; i++) {
+		int ret;
+		struct ip_flow *key;
+		struct flow_entry *fe;
+		uint64_t expire_at;
+		int index = tw_pop_expired(tw);
+		if (index < 0)
+			break;
+
+		fe = &instance->ip_flow_entry_table[index];
+		expire_at = flow_entry_expire_at(fe, request_timeout_cycles);
+		if (expire_at > now) {
+			/* The deadline of the entry has been postponed. */
+			tw_schedule(tw, index, expire_at);
+			continue;
 		}
 
-		index = rte_hash_bucket_iterate(instance->ip_flow_hash_table,
-			(void *)&key, &data, bidx, &next);
+		ret = rte_hash_get_key_with_position(
+			instance->ip_flow_hash_table, index, (void **)&key);
+		if (ret < 0) {
+			LOG_RATELIMIT(ERR, HASH,
+				"The GK block failed to get the key of the expired flow entry %d at %s: %s!\n",
+				index, __func__, strerror(-ret));
+		} else if (gk_del_flow_entry_from_hash(instance,
+				key, fe) >= 0) {
+			stats_inc(instance->stats, STATS_GK_FLOW_EXPIRATIONS);
+			continue;
+		}
+
+		stats_inc(instance->stats, STATS_GK_FLOW_EXPIRY_ERRORS);
+		if (fe->expiry_retries < GK_FLOW_EXPIRY_MAX_RETRIES) {
+			/*
+			 * Keep the entry on the timing wheel, so it is
+			 * not leaked, and try again later.
+			 */
+			tw_schedule(tw, index, now +
+				(tw->cycles_per_tick << fe->expiry_retries));
+			fe->expiry_retries++;
+			continue;
+		}
+
+		/*
+		 * Both failures mean that the hash table does not hold
+		 * a key at the position of the entry, so only the entry
+		 * itself is left to release.
+		 */
+		LOG_RATELIMIT(ERR, HASH,
+			"The GK block reclaimed the expired flow entry %d without its key after %d failed removals at %s\n",
+			index, GK_FLOW_EXPIRY_MAX_RETRIES + 1, __func__);
+		stats_dec(instance->stats, STATS_GK_FLOWS);
+		if (il_is_linked(&instance->grantor_flows, index))
+			il_del(&instance->grantor_flows, index);
+		memset(fe, 0, sizeof(*fe));
 	}
 }
 
@@ -550,6 +739,8 @@ setup_gk_instance(unsigned int lcore_id, struct gk_config *gk_conf)
 {
 	int  ret;
 	char ht_name[64];
+	uint32_t num_grantor_lists;
+	struct index_link *grantor_heads;
 	unsigned int block_idx = get_block_idx(gk_conf, lcore_id);
 	unsigned int socket_id = rte_lcore_to_socket_id(lcore_id);
 
@@ -579,6 +770,9 @@ setup_gk_instance(unsigned int lcore_id, struct gk_config *gk_conf)
 	/* Set a new hash compare function other than the default one. */
 	rte_hash_set_cmp_func(instance->ip_flow_hash_table, ip_flow_cmp_eq);
 
+	/* Each flow entry must fit in a single cache line. */
+	RTE_BUILD_BUG_ON(sizeof(struct flow_entry) != RTE_CACHE_LINE_SIZE);
+
 	/* Setup the flow entry table for GK block @block_idx. */
 	instance->ip_flow_entry_table = (struct flow_entry *)rte_calloc(NULL,
 		gk_conf->flow_ht_size, sizeof(struct flow_entry), 0);
@@ -591,14 +785,71 @@ setup_gk_instance(unsigned int lcore_id, struct gk_config *gk_conf)
 		goto flow_hash;
 	}
 
+	ret = tw_init(&instance->flow_expiry_tw,
+		instance->ip_flow_entry_table, gk_conf->flow_ht_size,
+		sizeof(struct flow_entry),
+		offsetof(struct flow_entry, expiry_link),
+		gk_conf->flow_expiry_tick_ms * cycles_per_ms, rte_rdtsc());
+	if (ret < 0)
+		goto flow_entry;
+
+	/*
+	 * Setup the lists of flow entries of each grantor,
+	 * plus the list of flow entries being flushed.
+	 */
+	num_grantor_lists = gk_conf->gk_max_num_ipv4_fib_entries +
+		gk_conf->gk_max_num_ipv6_fib_entries + 1;
+	grantor_heads = rte_calloc_socket(NULL, num_grantor_lists,
+		sizeof(*grantor_heads), 0, socket_id);
+	if (grantor_heads == NULL) {
+		RTE_LOG(ERR, MALLOC,
+			"The GK block can't create the lists of flow entries of the grantors at lcore %u!\n",
+			lcore_id);
+
+		ret = -1;
+		goto flow_entry;
+	}
+
+	ret = il_init(&instance->grantor_flows,
+		instance->ip_flow_entry_table, gk_conf->flow_ht_size,
+		sizeof(struct flow_entry),
+		offsetof(struct flow_entry, grantor_link),
+		grantor_heads, num_grantor_lists);
+	if (ret < 0) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gk: the flow table at lcore %u is too large!\n",
+			lcore_id);
+		goto grantor_heads;
+	}
+
+	/* Each grantor FIB entry is flushed at most once at a time. */
+	instance->flushing_fibs = rte_calloc_socket(NULL,
+		num_grantor_lists - 1, sizeof(*instance->flushing_fibs),
+		0, socket_id);
+	if (instance->flushing_fibs == NULL) {
+		RTE_LOG(ERR, MALLOC,
+			"The GK block can't create the list of grantors being flushed at lcore %u!\n",
+			lcore_id);
+
+		ret = -1;
+		goto grantor_heads;
+	}
+	instance->num_flushing_fibs = 0;
+
 	ret = init_mailbox("gk", MAILBOX_MAX_ENTRIES,
 		sizeof(struct gk_cmd_entry), lcore_id, &instance->mb);
     	if (ret < 0)
-        	goto flow_entry;
+        	goto flushing_fibs;
 
 	ret = 0;
 	goto out;
 
+flushing_fibs:
+	rte_free(instance->flushing_fibs);
+	instance->flushing_fibs = NULL;
+grantor_heads:
+	rte_free(grantor_heads);
+	instance->grantor_flows.heads = NULL;
 flow_entry:
     	rte_free(instance->ip_flow_entry_table);
     	instance->ip_flow_entry_table = NULL;
@@ -612,11 +863,12 @@ out:
 static struct flow_entry *
 find_flow_entry_candidate(struct gk_instance *instance,
 	uint32_t bidx, uint64_t request_timeout_cycles,
-	enum gk_flow_state state_to_add)
+	enum gk_flow_state state_to_add, const struct ip_flow **pkey)
 {
 	int32_t index;
 	uint32_t next = 0;
 	const struct ip_flow *key;
+	const struct ip_flow *last_key = NULL;
 	struct flow_entry *last_fe = NULL;
 	void *data;
 	uint64_t now = rte_rdtsc();
@@ -627,8 +879,10 @@ find_flow_entry_candidate(struct gk_instance *instance,
 		struct flow_entry *fe = &instance->ip_flow_entry_table[index];
 
 		/* Expired flow entry. */
-		if (is_flow_expired(fe, now, request_timeout_cycles))
+		if (is_flow_expired(key, fe, now, request_timeout_cycles)) {
+			*pkey = key;
 			return fe;
+		}
 
 		/*
 		 * Only flow entries with state GK_REQUEST
@@ -643,19 +897,24 @@ find_flow_entry_candidate(struct gk_instance *instance,
 			 * We use +2 instead of +1 in the test below to account
 			 * for random delays in the network.
 			 */
-			if (priority > fe->u.request.last_priority + 2)
+			if (priority > fe->u.request.last_priority + 2) {
+				*pkey = key;
 				return fe;
+			}
 
 			if (state_to_add != GK_REQUEST && (last_fe == NULL ||
 					last_fe->u.request.last_packet_seen_at >
-					fe->u.request.last_packet_seen_at))
+					fe->u.request.last_packet_seen_at)) {
+				last_key = key;
 				last_fe = fe;
+			}
 		}
 
 		index = rte_hash_bucket_iterate(instance->ip_flow_hash_table,
 			(void *)&key, &data, &bidx, &next);
 	}
 
+	*pkey = last_key;
 	return last_fe;
 }
 
@@ -664,14 +923,20 @@ drop_flow_entry_heuristically(struct gk_instance *instance,
 	hash_sig_t sig, uint64_t request_timeout_cycles,
 	enum gk_flow_state state_to_add)
 {
+	const struct ip_flow *key;
 	uint32_t primary_bidx = rte_hash_get_primary_bucket(
 		instance->ip_flow_hash_table, sig);
-	struct flow_entry *fe = find_flow_entry_candidate(
-		instance, primary_bidx, request_timeout_cycles, state_to_add);
+	struct flow_entry *fe = find_flow_entry_candidate(instance,
+		primary_bidx, request_timeout_cycles, state_to_add, &key);
+	int ret;
+
 	if (fe == NULL)
 		return -ENOSPC;
 
-	return gk_del_flow_entry_from_hash(instance->ip_flow_hash_table, fe);
+	ret = gk_del_flow_entry_from_hash(instance, key, fe);
+	if (ret >= 0)
+		stats_inc(instance->stats, STATS_GK_FLOW_EVICTIONS);
+	return ret;
 }
 
 /*
@@ -687,22 +952,26 @@ gk_hash_add_flow_entry(struct gk_instance *instance,
 		int ret = rte_hash_add_key_with_hash(
 			instance->ip_flow_hash_table, flow, rss_hash_val);
 		if (ret == -ENOSPC) {
-			RTE_LOG(WARNING, HASH,
+			LOG_RATELIMIT(WARNING, HASH,
 				"The GK block failed to add new key to hash table in %s due to lack of space!\n",
 				__func__);
 			ret = drop_flow_entry_heuristically(instance,
 				rss_hash_val, request_timeout_cycles,
 				state_to_add);
-			if (ret < 0)
+			if (ret < 0) {
+				stats_inc(instance->stats,
+					STATS_GK_FLOW_ENOSPC);
 				return -ENOSPC;
+			}
 			continue;
 		}
 
 		if (ret < 0) {
-			RTE_LOG(ERR, HASH,
+			LOG_RATELIMIT(ERR, HASH,
 				"The GK block failed to add a new key to hash table in %s: %s!\n",
 				__func__, strerror(-ret));
-		}
+		} else
+			stats_inc(instance->stats, STATS_GK_FLOWS);
 
 		return ret;
 	}
@@ -713,7 +982,7 @@ gk_hash_add_flow_entry(struct gk_instance *instance,
  * tries to add a new flow entry in the flow table.
  *
  * Notice, the function doesn't fully initialize the new flow entry,
- * instead it only initializes the @flow and @grantor_fib fields.
+ * instead it only initializes the @grantor_id field.
  */
 static struct flow_entry *
 add_new_flow_from_policy(
@@ -745,9 +1014,8 @@ add_new_flow_from_policy(
 		return NULL;
 
 	fe = &instance->ip_flow_entry_table[ret];
-	rte_memcpy(&fe->flow, &policy->flow, sizeof(fe->flow));
-
-	fe->grantor_fib = fib;
+	fe->grantor_id = fib_to_grantor_id(gk_conf, fib);
+	link_flow_entry_to_grantor(instance, ret);
 
 	return fe;
 }
@@ -810,42 +1078,91 @@ add_ggu_policy(struct ggu_policy *policy,
 	default:
 		RTE_LOG(ERR, GATEKEEPER,
 			"gk: unknown flow state %u!\n", policy->state);
-		break;
+		return;
 	}
+
+	tw_schedule(&instance->flow_expiry_tw,
+		fe - instance->ip_flow_entry_table,
+		flow_entry_expire_at(fe, gk_conf->request_timeout_cycles));
+}
+
+static inline uint32_t
+grantor_flush_list(struct gk_instance *instance)
+{
+	return instance->grantor_flows.num_heads - 1;
 }
 
+/*
+ * Remove a burst of the flow entries of the grantor FIB entries
+ * being flushed. Once all of them are removed, let the writers of the
+ * FIB entries know that this instance no longer refers to them.
+ */
 static void
-gk_synchronize(struct gk_fib *fib, struct gk_instance *instance)
+gk_flush_flow_entries(struct gk_instance *instance)
 {
-	switch (fib->action) {
-	case GK_FWD_GRANTOR: {
-		/* Flush the grantor @fib in the flow table. */
-
-		uint32_t next = 0;
-		int32_t index;
-		const struct ip_flow *key;
-		void *data;
-
-		index = rte_hash_iterate(instance->ip_flow_hash_table,
-			(void *)&key, &data, &next);
-		while (index >= 0) {
-			struct flow_entry *fe =
-				&instance->ip_flow_entry_table[index];
-			if (fe->grantor_fib == fib) {
-				gk_del_flow_entry_from_hash(
-					instance->ip_flow_hash_table, fe);
-			}
+	int i;
+	unsigned int j;
+
+	if (instance->num_flushing_fibs == 0)
+		return;
+
+	for (i = 0; i < GK_FLOW_FLUSH_BURST_SIZE; i++) {
+		int ret;
+		struct ip_flow *key;
+		int64_t index = il_first(&instance->grantor_flows,
+			grantor_flush_list(instance));
+		if (index < 0)
+			break;
 
-			index = rte_hash_iterate(instance->ip_flow_hash_table,
-				(void *)&key, &data, &next);
+		ret = rte_hash_get_key_with_position(
+			instance->ip_flow_hash_table, index, (void **)&key);
+		if (ret < 0) {
+			RTE_LOG(ERR, HASH,
+				"The GK block failed to get the key of the flow entry %" PRId64 " being flushed at %s: %s!\n",
+				index, __func__, strerror(-ret));
+			il_del(&instance->grantor_flows, index);
+			continue;
 		}
 
-		RTE_LOG(NOTICE, GATEKEEPER,
-			"gk: finished flushing flow table at lcore %u\n",
-			rte_lcore_id());
+		gk_del_flow_entry_from_hash(instance, key,
+			&instance->ip_flow_entry_table[index]);
+	}
 
-		break;
+	if (!il_empty(&instance->grantor_flows, grantor_flush_list(instance)))
+		return;
+
+	RTE_LOG(NOTICE, GATEKEEPER,
+		"gk: finished flushing %u grantors from the flow table at lcore %u\n",
+		instance->num_flushing_fibs, rte_lcore_id());
+
+	for (j = 0; j < instance->num_flushing_fibs; j++) {
+		rte_atomic16_inc(
+			&instance->flushing_fibs[j]->num_updated_instances);
 	}
+	instance->num_flushing_fibs = 0;
+}
+
+static void
+gk_synchronize(struct gk_fib *fib, struct gk_instance *instance,
+	struct gk_config *gk_conf)
+{
+	switch (fib->action) {
+	case GK_FWD_GRANTOR:
+		/*
+		 * Flush the grantor @fib in the flow table.
+		 *
+		 * Only the flow entries of @fib are visited, and
+		 * they are removed over the following iterations of
+		 * the main loop. If other grantors are being flushed,
+		 * the flow entries of @fib join theirs.
+		 * gk_flush_flow_entries() notifies the writers once
+		 * they are all gone.
+		 */
+		il_splice_tail(&instance->grantor_flows,
+			grantor_flush_list(instance),
+			fib_to_grantor_id(gk_conf, fib));
+		instance->flushing_fibs[instance->num_flushing_fibs++] = fib;
+		return;
 
 	case GK_FWD_GATEWAY_FRONT_NET:
 		/* FALLTHROUGH */
@@ -881,7 +1198,7 @@ process_gk_cmd(struct gk_cmd_entry *entry,
 		break;
 
 	case GK_SYNCH_WITH_LPM:
-		gk_synchronize(entry->u.fib, instance);
+		gk_synchronize(entry->u.fib, instance, gk_conf);
 		break;
 
 	default:
@@ -891,6 +1208,53 @@ process_gk_cmd(struct gk_cmd_entry *entry,
 	}
 }
 
+/*
+ * Map each entry of the RETA of the front interface in @rss_conf
+ * to the index of the GK instance that owns the queue of the entry.
+ */
+static int
+build_reta_to_instance(struct gk_config *gk_conf,
+	const struct gatekeeper_rss_config *rss_conf,
+	uint16_t *reta_to_instance)
+{
+	uint16_t i;
+
+	/*
+	 * The NIC uses the least significant bits of the RSS hash
+	 * to index the RETA, so its size must be a power of 2.
+	 */
+	if (!rte_is_power_of_2(rss_conf->reta_size)) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gk: the RETA size (%hu) of the front interface is not a power of 2!\n",
+			rss_conf->reta_size);
+		return -1;
+	}
+
+	for (i = 0; i < rss_conf->reta_size; i++) {
+		uint32_t idx = i / RTE_RETA_GROUP_SIZE;
+		uint32_t shift = i % RTE_RETA_GROUP_SIZE;
+		uint16_t queue_id = rss_conf->reta_conf[idx].reta[shift];
+		int j;
+
+		for (j = 0; j < gk_conf->num_lcores; j++) {
+			struct gk_instance *instance = &gk_conf->instances[j];
+			if (instance->rx_queue_front == queue_id)
+				break;
+		}
+
+		if (j == gk_conf->num_lcores) {
+			RTE_LOG(ERR, GATEKEEPER,
+				"gk: RETA entry %hu of the front interface refers to queue %hu, which is not of a GK instance!\n",
+				i, queue_id);
+			return -1;
+		}
+
+		reta_to_instance[i] = j;
+	}
+
+	return 0;
+}
+
 static int
 gk_setup_rss(struct gk_config *gk_conf)
 {
@@ -915,6 +1279,11 @@ gk_setup_rss(struct gk_config *gk_conf)
 	if (ret < 0)
 		goto out;
 
+	ret = build_reta_to_instance(gk_conf, &gk_conf->rss_conf_front,
+		gk_conf->reta_to_instance_front);
+	if (ret < 0)
+		goto out;
+
 	ret = gatekeeper_setup_rss(
 		port_back, gk_queues_back, gk_conf->num_lcores);
 	if (ret < 0)
@@ -931,10 +1300,34 @@ out:
 	return ret;
 }
 
-/* Process the packets on the front interface. */
-static void
-process_pkts_front(uint16_t port_front, uint16_t port_back,
-	uint16_t rx_queue_front, uint16_t tx_queue_back,
+static inline void
+prefetch_fib_eth_cache(struct gk_fib *fib)
+{
+	switch (fib->action) {
+	case GK_FWD_GRANTOR:
+		rte_prefetch0(fib->u.grantor.eth_cache);
+		break;
+	case GK_FWD_GATEWAY_FRONT_NET:
+		/* FALLTHROUGH */
+	case GK_FWD_GATEWAY_BACK_NET:
+		rte_prefetch0(fib->u.gateway.eth_cache);
+		break;
+	default:
+		/*
+		 * Neighbor entries need a hash lookup to find
+		 * their Ethernet cache, and the remaining actions
+		 * do not use one.
+		 */
+		break;
+	}
+}
+
+/*
+ * Process the packets on the front interface.
+ * Return the number of packets received.
+ */
+static uint16_t
+process_pkts_front(uint16_t port_front, uint16_t rx_queue_front,
 	unsigned int lcore, struct gk_instance *instance,
 	struct gk_config *gk_conf)
 {
@@ -942,12 +1335,32 @@ process_pkts_front(uint16_t port_front, uint16_t port_back,
 	int i;
 	int ret;
 	uint16_t num_rx;
+	uint16_t num_ip = 0;
 	uint16_t num_tx = 0;
-	uint16_t num_tx_succ;
 	uint16_t num_arp = 0;
+	uint16_t num_reqs = 0;
+	/* When the burst was received, if latency sampling is on. */
+	uint64_t rx_at = 0;
+	/*
+	 * Whether the flow table has been changed while
+	 * processing this burst, so the positions found by
+	 * the bulk lookup may no longer be accurate.
+	 */
+	bool flow_tbl_changed = false;
 	struct rte_mbuf *rx_bufs[GATEKEEPER_MAX_PKT_BURST];
 	struct rte_mbuf *tx_bufs[GATEKEEPER_MAX_PKT_BURST];
 	struct rte_mbuf *arp_bufs[GATEKEEPER_MAX_PKT_BURST];
+	struct rte_mbuf *req_bufs[GATEKEEPER_MAX_PKT_BURST];
+	struct ipacket packets[GATEKEEPER_MAX_PKT_BURST];
+	const void *flows[GATEKEEPER_MAX_PKT_BURST];
+	hash_sig_t flow_sigs[GATEKEEPER_MAX_PKT_BURST];
+	int32_t positions[GATEKEEPER_MAX_PKT_BURST];
+	struct gk_fib *fibs[GATEKEEPER_MAX_PKT_BURST];
+	/* The flows that are not in the flow table. */
+	uint16_t num_miss = 0;
+	uint16_t miss_idx[GATEKEEPER_MAX_PKT_BURST];
+	struct ip_flow *miss_flows[GATEKEEPER_MAX_PKT_BURST];
+	struct gk_fib *miss_fibs[GATEKEEPER_MAX_PKT_BURST];
 	ACL_SEARCH_DEF(acl4);
 	ACL_SEARCH_DEF(acl6);
 	struct gatekeeper_if *back = &gk_conf->net->back;
@@ -957,20 +1370,34 @@ process_pkts_front(uint16_t port_front, uint16_t port_back,
 		GATEKEEPER_MAX_PKT_BURST);
 
 	if (unlikely(num_rx == 0))
-		return;
+		return 0;
+
+	stats_add(instance->stats, STATS_PKTS_RX, num_rx);
+	if (gk_conf->latency_sample_period != 0)
+		rx_at = rte_rdtsc();
+
+	/*
+	 * The packets are processed in stages, so the memory accesses
+	 * of a stage are overlapped for the whole burst instead of
+	 * stalling on each packet:
+	 * (1) parse the packets;
+	 * (2) look up all flows in the flow table at once;
+	 * (3) prefetch the flow entries, look up the destinations
+	 *     of the new flows in the LPM table at once, and
+	 *     prefetch the FIB entries;
+	 * (4) run each packet through its flow entry.
+	 */
+
+	for (i = 0; i < num_rx; i++)
+		rte_prefetch0(rte_pktmbuf_mtod(rx_bufs[i], void *));
 
 	for (i = 0; i < num_rx; i++) {
-		struct ipacket packet;
-		/*
-		 * Pointer to the flow entry in request state 
-		 * under evaluation.
-		 */
-		struct flow_entry *fe;
 		struct rte_mbuf *pkt = rx_bufs[i];
+		struct ipacket *packet = &packets[num_ip];
 
-		ret = extract_packet_info(pkt, &packet);
+		ret = extract_packet_info(pkt, packet);
 		if (ret < 0) {
-			if (likely(packet.flow.proto == ETHER_TYPE_ARP)) {
+			if (likely(packet->flow.proto == ETHER_TYPE_ARP)) {
 				arp_bufs[num_arp++] = pkt;
 				continue;
 			}
@@ -980,35 +1407,121 @@ process_pkts_front(uint16_t port_front, uint16_t port_back,
 			continue;
 		}
 
+		flows[num_ip] = &packet->flow;
+		flow_sigs[num_ip] = pkt->hash.rss;
+		num_ip++;
+	}
+
+	if (num_ip > 0) {
+		/*
+		 * The hash function of the flow table is the same
+		 * as the one used for RSS, so the signatures
+		 * computed by the NIC are reused here.
+		 */
+		ret = rte_hash_lookup_bulk_with_hash(
+			instance->ip_flow_hash_table, flows, flow_sigs,
+			num_ip, positions);
+		if (unlikely(ret < 0)) {
+			LOG_RATELIMIT(ERR, HASH,
+				"The GK block failed to look up flows in bulk at %s: %s!\n",
+				__func__, strerror(-ret));
+			for (i = 0; i < num_ip; i++)
+				positions[i] = -ENOENT;
+		}
+	}
+
+	/*
+	 * Prefetch the flow entries that were found, and,
+	 * while they are on their way, look up the destinations
+	 * of the new flows in the global LPM table at once.
+	 */
+	for (i = 0; i < num_ip; i++) {
+		if (positions[i] >= 0) {
+			rte_prefetch0(
+				&instance->ip_flow_entry_table[positions[i]]);
+			continue;
+		}
+
+		miss_idx[num_miss] = i;
+		miss_flows[num_miss++] = &packets[i].flow;
+	}
+
+	if (num_miss > 0) {
+		look_up_fib_bulk(&gk_conf->lpm_tbl, miss_flows, miss_fibs,
+			num_miss);
+		for (i = 0; i < num_miss; i++) {
+			fibs[miss_idx[i]] = miss_fibs[i];
+			if (miss_fibs[i] != NULL)
+				rte_prefetch0(miss_fibs[i]);
+		}
+	}
+
+	for (i = 0; i < num_ip; i++) {
+		if (positions[i] >= 0) {
+			fibs[i] = grantor_id_to_fib(gk_conf,
+				instance->ip_flow_entry_table[
+				positions[i]].grantor_id);
+			rte_prefetch0(fibs[i]);
+		}
+	}
+
+	for (i = 0; i < num_ip; i++) {
+		if (fibs[i] != NULL)
+			prefetch_fib_eth_cache(fibs[i]);
+	}
+
+	for (i = 0; i < num_ip; i++) {
+		struct ipacket *packet = &packets[i];
+		/*
+		 * Pointer to the flow entry in request state 
+		 * under evaluation.
+		 */
+		struct flow_entry *fe;
+		struct gk_fib *fib;
+		struct rte_mbuf *pkt = packet->pkt;
+
 		/* 
 		 * Find the flow entry for the IP pair.
 		 *
 		 * If the pair of source and destination addresses 
 		 * is in the flow table, proceed as the entry instructs,
 		 * and go to the next packet.
+		 *
+		 * Adding flow entries during this burst may have
+		 * evicted the entry found for this packet, or added
+		 * an entry for its flow, so redo the lookup.
 		 */
-		ret = rte_hash_lookup_with_hash(instance->ip_flow_hash_table,
-			&packet.flow, pkt->hash.rss);
+		ret = positions[i];
+		if (unlikely(flow_tbl_changed)) {
+			ret = rte_hash_lookup_with_hash(
+				instance->ip_flow_hash_table,
+				&packet->flow, pkt->hash.rss);
+			if (ret < 0 && positions[i] >= 0) {
+				fibs[i] = look_up_fib(&gk_conf->lpm_tbl,
+					&packet->flow);
+			}
+		}
+
 		if (ret >= 0)
 			fe = &instance->ip_flow_entry_table[ret];
 		else {
 			/*
-			 * Otherwise, look up the destination address
-		 	 * in the global LPM table.
+			 * Otherwise, the destination address was
+		 	 * looked up in the global LPM table.
 			 */
-			struct gk_fib *fib = look_up_fib(
-				&gk_conf->lpm_tbl, &packet.flow);
 			struct ether_cache *eth_cache;
 
+			fib = fibs[i];
+
 		 	/* No entry for the destination, drop the packet. */
 			if (fib == NULL) {
-				if (packet.flow.proto == ETHER_TYPE_IPv4)
+				if (packet->flow.proto == ETHER_TYPE_IPv4)
 					add_pkt_acl(&acl4, pkt);
-				else if (likely(packet.flow.proto ==
+				else if (likely(packet->flow.proto ==
 						ETHER_TYPE_IPv6))
 					add_pkt_acl(&acl6, pkt);
 				else {
-					print_flow_err_msg(&packet.flow,
+					print_flow_err_msg(&packet->flow,
 						"gk: failed to get the fib entry");
 					drop_packet(pkt);
 				}
@@ -1029,8 +1542,9 @@ process_pkts_front(uint16_t port_front, uint16_t port_back,
 				 * brand-new entry instructs, and
 			 	 * go to the next packet.
 			 	 */
+				flow_tbl_changed = true;
 				ret = gk_hash_add_flow_entry(
-					instance, &packet.flow,
+					instance, &packet->flow,
 					gk_conf->request_timeout_cycles,
 					pkt->hash.rss, GK_REQUEST);
 				if (ret == -ENOSPC) {
@@ -1043,12 +1557,17 @@ process_pkts_front(uint16_t port_front, uint16_t port_back,
 					 */
 					struct flow_entry temp_fe;
 					initialize_flow_entry(&temp_fe,
-						&packet.flow, fib);
+						fib_to_grantor_id(gk_conf,
+						fib));
+					stats_inc(instance->stats,
+						STATS_GK_PKTS_REQUEST);
 					ret = gk_process_request(
-						&temp_fe, &packet,
+						&temp_fe, fib, packet,
 						gk_conf->sol_conf);
 					if (ret < 0)
 						drop_packet(pkt);
+					else
+						req_bufs[num_reqs++] = pkt;
 					continue;
 				} else if (ret < 0) {
 					drop_packet(pkt);
@@ -1056,7 +1575,12 @@ process_pkts_front(uint16_t port_front, uint16_t port_back,
 				}
 
 				fe = &instance->ip_flow_entry_table[ret];
-				initialize_flow_entry(fe, &packet.flow, fib);
+				initialize_flow_entry(fe,
+					fib_to_grantor_id(gk_conf, fib));
+				link_flow_entry_to_grantor(instance, ret);
+				tw_schedule(&instance->flow_expiry_tw, ret,
+					flow_entry_expire_at(fe,
+					gk_conf->request_timeout_cycles));
 				break;
 
 			case GK_FWD_GATEWAY_BACK_NET: {
@@ -1095,14 +1619,14 @@ process_pkts_front(uint16_t port_front, uint16_t port_back,
 				 * its packets to the neighbor in
 				 * the back network, forward accordingly.
 				 */
-				if (packet.flow.proto == ETHER_TYPE_IPv4) {
+				if (packet->flow.proto == ETHER_TYPE_IPv4) {
 					eth_cache = lookup_ether_cache(
 						&fib->u.neigh,
-						&packet.flow.f.v4.dst);
+						&packet->flow.f.v4.dst);
 				} else {
 					eth_cache = lookup_ether_cache(
 						&fib->u.neigh6,
-						packet.flow.f.v6.dst);
+						packet->flow.f.v6.dst);
 				}
 
 				RTE_VERIFY(eth_cache != NULL);
@@ -1127,26 +1651,31 @@ process_pkts_front(uint16_t port_front, uint16_t port_back,
 			}
 		}
 
+		fib = grantor_id_to_fib(gk_conf, fe->grantor_id);
+
 		switch (fe->state) {
 		case GK_REQUEST:
-			ret = gk_process_request(fe, &packet,
+			stats_inc(instance->stats, STATS_GK_PKTS_REQUEST);
+			ret = gk_process_request(fe, fib, packet,
 				gk_conf->sol_conf);
 			break;
 
 		case GK_GRANTED:
-			ret = gk_process_granted(fe, &packet,
+			stats_inc(instance->stats, STATS_GK_PKTS_GRANTED);
+			ret = gk_process_granted(fe, fib, packet,
 				gk_conf->sol_conf);
 			break;
 
 		case GK_DECLINED:
-			ret = gk_process_declined(fe, &packet,
+			stats_inc(instance->stats, STATS_GK_PKTS_DECLINED);
+			ret = gk_process_declined(fe, fib, packet,
 				gk_conf->sol_conf);
 			break;
 
 		default:
 			ret = -1;
 			/* XXX Incorrect state, log warning. */
-			RTE_LOG(ERR, GATEKEEPER,
+			LOG_RATELIMIT(ERR, GATEKEEPER,
 				"gk: unknown flow state!\n");
 			break;
 		}
@@ -1155,7 +1684,7 @@ process_pkts_front(uint16_t port_front, uint16_t port_back,
 			drop_packet(pkt);
 		else if (ret == EINPROGRESS) {
 			/* Request will be serviced by another lcore. */
-			continue;
+			req_bufs[num_reqs++] = pkt;
 		} else if (likely(ret == 0))
 			tx_bufs[num_tx++] = pkt;
 		else
@@ -1164,38 +1693,48 @@ process_pkts_front(uint16_t port_front, uint16_t port_back,
 	}
 
 	/* Send burst of TX packets, to second port of pair. */
-	num_tx_succ = rte_eth_tx_burst(port_back, tx_queue_back,
-		tx_bufs, num_tx);
-
-	/* XXX Do something better here! For now, free any unsent packets. */
-	if (unlikely(num_tx_succ < num_tx)) {
-		for (i = num_tx_succ; i < num_tx; i++)
-			drop_packet(tx_bufs[i]);
+	txb_add_bulk(&instance->tx_back, tx_bufs, num_tx);
+	txb_flush(&instance->tx_back);
+
+	/* Hand the requests over to the Solicitor. */
+	for (i = 0; i < num_reqs; i++) {
+		sol_set_req_arrival(req_bufs[i],
+			stats_sample(&instance->latency_countdown,
+				gk_conf->latency_sample_period) ? rx_at : 0);
 	}
+	gk_solicitor_enqueue_bulk(instance->sol_req_ring, req_bufs, num_reqs);
 
 	if (num_arp > 0)
 		submit_arp(arp_bufs, num_arp, &gk_conf->net->front);
 
 	process_pkts_acl(&gk_conf->net->front, lcore, &acl4, ETHER_TYPE_IPv4);
 	process_pkts_acl(&gk_conf->net->front, lcore, &acl6, ETHER_TYPE_IPv6);
+
+	return num_rx;
 }
 
-/* Process the packets on the back interface. */
-static void
-process_pkts_back(uint16_t port_back, uint16_t port_front,
-	uint16_t rx_queue_back, uint16_t tx_queue_front,
-	unsigned int lcore, struct gk_config *gk_conf)
+/*
+ * Process the packets on the back interface.
+ * Return the number of packets received.
+ */
+static uint16_t
+process_pkts_back(uint16_t port_back, uint16_t rx_queue_back,
+	unsigned int lcore, struct gk_instance *instance,
+	struct gk_config *gk_conf)
 {
 	/* Get burst of RX packets, from first port of pair. */
 	int i;
 	int ret;
 	uint16_t num_rx;
 	uint16_t num_tx = 0;
-	uint16_t num_tx_succ;
 	uint16_t num_arp = 0;
+	uint16_t num_ip = 0;
 	struct rte_mbuf *rx_bufs[GATEKEEPER_MAX_PKT_BURST];
 	struct rte_mbuf *tx_bufs[GATEKEEPER_MAX_PKT_BURST];
 	struct rte_mbuf *arp_bufs[GATEKEEPER_MAX_PKT_BURST];
+	struct ipacket packets[GATEKEEPER_MAX_PKT_BURST];
+	struct ip_flow *flows[GATEKEEPER_MAX_PKT_BURST];
+	struct gk_fib *fibs[GATEKEEPER_MAX_PKT_BURST];
 	ACL_SEARCH_DEF(acl4);
 	ACL_SEARCH_DEF(acl6);
 	struct gatekeeper_if *front = &gk_conf->net->front;
@@ -1205,17 +1744,26 @@ process_pkts_back(uint16_t port_back, uint16_t port_front,
 		GATEKEEPER_MAX_PKT_BURST);
 
 	if (unlikely(num_rx == 0))
-		return;
+		return 0;
+
+	stats_add(instance->stats, STATS_PKTS_RX, num_rx);
+
+	/*
+	 * As in process_pkts_front(), the packets are processed
+	 * in stages: parse all packets, look up all destinations
+	 * in the LPM table at once, and forward each packet.
+	 */
+
+	for (i = 0; i < num_rx; i++)
+		rte_prefetch0(rte_pktmbuf_mtod(rx_bufs[i], void *));
 
 	for (i = 0; i < num_rx; i++) {
-		struct ipacket packet;
-		struct gk_fib *fib;
 		struct rte_mbuf *pkt = rx_bufs[i];
-		struct ether_cache *eth_cache;
+		struct ipacket *packet = &packets[num_ip];
 
-		ret = extract_packet_info(pkt, &packet);
+		ret = extract_packet_info(pkt, packet);
 		if (ret < 0) {
-			if (likely(packet.flow.proto == ETHER_TYPE_ARP)) {
+			if (likely(packet->flow.proto == ETHER_TYPE_ARP)) {
 				arp_bufs[num_arp++] = pkt;
 				continue;
 			}
@@ -1225,17 +1773,32 @@ process_pkts_back(uint16_t port_back, uint16_t port_front,
 			continue;
 		}
 
-		fib = look_up_fib(&gk_conf->lpm_tbl, &packet.flow);
+		flows[num_ip++] = &packet->flow;
+	}
+
+	if (num_ip > 0)
+		look_up_fib_bulk(&gk_conf->lpm_tbl, flows, fibs, num_ip);
+
+	for (i = 0; i < num_ip; i++) {
+		if (fibs[i] != NULL)
+			prefetch_fib_eth_cache(fibs[i]);
+	}
+
+	for (i = 0; i < num_ip; i++) {
+		struct ipacket *packet = &packets[i];
+		struct gk_fib *fib = fibs[i];
+		struct rte_mbuf *pkt = packet->pkt;
+		struct ether_cache *eth_cache;
 
 		 /* No entry for the destination, drop the packet. */
 		if (fib == NULL) {
-			if (packet.flow.proto == ETHER_TYPE_IPv4)
+			if (packet->flow.proto == ETHER_TYPE_IPv4)
 				add_pkt_acl(&acl4, pkt);
-			else if (likely(packet.flow.proto ==
+			else if (likely(packet->flow.proto ==
 					ETHER_TYPE_IPv6))
 				add_pkt_acl(&acl6, pkt);
 			else {
-				print_flow_err_msg(&packet.flow,
+				print_flow_err_msg(&packet->flow,
 					"gk: failed to get the fib entry");
 				drop_packet(pkt);
 			}
@@ -1277,14 +1840,14 @@ process_pkts_back(uint16_t port_back, uint16_t port_front,
 			 * its packets to the neighbor in
 			 * the front network, forward accordingly.
 			 */
-			if (packet.flow.proto == ETHER_TYPE_IPv4) {
+			if (packet->flow.proto == ETHER_TYPE_IPv4) {
 				eth_cache = lookup_ether_cache(
 					&fib->u.neigh,
-					&packet.flow.f.v4.dst);
+					&packet->flow.f.v4.dst);
 			} else {
 				eth_cache = lookup_ether_cache(
 					&fib->u.neigh6,
-					packet.flow.f.v6.dst);
+					packet->flow.f.v6.dst);
 			}
 
 			RTE_VERIFY(eth_cache != NULL);
@@ -1303,7 +1866,7 @@ process_pkts_back(uint16_t port_back, uint16_t port_front,
 
 		default:
 			/* All other actions should log a warning. */
-			RTE_LOG(WARNING, GATEKEEPER,
+			LOG_RATELIMIT(WARNING, GATEKEEPER,
 				"gk: the fib entry has an unexpected action %u at %s!\n",
 				fib->action, __func__);
 			drop_packet(pkt);
@@ -1312,20 +1875,16 @@ process_pkts_back(uint16_t port_back, uint16_t port_front,
 	}
 
 	/* Send burst of TX packets, to second port of pair. */
-	num_tx_succ = rte_eth_tx_burst(port_front, tx_queue_front,
-		tx_bufs, num_tx);
-
-	/* XXX Do something better here! For now, free any unsent packets. */
-	if (unlikely(num_tx_succ < num_tx)) {
-		for (i = num_tx_succ; i < num_tx; i++)
-			drop_packet(tx_bufs[i]);
-	}
+	txb_add_bulk(&instance->tx_front, tx_bufs, num_tx);
+	txb_flush(&instance->tx_front);
 
 	if (num_arp > 0)
 		submit_arp(arp_bufs, num_arp, &gk_conf->net->back);
 
 	process_pkts_acl(&gk_conf->net->back, lcore, &acl4, ETHER_TYPE_IPv4);
 	process_pkts_acl(&gk_conf->net->back, lcore, &acl6, ETHER_TYPE_IPv6);
+
+	return num_rx;
 }
 
 static void
@@ -1357,47 +1916,64 @@ gk_proc(void *arg)
 	uint16_t port_front = get_net_conf()->front.id;
 	uint16_t port_back = get_net_conf()->back.id;
 	uint16_t rx_queue_front = instance->rx_queue_front;
-	uint16_t tx_queue_front = instance->tx_queue_front;
 	uint16_t rx_queue_back = instance->rx_queue_back;
-	uint16_t tx_queue_back = instance->tx_queue_back;
-
-	int num_buckets = rte_hash_get_num_buckets(
-		instance->ip_flow_hash_table);
-	uint32_t bucket_idx = 0;
-	uint64_t last_tsc = rte_rdtsc();
-	uint64_t bucket_scan_timeout_cycles = round(
-		(double)(gk_conf->flow_table_full_scan_ms *
-		rte_get_tsc_hz()) / (num_buckets * 1000.));
-	if (bucket_scan_timeout_cycles == 0) {
-		RTE_LOG(WARNING, GATEKEEPER,
-			"gk: the value of the field flow_table_full_scan_ms in Gatekeeper configuration is too small!");
-		exiting = true;
-		return -1;
-	}
+	struct profile prof;
 
 	RTE_LOG(NOTICE, GATEKEEPER,
 		"gk: the GK block is running at lcore = %u\n", lcore);
 
+	instance->stats = stats_register(lcore, STATS_BLOCK_GK);
+	profile_init(&prof, instance->stats);
+
+	txb_init(&instance->tx_front, port_front, instance->tx_queue_front);
+	txb_init(&instance->tx_back, port_back, instance->tx_queue_back);
+
 	gk_conf_hold(gk_conf);
+	qsbr_online(&gk_conf->qsbr, lcore);
 
 	while (likely(!exiting)) {
-		process_pkts_front(port_front, port_back,
-			rx_queue_front, tx_queue_back,
+		uint64_t now;
+		uint16_t num_rx;
+
+		num_rx = process_pkts_front(port_front, rx_queue_front,
 			lcore, instance, gk_conf);
+		profile_charge(&prof, num_rx > 0 ?
+			STATS_PHASE_GK_FRONT : STATS_PHASE_IDLE);
 
-		process_pkts_back(port_back, port_front,
-			rx_queue_back, tx_queue_front,
-			lcore, gk_conf);
+		num_rx = process_pkts_back(port_back, rx_queue_back,
+			lcore, instance, gk_conf);
+		profile_charge(&prof, num_rx > 0 ?
+			STATS_PHASE_GK_BACK : STATS_PHASE_IDLE);
+
+		now = rte_rdtsc();
+		txb_drain(&instance->tx_front, now);
+		txb_drain(&instance->tx_back, now);
+		log_ratelimit_flush(now);
+		stats_set(instance->stats, STATS_TX_DROPS,
+			instance->tx_front.num_dropped +
+			instance->tx_back.num_dropped);
+		profile_charge(&prof, STATS_PHASE_OTHER);
 
 		process_cmds_from_mailbox(instance, gk_conf);
+		profile_charge(&prof, STATS_PHASE_GK_MAILBOX);
 
-		if (rte_rdtsc() - last_tsc >= bucket_scan_timeout_cycles) {
-			gk_flow_tbl_bucket_scan(&bucket_idx,
-				gk_conf->request_timeout_cycles, instance);
-			last_tsc = rte_rdtsc();
-		}
+		gk_flush_flow_entries(instance);
+
+		gk_expire_flow_entries(instance,
+			gk_conf->request_timeout_cycles);
+		profile_charge(&prof, STATS_PHASE_GK_FLOW_SCAN);
+
+		/* No references to FIB entries are held past this point. */
+		qsbr_quiescent(&gk_conf->qsbr, lcore);
+		profile_charge(&prof, STATS_PHASE_OTHER);
 	}
 
+	qsbr_offline(&gk_conf->qsbr, lcore);
+	profile_free(&prof);
+
+	txb_free(&instance->tx_front, "gk");
+	txb_free(&instance->tx_back, "gk");
+
 	RTE_LOG(NOTICE, GATEKEEPER,
 		"gk: the GK block at lcore = %u is exiting\n", lcore);
 
@@ -1407,7 +1983,11 @@ gk_proc(void *arg)
 struct gk_config *
 alloc_gk_conf(void)
 {
-	return rte_calloc("gk_config", 1, sizeof(struct gk_config), 0);
+	struct gk_config *gk_conf =
+		rte_calloc("gk_config", 1, sizeof(struct gk_config), 0);
+	if (gk_conf != NULL)
+		qsbr_init(&gk_conf->qsbr);
+	return gk_conf;
 }
 
 void
@@ -1430,6 +2010,12 @@ destroy_gk_lpm(struct gk_lpm *ltbl)
 	ltbl->lpm6 = NULL;
 	rte_free(ltbl->fib_tbl6);
 	ltbl->fib_tbl6 = NULL;
+
+	/* A bulk load may have been in progress. */
+	destroy_ipv4_lpm(ltbl->shadow_lpm);
+	ltbl->shadow_lpm = NULL;
+	destroy_ipv6_lpm(ltbl->shadow_lpm6);
+	ltbl->shadow_lpm6 = NULL;
 }
 
 static int
@@ -1449,6 +2035,9 @@ cleanup_gk(struct gk_config *gk_conf)
 				ip_flow_entry_table);
 		}
 
+		rte_free(gk_conf->instances[i].grantor_flows.heads);
+		rte_free(gk_conf->instances[i].flushing_fibs);
+
 		destroy_mailbox(&gk_conf->instances[i].mb);
 	}
 
@@ -1466,6 +2055,7 @@ cleanup_gk(struct gk_config *gk_conf)
 			destroy_neigh_hash_table(&fib->u.neigh6);
 	}
 
+	qsbr_destroy(&gk_conf->qsbr);
 	destroy_gk_lpm(&gk_conf->lpm_tbl);
 
 	rte_free(gk_conf->instances);
@@ -1546,6 +2136,11 @@ gk_stage1(void *arg)
 		}
 		inst_ptr->tx_queue_back = ret;
 
+		inst_ptr->sol_req_ring = alloc_sol_req_ring(
+			gk_conf->sol_conf, lcore);
+		if (inst_ptr->sol_req_ring == NULL)
+			goto cleanup;
+
 		/* Setup the GK instance at @lcore. */
 		ret = setup_gk_instance(lcore, gk_conf);
 		if (ret < 0) {
@@ -1653,6 +2248,12 @@ success:
 	return 0;
 }
 
+size_t
+gk_flow_entry_size(void)
+{
+	return sizeof(struct flow_entry);
+}
+
 struct mailbox *
 get_responsible_gk_mailbox(const struct ip_flow *flow,
 	const struct gk_config *gk_conf)
@@ -1662,36 +2263,15 @@ get_responsible_gk_mailbox(const struct ip_flow *flow,
 	 * pair <Src, Dst> in the decision.
 	 */
 	uint32_t rss_hash_val = rss_ip_flow_hf(flow, 0, 0);
-	uint32_t idx;
-	uint32_t shift;
-	uint16_t queue_id;
-	int i, block_idx = -1;
 
 	/*
-	 * XXX Change the mapping rss hash value to rss reta entry
-	 * if the reta size is not 128.
+	 * The RETA size is a power of 2 (see build_reta_to_instance()),
+	 * and the NIC indexes the RETA with the least significant bits
+	 * of the RSS hash.
 	 */
-	RTE_VERIFY(gk_conf->rss_conf_front.reta_size == 128);
-	rss_hash_val = (rss_hash_val & 127);
-
-	/*
-	 * Identify which GK block is responsible for the
-	 * pair <Src, Dst> in the decision.
-	 */
-	idx = rss_hash_val / RTE_RETA_GROUP_SIZE;
-	shift = rss_hash_val % RTE_RETA_GROUP_SIZE;
-	queue_id = gk_conf->rss_conf_front.reta_conf[idx].reta[shift];
-
-	/* XXX Change mapping queue id to the GK instance id efficiently. */
-	for (i = 0; i < gk_conf->num_lcores; i++)
-		if (gk_conf->instances[i].rx_queue_front == queue_id) {
-			block_idx = i;
-			break;
-		}
-
-	if (block_idx == -1)
-		RTE_LOG(ERR, GATEKEEPER,
-			"gk: wrong RSS configuration for GK blocks!\n");
+	uint16_t reta_idx = rss_hash_val &
+		(gk_conf->rss_conf_front.reta_size - 1);
 
-	return &gk_conf->instances[block_idx].mb;
+	return &gk_conf->instances[
+		gk_conf->reta_to_instance_front[reta_idx]].mb;
 }
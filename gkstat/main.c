@@ -0,0 +1,319 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * gkstat - print the statistics of a running Gatekeeper.
+ *
+ * gkstat runs as a DPDK secondary process, and only reads the
+ * memzone of the statistics, so it does not disturb the lcores
+ * of Gatekeeper. Run it as:
+ *
+ *	gkstat --proc-type=secondary [EAL options] -- [-i SECS] [-c COUNT] [-l]
+ *
+ * Every SECS seconds (1 by default), gkstat prints the counters of
+ * each functional block summed over its lcores, or the counters of
+ * each lcore with -l, along with their rates over the interval.
+ * It also prints the latencies sampled over the interval, in
+ * microseconds, when the blocks are configured to sample them,
+ * and where the lcores spent their cycles over the interval,
+ * when Gatekeeper is built with profiling.
+ * gkstat exits after COUNT reports, or runs until interrupted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include <rte_eal.h>
+#include <rte_log.h>
+#include <rte_lcore.h>
+
+#include "gatekeeper_stats.h"
+
+static volatile int exiting = false;
+
+static void
+signal_handler(int signum)
+{
+	RTE_SET_USED(signum);
+	exiting = true;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s --proc-type=secondary [EAL options] -- [-i SECS] [-c COUNT] [-l]\n"
+		"  -i SECS   seconds between reports (default: 1)\n"
+		"  -c COUNT  number of reports before exiting (default: unlimited)\n"
+		"  -l        report each lcore instead of each functional block\n",
+		prog);
+}
+
+/* The statistics of each row of a report, a block or an lcore. */
+struct snapshot {
+	uint32_t                blocks[RTE_MAX_LCORE];
+	uint64_t                counters[RTE_MAX_LCORE][STATS_NUM_COUNTERS];
+	struct stats_hist       hists[RTE_MAX_LCORE][STATS_NUM_HISTS];
+	struct stats_phase_cost phases[RTE_MAX_LCORE][STATS_NUM_PHASES];
+};
+
+static void
+phase_cost_add(struct stats_phase_cost *dst,
+	const struct stats_phase_cost *src)
+{
+	dst->calls += src->calls;
+	dst->tsc_cycles += src->tsc_cycles;
+	dst->core_cycles += src->core_cycles;
+	dst->instructions += src->instructions;
+	dst->cache_misses += src->cache_misses;
+}
+
+/* Copy the statistics of @shm, adding them up per block unless @per_lcore. */
+static void
+take_snapshot(const struct stats_shm *shm, bool per_lcore,
+	struct snapshot *snap)
+{
+	unsigned int i, j;
+
+	memset(snap, 0, sizeof(*snap));
+
+	for (i = 0; i < RTE_MAX_LCORE; i++) {
+		const struct stats_lcore *stats = &shm->lcores[i];
+		uint32_t block = stats->block;
+		unsigned int row = per_lcore ? i : block;
+
+		if (per_lcore)
+			snap->blocks[i] = block;
+		if (block == STATS_BLOCK_NONE || block >= STATS_NUM_BLOCKS)
+			continue;
+
+		for (j = 0; j < STATS_NUM_COUNTERS; j++)
+			snap->counters[row][j] += stats->counters[j];
+		for (j = 0; j < STATS_NUM_HISTS; j++)
+			stats_hist_add(&snap->hists[row][j], &stats->hists[j]);
+		for (j = 0; j < STATS_NUM_PHASES; j++)
+			phase_cost_add(&snap->phases[row][j],
+				&stats->phases[j]);
+	}
+
+	if (!per_lcore) {
+		for (i = 0; i < STATS_NUM_BLOCKS; i++)
+			snap->blocks[i] = i;
+	}
+}
+
+static void
+print_row_header(bool per_lcore, unsigned int row, uint32_t block)
+{
+	if (per_lcore)
+		printf("%s (lcore %u):\n", stats_block_names[block], row);
+	else
+		printf("%s:\n", stats_block_names[block]);
+}
+
+/*
+ * Print the durations that @cur recorded since @prev. The maximum
+ * cannot be taken per interval, so it is the lifetime maximum.
+ */
+static void
+report_hist(const char *name, double tsc_mhz,
+	const struct stats_hist *cur, const struct stats_hist *prev)
+{
+	struct stats_hist hist = *cur;
+
+	stats_hist_sub(&hist, prev);
+	if (hist.count == 0)
+		return;
+
+	printf("  %-20s %20" PRIu64 " samples, mean %.1f p50 %.1f p90 %.1f p99 %.1f us, lifetime max %.1f us\n",
+		name, hist.count, hist.sum / tsc_mhz / hist.count,
+		stats_hist_percentile(&hist, 50) / tsc_mhz,
+		stats_hist_percentile(&hist, 90) / tsc_mhz,
+		stats_hist_percentile(&hist, 99) / tsc_mhz,
+		hist.max / tsc_mhz);
+}
+
+/*
+ * Print the share of the cycles of the interval that each phase
+ * took, along with its cycles per call, and, when the hardware
+ * counters are available, its instructions per cycle and cache
+ * misses per call.
+ */
+static void
+report_phases(const struct stats_phase_cost cur[STATS_NUM_PHASES],
+	const struct stats_phase_cost prev[STATS_NUM_PHASES])
+{
+	uint64_t total = 0;
+	unsigned int i;
+
+	for (i = 0; i < STATS_NUM_PHASES; i++)
+		total += cur[i].tsc_cycles - prev[i].tsc_cycles;
+	if (total == 0)
+		return;
+
+	for (i = 0; i < STATS_NUM_PHASES; i++) {
+		uint64_t calls = cur[i].calls - prev[i].calls;
+		uint64_t cycles = cur[i].tsc_cycles - prev[i].tsc_cycles;
+		uint64_t core_cycles =
+			cur[i].core_cycles - prev[i].core_cycles;
+
+		if (calls == 0)
+			continue;
+
+		printf("  phase %-14s %6.2f%% %12.1f cycles/call",
+			stats_phase_names[i], 100. * cycles / total,
+			(double)cycles / calls);
+		if (core_cycles > 0) {
+			printf(" %6.2f IPC %10.2f misses/call",
+				(double)(cur[i].instructions -
+					prev[i].instructions) / core_cycles,
+				(double)(cur[i].cache_misses -
+					prev[i].cache_misses) / calls);
+		}
+		printf("\n");
+	}
+}
+
+static void
+report(const struct stats_shm *shm, bool per_lcore, double secs,
+	const struct snapshot *cur, const struct snapshot *prev)
+{
+	double tsc_mhz = shm->tsc_hz / 1e6;
+	unsigned int num_rows = per_lcore ? RTE_MAX_LCORE : STATS_NUM_BLOCKS;
+	unsigned int i, j;
+
+	for (i = 0; i < num_rows; i++) {
+		uint32_t block = cur->blocks[i];
+		bool any = false;
+
+		if (block == STATS_BLOCK_NONE || block >= STATS_NUM_BLOCKS)
+			continue;
+
+		for (j = 0; j < STATS_NUM_COUNTERS; j++) {
+			uint64_t value = cur->counters[i][j];
+
+			if (value == 0)
+				continue;
+
+			if (!any) {
+				print_row_header(per_lcore, i, block);
+				any = true;
+			}
+
+			if (stats_counters[j].gauge) {
+				printf("  %-20s %20" PRIu64 "\n",
+					stats_counters[j].name, value);
+			} else {
+				printf("  %-20s %20" PRIu64 " %14.1f/s\n",
+					stats_counters[j].name, value,
+					(value - prev->counters[i][j]) / secs);
+			}
+		}
+
+		for (j = 0; j < STATS_NUM_HISTS; j++) {
+			if (cur->hists[i][j].count == 0)
+				continue;
+
+			if (!any) {
+				print_row_header(per_lcore, i, block);
+				any = true;
+			}
+
+			report_hist(stats_hist_names[j], tsc_mhz,
+				&cur->hists[i][j], &prev->hists[i][j]);
+		}
+
+		if (any)
+			report_phases(cur->phases[i], prev->phases[i]);
+	}
+
+	printf("\n");
+	fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+	static struct snapshot snaps[2];
+	const struct stats_shm *shm;
+	unsigned int interval = 1;
+	unsigned long count = 0;
+	unsigned long num_reports = 0;
+	bool per_lcore = false;
+	unsigned int cur = 0;
+	int opt;
+
+	int ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Error with EAL initialization!\n");
+	argc -= ret;
+	argv += ret;
+
+	if (rte_eal_process_type() != RTE_PROC_SECONDARY)
+		rte_exit(EXIT_FAILURE,
+			"gkstat must run with --proc-type=secondary\n");
+
+	while ((opt = getopt(argc, argv, "i:c:l")) != -1) {
+		switch (opt) {
+		case 'i':
+			interval = atoi(optarg);
+			break;
+		case 'c':
+			count = strtoul(optarg, NULL, 10);
+			break;
+		case 'l':
+			per_lcore = true;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (interval == 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	shm = stats_attach();
+	if (shm == NULL)
+		return EXIT_FAILURE;
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	take_snapshot(shm, per_lcore, &snaps[cur]);
+
+	while (!exiting && (count == 0 || num_reports < count)) {
+		sleep(interval);
+		if (exiting)
+			break;
+
+		cur ^= 1;
+		take_snapshot(shm, per_lcore, &snaps[cur]);
+		report(shm, per_lcore, interval, &snaps[cur], &snaps[cur ^ 1]);
+		num_reports++;
+	}
+
+	return EXIT_SUCCESS;
+}
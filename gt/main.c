@@ -38,12 +38,14 @@
 #include "gatekeeper_ipip.h"
 #include "gatekeeper_gk.h"
 #include "gatekeeper_gt.h"
+#include "gatekeeper_profile.h"
 #include "gatekeeper_lls.h"
 #include "gatekeeper_main.h"
 #include "gatekeeper_net.h"
 #include "gatekeeper_launch.h"
 #include "gatekeeper_l2.h"
 #include "gatekeeper_varip.h"
+#include "gatekeeper_log_ratelimit.h"
 
 /* TODO Get the install-path via Makefile. */
 #define LUA_POLICY_BASE_DIR "./lua"
@@ -74,6 +76,87 @@ gt_setup_rss(struct gt_config *gt_conf)
 	return gatekeeper_setup_rss(port_in, gt_queues, gt_conf->num_lcores);
 }
 
+/*
+ * The NIC may report in the packet type of @pkt that an IPv6 header
+ * has no extension headers, in which case they need not be walked.
+ * The packet type is zero when the NIC does not parse packets.
+ */
+static inline bool
+outer_ipv6_has_no_exthdr(const struct rte_mbuf *pkt)
+{
+	return (pkt->packet_type & RTE_PTYPE_L3_MASK) == RTE_PTYPE_L3_IPV6;
+}
+
+static inline bool
+inner_ipv6_has_no_exthdr(const struct rte_mbuf *pkt)
+{
+	return (pkt->packet_type & RTE_PTYPE_TUNNEL_MASK) ==
+			RTE_PTYPE_TUNNEL_IP &&
+		(pkt->packet_type & RTE_PTYPE_INNER_L3_MASK) ==
+			RTE_PTYPE_INNER_L3_IPV6;
+}
+
+/* Fill the flow descriptor of @info once its headers are found. */
+static void
+fill_flow_desc(struct rte_mbuf *pkt, struct gt_packet_headers *info)
+{
+	struct gt_flow_desc *flow = &info->flow;
+	uint32_t l3_hdr_len = (uint8_t *)info->l4_hdr -
+		(uint8_t *)info->inner_l3_hdr;
+	uint32_t l4_pos = (uint8_t *)info->l4_hdr -
+		rte_pktmbuf_mtod(pkt, uint8_t *);
+	uint32_t l4_hdr_room = pkt->data_len > l4_pos
+		? pkt->data_len - l4_pos : 0;
+	uint32_t l3_len;
+
+	if (info->inner_ip_ver == ETHER_TYPE_IPv4) {
+		struct ipv4_hdr *ip4_hdr = info->inner_l3_hdr;
+
+		flow->addr.v4.src = rte_be_to_cpu_32(ip4_hdr->src_addr);
+		flow->addr.v4.dst = rte_be_to_cpu_32(ip4_hdr->dst_addr);
+		l3_len = rte_be_to_cpu_16(ip4_hdr->total_length);
+		flow->dscp = ip4_hdr->type_of_service >> 2;
+	} else {
+		struct ipv6_hdr *ip6_hdr = info->inner_l3_hdr;
+
+		rte_memcpy(flow->addr.v6.src, ip6_hdr->src_addr,
+			sizeof(flow->addr.v6.src));
+		rte_memcpy(flow->addr.v6.dst, ip6_hdr->dst_addr,
+			sizeof(flow->addr.v6.dst));
+		l3_len = sizeof(*ip6_hdr) +
+			rte_be_to_cpu_16(ip6_hdr->payload_len);
+		flow->dscp = (rte_be_to_cpu_32(ip6_hdr->vtc_flow) >> 22) & 0x3F;
+	}
+
+	flow->l3_len = RTE_MIN(l3_len, UINT16_MAX);
+	flow->l4_len = l3_len > l3_hdr_len ? l3_len - l3_hdr_len : 0;
+	flow->proto = info->l4_proto;
+	flow->reserved = 0;
+
+	flow->src_port = 0;
+	flow->dst_port = 0;
+	flow->tcp_flags = 0;
+
+	/* Fragments are reassembled before their policies are decided. */
+	if (info->frag)
+		return;
+
+	if (info->l4_proto == IPPROTO_TCP &&
+			l4_hdr_room >= sizeof(struct tcp_hdr)) {
+		struct tcp_hdr *tcp_hdr = info->l4_hdr;
+
+		flow->src_port = rte_be_to_cpu_16(tcp_hdr->src_port);
+		flow->dst_port = rte_be_to_cpu_16(tcp_hdr->dst_port);
+		flow->tcp_flags = tcp_hdr->tcp_flags;
+	} else if (info->l4_proto == IPPROTO_UDP &&
+			l4_hdr_room >= sizeof(struct udp_hdr)) {
+		struct udp_hdr *udp_hdr = info->l4_hdr;
+
+		flow->src_port = rte_be_to_cpu_16(udp_hdr->src_port);
+		flow->dst_port = rte_be_to_cpu_16(udp_hdr->dst_port);
+	}
+}
+
 static int
 gt_parse_incoming_pkt(struct rte_mbuf *pkt, struct gt_packet_headers *info)
 {
@@ -110,10 +193,15 @@ gt_parse_incoming_pkt(struct rte_mbuf *pkt, struct gt_packet_headers *info)
 			return -1;
 
 		outer_ipv6_hdr = (struct ipv6_hdr *)info->outer_l3_hdr;
-		outer_ipv6_hdr_len = ipv6_skip_exthdr(outer_ipv6_hdr,
-			pkt->data_len - parsed_len, &encasulated_proto);
+		if (outer_ipv6_has_no_exthdr(pkt)) {
+			outer_ipv6_hdr_len = sizeof(*outer_ipv6_hdr);
+			encasulated_proto = outer_ipv6_hdr->proto;
+		} else {
+			outer_ipv6_hdr_len = ipv6_skip_exthdr(outer_ipv6_hdr,
+				pkt->data_len - parsed_len, &encasulated_proto);
+		}
                 if (outer_ipv6_hdr_len < 0) {
-                        RTE_LOG(ERR, GATEKEEPER,
+                        LOG_RATELIMIT(ERR, GATEKEEPER,
                                 "gt: failed to parse the packet's outer IPv6 extension headers!\n");
 			return -1;
                 }
@@ -163,10 +251,15 @@ gt_parse_incoming_pkt(struct rte_mbuf *pkt, struct gt_packet_headers *info)
 			return -1;
 
 		inner_ipv6_hdr = (struct ipv6_hdr *)info->inner_l3_hdr;
-		l4_offset = ipv6_skip_exthdr(inner_ipv6_hdr, pkt->data_len -
-			parsed_len, &info->l4_proto);
+		if (inner_ipv6_has_no_exthdr(pkt)) {
+			l4_offset = sizeof(*inner_ipv6_hdr);
+			info->l4_proto = inner_ipv6_hdr->proto;
+		} else {
+			l4_offset = ipv6_skip_exthdr(inner_ipv6_hdr,
+				pkt->data_len - parsed_len, &info->l4_proto);
+		}
                 if (l4_offset < 0) {
-                        RTE_LOG(ERR, GATEKEEPER,
+                        LOG_RATELIMIT(ERR, GATEKEEPER,
                                 "gt: failed to parse the packet's inner IPv6 extension headers!\n");
 			return -1;
                 }
@@ -184,6 +277,7 @@ gt_parse_incoming_pkt(struct rte_mbuf *pkt, struct gt_packet_headers *info)
 	} else
 		return -1;
 
+	fill_flow_desc(pkt, info);
 	return 0;
 }
 
@@ -216,73 +310,222 @@ gt_reassemble_incoming_pkt(struct rte_mbuf *pkt,
 	return NULL;
 }
 
+/* Requests of a burst that wait for lookup_policy_burst(). */
+struct gt_policy_burst {
+	unsigned int             num_pkts;
+	struct rte_mbuf          *pkts[GATEKEEPER_MAX_PKT_BURST];
+	struct gt_decision       *cached[GATEKEEPER_MAX_PKT_BURST];
+	struct gt_packet_headers pkt_infos[GATEKEEPER_MAX_PKT_BURST];
+	struct ggu_policy        policies[GATEKEEPER_MAX_PKT_BURST];
+
+	/*
+	 * Requests whose flows are already pending above, and
+	 * the index of the pending request whose decision they take.
+	 */
+	unsigned int             num_dups;
+	struct rte_mbuf          *dup_pkts[GATEKEEPER_MAX_PKT_BURST];
+	struct gt_packet_headers dup_pkt_infos[GATEKEEPER_MAX_PKT_BURST];
+	uint8_t                  dup_of[GATEKEEPER_MAX_PKT_BURST];
+};
+
 static int
-lookup_policy_decision(struct gt_packet_headers *pkt_info,
-	struct ggu_policy *policy, struct gt_instance *instance)
+fill_policy_flow(struct gt_packet_headers *pkt_info, struct ip_flow *flow,
+	const char *caller)
 {
-	policy->flow.proto = pkt_info->inner_ip_ver;
+	flow->proto = pkt_info->inner_ip_ver;
 	if (pkt_info->inner_ip_ver == ETHER_TYPE_IPv4) {
 		struct ipv4_hdr *ip4_hdr = pkt_info->inner_l3_hdr;
 
-		policy->flow.f.v4.src = ip4_hdr->src_addr;
-		policy->flow.f.v4.dst = ip4_hdr->dst_addr;
+		flow->f.v4.src = ip4_hdr->src_addr;
+		flow->f.v4.dst = ip4_hdr->dst_addr;
 	} else if (likely(pkt_info->inner_ip_ver == ETHER_TYPE_IPv6)) {
 		struct ipv6_hdr *ip6_hdr = pkt_info->inner_l3_hdr;
 
-		rte_memcpy(policy->flow.f.v6.src, ip6_hdr->src_addr,
-			sizeof(policy->flow.f.v6.src));
-		rte_memcpy(policy->flow.f.v6.dst, ip6_hdr->dst_addr,
-			sizeof(policy->flow.f.v6.dst));
+		rte_memcpy(flow->f.v6.src, ip6_hdr->src_addr,
+			sizeof(flow->f.v6.src));
+		rte_memcpy(flow->f.v6.dst, ip6_hdr->dst_addr,
+			sizeof(flow->f.v6.dst));
 	} else {
 		RTE_LOG(ERR, GATEKEEPER,
 			"Unexpected condition: gt block at lcore %u lookups policy decision for an non-IP packet in function %s!\n",
-			rte_lcore_id(), __func__);
+			rte_lcore_id(), caller);
+		return -1;
+	}
+
+	return 0;
+}
+
+static inline struct gt_decision *
+get_cached_decision(struct gt_instance *instance, const struct ip_flow *flow)
+{
+	uint32_t hash = rss_ip_flow_hf(flow, 0, 0);
+	return &instance->decision_cache[
+		hash & (instance->decision_cache_size - 1)];
+}
+
+/*
+ * Fill the flow of @policy, and look its decision up in the cache
+ * of the instance. Return 0 if the decision is in the cache, 1 if
+ * the policy must decide it, and -1 on error. When the policy must
+ * decide it, @cached is set to the entry that the decision goes to,
+ * or NULL if the cache is disabled.
+ */
+static int
+lookup_cached_decision(struct gt_packet_headers *pkt_info,
+	struct ggu_policy *policy, uint64_t now,
+	struct gt_instance *instance, struct gt_decision **cached)
+{
+	struct gt_decision *entry;
+
+	*cached = NULL;
+	if (fill_policy_flow(pkt_info, &policy->flow, __func__) < 0)
 		return -1;
+
+	if (instance->decision_cache_size == 0)
+		return 1;
+
+	entry = get_cached_decision(instance, &policy->flow);
+	if (entry->expire_at > now && ip_flow_cmp_eq(&entry->policy.flow,
+			&policy->flow, sizeof(policy->flow)) == 0) {
+		*policy = entry->policy;
+		stats_inc(instance->stats, STATS_GT_DECISION_CACHE_HITS);
+		return 0;
 	}
 
+	*cached = entry;
+	return 1;
+}
+
+/*
+ * Return the index of the request of @burst that is pending
+ * for the same flow as @policy, or -1 if there is none.
+ * Requests of the same flow go to the same entry @cached
+ * of the cache, so only those requests need their flows compared.
+ * When the cache is disabled, @cached is NULL for every request.
+ */
+static int
+find_pending_decision(const struct gt_policy_burst *burst,
+	const struct ggu_policy *policy, const struct gt_decision *cached)
+{
+	unsigned int i;
+
+	for (i = 0; i < burst->num_pkts; i++) {
+		if (burst->cached[i] == cached &&
+				ip_flow_cmp_eq(&burst->policies[i].flow,
+				&policy->flow, sizeof(policy->flow)) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+static inline void
+cache_decision(struct gt_decision *cached, const struct ggu_policy *policy,
+	uint64_t now, struct gt_config *gt_conf)
+{
+	if (cached == NULL)
+		return;
+
+	cached->policy = *policy;
+	cached->expire_at = now + gt_conf->decision_cache_ttl_cycles;
+}
+
+/*
+ * Whether Lua decided @policy. Any other state would make
+ * notify_kind() panic, so such policies are not decided.
+ */
+static inline bool
+policy_decided(const struct ggu_policy *policy)
+{
+	return policy->state == GK_GRANTED || policy->state == GK_DECLINED;
+}
+
+/*
+ * Decide the policy of the flow of @pkt_info. Decisions that are
+ * still in the cache of the instance are reused, and new decisions
+ * are cached. Like lookup_policy_decision_burst(), policies that
+ * the Lua function lookup_policy() leaves in state GK_REQUEST are
+ * not decided, and -1 is returned.
+ */
+static int
+lookup_policy_decision(struct gt_packet_headers *pkt_info,
+	struct ggu_policy *policy, uint64_t now,
+	struct gt_instance *instance, struct gt_config *gt_conf)
+{
+	struct gt_decision *cached;
+	int ret = lookup_cached_decision(pkt_info, policy, now,
+		instance, &cached);
+	if (ret <= 0)
+		return ret;
+
+	policy->state = GK_REQUEST;
+
 	lua_getglobal(instance->lua_state, "lookup_policy");
 	lua_pushlightuserdata(instance->lua_state, pkt_info);
 	lua_pushlightuserdata(instance->lua_state, policy);
 
 	if (lua_pcall(instance->lua_state, 2, 0, 0) != 0) {
-		RTE_LOG(ERR, GATEKEEPER,
+		stats_inc(instance->stats, STATS_GT_LUA_ERRORS);
+		LOG_RATELIMIT(ERR, GATEKEEPER,
 			"gt: error running function `lookup_policy': %s, at lcore %u\n",
 			lua_tostring(instance->lua_state, -1), rte_lcore_id());
+		lua_pop(instance->lua_state, 1);
 		return -1;
 	}
 
+	if (!policy_decided(policy))
+		return -1;
+
+	cache_decision(cached, policy, now, gt_conf);
 	return 0;
 }
 
+/*
+ * Decide the policies of the packets of @burst with a single call to
+ * the Lua function lookup_policy_burst(), whose arguments are
+ * the arrays of packet headers and policies and their length.
+ * The flows of the policies must be filled. Policies that are left
+ * in state GK_REQUEST are not decided.
+ */
 static int
-lookup_frag_punish_policy_decision(struct gt_packet_headers *pkt_info,
-	struct ggu_policy *policy, struct gt_instance *instance)
+lookup_policy_decision_burst(struct gt_policy_burst *burst,
+	struct gt_instance *instance)
 {
-	policy->flow.proto = pkt_info->inner_ip_ver;
-	if (pkt_info->inner_ip_ver == ETHER_TYPE_IPv4) {
-		struct ipv4_hdr *ip4_hdr = pkt_info->inner_l3_hdr;
+	unsigned int i;
 
-		policy->flow.f.v4.src = ip4_hdr->src_addr;
-		policy->flow.f.v4.dst = ip4_hdr->dst_addr;
-	} else if (likely(pkt_info->inner_ip_ver == ETHER_TYPE_IPv6)) {
-		struct ipv6_hdr *ip6_hdr = pkt_info->inner_l3_hdr;
+	for (i = 0; i < burst->num_pkts; i++)
+		burst->policies[i].state = GK_REQUEST;
 
-		rte_memcpy(policy->flow.f.v6.src, ip6_hdr->src_addr,
-			sizeof(policy->flow.f.v6.src));
-		rte_memcpy(policy->flow.f.v6.dst, ip6_hdr->dst_addr,
-			sizeof(policy->flow.f.v6.dst));
-	} else {
-		RTE_LOG(ERR, GATEKEEPER,
-			"Unexpected condition: gt block at lcore %u lookups policy decision for an non-IP packet in function %s!\n",
-			rte_lcore_id(), __func__);
+	lua_getglobal(instance->lua_state, "lookup_policy_burst");
+	lua_pushlightuserdata(instance->lua_state, burst->pkt_infos);
+	lua_pushlightuserdata(instance->lua_state, burst->policies);
+	lua_pushinteger(instance->lua_state, burst->num_pkts);
+
+	if (lua_pcall(instance->lua_state, 3, 0, 0) != 0) {
+		stats_inc(instance->stats, STATS_GT_LUA_ERRORS);
+		LOG_RATELIMIT(ERR, GATEKEEPER,
+			"gt: error running function `lookup_policy_burst': %s, at lcore %u\n",
+			lua_tostring(instance->lua_state, -1), rte_lcore_id());
+		lua_pop(instance->lua_state, 1);
 		return -1;
 	}
 
+	return 0;
+}
+
+static int
+lookup_frag_punish_policy_decision(struct gt_packet_headers *pkt_info,
+	struct ggu_policy *policy, struct gt_instance *instance)
+{
+	if (fill_policy_flow(pkt_info, &policy->flow, __func__) < 0)
+		return -1;
+
 	lua_getglobal(instance->lua_state, "lookup_frag_punish_policy");
 	lua_pushlightuserdata(instance->lua_state, policy);
 
 	if (lua_pcall(instance->lua_state, 1, 0, 0) != 0) {
-		RTE_LOG(ERR, GATEKEEPER,
+		stats_inc(instance->stats, STATS_GT_LUA_ERRORS);
+		LOG_RATELIMIT(ERR, GATEKEEPER,
 			"gt: error running function `lookup_frag_punish_policy': %s, at lcore %u\n",
 			lua_tostring(instance->lua_state, -1), rte_lcore_id());
 		return -1;
@@ -347,7 +590,7 @@ print_ip_err_msg(struct gt_packet_headers *pkt_info)
 		}
 	}
 
-	RTE_LOG(ALERT, GATEKEEPER,
+	LOG_RATELIMIT(ALERT, GATEKEEPER,
 		"gt: receiving a packet with IP source address %s, and destination address %s, whose destination IP address is not the Grantor server itself.!\n",
 		src, dst);
 }
@@ -512,7 +755,7 @@ gt_neigh_get_ether_cache(struct neighbor_hash_table *neigh,
 				return NULL;
 			}
 
-			RTE_LOG(WARNING, GATEKEEPER,
+			LOG_RATELIMIT(WARNING, GATEKEEPER,
 				"gt: %s: receiving an IPv4 packet with destination IP address %s, which is not on the same subnet as the GT server!\n",
 				__func__, ip);
 			return NULL;
@@ -527,7 +770,7 @@ gt_neigh_get_ether_cache(struct neighbor_hash_table *neigh,
 				return NULL;
 			}
 
-			RTE_LOG(WARNING, GATEKEEPER,
+			LOG_RATELIMIT(WARNING, GATEKEEPER,
 				"gt: %s: receiving an IPv6 packet with destination IP address %s, which is not on the same subnet as the GT server!\n",
 				__func__, ip);
 			return NULL;
@@ -543,7 +786,7 @@ gt_neigh_get_ether_cache(struct neighbor_hash_table *neigh,
 
 		eth_cache = get_new_ether_cache(neigh);
 		if (eth_cache == NULL) {
-			RTE_LOG(WARNING, GATEKEEPER,
+			LOG_RATELIMIT(WARNING, GATEKEEPER,
 				"gt: failed to get a new Ethernet cache entry from the neighbor hash table at %s, the cache is overflowing!\n",
 				__func__);
 			return NULL;
@@ -559,7 +802,7 @@ gt_neigh_get_ether_cache(struct neighbor_hash_table *neigh,
 	if (ret == 0)
 		return eth_cache;
 
-	RTE_LOG(ERR, HASH,
+	LOG_RATELIMIT(ERR, HASH,
 		"Failed to add a cache entry to the neighbor hash table at %s\n",
 		__func__);
 
@@ -625,7 +868,7 @@ decap_and_fill_eth(struct rte_mbuf *m, struct gt_config *gt_conf,
 
 	if (adjust_pkt_len(m, &gt_conf->net->front,
 			bytes_to_add) == NULL) {
-		RTE_LOG(ERR, GATEKEEPER,
+		LOG_RATELIMIT(ERR, GATEKEEPER,
 			"gt: could not adjust packet length\n");
 		return -1;
 	}
@@ -646,135 +889,195 @@ decap_and_fill_eth(struct rte_mbuf *m, struct gt_config *gt_conf,
 }
 
 static void
-fill_eth_hdr_reverse(struct gatekeeper_if *iface, struct ether_hdr *eth_hdr,
-	struct gt_packet_headers *pkt_info)
+print_unsent_policy(struct ggu_policy *policy)
 {
-	struct ether_hdr *raw_eth = (struct ether_hdr *)pkt_info->l2_hdr;
-	ether_addr_copy(&raw_eth->s_addr, &eth_hdr->d_addr);
-	ether_addr_copy(&raw_eth->d_addr, &eth_hdr->s_addr);
-	if (iface->vlan_insert) {
-		fill_vlan_hdr(eth_hdr, iface->vlan_tag_be,
-			pkt_info->outer_ethertype);
+	int ret;
+	char err_msg[1024];
+
+	if (policy->state == GK_REQUEST) {
+		ret = snprintf(err_msg, sizeof(err_msg),
+			"gt: failed to send out the notification to Gatekeeper with policy decision [state: %hhu]",
+			policy->state);
+	} else if (policy->state == GK_GRANTED) {
+		ret = snprintf(err_msg, sizeof(err_msg),
+			"gt: failed to send out the notification to Gatekeeper with policy decision [state: %hhu, tx_rate_kb_sec: %u, cap_expire_sec: %u, next_renewal_ms: %u, renewal_step_ms: %u]",
+			policy->state, policy->params.u.granted.tx_rate_kb_sec,
+			policy->params.u.granted.cap_expire_sec,
+			policy->params.u.granted.next_renewal_ms,
+			policy->params.u.granted.renewal_step_ms);
+	} else if (policy->state == GK_DECLINED) {
+		ret = snprintf(err_msg, sizeof(err_msg),
+			"gt: failed to send out the notification to Gatekeeper with policy decision [state: %hhu, expire_sec: %u]",
+			policy->state,
+			policy->params.u.declined.expire_sec);
 	} else {
-		eth_hdr->ether_type =
-			rte_cpu_to_be_16(pkt_info->outer_ethertype);
+		ret = snprintf(err_msg, sizeof(err_msg),
+			"gt: unknown policy decision with state %hhu at %s, there is a bug in the Lua policy!\n",
+			policy->state, __func__);
 	}
+
+	RTE_VERIFY(ret > 0 && ret < (int)sizeof(err_msg));
+	print_flow_err_msg(&policy->flow, err_msg);
 }
 
-static struct rte_mbuf *
-alloc_and_fill_notify_pkt(unsigned int socket, struct ggu_policy *policy,
-	struct gt_packet_headers *pkt_info, struct gt_config *gt_conf)
+/* Index of the decisions like @policy in struct gt_notify_buf::counts. */
+static inline unsigned int
+notify_kind(const struct ggu_policy *policy)
 {
-	uint8_t *data;
-	uint16_t ethertype = pkt_info->outer_ethertype;
+	bool ipv6;
+
+	if (policy->flow.proto == ETHER_TYPE_IPv4)
+		ipv6 = false;
+	else if (policy->flow.proto == ETHER_TYPE_IPv6)
+		ipv6 = true;
+	else
+		rte_panic("Unexpected condition: gt fills up a notify packet with unknown flow protocol %hu\n",
+			policy->flow.proto);
+
+	/* The order of the fields n1, n2, n3, and n4. */
+	if (policy->state == GK_DECLINED)
+		return ipv6;
+	if (policy->state == GK_GRANTED)
+		return 2 + ipv6;
+
+	rte_panic("Unexpected condition: gt fills up a notify packet with unexpected policy state %u\n",
+		policy->state);
+}
+
+/* Length of @policy in a notification packet. */
+static inline uint16_t
+notify_policy_len(const struct ggu_policy *policy)
+{
+	uint16_t len = policy->flow.proto == ETHER_TYPE_IPv4
+		? sizeof(policy->flow.f.v4)
+		: sizeof(policy->flow.f.v6);
+
+	return len + (policy->state == GK_GRANTED
+		? sizeof(policy->params.u.granted)
+		: sizeof(policy->params.u.declined));
+}
+
+/* Maximum length of the decisions in a notification packet. */
+static inline uint16_t
+notify_max_payload_len(uint16_t ethertype)
+{
+	return ETHER_MTU - (ethertype == ETHER_TYPE_IPv4
+		? sizeof(struct ipv4_hdr) : sizeof(struct ipv6_hdr)) -
+		sizeof(struct udp_hdr) - sizeof(struct ggu_common_hdr);
+}
+
+static uint8_t *
+fill_notify_policy(uint8_t *data, const struct ggu_policy *policy)
+{
+	if (policy->flow.proto == ETHER_TYPE_IPv4) {
+		rte_memcpy(data, &policy->flow.f.v4,
+			sizeof(policy->flow.f.v4));
+		data += sizeof(policy->flow.f.v4);
+	} else {
+		rte_memcpy(data, &policy->flow.f.v6,
+			sizeof(policy->flow.f.v6));
+		data += sizeof(policy->flow.f.v6);
+	}
+
+	if (policy->state == GK_GRANTED) {
+		rte_memcpy(data, &policy->params.u.granted,
+			sizeof(policy->params.u.granted));
+		data += sizeof(policy->params.u.granted);
+	} else {
+		rte_memcpy(data, &policy->params.u.declined,
+			sizeof(policy->params.u.declined));
+		data += sizeof(policy->params.u.declined);
+	}
+
+	return data;
+}
+
+/*
+ * Send the decisions of @buf to their Gatekeeper server
+ * in a single notification packet, and empty @buf.
+ */
+static void
+flush_notify_buf(struct gt_notify_buf *buf, unsigned int socket,
+	struct gt_instance *instance, struct gt_config *gt_conf)
+{
+	struct gatekeeper_if *front = &gt_conf->net->front;
+	size_t l2_len = front->l2_len_out;
+	size_t l3_len = buf->ethertype == ETHER_TYPE_IPv4
+		? sizeof(struct ipv4_hdr) : sizeof(struct ipv6_hdr);
 	struct ether_hdr *notify_eth;
-	struct ipv4_hdr *notify_ipv4 = NULL;
-	struct ipv6_hdr *notify_ipv6 = NULL;
 	struct udp_hdr *notify_udp;
 	struct ggu_common_hdr *notify_ggu;
-	size_t l2_len;
+	struct rte_mbuf *notify_pkt;
+	uint8_t *data;
+	unsigned int kind;
+	uint16_t i;
+
+	if (buf->ethertype == 0)
+		return;
 
-	struct rte_mbuf *notify_pkt = rte_pktmbuf_alloc(
+	notify_pkt = rte_pktmbuf_alloc(
 		gt_conf->net->gatekeeper_pktmbuf_pool[socket]);
 	if (notify_pkt == NULL) {
-		RTE_LOG(ERR, MEMPOOL,
+		LOG_RATELIMIT(ERR, MEMPOOL,
 			"gt: failed to allocate notification packet!");
-		return NULL;
+		for (i = 0; i < buf->num_policies; i++)
+			print_unsent_policy(&buf->policies[i]);
+		goto out;
 	}
 
-	l2_len = gt_conf->net->front.l2_len_out;
-	if (ethertype == ETHER_TYPE_IPv4) {
-		notify_eth = (struct ether_hdr *)rte_pktmbuf_append(notify_pkt,
-			l2_len + sizeof(struct ipv4_hdr) +
-			sizeof(struct udp_hdr) + sizeof(struct ggu_common_hdr));
-		notify_ipv4 = (struct ipv4_hdr *)
-			((uint8_t *)notify_eth + l2_len);
-		notify_udp = (struct udp_hdr *)&notify_ipv4[1];
-		notify_ggu = (struct ggu_common_hdr *)&notify_udp[1];
-	} else if (ethertype == ETHER_TYPE_IPv6) {
-		notify_eth = (struct ether_hdr *)rte_pktmbuf_append(notify_pkt,
-			l2_len + sizeof(struct ipv6_hdr) +
-			sizeof(struct udp_hdr) + sizeof(struct ggu_common_hdr));
-		notify_ipv6 = (struct ipv6_hdr *)
-			((uint8_t *)notify_eth + l2_len);
-		notify_udp = (struct udp_hdr *)&notify_ipv6[1];
-		notify_ggu = (struct ggu_common_hdr *)&notify_udp[1];
-	} else
-		rte_panic("Unexpected condition: gt fills up a notify packet with unknown ethernet type %hu\n",
-			ethertype);
+	notify_eth = (struct ether_hdr *)rte_pktmbuf_append(notify_pkt,
+		l2_len + l3_len + sizeof(struct udp_hdr) +
+		sizeof(struct ggu_common_hdr) + buf->payload_len);
+	notify_udp = (struct udp_hdr *)((uint8_t *)notify_eth +
+		l2_len + l3_len);
+	notify_ggu = (struct ggu_common_hdr *)&notify_udp[1];
 
-	/* Fill up the policy decision. */
+	/*
+	 * Fill up the policy decisions. They are grouped by kind
+	 * in the order of the fields n1, n2, n3, and n4.
+	 */
 	memset(notify_ggu, 0, sizeof(*notify_ggu));
 	notify_ggu->v1 = GGU_PD_VER1;
-	if (policy->flow.proto == ETHER_TYPE_IPv4
-			&& policy->state == GK_DECLINED) {
-		notify_ggu->n1 = 1;
-		data = (uint8_t *)rte_pktmbuf_append(notify_pkt,
-			sizeof(policy->flow.f.v4) +
-			sizeof(policy->params.u.declined));
-		rte_memcpy(data, &policy->flow.f.v4,
-			sizeof(policy->flow.f.v4));
-		rte_memcpy(data + sizeof(policy->flow.f.v4),
-			&policy->params.u.declined,
-			sizeof(policy->params.u.declined));
-	} else if (policy->flow.proto == ETHER_TYPE_IPv6
-			&& policy->state == GK_DECLINED) {
-		notify_ggu->n2 = 1;
-		data = (uint8_t *)rte_pktmbuf_append(notify_pkt,
-			sizeof(policy->flow.f.v6) +
-			sizeof(policy->params.u.declined));
-		rte_memcpy(data, &policy->flow.f.v6,
-			sizeof(policy->flow.f.v6));
-		rte_memcpy(data + sizeof(policy->flow.f.v6),
-			&policy->params.u.declined,
-			sizeof(policy->params.u.declined));
-	} else if (policy->flow.proto == ETHER_TYPE_IPv4
-			&& policy->state == GK_GRANTED) {
-		notify_ggu->n3 = 1;
-		data = (uint8_t *)rte_pktmbuf_append(notify_pkt,
-			sizeof(policy->flow.f.v4) +
-			sizeof(policy->params.u.granted));
-		rte_memcpy(data, &policy->flow.f.v4,
-			sizeof(policy->flow.f.v4));
-		rte_memcpy(data + sizeof(policy->flow.f.v4),
-			&policy->params.u.granted,
-			sizeof(policy->params.u.granted));
-	} else if (policy->flow.proto == ETHER_TYPE_IPv6
-			&& policy->state == GK_GRANTED) {
-		notify_ggu->n4 = 1;
-		data = (uint8_t *)rte_pktmbuf_append(notify_pkt,
-			sizeof(policy->flow.f.v6) +
-			sizeof(policy->params.u.granted));
-		rte_memcpy(data, &policy->flow.f.v6,
-			sizeof(policy->flow.f.v6));
-		rte_memcpy(data + sizeof(policy->flow.f.v6),
-			&policy->params.u.granted,
-			sizeof(policy->params.u.granted));
-	} else
-		rte_panic("Unexpected condition: gt fills up a notify packet with unexpected policy state %u\n",
-			policy->state);
+	notify_ggu->n1 = buf->counts[0];
+	notify_ggu->n2 = buf->counts[1];
+	notify_ggu->n3 = buf->counts[2];
+	notify_ggu->n4 = buf->counts[3];
+	notify_ggu->flags = GGU_FLAG_HEADROOM;
+	notify_ggu->headroom = instance->headroom;
+	data = (uint8_t *)&notify_ggu[1];
+	for (kind = 0; kind < RTE_DIM(buf->counts); kind++) {
+		if (buf->counts[kind] == 0)
+			continue;
+		for (i = 0; i < buf->num_policies; i++) {
+			if (notify_kind(&buf->policies[i]) == kind)
+				data = fill_notify_policy(data,
+					&buf->policies[i]);
+		}
+	}
 
 	/* Fill up the link-layer header. */
-	fill_eth_hdr_reverse(&gt_conf->net->front, notify_eth, pkt_info);
+	ether_addr_copy(&buf->eth_dst, &notify_eth->d_addr);
+	ether_addr_copy(&buf->eth_src, &notify_eth->s_addr);
+	if (front->vlan_insert)
+		fill_vlan_hdr(notify_eth, front->vlan_tag_be, buf->ethertype);
+	else
+		notify_eth->ether_type = rte_cpu_to_be_16(buf->ethertype);
 	notify_pkt->l2_len = l2_len;
 
 	/* Fill up the IP header. */
-	if (ethertype == ETHER_TYPE_IPv4) {
-		struct ipv4_hdr *ipv4_hdr =
-			(struct ipv4_hdr *)pkt_info->outer_l3_hdr;
+	if (buf->ethertype == ETHER_TYPE_IPv4) {
+		struct ipv4_hdr *notify_ipv4 = (struct ipv4_hdr *)
+			((uint8_t *)notify_eth + l2_len);
+
 		/* Fill up the IPv4 header. */
 		notify_ipv4->version_ihl = IP_VHL_DEF;
+		notify_ipv4->type_of_service = 0;
 		notify_ipv4->packet_id = 0;
 		notify_ipv4->fragment_offset = IP_DN_FRAGMENT_FLAG;
 		notify_ipv4->time_to_live = IP_DEFTTL;
 		notify_ipv4->next_proto_id = IPPROTO_UDP;
-		/* The source address is the Grantor server IP address. */
-		notify_ipv4->src_addr = ipv4_hdr->dst_addr;
-		/*
-		 * The destination address is the
-		 * Gatekeeper server IP address.
-		 */
-		notify_ipv4->dst_addr = ipv4_hdr->src_addr;
+		notify_ipv4->src_addr = buf->addr.v4.gt;
+		notify_ipv4->dst_addr = buf->addr.v4.gk;
 		notify_ipv4->total_length = rte_cpu_to_be_16(
 			notify_pkt->data_len - l2_len);
 
@@ -792,18 +1095,19 @@ alloc_and_fill_notify_pkt(unsigned int socket, struct ggu_policy *policy,
 		notify_udp->dgram_cksum =
 			rte_ipv4_phdr_cksum(notify_ipv4,
 			notify_pkt->ol_flags);
-	} else if (ethertype == ETHER_TYPE_IPv6) {
-		struct ipv6_hdr *ipv6_hdr =
-			(struct ipv6_hdr *)pkt_info->outer_l3_hdr;
+	} else {
+		struct ipv6_hdr *notify_ipv6 = (struct ipv6_hdr *)
+			((uint8_t *)notify_eth + l2_len);
+
 		/* Fill up the outer IPv6 header. */
 		notify_ipv6->vtc_flow =
 			rte_cpu_to_be_32(IPv6_DEFAULT_VTC_FLOW);
-		notify_ipv6->proto = IPPROTO_UDP; 
+		notify_ipv6->proto = IPPROTO_UDP;
 		notify_ipv6->hop_limits = IPv6_DEFAULT_HOP_LIMITS;
 
-		rte_memcpy(notify_ipv6->src_addr, ipv6_hdr->dst_addr,
+		rte_memcpy(notify_ipv6->src_addr, buf->addr.v6.gt,
 			sizeof(notify_ipv6->src_addr));
-		rte_memcpy(notify_ipv6->dst_addr, ipv6_hdr->src_addr,
+		rte_memcpy(notify_ipv6->dst_addr, buf->addr.v6.gk,
 			sizeof(notify_ipv6->dst_addr));
 		notify_ipv6->payload_len =
 			rte_cpu_to_be_16(notify_pkt->data_len -
@@ -824,50 +1128,138 @@ alloc_and_fill_notify_pkt(unsigned int socket, struct ggu_policy *policy,
 	notify_udp->dst_port = gt_conf->ggu_dst_port;
 	notify_udp->dgram_len = rte_cpu_to_be_16((uint16_t)(
 		sizeof(*notify_udp) + sizeof(*notify_ggu) +
-		(notify_ggu->n1 + notify_ggu->n3) *
-		sizeof(policy->flow.f.v4) +
-		(notify_ggu->n2 + notify_ggu->n4) *
-		sizeof(policy->flow.f.v6) +
-		(notify_ggu->n1 + notify_ggu->n2) *
-		sizeof(policy->params.u.declined) + 
-		(notify_ggu->n3 + notify_ggu->n4) *
-		sizeof(policy->params.u.granted)));
+		buf->payload_len));
 
 	notify_pkt->l4_len = sizeof(struct udp_hdr);
 
-	return notify_pkt;
+	txb_add(&instance->tx, notify_pkt);
+
+out:
+	buf->ethertype = 0;
+	buf->num_policies = 0;
+	buf->payload_len = 0;
+	memset(buf->counts, 0, sizeof(buf->counts));
 }
 
-static void
-print_unsent_policy(struct ggu_policy *policy)
+static bool
+notify_buf_matches(const struct gt_notify_buf *buf,
+	const struct gt_packet_headers *pkt_info)
 {
-	int ret;
-	char err_msg[1024];
+	if (buf->ethertype != pkt_info->outer_ethertype)
+		return false;
 
-	if (policy->state == GK_REQUEST) {
-		ret = snprintf(err_msg, sizeof(err_msg),
-			"gt: failed to send out the notification to Gatekeeper with policy decision [state: %hhu]",
-			policy->state);
-	} else if (policy->state == GK_GRANTED) {
-		ret = snprintf(err_msg, sizeof(err_msg),
-			"gt: failed to send out the notification to Gatekeeper with policy decision [state: %hhu, tx_rate_kb_sec: %u, cap_expire_sec: %u, next_renewal_ms: %u, renewal_step_ms: %u]",
-			policy->state, policy->params.u.granted.tx_rate_kb_sec,
-			policy->params.u.granted.cap_expire_sec,
-			policy->params.u.granted.next_renewal_ms,
-			policy->params.u.granted.renewal_step_ms);
-	} else if (policy->state == GK_DECLINED) {
-		ret = snprintf(err_msg, sizeof(err_msg),
-			"gt: failed to send out the notification to Gatekeeper with policy decision [state: %hhu, expire_sec: %u]",
-			policy->state,
-			policy->params.u.declined.expire_sec);
+	if (buf->ethertype == ETHER_TYPE_IPv4) {
+		const struct ipv4_hdr *ipv4_hdr = pkt_info->outer_l3_hdr;
+		return buf->addr.v4.gk == ipv4_hdr->src_addr &&
+			buf->addr.v4.gt == ipv4_hdr->dst_addr;
 	} else {
-		ret = snprintf(err_msg, sizeof(err_msg),
-			"gt: unknown policy decision with state %hhu at %s, there is a bug in the Lua policy!\n",
-			policy->state, __func__);
+		const struct ipv6_hdr *ipv6_hdr = pkt_info->outer_l3_hdr;
+		return memcmp(buf->addr.v6.gk, ipv6_hdr->src_addr,
+				sizeof(buf->addr.v6.gk)) == 0 &&
+			memcmp(buf->addr.v6.gt, ipv6_hdr->dst_addr,
+				sizeof(buf->addr.v6.gt)) == 0;
 	}
+}
 
-	RTE_VERIFY(ret > 0 && ret < (int)sizeof(err_msg));
-	print_flow_err_msg(&policy->flow, err_msg);
+/*
+ * Find the buffer of the Gatekeeper server that sent the packet
+ * of @pkt_info. If there is none, flush the oldest buffer when
+ * all are in use, and address a buffer to that server.
+ */
+static struct gt_notify_buf *
+get_notify_buf(struct gt_packet_headers *pkt_info, uint64_t now,
+	unsigned int socket, struct gt_instance *instance,
+	struct gt_config *gt_conf)
+{
+	struct ether_hdr *raw_eth = (struct ether_hdr *)pkt_info->l2_hdr;
+	struct gt_notify_buf *free_buf = NULL;
+	struct gt_notify_buf *oldest_buf = NULL;
+	struct gt_notify_buf *buf;
+	unsigned int i;
+
+	for (i = 0; i < GT_NOTIFY_MAX_DSTS; i++) {
+		buf = &instance->notify_bufs[i];
+		if (buf->ethertype == 0) {
+			if (free_buf == NULL)
+				free_buf = buf;
+			continue;
+		}
+		if (notify_buf_matches(buf, pkt_info))
+			return buf;
+		if (oldest_buf == NULL || buf->first_at < oldest_buf->first_at)
+			oldest_buf = buf;
+	}
+
+	if (free_buf == NULL) {
+		flush_notify_buf(oldest_buf, socket, instance, gt_conf);
+		free_buf = oldest_buf;
+	}
+
+	buf = free_buf;
+	buf->ethertype = pkt_info->outer_ethertype;
+	buf->first_at = now;
+	ether_addr_copy(&raw_eth->s_addr, &buf->eth_dst);
+	ether_addr_copy(&raw_eth->d_addr, &buf->eth_src);
+	if (buf->ethertype == ETHER_TYPE_IPv4) {
+		struct ipv4_hdr *ipv4_hdr = pkt_info->outer_l3_hdr;
+		/* The Gatekeeper server is the source of the packet. */
+		buf->addr.v4.gk = ipv4_hdr->src_addr;
+		buf->addr.v4.gt = ipv4_hdr->dst_addr;
+	} else if (buf->ethertype == ETHER_TYPE_IPv6) {
+		struct ipv6_hdr *ipv6_hdr = pkt_info->outer_l3_hdr;
+		rte_memcpy(buf->addr.v6.gk, ipv6_hdr->src_addr,
+			sizeof(buf->addr.v6.gk));
+		rte_memcpy(buf->addr.v6.gt, ipv6_hdr->dst_addr,
+			sizeof(buf->addr.v6.gt));
+	} else
+		rte_panic("Unexpected condition: gt fills up a notify packet with unknown ethernet type %hu\n",
+			buf->ethertype);
+
+	return buf;
+}
+
+/*
+ * Buffer @policy to be sent to the Gatekeeper server that sent the
+ * packet of @pkt_info. The buffer is flushed before it overflows
+ * the MTU or the counters of struct ggu_common_hdr.
+ */
+static void
+notify_policy(struct ggu_policy *policy, struct gt_packet_headers *pkt_info,
+	uint64_t now, unsigned int socket, struct gt_instance *instance,
+	struct gt_config *gt_conf)
+{
+	struct gt_notify_buf *buf = get_notify_buf(pkt_info, now,
+		socket, instance, gt_conf);
+	unsigned int kind = notify_kind(policy);
+	uint16_t len = notify_policy_len(policy);
+
+	if (unlikely(buf->num_policies >= GT_NOTIFY_MAX_POLICIES ||
+			buf->counts[kind] == UINT8_MAX ||
+			buf->payload_len + len >
+				notify_max_payload_len(buf->ethertype))) {
+		flush_notify_buf(buf, socket, instance, gt_conf);
+		buf = get_notify_buf(pkt_info, now, socket, instance, gt_conf);
+	}
+
+	buf->policies[buf->num_policies++] = *policy;
+	buf->payload_len += len;
+	buf->counts[kind]++;
+}
+
+/* Flush the buffers whose first decision has waited @max_delay_cycles. */
+static void
+drain_notify_bufs(uint64_t now, uint64_t max_delay_cycles,
+	unsigned int socket, struct gt_instance *instance,
+	struct gt_config *gt_conf)
+{
+	unsigned int i;
+
+	for (i = 0; i < GT_NOTIFY_MAX_DSTS; i++) {
+		struct gt_notify_buf *buf = &instance->notify_bufs[i];
+		if (buf->ethertype != 0 &&
+				now - buf->first_at >= max_delay_cycles)
+			flush_notify_buf(buf, socket, instance, gt_conf);
+	}
 }
 
 /*
@@ -876,8 +1268,8 @@ print_unsent_policy(struct ggu_policy *policy)
  * with fragmented packets.
  */
 static void 
-process_death_row(int socket_id, uint16_t port, uint16_t tx_queue,
-	int punish, struct rte_ip_frag_death_row *death_row,
+process_death_row(int socket_id, int punish,
+	struct rte_ip_frag_death_row *death_row, uint64_t now,
 	struct gt_instance *instance, struct gt_config *gt_conf)
 {
 	uint32_t i;
@@ -886,14 +1278,13 @@ process_death_row(int socket_id, uint16_t port, uint16_t tx_queue,
 		int ret;
 		struct gt_packet_headers pkt_info;
 		struct ggu_policy policy;
-		struct rte_mbuf *notify_pkt;
 
 		if (!punish)
 			goto free_packet;
 
 		ret = gt_parse_incoming_pkt(death_row->row[i], &pkt_info);
 		if (ret < 0) {
-			RTE_LOG(WARNING, GATEKEEPER,
+			LOG_RATELIMIT(WARNING, GATEKEEPER,
 				"gt: failed to parse the fragments at %s, and the packet doesn't trigger any policy consultation at all!\n",
 				__func__);
 			rte_pktmbuf_free(death_row->row[i]);
@@ -913,23 +1304,13 @@ process_death_row(int socket_id, uint16_t port, uint16_t tx_queue,
 		if (ret < 0) {
 			policy.state = GK_DECLINED;
 			policy.params.u.declined.expire_sec = 600;
-			RTE_LOG(WARNING, GATEKEEPER,
+			LOG_RATELIMIT(WARNING, GATEKEEPER,
 				"gt: failed to lookup the punishment policy for the packet fragment! Our failsafe action is to decline the flow for 10 minutes!\n");
 		}
 
-		/*
-		 * TODO Reply in a batch.
-		 * Reply the policy decision to GK-GT unit.
-		 */
-		notify_pkt = alloc_and_fill_notify_pkt(
-			socket_id, &policy, &pkt_info, gt_conf);
-		if (notify_pkt == NULL)
-			print_unsent_policy(&policy);
-		else if (rte_eth_tx_burst(port, tx_queue,
-				&notify_pkt, 1) != 1) {
-			print_unsent_policy(&policy);
-			rte_pktmbuf_free(notify_pkt);
-		}
+		/* Reply the policy decision to GK-GT unit. */
+		notify_policy(&policy, &pkt_info, now, socket_id,
+			instance, gt_conf);
 
 free_packet:
 		rte_pktmbuf_free(death_row->row[i]);
@@ -955,12 +1336,113 @@ gt_process_unparsed_incoming_pkt(struct acl_search *acl4,
 		return;
 	}
 
-	RTE_LOG(ALERT, GATEKEEPER,
+	LOG_RATELIMIT(ALERT, GATEKEEPER,
 		"gt: parsing an invalid packet with outer Ethernet type %hu!\n",
 		outer_ethertype);
 	rte_pktmbuf_free(pkt);
 }
 
+/*
+ * At the end of each period, compute the share of the period
+ * that the instance was not processing packets.
+ */
+static void
+update_headroom(struct gt_instance *instance, uint64_t now,
+	uint64_t period_cycles)
+{
+	uint64_t elapsed = now - instance->headroom_period_start;
+	uint64_t busy;
+
+	if (elapsed < period_cycles)
+		return;
+
+	busy = RTE_MIN(instance->busy_cycles, elapsed);
+	instance->headroom = GGU_MAX_HEADROOM * (elapsed - busy) / elapsed;
+	instance->busy_cycles = 0;
+	instance->headroom_period_start = now;
+}
+
+/*
+ * Notify the decision of @policy to the Gatekeeper server,
+ * and forward @m if its flow is granted.
+ */
+static void
+apply_policy_decision(struct rte_mbuf *m, struct gt_packet_headers *pkt_info,
+	struct ggu_policy *policy, uint64_t now, unsigned int socket,
+	struct gt_instance *instance, struct gt_config *gt_conf)
+{
+	stats_inc(instance->stats, STATS_GT_DECISIONS);
+
+	/*
+	 * Reply the policy decision to GK-GT unit
+	 * along with the other decisions to the same
+	 * Gatekeeper server.
+	 */
+	notify_policy(policy, pkt_info, now, socket, instance, gt_conf);
+
+	if (policy->state == GK_GRANTED) {
+		if (decap_and_fill_eth(m, gt_conf, pkt_info, instance) < 0)
+			rte_pktmbuf_free(m);
+		else
+			txb_add(&instance->tx, m);
+	} else
+		rte_pktmbuf_free(m);
+}
+
+static void
+process_policy_burst(struct gt_policy_burst *burst, uint64_t now,
+	unsigned int socket, struct gt_instance *instance,
+	struct gt_config *gt_conf, struct profile *prof)
+{
+	unsigned int i;
+	int ret;
+
+	if (burst->num_pkts == 0)
+		return;
+
+	/* Sampled latencies are the average of the burst. */
+	if (unlikely(stats_sample(&instance->latency_countdown,
+			gt_conf->latency_sample_period))) {
+		uint64_t start = rte_rdtsc();
+		ret = lookup_policy_decision_burst(burst, instance);
+		stats_hist_record(instance->stats, STATS_HIST_GT_POLICY,
+			(rte_rdtsc() - start) / burst->num_pkts);
+	} else
+		ret = lookup_policy_decision_burst(burst, instance);
+	profile_charge(prof, STATS_PHASE_GT_POLICY);
+
+	for (i = 0; i < burst->num_pkts; i++) {
+		struct ggu_policy *policy = &burst->policies[i];
+
+		if (ret < 0 || !policy_decided(policy)) {
+			rte_pktmbuf_free(burst->pkts[i]);
+			continue;
+		}
+
+		cache_decision(burst->cached[i], policy, now, gt_conf);
+		apply_policy_decision(burst->pkts[i], &burst->pkt_infos[i],
+			policy, now, socket, instance, gt_conf);
+	}
+
+	for (i = 0; i < burst->num_dups; i++) {
+		struct ggu_policy *policy =
+			&burst->policies[burst->dup_of[i]];
+
+		if (ret < 0 || !policy_decided(policy)) {
+			rte_pktmbuf_free(burst->dup_pkts[i]);
+			continue;
+		}
+
+		apply_policy_decision(burst->dup_pkts[i],
+			&burst->dup_pkt_infos[i], policy, now, socket,
+			instance, gt_conf);
+	}
+	profile_charge(prof, STATS_PHASE_GT_TX);
+
+	burst->num_pkts = 0;
+	burst->num_dups = 0;
+}
+
 static int
 gt_proc(void *arg)
 {
@@ -973,10 +1455,14 @@ gt_proc(void *arg)
 	uint64_t last_tsc = rte_rdtsc();
 	uint16_t port = get_net_conf()->front.id;
 	uint16_t rx_queue = instance->rx_queue;
-	uint16_t tx_queue = instance->tx_queue;
 	uint64_t frag_scan_timeout_cycles = round(
 		gt_conf->frag_scan_timeout_ms * rte_get_tsc_hz() / 1000.);
+	uint64_t headroom_period_cycles = round(
+		GT_HEADROOM_PERIOD_MS * rte_get_tsc_hz() / 1000.);
+	uint64_t notify_max_delay_cycles = round(
+		gt_conf->notify_max_delay_us * rte_get_tsc_hz() / 1000000.);
 	uint32_t next = 0;
+	struct profile prof;
 	/*
 	 * The mbuf death row contains
 	 * packets to be freed.
@@ -987,34 +1473,64 @@ gt_proc(void *arg)
 	RTE_LOG(NOTICE, GATEKEEPER,
 		"gt: the GT block is running at lcore = %u\n", lcore);
 
+	txb_init(&instance->tx, port, instance->tx_queue);
+
+	instance->headroom = GGU_MAX_HEADROOM;
+	instance->headroom_period_start = last_tsc;
+	instance->busy_cycles = 0;
+	instance->stats = stats_register(lcore, STATS_BLOCK_GT);
+	profile_init(&prof, instance->stats);
+
 	gt_conf_hold(gt_conf);
 
 	while (likely(!exiting)) {
 		int i;
 		int ret;
 		uint16_t num_rx;
-		uint16_t num_tx = 0;
-		uint16_t num_tx_succ;
 		uint16_t num_arp = 0;
 		uint64_t cur_tsc = rte_rdtsc();
 		struct rte_mbuf *rx_bufs[GATEKEEPER_MAX_PKT_BURST];
-		struct rte_mbuf *tx_bufs[GATEKEEPER_MAX_PKT_BURST];
 		struct rte_mbuf *arp_bufs[GATEKEEPER_MAX_PKT_BURST];
+		struct gt_policy_burst burst;
 		ACL_SEARCH_DEF(acl4);
 		ACL_SEARCH_DEF(acl6);
 
+		log_ratelimit_flush(cur_tsc);
+
+		drain_notify_bufs(cur_tsc, notify_max_delay_cycles, socket,
+			instance, gt_conf);
+		txb_drain(&instance->tx, cur_tsc);
+		update_headroom(instance, cur_tsc, headroom_period_cycles);
+		stats_set(instance->stats, STATS_TX_DROPS,
+			instance->tx.num_dropped);
+		profile_charge(&prof, STATS_PHASE_OTHER);
+
 		/* Load a set of packets from the front NIC. */
 		num_rx = rte_eth_rx_burst(port, rx_queue, rx_bufs,
 			GATEKEEPER_MAX_PKT_BURST);
 
-		if (unlikely(num_rx == 0))
+		if (unlikely(num_rx == 0)) {
+			profile_charge(&prof, STATS_PHASE_IDLE);
 			continue;
+		}
+
+		stats_add(instance->stats, STATS_PKTS_RX, num_rx);
+		profile_charge(&prof, STATS_PHASE_GT_RX);
+
+		burst.num_pkts = 0;
+		burst.num_dups = 0;
 
 		for (i = 0; i < num_rx; i++) {
 			struct rte_mbuf *m = rx_bufs[i];
 			struct gt_packet_headers pkt_info;
 			struct ggu_policy policy;
-			struct rte_mbuf *notify_pkt;
+
+			/*
+			 * What the previous packet did after its policy
+			 * decision, if any, is charged to transmission.
+			 */
+			if (i > 0)
+				profile_charge(&prof, STATS_PHASE_GT_TX);
 
 			/*
 			 * Only request packets and priority packets
@@ -1024,6 +1540,7 @@ gt_proc(void *arg)
 			 * Other packets will be fowarded directly.
 			 */
 			ret = gt_parse_incoming_pkt(m, &pkt_info);
+			profile_charge(&prof, STATS_PHASE_GT_PARSE);
 			if (ret < 0) {
 				gt_process_unparsed_incoming_pkt(
 					&acl4, &acl6, &num_arp, arp_bufs,
@@ -1041,15 +1558,18 @@ gt_proc(void *arg)
 					&death_row, instance);
 
 				/* Process the death packets. */
-				process_death_row(socket, port, tx_queue,
-					m == NULL, &death_row,
-					instance, gt_conf);
+				process_death_row(socket, m == NULL,
+					&death_row, cur_tsc, instance,
+					gt_conf);
+				profile_charge(&prof,
+					STATS_PHASE_GT_REASSEMBLY);
 
 				if (m == NULL)
 					continue;
 
 				ret = gt_parse_incoming_pkt(
 					m, &pkt_info);
+				profile_charge(&prof, STATS_PHASE_GT_PARSE);
 				if (ret < 0) {
 					gt_process_unparsed_incoming_pkt(
 						&acl4, &acl6, &num_arp,
@@ -1071,7 +1591,7 @@ gt_proc(void *arg)
 				if (ret < 0)
 					rte_pktmbuf_free(m);
 				else
-					tx_bufs[num_tx++] = m;
+					txb_add(&instance->tx, m);
 				continue;
 			}
 
@@ -1082,47 +1602,76 @@ gt_proc(void *arg)
 			 * decides which capabilities to grant or decline,
 			 * the maximum receiving rate of the granted
 			 * capabilities, and when each decision expires.
+			 * Recent decisions are answered from a cache.
+			 *
+			 * When the policy defines lookup_policy_burst(),
+			 * the requests whose decisions are not cached are
+			 * decided together after the whole burst is read,
+			 * and requests of a flow that is already pending
+			 * take the decision of the first one.
 			 */
-			ret = lookup_policy_decision(
-				&pkt_info, &policy, instance);
+			if (instance->policy_burst) {
+				unsigned int n = burst.num_pkts;
+				ret = lookup_cached_decision(&pkt_info,
+					&burst.policies[n], cur_tsc, instance,
+					&burst.cached[n]);
+				if (ret > 0) {
+					int pending = find_pending_decision(
+						&burst, &burst.policies[n],
+						burst.cached[n]);
+					if (pending >= 0) {
+						unsigned int d = burst.num_dups;
+						burst.dup_pkts[d] = m;
+						burst.dup_pkt_infos[d] =
+							pkt_info;
+						burst.dup_of[d] = pending;
+						burst.num_dups++;
+						profile_charge(&prof,
+							STATS_PHASE_GT_POLICY);
+						continue;
+					}
+					burst.pkts[n] = m;
+					burst.pkt_infos[n] = pkt_info;
+					burst.num_pkts++;
+					profile_charge(&prof,
+						STATS_PHASE_GT_POLICY);
+					continue;
+				}
+				policy = burst.policies[n];
+			} else if (unlikely(stats_sample(
+					&instance->latency_countdown,
+					gt_conf->latency_sample_period))) {
+				uint64_t start = rte_rdtsc();
+				ret = lookup_policy_decision(&pkt_info,
+					&policy, cur_tsc, instance, gt_conf);
+				stats_hist_record(instance->stats,
+					STATS_HIST_GT_POLICY,
+					rte_rdtsc() - start);
+			} else {
+				ret = lookup_policy_decision(&pkt_info,
+					&policy, cur_tsc, instance, gt_conf);
+			}
+			profile_charge(&prof, STATS_PHASE_GT_POLICY);
 			if (ret < 0) {
 				rte_pktmbuf_free(m);
 				continue;
 			}
 
-			/*
-			 * TODO Reply in a batch.
-			 * Reply the policy decision to GK-GT unit.
-			 */
-			notify_pkt = alloc_and_fill_notify_pkt(
-				socket, &policy, &pkt_info, gt_conf);
-			if (notify_pkt != NULL && rte_eth_tx_burst(
-					port, tx_queue, &notify_pkt, 1) != 1)
-				rte_pktmbuf_free(notify_pkt);
+			apply_policy_decision(m, &pkt_info, &policy, cur_tsc,
+				socket, instance, gt_conf);
+		}
 
-			if (policy.state == GK_GRANTED) {
-				ret = decap_and_fill_eth(m, gt_conf,
-					&pkt_info, instance);
-				if (ret < 0)
-					rte_pktmbuf_free(m);
-				else
-					tx_bufs[num_tx++] = m;
-			} else
-				rte_pktmbuf_free(m);
+		if (burst.num_pkts > 0) {
+			profile_charge(&prof, STATS_PHASE_GT_TX);
+			process_policy_burst(&burst, cur_tsc, socket,
+				instance, gt_conf, &prof);
 		}
 
 		/* Send burst of TX packets, to second port of pair. */
-		num_tx_succ = rte_eth_tx_burst(port, tx_queue,
-			tx_bufs, num_tx);
-
-		/*
-		 * XXX Do something better here!
-		 * For now, free any unsent packets.
-		 */
-		if (unlikely(num_tx_succ < num_tx)) {
-			for (i = num_tx_succ; i < num_tx; i++)
-				rte_pktmbuf_free(tx_bufs[i]);
-		}
+		drain_notify_bufs(cur_tsc, notify_max_delay_cycles, socket,
+			instance, gt_conf);
+		txb_flush(&instance->tx);
+		profile_charge(&prof, STATS_PHASE_GT_TX);
 
 		if (num_arp > 0)
 			submit_arp(arp_bufs, num_arp, &gt_conf->net->front);
@@ -1131,6 +1680,7 @@ gt_proc(void *arg)
 			ETHER_TYPE_IPv4);
 		process_pkts_acl(&gt_conf->net->front, lcore, &acl6,
 			ETHER_TYPE_IPv6);
+		profile_charge(&prof, STATS_PHASE_OTHER);
 
 		if (cur_tsc - last_tsc >= frag_scan_timeout_cycles) {
 			RTE_VERIFY(death_row.cnt == 0);
@@ -1143,14 +1693,19 @@ gt_proc(void *arg)
 			}
 
 			/* Process the death packets. */
-			process_death_row(socket, port,
-				tx_queue, true, &death_row,
-				instance, gt_conf);
+			process_death_row(socket, true, &death_row,
+				cur_tsc, instance, gt_conf);
 
 			last_tsc = rte_rdtsc();
+			profile_charge(&prof, STATS_PHASE_GT_FRAG_SCAN);
 		}
+
+		instance->busy_cycles += rte_rdtsc() - cur_tsc;
 	}
 
+	profile_free(&prof);
+	txb_free(&instance->tx, "gt");
+
 	RTE_LOG(NOTICE, GATEKEEPER,
 		"gt: the GT block at lcore = %u is exiting\n", lcore);
 
@@ -1175,6 +1730,10 @@ cleanup_gt_instance(struct gt_instance *instance)
 
 	lua_close(instance->lua_state);
 	instance->lua_state = NULL;
+
+	rte_free(instance->decision_cache);
+	instance->decision_cache = NULL;
+	instance->decision_cache_size = 0;
 }
 
 static int
@@ -1231,6 +1790,11 @@ config_gt_instance(struct gt_config *gt_conf, unsigned int lcore_id)
 
 	luaL_openlibs(instance->lua_state);
 	set_lua_path(instance->lua_state, LUA_POLICY_BASE_DIR);
+
+	/* Let the policy create its tables on the socket of this lcore. */
+	lua_pushinteger(instance->lua_state, lcore_id);
+	lua_setglobal(instance->lua_state, "GT_LCORE_ID");
+
 	ret = luaL_loadfile(instance->lua_state, lua_entry_path);
 	if (ret != 0) {
 		RTE_LOG(ERR, GATEKEEPER,
@@ -1248,6 +1812,11 @@ config_gt_instance(struct gt_config *gt_conf, unsigned int lcore_id)
 		goto cleanup;
 	}
 
+	/* Prefer deciding whole bursts if the policy can. */
+	lua_getglobal(instance->lua_state, "lookup_policy_burst");
+	instance->policy_burst = lua_isfunction(instance->lua_state, -1);
+	lua_pop(instance->lua_state, 1);
+
 	if (gt_conf->net->front.configured_proto & CONFIGURED_IPV4) {
 		ret = setup_neighbor_tbl(
 			rte_lcore_to_socket_id(gt_conf->lcores[0]),
@@ -1298,6 +1867,29 @@ config_gt_instance(struct gt_config *gt_conf, unsigned int lcore_id)
 		goto cleanup;
 	}
 
+	if (gt_conf->decision_cache_size > 0) {
+		if (!rte_is_power_of_2(gt_conf->decision_cache_size)) {
+			RTE_LOG(ERR, GATEKEEPER,
+				"gt: configuration error - the size of the decision cache should be a power of 2, while it is %u!\n",
+				gt_conf->decision_cache_size);
+			ret = -1;
+			goto cleanup;
+		}
+
+		instance->decision_cache = rte_calloc_socket(
+			"gt_decision_cache", gt_conf->decision_cache_size,
+			sizeof(*instance->decision_cache), 0,
+			rte_lcore_to_socket_id(lcore_id));
+		if (instance->decision_cache == NULL) {
+			RTE_LOG(ERR, GATEKEEPER,
+				"gt: failed to allocate the decision cache at lcore %u!\n",
+				lcore_id);
+			ret = -1;
+			goto cleanup;
+		}
+		instance->decision_cache_size = gt_conf->decision_cache_size;
+	}
+
 	goto out;
 
 cleanup:
@@ -1441,6 +2033,9 @@ run_gt(struct net_config *net_conf, struct gt_config *gt_conf)
 	gt_conf->ggu_src_port = rte_cpu_to_be_16(gt_conf->ggu_src_port);
 	gt_conf->ggu_dst_port = rte_cpu_to_be_16(gt_conf->ggu_dst_port);
 
+	gt_conf->decision_cache_ttl_cycles = round(
+		gt_conf->decision_cache_ttl_ms * rte_get_tsc_hz() / 1000.);
+
 	goto success;
 
 stage2:
@@ -0,0 +1,400 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <netinet/in.h>
+
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_branch_prediction.h>
+
+#include "gatekeeper_gk.h"
+#include "gatekeeper_lpm.h"
+#include "gatekeeper_main.h"
+#include "gatekeeper_net.h"
+#include "gatekeeper_policy_tbl.h"
+
+/*
+ * Tells apart the LPM tables and hash tables of each policy table.
+ * Policy tables are only created by the Lua policies that
+ * config_gt_instance() runs during stage 2, which runs on the
+ * master lcore, so this counter needs no synchronization.
+ */
+static unsigned int num_tbls_created;
+
+struct policy_tbl *
+policy_tbl_create(const struct policy_tbl_config *config)
+{
+	unsigned int socket_id = rte_lcore_to_socket_id(config->lcore_id);
+	unsigned int id = num_tbls_created++;
+	uint32_t max_num_dsts;
+	struct policy_tbl *tbl;
+
+	if (config->num_groups == 0 ||
+			config->default_group >= config->num_groups) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gt: policy table needs at least one group, and its default group %u must be less than the number of groups %u\n",
+			config->default_group, config->num_groups);
+		return NULL;
+	}
+
+	tbl = rte_zmalloc_socket("policy_tbl", sizeof(*tbl), 0, socket_id);
+	if (tbl == NULL) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gt: failed to allocate a policy table\n");
+		return NULL;
+	}
+	tbl->config = *config;
+
+	tbl->groups = rte_calloc_socket("policy_tbl_groups",
+		config->num_groups, sizeof(*tbl->groups), 0, socket_id);
+	max_num_dsts = config->max_num_ipv4_rules +
+		config->max_num_ipv6_rules + 1;
+	tbl->dst_groups = rte_calloc_socket("policy_tbl_dsts",
+		max_num_dsts, sizeof(*tbl->dst_groups), 0, socket_id);
+	if (tbl->groups == NULL || tbl->dst_groups == NULL) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gt: failed to allocate the groups of a policy table\n");
+		goto destroy;
+	}
+	tbl->dst_groups[POLICY_TBL_ANY_DST] = config->default_group;
+	tbl->num_dsts = POLICY_TBL_ANY_DST + 1;
+
+	if (config->max_num_ipv4_rules > 0) {
+		struct rte_lpm_config lpm_conf = {
+			.max_rules = config->max_num_ipv4_rules,
+			.number_tbl8s = config->num_ipv4_tbl8s,
+		};
+
+		tbl->src4 = init_ipv4_lpm("gt_policy_src", &lpm_conf,
+			socket_id, config->lcore_id, id);
+		tbl->dst4 = init_ipv4_lpm("gt_policy_dst", &lpm_conf,
+			socket_id, config->lcore_id, id);
+		if (tbl->src4 == NULL || tbl->dst4 == NULL)
+			goto destroy;
+	}
+
+	if (config->max_num_ipv6_rules > 0) {
+		struct rte_lpm6_config lpm6_conf = {
+			.max_rules = config->max_num_ipv6_rules,
+			.number_tbl8s = config->num_ipv6_tbl8s,
+		};
+
+		tbl->src6 = init_ipv6_lpm("gt_policy_src", &lpm6_conf,
+			socket_id, config->lcore_id, id);
+		tbl->dst6 = init_ipv6_lpm("gt_policy_dst", &lpm6_conf,
+			socket_id, config->lcore_id, id);
+		if (tbl->src6 == NULL || tbl->dst6 == NULL)
+			goto destroy;
+	}
+
+	if (config->max_num_port_rules > 0) {
+		char name[64];
+		struct rte_hash_parameters params = {
+			.name = name,
+			.entries = config->max_num_port_rules,
+			.reserved = 0,
+			.key_len = sizeof(struct policy_tbl_port_key),
+			.hash_func = DEFAULT_HASH_FUNC,
+			.hash_func_init_val = 0,
+			.socket_id = socket_id,
+			.extra_flag = 0,
+		};
+		int ret = snprintf(name, sizeof(name), "gt_policy_ports_%u_%u",
+			config->lcore_id, id);
+		RTE_VERIFY(ret > 0 && ret < (int)sizeof(name));
+
+		tbl->ports = rte_hash_create(&params);
+		if (tbl->ports == NULL) {
+			RTE_LOG(ERR, HASH,
+				"gt: failed to create the port rules %s\n",
+				name);
+			goto destroy;
+		}
+	}
+
+	return tbl;
+
+destroy:
+	policy_tbl_destroy(tbl);
+	return NULL;
+}
+
+void
+policy_tbl_destroy(struct policy_tbl *tbl)
+{
+	if (tbl == NULL)
+		return;
+
+	/* If the pointers are NULL, the functions below do nothing. */
+	rte_hash_free(tbl->ports);
+	destroy_ipv6_lpm(tbl->dst6);
+	destroy_ipv6_lpm(tbl->src6);
+	destroy_ipv4_lpm(tbl->dst4);
+	destroy_ipv4_lpm(tbl->src4);
+	rte_free(tbl->dst_groups);
+	rte_free(tbl->groups);
+	rte_free(tbl);
+}
+
+static inline bool
+valid_group(const struct policy_tbl *tbl, uint32_t group)
+{
+	if (likely(group < tbl->config.num_groups))
+		return true;
+
+	RTE_LOG(ERR, GATEKEEPER,
+		"gt: group %u of a policy table is out of range, there are %u groups\n",
+		group, tbl->config.num_groups);
+	return false;
+}
+
+/* Set the decision of the flows of @group. */
+int
+policy_tbl_set_group(struct policy_tbl *tbl, uint32_t group,
+	const struct ggu_policy *decision)
+{
+	if (!valid_group(tbl, group))
+		return -1;
+
+	if (decision->state != GK_GRANTED && decision->state != GK_DECLINED) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gt: the decision of group %u of a policy table has invalid state %hhu\n",
+			group, decision->state);
+		return -1;
+	}
+
+	tbl->groups[group].state = decision->state;
+	tbl->groups[group].params = decision->params;
+	return 0;
+}
+
+/* Add @prefix to @lpm4 or @lpm6, whichever matches its IP version. */
+static int
+add_prefix(struct rte_lpm *lpm4, struct rte_lpm6 *lpm6, const char *prefix,
+	uint32_t next_hop)
+{
+	struct ipaddr addr;
+	int prefix_len = parse_ip_prefix(prefix, &addr);
+	int ret;
+
+	if (prefix_len < 0)
+		return -1;
+
+	if (addr.proto == ETHER_TYPE_IPv4) {
+		if (lpm4 == NULL) {
+			RTE_LOG(ERR, GATEKEEPER,
+				"gt: policy table has no room for IPv4 prefix %s\n",
+				prefix);
+			return -1;
+		}
+		ret = rte_lpm_add(lpm4, ntohl(addr.ip.v4.s_addr),
+			prefix_len, next_hop);
+	} else {
+		if (lpm6 == NULL) {
+			RTE_LOG(ERR, GATEKEEPER,
+				"gt: policy table has no room for IPv6 prefix %s\n",
+				prefix);
+			return -1;
+		}
+		ret = rte_lpm6_add(lpm6, addr.ip.v6.s6_addr,
+			prefix_len, next_hop);
+	}
+
+	if (ret < 0) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gt: failed to add prefix %s to a policy table (err=%d)\n",
+			prefix, ret);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Requests from @prefix go to @group. */
+int
+policy_tbl_add_src(struct policy_tbl *tbl, const char *prefix,
+	uint32_t group)
+{
+	if (!valid_group(tbl, group))
+		return -1;
+
+	return add_prefix(tbl->src4, tbl->src6, prefix, group);
+}
+
+/*
+ * Requests to @prefix go to @group, unless a port rule of the
+ * destination applies. Return the destination for the port rules.
+ */
+int
+policy_tbl_add_dst(struct policy_tbl *tbl, const char *prefix,
+	uint32_t group)
+{
+	uint32_t dst = tbl->num_dsts;
+
+	if (!valid_group(tbl, group))
+		return -1;
+
+	if (dst >= tbl->config.max_num_ipv4_rules +
+			tbl->config.max_num_ipv6_rules + 1) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gt: policy table has no room for destination %s\n",
+			prefix);
+		return -1;
+	}
+
+	if (add_prefix(tbl->dst4, tbl->dst6, prefix, dst) < 0)
+		return -1;
+
+	tbl->dst_groups[dst] = group;
+	tbl->num_dsts++;
+	return dst;
+}
+
+/*
+ * Requests of L4 protocol @proto to @port of @dst go to @group.
+ * @dst is either a value returned by policy_tbl_add_dst() or
+ * POLICY_TBL_ANY_DST. Requests without ports have port 0;
+ * see struct gt_flow_desc.
+ */
+int
+policy_tbl_add_port(struct policy_tbl *tbl, int dst, uint8_t proto,
+	uint16_t port, uint32_t group)
+{
+	struct policy_tbl_port_key key;
+	int ret;
+
+	if (!valid_group(tbl, group))
+		return -1;
+
+	if (dst < 0 || (uint32_t)dst >= tbl->num_dsts) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gt: destination %d of a policy table does not exist\n",
+			dst);
+		return -1;
+	}
+
+	if (tbl->ports == NULL) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"gt: policy table has no room for port rules\n");
+		return -1;
+	}
+
+	memset(&key, 0, sizeof(key));
+	key.dst = dst;
+	key.proto = proto;
+	key.port = port;
+	ret = rte_hash_add_key_data(tbl->ports, &key,
+		(void *)(uintptr_t)group);
+	if (ret < 0) {
+		RTE_LOG(ERR, HASH,
+			"gt: failed to add port rule %hhu/%hu to a policy table (err=%d)\n",
+			proto, port, ret);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+lookup_port(const struct policy_tbl *tbl, uint32_t dst,
+	const struct gt_flow_desc *flow)
+{
+	struct policy_tbl_port_key key;
+	void *group;
+
+	if (tbl->ports == NULL)
+		return -1;
+
+	memset(&key, 0, sizeof(key));
+	key.dst = dst;
+	key.proto = flow->proto;
+	key.port = flow->dst_port;
+	if (rte_hash_lookup_data(tbl->ports, &key, &group) < 0)
+		return -1;
+	return (uintptr_t)group;
+}
+
+/*
+ * Resolve the request of @pkt_info to a group, as described in
+ * gatekeeper_policy_tbl.h. Return -1 if it is not an IP packet.
+ */
+int
+policy_tbl_lookup(const struct policy_tbl *tbl,
+	const struct gt_packet_headers *pkt_info)
+{
+	const struct gt_flow_desc *flow = &pkt_info->flow;
+	uint32_t dst = POLICY_TBL_ANY_DST;
+	uint32_t next_hop;
+	int group;
+
+	/* Misses are expected, so the lookups are not logged. */
+	if (pkt_info->inner_ip_ver == ETHER_TYPE_IPv4) {
+		if (tbl->src4 != NULL && rte_lpm_lookup(tbl->src4,
+				flow->addr.v4.src, &next_hop) == 0)
+			return next_hop;
+
+		if (tbl->dst4 != NULL && rte_lpm_lookup(tbl->dst4,
+				flow->addr.v4.dst, &next_hop) == 0)
+			dst = next_hop;
+	} else if (likely(pkt_info->inner_ip_ver == ETHER_TYPE_IPv6)) {
+		/* rte_lpm6_lookup() does not change the address. */
+		if (tbl->src6 != NULL && rte_lpm6_lookup(tbl->src6,
+				(uint8_t *)flow->addr.v6.src, &next_hop) == 0)
+			return next_hop;
+
+		if (tbl->dst6 != NULL && rte_lpm6_lookup(tbl->dst6,
+				(uint8_t *)flow->addr.v6.dst, &next_hop) == 0)
+			dst = next_hop;
+	} else
+		return -1;
+
+	group = lookup_port(tbl, dst, flow);
+	if (group >= 0)
+		return group;
+
+	if (dst != POLICY_TBL_ANY_DST)
+		return tbl->dst_groups[dst];
+
+	group = lookup_port(tbl, POLICY_TBL_ANY_DST, flow);
+	if (group >= 0)
+		return group;
+
+	return tbl->config.default_group;
+}
+
+/* Fill @policy with the decision of @group. */
+int
+policy_tbl_fill(const struct policy_tbl *tbl, uint32_t group,
+	struct ggu_policy *policy)
+{
+	const struct ggu_policy *decision;
+
+	if (unlikely(group >= tbl->config.num_groups))
+		return -1;
+
+	decision = &tbl->groups[group];
+	if (unlikely(decision->state == GK_REQUEST))
+		return -1;
+
+	policy->state = decision->state;
+	policy->params = decision->params;
+	return 0;
+}
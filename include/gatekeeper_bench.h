@@ -0,0 +1,68 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GATEKEEPER_BENCH_H_
+#define _GATEKEEPER_BENCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gatekeeper_net.h"
+
+struct gk_config;
+
+/*
+ * Offline benchmark of the data paths; see bench/bench.c.
+ *
+ * The benchmark is the regular Gatekeeper linked with bench/bench.c.
+ * Its interfaces are DPDK ring devices, which the master lcore feeds
+ * with packets replayed from memory, and whose output it drains and
+ * counts. Gatekeeper only reaches the benchmark through @bench_hooks,
+ * which bench/bench.c sets before main() runs, so the same objects
+ * serve both programs.
+ */
+struct bench_hooks {
+	/* Directory of the Lua configuration that overrides LUA_BASE_DIR. */
+	const char *lua_base_dir;
+
+	/* Create the devices of the benchmark before the network. */
+	int (*init)(int argc, char **argv);
+	/* Replay packets at the master lcore once Gatekeeper runs. */
+	int (*run)(void);
+	/* Print the results after all lcores have stopped. */
+	void (*report)(void);
+
+	/*
+	 * Ring devices have no RSS redirection table, so the benchmark
+	 * keeps one for them and steers packets to RX queues in software.
+	 */
+	int (*setup_soft_rss)(uint16_t port_id, uint16_t *queues,
+		uint16_t num_queues);
+	int (*get_soft_rss)(uint16_t port_id,
+		struct gatekeeper_rss_config *rss_conf);
+};
+
+/* NULL unless Gatekeeper runs as the benchmark. */
+extern const struct bench_hooks *bench_hooks;
+
+/* Called from bench/lua/gatekeeper_config.lua and bench/lua/gk.lua. */
+bool bench_grantor(void);
+void bench_set_gk_conf(struct gk_config *conf);
+unsigned int bench_flow_ht_size(void);
+
+#endif /* _GATEKEEPER_BENCH_H_ */
@@ -24,6 +24,8 @@
 #include "gatekeeper_gk.h"
 #include "gatekeeper_gt.h"
 #include "gatekeeper_mailbox.h"
+#include "gatekeeper_tx_buffer.h"
+#include "gatekeeper_stats.h"
 #include "list.h"
 
 /* Configuration for the Control Plane Support functional block. */
@@ -59,6 +61,13 @@ struct cps_config {
 	uint16_t          rx_queue_back;
 	uint16_t          tx_queue_back;
 
+	/* Buffers of the packets to transmit on the TX queues. */
+	struct tx_buffer  tx_front;
+	struct tx_buffer  tx_back;
+
+	/* The statistics of the block. */
+	struct stats_lcore *stats;
+
 	/* Unanswered resolution requests from the KNIs. */
 	struct list_head  arp_requests;
 	struct list_head  nd_requests;
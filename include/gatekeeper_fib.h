@@ -150,6 +150,9 @@ struct gk_fib {
 		 	 */
 			struct ipaddr gt_addr;
 
+			/* The id of the Grantor at the Solicitor. */
+			uint16_t sol_grantor_id;
+
 			/* The cached Ethernet header. */
 			struct ether_cache *eth_cache;
 		} grantor;
@@ -187,6 +190,25 @@ struct gk_lpm {
 	 * decides the actions on packets.
 	 */
 	struct gk_fib   *fib_tbl6;
+
+	/*
+	 * While a bulk load is in progress, writers update the shadow
+	 * LPM tables below instead of @lpm and @lpm6, which the GK blocks
+	 * keep reading. Committing the bulk load publishes the shadow
+	 * LPM tables by swapping the pointers @lpm and @lpm6.
+	 *
+	 * The FIB tables are shared by both generations of LPM tables.
+	 * The FIB entries of a bulk load are only reachable through
+	 * the shadow LPM tables until the bulk load is committed.
+	 *
+	 * The fields below are protected by @lock.
+	 */
+	bool            bulk_loading;
+	struct rte_lpm  *shadow_lpm;
+	struct rte_lpm6 *shadow_lpm6;
+
+	/* The number of generations of LPM tables created so far. */
+	unsigned int    num_lpm_gens;
 };
 
 struct ip_prefix {
@@ -215,6 +237,18 @@ int del_fib_entry_numerical(
 	struct ip_prefix *prefix_info, struct gk_config *gk_conf);
 int del_fib_entry(const char *ip_prefix, struct gk_config *gk_conf);
 
+/*
+ * Bulk loads replace all FIB entries at once, for example, to load
+ * a full routing table. Between begin_fib_bulk_load() and
+ * commit_fib_bulk_load(), the functions above update a shadow
+ * LPM table that starts with only the network prefixes of
+ * the interfaces; the GK blocks keep using the current table.
+ */
+int begin_fib_bulk_load(struct gk_config *gk_conf);
+int commit_fib_bulk_load(struct gk_config *gk_conf);
+int abort_fib_bulk_load(struct gk_config *gk_conf);
+void reclaim_fib_entries(struct gk_config *gk_conf);
+
 /* TODO Customize the hash function for IPv4. */
 
 static inline struct ether_cache *
@@ -22,6 +22,7 @@
 #include "gatekeeper_mailbox.h"
 #include "gatekeeper_net.h"
 #include "gatekeeper_flow.h"
+#include "gatekeeper_stats.h"
 
 #define GGU_PD_VER1 (1)
 
@@ -45,6 +46,9 @@ struct ggu_config {
 
 	/* Mailbox to hold requests from other blocks. */
 	struct mailbox    mailbox;
+
+	/* The statistics of the block. */
+	struct stats_lcore *stats;
 };
 
 /*
@@ -65,8 +69,14 @@ struct ggu_config {
  * Field v1 will enable us to change the format, incrementally update
  * the Gatekeeper servers, and incrementally update the Grantor servers.
  *
+ * When flag GGU_FLAG_HEADROOM is set, field headroom carries the share of
+ * the capacity of the Grantor instance that sent the packet that is not
+ * used to evaluate policies, from 0 (saturated) to GGU_MAX_HEADROOM (idle).
+ * Grantors that do not set the flag leave both fields zeroed, so they
+ * remain compatible with version 1 of the format.
+ *
  * Notice that, to guarantee that all the accesses after struct ggu_common_hdr
- * in a packet are 32-bit aligned, we add uint8_t reserved[3]; at the very end
+ * in a packet are 32-bit aligned, we add uint8_t reserved[1]; at the very end
  * of struct ggu_common_hdr.
  */
 struct ggu_common_hdr {
@@ -75,9 +85,16 @@ struct ggu_common_hdr {
 	uint8_t n2;
 	uint8_t n3;
 	uint8_t n4;
-	uint8_t reserved[3];
+	uint8_t flags;
+	uint8_t headroom;
+	uint8_t reserved[1];
 }__attribute__((packed));
 
+/* Field headroom of struct ggu_common_hdr is valid. */
+#define GGU_FLAG_HEADROOM (0x01)
+
+#define GGU_MAX_HEADROOM (UINT8_MAX)
+
 struct ggu_policy {
 	uint8_t  state;
 	struct ip_flow flow;
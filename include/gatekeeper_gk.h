@@ -28,6 +28,11 @@
 #include "gatekeeper_mailbox.h"
 #include "gatekeeper_lpm.h"
 #include "gatekeeper_sol.h"
+#include "gatekeeper_timer_wheel.h"
+#include "gatekeeper_index_list.h"
+#include "gatekeeper_qsbr.h"
+#include "gatekeeper_tx_buffer.h"
+#include "gatekeeper_stats.h"
 
 /*
  * The LPM reserves 24-bit for the next-hop field.
@@ -53,7 +58,33 @@ struct gk_instance {
 	uint16_t          rx_queue_back;
 	/* TX queue on the back interface. */
 	uint16_t          tx_queue_back;
+	/* Buffers of the packets to transmit on the TX queues. */
+	struct tx_buffer  tx_front;
+	struct tx_buffer  tx_back;
+	/* Ring through which requests are handed over to the Solicitor. */
+	struct rte_ring   *sol_req_ring;
 	struct mailbox    mb;
+	/* Timing wheel of the deadlines of the flow entries. */
+	struct timer_wheel flow_expiry_tw;
+	/*
+	 * Lists of the flow entries of each grantor FIB entry,
+	 * indexed by the ID of the FIB entry, followed by the list
+	 * of flow entries being flushed.
+	 */
+	struct index_lists grantor_flows;
+	/*
+	 * The grantor FIB entries whose flow entries are in the list
+	 * of flow entries being flushed. They are all notified once
+	 * that list is empty.
+	 */
+	struct gk_fib     **flushing_fibs;
+	unsigned int      num_flushing_fibs;
+
+	/* The statistics of the instance. */
+	struct stats_lcore *stats;
+
+	/* Requests left until the next one is sampled for latency. */
+	uint32_t          latency_countdown;
 };
 
 /* Configuration for the GK functional block. */
@@ -88,8 +119,19 @@ struct gk_config {
 	unsigned int       gk_max_num_ipv4_fib_entries;
 	unsigned int       gk_max_num_ipv6_fib_entries;
 
-	/* Time for scanning the whole flow table in ms. */
-	unsigned int       flow_table_full_scan_ms;
+	/*
+	 * Granularity in ms of the expiration of flow entries.
+	 * Expired flow entries are removed from the flow table
+	 * at most this long after their deadlines.
+	 */
+	unsigned int       flow_expiry_tick_ms;
+
+	/*
+	 * Sample one in this many requests to measure how long
+	 * requests take through GK and the Solicitor; see
+	 * gatekeeper_stats.h. Zero disables the sampling.
+	 */
+	unsigned int       latency_sample_period;
 
 	/*
 	 * The fields below are for internal use.
@@ -119,11 +161,28 @@ struct gk_config {
 	 */
 	struct gk_lpm      lpm_tbl;
 
+	/*
+	 * Defers the release of FIB entries and Ethernet cache entries
+	 * removed from @lpm_tbl until the GK instances can no longer
+	 * refer to them. The deferred callbacks run with
+	 * the lock of @lpm_tbl held.
+	 */
+	struct qsbr        qsbr;
+
 	/* The RSS configuration for the front interface. */
 	struct gatekeeper_rss_config rss_conf_front;
 
 	/* The RSS configuration for the back interface. */
 	struct gatekeeper_rss_config rss_conf_back;
+
+	/*
+	 * The indexes in @instances of the GK instances that receive
+	 * the packets of each entry of the RETA of the front interface.
+	 * It is built once the RETA is programmed, so that finding the
+	 * instance responsible for a flow does not require searching
+	 * @instances.
+	 */
+	uint16_t           reta_to_instance_front[ETH_RSS_RETA_SIZE_512];
 };
 
 /* Define the possible command operations for GK block. */
@@ -155,6 +214,9 @@ int run_gk(struct net_config *net_conf, struct gk_config *gk_conf,
 struct mailbox *get_responsible_gk_mailbox(
 	const struct ip_flow *flow, const struct gk_config *gk_conf);
 
+/* Size of the entries of the flow tables, not counting their keys. */
+size_t gk_flow_entry_size(void);
+
 int pkt_copy_cached_eth_header(struct rte_mbuf *pkt,
 	struct ether_cache *eth_cache, size_t l2_len_out);
 
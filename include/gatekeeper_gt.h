@@ -28,7 +28,47 @@
 #include <rte_ip_frag.h>
 
 #include "gatekeeper_fib.h"
+#include "gatekeeper_ggu.h"
 #include "gatekeeper_config.h"
+#include "gatekeeper_tx_buffer.h"
+#include "gatekeeper_stats.h"
+
+/*
+ * Flow of the encapsulated packet of a request, parsed so that
+ * policies read plain fields instead of headers.
+ * All fields are in host order.
+ */
+struct gt_flow_desc {
+	union {
+		struct {
+			uint32_t src;
+			uint32_t dst;
+		} v4;
+
+		struct {
+			uint8_t  src[16];
+			uint8_t  dst[16];
+		} v6;
+	} addr;
+
+	/*
+	 * The ports are 0 if the protocol is neither TCP nor UDP,
+	 * if the packet is a fragment, or if the first segment of
+	 * the packet does not have its whole L4 header. So are the
+	 * TCP flags of packets other than TCP.
+	 */
+	uint16_t src_port;
+	uint16_t dst_port;
+
+	/* Lengths of the IP packet and of its L4 payload, per its header. */
+	uint16_t l3_len;
+	uint16_t l4_len;
+
+	uint8_t  proto;
+	uint8_t  tcp_flags;
+	uint8_t  dscp;
+	uint8_t  reserved;
+};
 
 struct gt_packet_headers {
 	uint16_t outer_ethertype;
@@ -42,6 +82,8 @@ struct gt_packet_headers {
 	void     *inner_l3_hdr;
 	void     *l4_hdr;
 
+	struct gt_flow_desc flow;
+
 	/*
 	 * The fields below are for internal use.
 	 * Configuration files should not refer to them.
@@ -54,6 +96,67 @@ struct gt_packet_headers {
 	struct ipv6_extension_fragment *frag_hdr;
 };
 
+/* Maximum number of policy decisions in a notification packet. */
+#define GT_NOTIFY_MAX_POLICIES (128)
+
+/* Maximum number of Gatekeeper servers with pending notifications. */
+#define GT_NOTIFY_MAX_DSTS (16)
+
+/*
+ * Policy decisions waiting to be sent to a Gatekeeper server,
+ * so that a notification packet carries as many of them as
+ * its MTU allows.
+ */
+struct gt_notify_buf {
+	/* Ethernet type of the notification, or 0 if the buffer is empty. */
+	uint16_t          ethertype;
+
+	/* Number of decisions in @policies. */
+	uint16_t          num_policies;
+
+	/* Length of the decisions of @policies in a packet. */
+	uint16_t          payload_len;
+
+	/* Number of decisions of each kind; see struct ggu_common_hdr. */
+	uint8_t           counts[4];
+
+	/* When the first decision was buffered, in cycles. */
+	uint64_t          first_at;
+
+	/* Ethernet addresses of the notification. */
+	struct ether_addr eth_src;
+	struct ether_addr eth_dst;
+
+	/* Addresses of the Grantor server and the Gatekeeper server. */
+	union {
+		struct {
+			uint32_t gt;
+			uint32_t gk;
+		} v4;
+
+		struct {
+			uint8_t  gt[16];
+			uint8_t  gk[16];
+		} v6;
+	} addr;
+
+	struct ggu_policy policies[GT_NOTIFY_MAX_POLICIES];
+};
+
+/*
+ * A recent policy decision. Requests of a flow keep arriving
+ * while its decision is on the way to the Gatekeeper server,
+ * so the decision is kept for a while to answer them without
+ * running the Lua policy again.
+ */
+struct gt_decision {
+	/* When the decision expires, in cycles; 0 if the entry is empty. */
+	uint64_t          expire_at;
+
+	/* The decision, which includes its flow. */
+	struct ggu_policy policy;
+};
+
 /* Structures for each GT instance. */
 struct gt_instance {
 	/* RX queue on the front interface. */
@@ -62,9 +165,15 @@ struct gt_instance {
 	/* TX queue on the front interface. */
 	uint16_t      tx_queue;
 
+	/* Buffer of the packets to transmit on @tx_queue. */
+	struct tx_buffer tx;
+
 	/* The lua state that belongs to the instance. */
 	lua_State     *lua_state;
 
+	/* Whether the policy defines lookup_policy_burst(). */
+	bool          policy_burst;
+
 	/* The neighbor hash tables that stores the Ethernet cached headers. */
 	struct neighbor_hash_table neigh;
 	struct neighbor_hash_table neigh6;
@@ -74,8 +183,42 @@ struct gt_instance {
 	 * received fragments of the packet.
 	 */
 	struct rte_ip_frag_tbl *frag_tbl;
+
+	/*
+	 * The share of the last period that the instance was idle,
+	 * which is advertised in the GGU notifications so that
+	 * Gatekeeper servers can adapt their request bandwidth.
+	 * See struct ggu_common_hdr.
+	 */
+	uint8_t       headroom;
+
+	/* When the current period started, in cycles. */
+	uint64_t      headroom_period_start;
+
+	/* Cycles spent processing packets in the current period. */
+	uint64_t      busy_cycles;
+
+	/* The statistics of the instance. */
+	struct stats_lcore *stats;
+
+	/* Decisions left until the next one is sampled for latency. */
+	uint32_t      latency_countdown;
+
+	/*
+	 * Direct-mapped cache of recent policy decisions, indexed by
+	 * the hash of their flows, and its number of entries, which is
+	 * zero when the cache is disabled.
+	 */
+	struct gt_decision *decision_cache;
+	uint32_t      decision_cache_size;
+
+	/* Policy decisions not sent yet, per Gatekeeper server. */
+	struct gt_notify_buf notify_bufs[GT_NOTIFY_MAX_DSTS];
 };
 
+/* Length of the periods over which the headroom is measured. */
+#define GT_HEADROOM_PERIOD_MS (100)
+
 /* Configuration for the GT functional block. */
 struct gt_config {
 	/* The UDP source and destination port numbers for GK-GT Unit. */
@@ -103,12 +246,38 @@ struct gt_config {
 	/* Maximum TTL numbers are in ms. */
 	uint32_t           frag_max_flow_ttl_ms;
 
+	/*
+	 * Sample one in this many policy decisions to measure
+	 * how long they take. Zero disables the sampling.
+	 */
+	uint32_t           latency_sample_period;
+
+	/*
+	 * Maximum time in microseconds that a policy decision waits
+	 * to be sent along with other decisions to the same Gatekeeper
+	 * server. Zero sends the decisions at the end of each burst.
+	 */
+	uint32_t           notify_max_delay_us;
+
+	/*
+	 * Number of entries of the cache of recent policy decisions
+	 * of each instance, which must be a power of 2, and how long
+	 * decisions stay in the cache. Zero disables the cache.
+	 * Policies are not reloaded at runtime, so decisions only
+	 * leave the cache when they expire or are replaced.
+	 */
+	uint32_t           decision_cache_size;
+	uint32_t           decision_cache_ttl_ms;
+
 	/*
 	 * The fields below are for internal use.
 	 * Configuration files should not refer to them.
 	 */
 	rte_atomic32_t	   ref_cnt;
 
+	/* How long decisions stay in the caches, in cycles. */
+	uint64_t           decision_cache_ttl_cycles;
+
 	/* The lcore ids at which each instance runs. */
 	unsigned int       *lcores;
 
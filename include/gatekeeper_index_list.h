@@ -0,0 +1,169 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GATEKEEPER_INDEX_LIST_H_
+#define _GATEKEEPER_INDEX_LIST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Doubly linked lists whose nodes are the elements of an array,
+ * for example, the flow entries of a GK instance.
+ *
+ * Nodes are referred to by their indexes in the array instead of
+ * pointers, so the link that each node embeds only takes 8 bytes.
+ * All lists of a struct index_lists share the same array of nodes,
+ * and a node can only be in one of these lists at a time.
+ *
+ * References are encoded as follows:
+ *   0 means no reference, so a zeroed node is not in any list;
+ *   [1, @num_nodes] refers to the node at index (reference - 1);
+ *   the following @num_heads values refer to @heads.
+ */
+
+struct index_link {
+	uint32_t next;
+	uint32_t prev;
+};
+
+struct index_lists {
+	/* The array of nodes, and where their links are. */
+	char              *nodes;
+	size_t            node_size;
+	size_t            link_offset;
+	uint32_t          num_nodes;
+
+	/* The heads of the lists. */
+	struct index_link *heads;
+	uint32_t          num_heads;
+};
+
+static inline struct index_link *
+il_node_link(struct index_lists *il, uint32_t index)
+{
+	return (struct index_link *)(il->nodes +
+		(size_t)index * il->node_size + il->link_offset);
+}
+
+static inline uint32_t
+il_head_ref(struct index_lists *il, uint32_t head)
+{
+	return il->num_nodes + 1 + head;
+}
+
+static inline struct index_link *
+il_ref_link(struct index_lists *il, uint32_t ref)
+{
+	if (ref <= il->num_nodes)
+		return il_node_link(il, ref - 1);
+	return &il->heads[ref - il->num_nodes - 1];
+}
+
+/* Returns a negative number if the references would not fit. */
+static inline int
+il_init(struct index_lists *il, void *nodes, uint32_t num_nodes,
+	size_t node_size, size_t link_offset,
+	struct index_link *heads, uint32_t num_heads)
+{
+	uint32_t i;
+
+	if (num_nodes > UINT32_MAX - 1 - num_heads)
+		return -1;
+
+	il->nodes = nodes;
+	il->node_size = node_size;
+	il->link_offset = link_offset;
+	il->num_nodes = num_nodes;
+	il->heads = heads;
+	il->num_heads = num_heads;
+
+	for (i = 0; i < num_heads; i++) {
+		heads[i].next = il_head_ref(il, i);
+		heads[i].prev = il_head_ref(il, i);
+	}
+
+	return 0;
+}
+
+static inline bool
+il_is_linked(struct index_lists *il, uint32_t index)
+{
+	return il_node_link(il, index)->next != 0;
+}
+
+static inline bool
+il_empty(struct index_lists *il, uint32_t head)
+{
+	return il->heads[head].next == il_head_ref(il, head);
+}
+
+/* Returns the index of the first node of list @head, or -1 if empty. */
+static inline int64_t
+il_first(struct index_lists *il, uint32_t head)
+{
+	if (il_empty(il, head))
+		return -1;
+	return (int64_t)il->heads[head].next - 1;
+}
+
+static inline void
+il_add_tail(struct index_lists *il, uint32_t head, uint32_t index)
+{
+	uint32_t ref = index + 1;
+	struct index_link *h = &il->heads[head];
+	struct index_link *link = il_node_link(il, index);
+
+	link->next = il_head_ref(il, head);
+	link->prev = h->prev;
+	il_ref_link(il, h->prev)->next = ref;
+	h->prev = ref;
+}
+
+static inline void
+il_del(struct index_lists *il, uint32_t index)
+{
+	struct index_link *link = il_node_link(il, index);
+
+	il_ref_link(il, link->prev)->next = link->next;
+	il_ref_link(il, link->next)->prev = link->prev;
+	link->next = 0;
+	link->prev = 0;
+}
+
+/* Move all nodes of list @src to the end of list @dst. */
+static inline void
+il_splice_tail(struct index_lists *il, uint32_t dst, uint32_t src)
+{
+	struct index_link *d = &il->heads[dst];
+	struct index_link *s = &il->heads[src];
+
+	if (il_empty(il, src))
+		return;
+
+	il_ref_link(il, s->next)->prev = d->prev;
+	il_ref_link(il, d->prev)->next = s->next;
+	il_ref_link(il, s->prev)->next = il_head_ref(il, dst);
+	d->prev = s->prev;
+
+	s->next = il_head_ref(il, src);
+	s->prev = il_head_ref(il, src);
+}
+
+#endif /* _GATEKEEPER_INDEX_LIST_H_ */
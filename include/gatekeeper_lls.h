@@ -26,6 +26,7 @@
 
 #include "gatekeeper_acl.h"
 #include "gatekeeper_mailbox.h"
+#include "gatekeeper_stats.h"
 
 /*
  * Maximum key length (in bytes) for an LLS map. It should be set
@@ -210,6 +211,9 @@ struct lls_config {
 	uint16_t          tx_queue_front;
 	uint16_t          rx_queue_back;
 	uint16_t          tx_queue_back;
+
+	/* The statistics of the block. */
+	struct stats_lcore *stats;
 };
 
 /*
@@ -0,0 +1,90 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GATEKEEPER_LOG_RATELIMIT_H_
+#define _GATEKEEPER_LOG_RATELIMIT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <rte_log.h>
+#include <rte_lcore.h>
+
+/*
+ * Rate-limited logging for the paths that run per packet.
+ *
+ * Each lcore has its own token bucket at every call site of
+ * LOG_RATELIMIT(), so no lock or atomic operation is needed once
+ * the site is set up. An lcore emits up to LOG_RATELIMIT_BURST
+ * messages in a row at a site, and then one message every
+ * LOG_RATELIMIT_INTERVAL_MS / LOG_RATELIMIT_BURST milliseconds.
+ * The number of messages suppressed in between is reported right
+ * before the next message of the site is emitted, or by
+ * log_ratelimit_flush() at most LOG_RATELIMIT_INTERVAL_MS later,
+ * so the end of a flood is reported as well.
+ *
+ * The buckets of an lcore live in a table that is allocated
+ * the first time the lcore logs at any site, and that is indexed
+ * by the sites in the order in which they are first used.
+ * Sites beyond LOG_RATELIMIT_MAX_SITES share the last bucket, and
+ * the messages suppressed in it are reported without a site.
+ *
+ * Threads that are not EAL lcores share a single table, so their
+ * counters are only approximate.
+ */
+
+/* Number of messages that a site can emit in a row per lcore. */
+#define LOG_RATELIMIT_BURST (10)
+
+/* Time in milliseconds for a site to regain LOG_RATELIMIT_BURST tokens. */
+#define LOG_RATELIMIT_INTERVAL_MS (5000)
+
+/* Number of call sites that have buckets of their own. */
+#define LOG_RATELIMIT_MAX_SITES (128)
+
+/* A call site of LOG_RATELIMIT(). */
+struct log_ratelimit_site {
+	const char        *file;
+	int               line;
+	uint32_t          level;
+	uint32_t          logtype;
+	/* The prefix that RTE_LOG() adds to the messages of the site. */
+	const char        *prefix;
+
+	/* One plus the index of the bucket of the site, or 0 until set. */
+	volatile uint32_t id;
+};
+
+bool log_ratelimit_allow(struct log_ratelimit_site *site);
+void log_ratelimit_flush(uint64_t now);
+
+#define LOG_RATELIMIT(level, type, ...) do {				\
+	static struct log_ratelimit_site __rl_site = {			\
+		.file = __FILE__,					\
+		.line = __LINE__,					\
+		.level = RTE_LOG_ ## level,				\
+		.logtype = RTE_LOGTYPE_ ## type,			\
+		.prefix = # type ": ",					\
+		.id = 0,						\
+	};								\
+	if (log_ratelimit_allow(&__rl_site))				\
+		RTE_LOG(level, type, __VA_ARGS__);			\
+} while (0)
+
+#endif /* _GATEKEEPER_LOG_RATELIMIT_H_ */
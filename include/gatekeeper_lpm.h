@@ -31,12 +31,17 @@ struct rte_lpm *init_ipv4_lpm(const char *tag,
 	const struct rte_lpm_config *lpm_conf,
 	unsigned int socket_id, unsigned int lcore, unsigned int identifier);
 int lpm_lookup_ipv4(struct rte_lpm *lpm, uint32_t ip);
+void lpm_lookup_ipv4_bulk(struct rte_lpm *lpm, const uint32_t *ips,
+	int32_t *next_hops, unsigned int n);
 
 /* Similar to init_ipv4_lpm(), see above. */
 struct rte_lpm6 *init_ipv6_lpm(const char *tag,
 	const struct rte_lpm6_config *lpm6_conf,
 	unsigned int socket_id, unsigned int lcore, unsigned int identifier);
 int lpm_lookup_ipv6(struct rte_lpm6 *lpm, uint8_t *ip);
+void lpm_lookup_ipv6_bulk(struct rte_lpm6 *lpm,
+	uint8_t ips[][RTE_LPM6_IPV6_ADDR_SIZE], int32_t *next_hops,
+	unsigned int n);
 
 static inline void
 destroy_ipv4_lpm(struct rte_lpm *lpm)
@@ -20,6 +20,7 @@
 #define _GATEKEEPER_NET_H_
 
 #include <stdint.h>
+#include <string.h>
 #include <stdbool.h>
 #include <netinet/in.h>
 
@@ -336,6 +337,7 @@ void lua_free_iface(struct gatekeeper_if *iface);
 
 int get_ip_type(const char *ip_addr);
 int convert_str_to_ip(const char *ip_addr, struct ipaddr *res);
+int parse_ip_prefix(const char *ip_prefix, struct ipaddr *res);
 int ethertype_filter_add(uint16_t port_id, uint16_t ether_type,
 	uint16_t queue_id);
 
@@ -368,6 +370,16 @@ ipv6_if_configured(struct gatekeeper_if *iface)
 	return !!(iface->configured_proto & CONFIGURED_IPV6);
 }
 
+static inline bool
+ipaddr_equal(const struct ipaddr *a, const struct ipaddr *b)
+{
+	if (a->proto != b->proto)
+		return false;
+	if (a->proto == ETHER_TYPE_IPv4)
+		return a->ip.v4.s_addr == b->ip.v4.s_addr;
+	return memcmp(&a->ip.v6, &b->ip.v6, sizeof(a->ip.v6)) == 0;
+}
+
 static inline int
 max_prefix_len(int ip_type)
 {
@@ -0,0 +1,126 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GATEKEEPER_POLICY_TBL_H_
+#define _GATEKEEPER_POLICY_TBL_H_
+
+#include <stdint.h>
+
+#include <rte_lpm.h>
+#include <rte_lpm6.h>
+#include <rte_hash.h>
+
+#include "gatekeeper_ggu.h"
+#include "gatekeeper_gt.h"
+
+/*
+ * Policy tables of Grantor servers.
+ *
+ * A Lua policy declares its rules in a policy table when it is loaded,
+ * and then resolves each request to a group of flows with a single
+ * call to policy_tbl_lookup(), whose cost does not depend on the
+ * number of rules. Each group has the parameters of the decisions of
+ * its flows. The functions below are called from Lua through FFI;
+ * see lua/policylib.lua.
+ *
+ * A request is resolved to:
+ *	1. the group of the longest source prefix that matches it;
+ *	2. otherwise, the group of the port rule of the longest
+ *	   destination prefix that matches it, for its L4 protocol
+ *	   and destination port;
+ *	3. otherwise, the group of that destination prefix;
+ *	4. otherwise, the port rule of any destination;
+ *	5. otherwise, the default group of the table.
+ *
+ * Each GT instance has its own tables, since each has its own Lua
+ * state, so the tables are only read by a single lcore.
+ */
+
+/* Destination of the port rules that apply to any destination. */
+#define POLICY_TBL_ANY_DST (0)
+
+struct policy_tbl_config {
+	/* The lcore of the GT instance that uses the table. */
+	unsigned int lcore_id;
+
+	/* Capacity of the source and destination prefixes. */
+	uint32_t     max_num_ipv4_rules;
+	uint32_t     num_ipv4_tbl8s;
+	uint32_t     max_num_ipv6_rules;
+	uint32_t     num_ipv6_tbl8s;
+
+	/* Capacity of the port rules. */
+	uint32_t     max_num_port_rules;
+
+	/* Number of groups; group ids go from 0 to @num_groups - 1. */
+	uint32_t     num_groups;
+
+	/* The group of requests that match no rule. */
+	uint32_t     default_group;
+};
+
+struct policy_tbl {
+	struct policy_tbl_config config;
+
+	/* Source prefixes; the next hops are group ids. */
+	struct rte_lpm    *src4;
+	struct rte_lpm6   *src6;
+
+	/* Destination prefixes; the next hops index @dst_groups. */
+	struct rte_lpm    *dst4;
+	struct rte_lpm6   *dst6;
+
+	/* Port rules, which map struct policy_tbl_port_key to groups. */
+	struct rte_hash   *ports;
+
+	/*
+	 * The group of each destination prefix, and the number of
+	 * destinations so far. Entry POLICY_TBL_ANY_DST holds
+	 * the default group.
+	 */
+	uint32_t          *dst_groups;
+	uint32_t          num_dsts;
+
+	/* The decision of each group; the flows are not used. */
+	struct ggu_policy *groups;
+};
+
+struct policy_tbl_port_key {
+	uint32_t dst;
+	uint8_t  proto;
+	uint8_t  reserved;
+	/* In host order. */
+	uint16_t port;
+};
+
+struct policy_tbl *policy_tbl_create(const struct policy_tbl_config *config);
+void policy_tbl_destroy(struct policy_tbl *tbl);
+int policy_tbl_set_group(struct policy_tbl *tbl, uint32_t group,
+	const struct ggu_policy *decision);
+int policy_tbl_add_src(struct policy_tbl *tbl, const char *prefix,
+	uint32_t group);
+int policy_tbl_add_dst(struct policy_tbl *tbl, const char *prefix,
+	uint32_t group);
+int policy_tbl_add_port(struct policy_tbl *tbl, int dst, uint8_t proto,
+	uint16_t port, uint32_t group);
+int policy_tbl_lookup(const struct policy_tbl *tbl,
+	const struct gt_packet_headers *pkt_info);
+int policy_tbl_fill(const struct policy_tbl *tbl, uint32_t group,
+	struct ggu_policy *policy);
+
+#endif /* _GATEKEEPER_POLICY_TBL_H_ */
@@ -0,0 +1,164 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GATEKEEPER_PROFILE_H_
+#define _GATEKEEPER_PROFILE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_atomic.h>
+#include <rte_branch_prediction.h>
+
+#include "gatekeeper_stats.h"
+
+/*
+ * Cycle accounting of the phases of the main loops.
+ *
+ * A main loop calls profile_charge() at the end of each of its
+ * phases, which charges the cycles since the previous call to
+ * that phase in the statistics of the lcore, so every cycle of the
+ * loop is charged to some phase. gkstat prints the share of cycles
+ * of each phase.
+ *
+ * The accounting is only compiled in when GATEKEEPER_PROFILE is
+ * defined, which `make PROFILE=y` does. Otherwise, the functions
+ * below are empty and cost nothing. `make PROFILE=pmu` also defines
+ * GATEKEEPER_PROFILE_PMU, which counts core cycles, instructions,
+ * and cache misses per phase with hardware counters opened through
+ * perf_event_open(2) and read with rdpmc, without system calls.
+ */
+
+#if defined(GATEKEEPER_PROFILE_PMU) && !defined(GATEKEEPER_PROFILE)
+#define GATEKEEPER_PROFILE
+#endif
+
+#if defined(GATEKEEPER_PROFILE_PMU) && !defined(RTE_ARCH_X86)
+#error "GATEKEEPER_PROFILE_PMU needs rdpmc, which is only available on x86"
+#endif
+
+#ifdef GATEKEEPER_PROFILE_PMU
+#include <linux/perf_event.h>
+#endif
+
+enum profile_pmu_event {
+	PROFILE_PMU_CORE_CYCLES = 0,
+	PROFILE_PMU_INSTRUCTIONS,
+	PROFILE_PMU_CACHE_MISSES,
+
+	PROFILE_NUM_PMU_EVENTS
+};
+
+/* The accounting state of an lcore; only that lcore may use it. */
+struct profile {
+	struct stats_lcore *stats;
+
+	/* When the current phase started, in cycles of the TSC. */
+	uint64_t           mark;
+
+	/* Whether the hardware counters below are open. */
+	bool               pmu;
+
+	/* The hardware counters, and their values at @mark. */
+	int                pmu_fds[PROFILE_NUM_PMU_EVENTS];
+	void               *pmu_pages[PROFILE_NUM_PMU_EVENTS];
+	uint64_t           pmu_marks[PROFILE_NUM_PMU_EVENTS];
+};
+
+void profile_init(struct profile *prof, struct stats_lcore *stats);
+void profile_free(struct profile *prof);
+
+#ifdef GATEKEEPER_PROFILE_PMU
+/*
+ * Read the hardware counter of @page from user space,
+ * as documented in perf_event_open(2).
+ */
+static inline uint64_t
+profile_read_pmu(const void *page)
+{
+	const volatile struct perf_event_mmap_page *pc = page;
+	uint32_t seq;
+	uint64_t count;
+
+	do {
+		uint32_t idx;
+
+		seq = pc->lock;
+		rte_compiler_barrier();
+
+		idx = pc->index;
+		count = pc->offset;
+		if (likely(idx != 0)) {
+			unsigned int shift = 64 - pc->pmc_width;
+			uint32_t lo, hi;
+			int64_t pmc;
+
+			asm volatile("rdpmc" : "=a" (lo), "=d" (hi)
+				: "c" (idx - 1));
+			pmc = (int64_t)(((uint64_t)hi << 32) | lo);
+			count += (pmc << shift) >> shift;
+		}
+
+		rte_compiler_barrier();
+	} while (pc->lock != seq);
+
+	return count;
+}
+
+static inline uint64_t
+profile_pmu_delta(struct profile *prof, enum profile_pmu_event event)
+{
+	uint64_t now = profile_read_pmu(prof->pmu_pages[event]);
+	uint64_t delta = now - prof->pmu_marks[event];
+
+	prof->pmu_marks[event] = now;
+	return delta;
+}
+#endif
+
+/* Charge the cycles since the last call to @phase. */
+static inline void
+profile_charge(struct profile *prof, enum stats_phase phase)
+{
+#ifdef GATEKEEPER_PROFILE
+	struct stats_phase_cost *cost = &prof->stats->phases[phase];
+	uint64_t now = rte_rdtsc();
+
+	cost->calls++;
+	cost->tsc_cycles += now - prof->mark;
+	prof->mark = now;
+
+#ifdef GATEKEEPER_PROFILE_PMU
+	if (prof->pmu) {
+		cost->core_cycles +=
+			profile_pmu_delta(prof, PROFILE_PMU_CORE_CYCLES);
+		cost->instructions +=
+			profile_pmu_delta(prof, PROFILE_PMU_INSTRUCTIONS);
+		cost->cache_misses +=
+			profile_pmu_delta(prof, PROFILE_PMU_CACHE_MISSES);
+	}
+#endif
+#else
+	RTE_SET_USED(prof);
+	RTE_SET_USED(phase);
+#endif
+}
+
+#endif /* _GATEKEEPER_PROFILE_H_ */
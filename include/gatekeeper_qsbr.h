@@ -0,0 +1,116 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GATEKEEPER_QSBR_H_
+#define _GATEKEEPER_QSBR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_lcore.h>
+#include <rte_atomic.h>
+#include <rte_spinlock.h>
+
+#include "list.h"
+
+/*
+ * Quiescent-state-based reclamation (QSBR).
+ *
+ * Readers are lcores that access shared objects without locks.
+ * Once per iteration of their main loops, when they do not hold
+ * references to any of these objects, readers report a quiescent
+ * state with qsbr_quiescent().
+ *
+ * Writers unlink an object, so no new reference to it can be
+ * obtained, and call qsbr_defer() to have it released once every
+ * reader online has gone through a quiescent state.
+ * Writers never wait for readers; deferred callbacks run when
+ * a writer, or a control-plane thread on its behalf, calls
+ * qsbr_reclaim() after the grace period. Readers should not call
+ * qsbr_reclaim(), since callbacks may be slow or take locks.
+ */
+
+struct qsbr_reader {
+	/*
+	 * The epoch of the last quiescent state of the reader,
+	 * or zero if the reader is offline.
+	 */
+	volatile uint64_t epoch;
+} __rte_cache_aligned;
+
+/*
+ * Callbacks may return -EAGAIN to stay deferred, when the object
+ * depends on something other than the grace period to be released.
+ * They will be called again at the next call of qsbr_reclaim().
+ *
+ * Callbacks run without the lock of struct qsbr held, so they may
+ * call qsbr_defer() to defer the release of the objects that they
+ * drop the last references to. They must not call qsbr_reclaim().
+ */
+typedef int (*qsbr_free_cb)(void *arg);
+
+struct qsbr {
+	/* The current epoch, it starts at one. */
+	rte_atomic64_t     epoch;
+
+	/* The readers, indexed by lcore id. */
+	struct qsbr_reader readers[RTE_MAX_LCORE];
+
+	/* Protects the fields below. */
+	rte_spinlock_t     lock;
+
+	/* The deferred callbacks in the order that they were deferred. */
+	struct list_head   deferred;
+	unsigned int       num_deferred;
+};
+
+void qsbr_init(struct qsbr *qs);
+int qsbr_defer(struct qsbr *qs, qsbr_free_cb cb, void *arg);
+unsigned int qsbr_reclaim(struct qsbr *qs);
+void qsbr_destroy(struct qsbr *qs);
+
+/* Whether there may be deferred callbacks; it does not take the lock. */
+static inline bool
+qsbr_has_deferred(struct qsbr *qs)
+{
+	return *(volatile unsigned int *)&qs->num_deferred > 0;
+}
+
+static inline void
+qsbr_quiescent(struct qsbr *qs, unsigned int lcore_id)
+{
+	/* All previous accesses to shared objects must be done. */
+	rte_smp_mb();
+	qs->readers[lcore_id].epoch = rte_atomic64_read(&qs->epoch);
+}
+
+static inline void
+qsbr_online(struct qsbr *qs, unsigned int lcore_id)
+{
+	qs->readers[lcore_id].epoch = rte_atomic64_read(&qs->epoch);
+	rte_smp_mb();
+}
+
+static inline void
+qsbr_offline(struct qsbr *qs, unsigned int lcore_id)
+{
+	rte_smp_mb();
+	qs->readers[lcore_id].epoch = 0;
+}
+
+#endif /* _GATEKEEPER_QSBR_H_ */
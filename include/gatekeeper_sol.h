@@ -20,19 +20,16 @@
 #define _GATEKEEPER_SOL_H_
 
 #include <rte_approx.h>
+#include <rte_atomic.h>
 #include <rte_cycles.h>
 #include <rte_reciprocal.h>
+#include <rte_mbuf.h>
+#include <rte_ring.h>
+#include <rte_spinlock.h>
 
-#include "list.h"
-
-struct priority_req {
-	/* Doubly-linked list node. */
-	struct list_head    list;
-	/* The packet for this request. */
-	struct rte_mbuf     *pkt;
-	/* The priority of this request. */
-	uint8_t             priority;
-};
+#include "gatekeeper_net.h"
+#include "gatekeeper_tx_buffer.h"
+#include "gatekeeper_stats.h"
 
 /*
  * The maximum priority that a packet can be assigned.
@@ -42,6 +39,87 @@ struct priority_req {
  */
 #define GK_MAX_REQ_PRIORITY (63)
 
+/* The maximum number of Grantors that the Solicitor tells apart. */
+#define SOL_MAX_GRANTORS (64)
+
+/*
+ * The id shared by the Grantors that come once the ids of all the
+ * other Grantors are in use, so FIB entries can still be added.
+ */
+#define SOL_GRANTOR_SHARED (SOL_MAX_GRANTORS - 1)
+
+/* No Grantor, in the lists of Grantors of a request queue. */
+#define SOL_GRANTOR_NONE (UINT16_MAX)
+
+/* No slot, in the lists of requests of a request queue. */
+#define REQ_SLOT_NONE (UINT32_MAX)
+
+/* A request in a request queue; see sol/main.c. */
+struct req_slot {
+	struct rte_mbuf       *pkt;
+	uint32_t              prev;
+	uint32_t              next;
+};
+
+/* A FIFO of the requests of a priority of a Grantor. */
+struct req_fifo {
+	/* The slots of the oldest and newest requests in the FIFO. */
+	uint32_t              head;
+	uint32_t              tail;
+};
+
+/* The requests bound to a Grantor. */
+struct sol_grantor_queue {
+	/* Bit i is set when the FIFO of priority i is not empty. */
+	uint64_t              occupied;
+
+	/* Number of requests in the FIFOs. */
+	uint32_t              len;
+
+	/* The largest number of requests that the FIFOs have held. */
+	uint32_t              max_len;
+
+	/* The FIFOs of each priority. */
+	struct req_fifo       fifos[GK_MAX_REQ_PRIORITY + 1];
+
+	/* Deficit of the Grantor in the deficit round robin. */
+	uint32_t              deficit_bytes;
+
+	/*
+	 * Whether the Grantor sent a request in its current turn,
+	 * which may have started in a previous call of dequeue_reqs().
+	 */
+	bool                  turn_sent;
+
+	/* Whether the Grantor is in the list of active Grantors. */
+	bool                  active;
+
+	/* Neighbors in the list of active Grantors. */
+	uint16_t              prev_active;
+	uint16_t              next_active;
+
+	/*
+	 * Request bandwidth of the Grantor, as a percentage of
+	 * the capacity of the link; see adjust_req_bw().
+	 */
+	double                bw_rate;
+
+	/* Credits of the Grantor, and when they were last refilled. */
+	double                credit_bytes;
+	uint64_t              refilled_at;
+
+	/* Whether the Grantor ran out of credits since the last period. */
+	bool                  out_of_credit;
+
+	/* The generation of the Grantor id that @bw_rate belongs to. */
+	uint32_t              generation;
+
+	/* Statistics of the requests bound to the Grantor. */
+	uint64_t              num_enqueued;
+	uint64_t              num_sent;
+	uint64_t              num_dropped;
+};
+
 /*
  * XXX The DPDK packet scheduler uses __rte_cache_aligned
  * on member @memory and on the struct as a whole. Should
@@ -50,18 +128,30 @@ struct priority_req {
 struct req_queue {
 	/* Length of the priority queue. */
 	uint32_t              len;
-	/* The highest priority of any packet currently in the queue. */
-	uint16_t              highest_priority;
-	/* The lowest priority of any packet currently in the queue. */
-	uint16_t              lowest_priority;
+
+	/* Number of requests of each priority over all Grantors. */
+	uint32_t              pri_len[GK_MAX_REQ_PRIORITY + 1];
+
+	/* Bit i is set when there are requests of priority i. */
+	uint64_t              occupied;
+
+	/* The slots of the requests, and the list of free slots. */
+	struct req_slot       *slots;
+	uint32_t              free_slot;
+
+	/* The requests of each Grantor, indexed by Grantor id. */
+	struct sol_grantor_queue grantors[SOL_MAX_GRANTORS];
 
 	/*
-	 * The head of the priority queue, referencing the node
-	 * that contains the packet with the highest priority.
+	 * The Grantors that have requests, in the order in
+	 * which the deficit round robin serves them.
 	 */
-	struct list_head      head;
-	/* Array of pointers to packets of each priority. */
-	struct priority_req   *priorities[GK_MAX_REQ_PRIORITY + 1];
+	uint16_t              active_head;
+	uint16_t              active_tail;
+	uint16_t              num_active;
+
+	/* Whether the turn of @active_head has started. */
+	bool                  turn_started;
 
 	/*
 	 * Token bucket algorithm state.
@@ -91,17 +181,114 @@ struct req_queue {
 	uint64_t              time_cpu_cycles;
 };
 
+/* Feedback older than this is ignored, in milliseconds. */
+#define SOL_FEEDBACK_TIMEOUT_MS (1000)
+
+/*
+ * A Grantor server to which the GK block sends requests, and the
+ * feedback that it sends along with its policy decisions.
+ *
+ * The GK block gets the id of a Grantor, its index in the table,
+ * when it creates a FIB entry of the Grantor, and puts it back once
+ * the FIB entry is released. The id of a Grantor without FIB entries
+ * can go to a new Grantor, which bumps its generation. The feedback
+ * is only updated by the GK-GT unit. The Solicitor instances read
+ * the table without locks.
+ */
+struct sol_grantor {
+	struct ipaddr     addr;
+
+	/* Number of FIB entries of the Grantor; under @grantors_lock. */
+	uint32_t          ref_cnt;
+
+	/* Bumped each time the id goes to another Grantor. */
+	volatile uint32_t generation;
+
+	/*
+	 * Moving average of the headroom reported by the instances
+	 * of the Grantor, from 0 to GGU_MAX_HEADROOM.
+	 */
+	volatile uint8_t  headroom;
+
+	/* When the last report arrived, in cycles. */
+	volatile uint64_t reported_at;
+};
+
+/*
+ * A Solicitor instance. Each instance runs at its own lcore, and
+ * services the requests of the GK instances that are mapped to it
+ * with its own priority queue, share of the request bandwidth,
+ * and TX queue.
+ */
+struct sol_instance {
+	/* Priority queue for request packets. */
+	struct req_queue   req_queue;
+
+	/*
+	 * Rings into which GK instances enqueue request packets
+	 * to be serviced and sent out by this instance.
+	 * Each GK instance is the only producer of its ring.
+	 */
+	struct rte_ring    *req_rings[RTE_MAX_LCORE];
+	unsigned int       num_req_rings;
+
+	/* TX queue on the back interface. */
+	uint16_t           tx_queue_back;
+
+	/* Buffer of the packets to transmit on @tx_queue_back. */
+	struct tx_buffer   tx_back;
+
+	/* Capacity of the back interface in bytes per second. */
+	uint64_t           link_speed_bytes;
+
+	/* Share of the request bandwidth that this instance gets. */
+	double             bw_share;
+
+	/*
+	 * Bytes per cycle that this instance gets when the request
+	 * bandwidth is the full capacity of the link.
+	 */
+	double             bytes_per_cycle;
+
+	/* When the bandwidths of the Grantors are adjusted next. */
+	uint64_t           next_feedback_at;
+
+	/*
+	 * Copy of the bitmap of occupied priorities of @req_queue
+	 * that the other instances read to measure how far the
+	 * order of the requests sent out by the instances is
+	 * from a single global priority order.
+	 */
+	volatile uint64_t  published_occupied;
+
+	/* Number of requests sent out by this instance. */
+	uint64_t           num_dequeued;
+
+	/*
+	 * Number of requests sent out while another instance
+	 * had a request of higher priority in its queue.
+	 */
+	uint64_t           num_inversions;
+
+	/* The statistics of the instance. */
+	struct stats_lcore *stats;
+} __rte_cache_aligned;
+
 /* Configuration for the Solicitor functional block. */
 struct sol_config {
-	unsigned int       lcore_id;
-
-	/* Maximum number of requests to store in priority queue at once. */
+	/*
+	 * Maximum number of requests to store in the priority
+	 * queue of each instance at once.
+	 */
 	unsigned int       pri_req_max_len;
 
 	/*
-	 * Bandwidth limit for the priority queue of requests,
+	 * Bandwidth limit for the priority queues of requests,
 	 * as a percentage of the capacity of the link. Must
-	 * be > 0 and < 1.
+	 * be > 0 and < 1. The bandwidth is split among the
+	 * instances in proportion to the GK instances mapped
+	 * to each of them, and it is shared among the Grantors
+	 * with deficit round robin.
 	 */
 	double             req_bw_rate;
 
@@ -110,27 +297,136 @@ struct sol_config {
 	unsigned int       deq_burst_size;
 
 	/*
-	 * The fields below are for internal use.
-	 * Configuration files should not refer to them.
+	 * Bounds of the request bandwidth of each Grantor, as
+	 * percentages of the capacity of the link. Within these
+	 * bounds, the request bandwidth of a Grantor follows the
+	 * headroom that it reports. @req_bw_rate_max must not be
+	 * greater than @req_bw_rate. When both are zero, the request
+	 * bandwidth of each Grantor is only limited by @req_bw_rate.
 	 */
+	double             req_bw_rate_min;
+	double             req_bw_rate_max;
 
-	/* Priority queue for request packets. */
-	struct req_queue   req_queue;
+	/*
+	 * Share of their capacity that Grantors should keep idle.
+	 * The request bandwidth of a Grantor is reduced while it
+	 * reports less headroom than this, and it is increased
+	 * while it reports more headroom than this.
+	 */
+	double             grantor_headroom_target;
+
+	/* Period in milliseconds of the adjustments of the bandwidth. */
+	unsigned int       feedback_period_ms;
 
 	/*
-	 * Mailbox into which GK instances enqueue request packets
-	 * to be serviced and sent out by the Solicitor.
+	 * The fields below are for internal use.
+	 * Configuration files should not refer to them.
 	 */
-	struct mailbox     mb;
 
-	/* TX queue on the back interface. */
-	uint16_t           tx_queue_back;
+	/* @feedback_period_ms in cycles. */
+	uint64_t           feedback_period_cycles;
+
+	/* The Grantors, indexed by Grantor id. */
+	struct sol_grantor grantors[SOL_MAX_GRANTORS];
+	volatile unsigned int num_grantors;
+
+	/* Serializes the addition and removal of Grantors. */
+	rte_spinlock_t     grantors_lock;
+
+	rte_atomic32_t     ref_cnt;
+
+	/* The lcore ids at which each instance runs. */
+	unsigned int       *lcores;
+
+	/* The number of lcore ids in @lcores. */
+	int                num_lcores;
+
+	struct sol_instance *instances;
+
+	/* Number of request rings over all instances. */
+	unsigned int       num_req_rings;
+
 	struct net_config  *net;
 };
 
 struct sol_config *alloc_sol_conf(void);
 int run_sol(struct net_config *net_conf, struct sol_config *sol_conf);
-int gk_solicitor_enqueue(struct sol_config *sol_conf, struct rte_mbuf *pkt,
-	uint8_t priority);
+int sol_conf_put(struct sol_config *sol_conf);
+struct rte_ring *alloc_sol_req_ring(struct sol_config *sol_conf,
+	unsigned int lcore_id);
+void gk_solicitor_enqueue_bulk(struct rte_ring *req_ring,
+	struct rte_mbuf **pkts, unsigned int num_pkts);
+int sol_register_grantor(struct sol_config *sol_conf,
+	const struct ipaddr *gt_addr);
+void sol_put_grantor(struct sol_config *sol_conf, uint16_t grantor_id);
+void sol_report_grantor_headroom(struct sol_config *sol_conf,
+	const struct ipaddr *gt_addr, uint8_t headroom);
+
+/*
+ * The priority and the Grantor id of a request travel in its mbuf,
+ * in the fields of the hash of the hierarchical scheduler, which
+ * overlap the RSS hash that is not needed once the packet is received.
+ */
+static inline void
+sol_set_req_priority(struct rte_mbuf *pkt, uint8_t priority)
+{
+	pkt->hash.sched.lo = priority;
+}
+
+static inline uint8_t
+sol_get_req_priority(const struct rte_mbuf *pkt)
+{
+	return pkt->hash.sched.lo;
+}
+
+static inline void
+sol_set_req_grantor(struct rte_mbuf *pkt, uint16_t grantor_id)
+{
+	pkt->hash.sched.hi = grantor_id;
+}
+
+static inline uint16_t
+sol_get_req_grantor(const struct rte_mbuf *pkt)
+{
+	return pkt->hash.sched.hi;
+}
+
+/*
+ * When latency sampling is on, a sampled request carries when GK
+ * received it and when the Solicitor enqueued it, in cycles.
+ * The arrival goes in the timestamp field, which shares the first
+ * cache line of the mbuf with the fields above, so that checking
+ * whether a request was sampled does not cost a cache miss.
+ * A request that GK did not sample carries zero as its arrival.
+ */
+static inline void
+sol_set_req_arrival(struct rte_mbuf *pkt, uint64_t arrived_at)
+{
+	pkt->timestamp = arrived_at;
+}
+
+static inline uint64_t
+sol_get_req_arrival(const struct rte_mbuf *pkt)
+{
+	return pkt->timestamp;
+}
+
+static inline void
+sol_set_req_enqueued_at(struct rte_mbuf *pkt, uint64_t enqueued_at)
+{
+	pkt->udata64 = enqueued_at;
+}
+
+static inline uint64_t
+sol_get_req_enqueued_at(const struct rte_mbuf *pkt)
+{
+	return pkt->udata64;
+}
+
+static inline void
+sol_conf_hold(struct sol_config *sol_conf)
+{
+	rte_atomic32_inc(&sol_conf->ref_cnt);
+}
 
 #endif /* _GATEKEEPER_SOL_H_ */
@@ -0,0 +1,300 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GATEKEEPER_STATS_H_
+#define _GATEKEEPER_STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <rte_lcore.h>
+#include <rte_memory.h>
+
+/*
+ * Statistics of the functional blocks.
+ *
+ * Each lcore has a block of counters that only the lcore writes,
+ * without atomic operations or barriers. The blocks of all lcores
+ * live in a memzone, so that other processes, such as gkstat,
+ * can attach to it as DPDK secondary processes and read the
+ * counters at any time. Readers may see a counter that is slightly
+ * out of date, but a 64-bit counter is never seen half updated.
+ *
+ * Each lcore also has latency histograms, which record durations
+ * in cycles in log-linear buckets: every power of two is split into
+ * STATS_HIST_SUB_BUCKETS buckets, so the relative error of a bucket
+ * is bounded by 1 / STATS_HIST_SUB_BUCKETS. Histograms of the same
+ * stage are merged by adding up their buckets.
+ *
+ * When Gatekeeper is built with profiling (see gatekeeper_profile.h),
+ * each lcore also accounts the cycles that its main loop spends
+ * in each phase.
+ */
+
+#define STATS_MEMZONE_NAME "gatekeeper_stats"
+
+/* Identifies the layout of the memzone; change it when the layout changes. */
+#define STATS_MAGIC (0x47535406)
+
+enum stats_block {
+	STATS_BLOCK_NONE = 0,
+	STATS_BLOCK_GK,
+	STATS_BLOCK_GT,
+	STATS_BLOCK_SOL,
+	STATS_BLOCK_GGU,
+	STATS_BLOCK_LLS,
+	STATS_BLOCK_CPS,
+	STATS_NUM_BLOCKS
+};
+
+enum stats_counter {
+	/* Packets received by the functional block. */
+	STATS_PKTS_RX = 0,
+	/* Packets that the TX buffers of the block dropped. */
+	STATS_TX_DROPS,
+
+	/* GK block. */
+	STATS_GK_PKTS_REQUEST,
+	STATS_GK_PKTS_GRANTED,
+	STATS_GK_PKTS_DECLINED,
+	STATS_GK_FLOWS,
+	STATS_GK_FLOW_EXPIRATIONS,
+	STATS_GK_FLOW_EVICTIONS,
+	STATS_GK_FLOW_ENOSPC,
+	STATS_GK_FLOW_EXPIRY_ERRORS,
+
+	/* Solicitor block. */
+	STATS_SOL_REQS_ENQUEUED,
+	STATS_SOL_REQS_SENT,
+	STATS_SOL_REQS_DROPPED,
+	STATS_SOL_QUEUE_LEN,
+	/* Requests sent ahead of queued ones of higher priority. */
+	STATS_SOL_PRIORITY_INVERSIONS,
+
+	/* GT block. */
+	STATS_GT_DECISIONS,
+	STATS_GT_LUA_ERRORS,
+	STATS_GT_DECISION_CACHE_HITS,
+
+	/* GK-GT unit. */
+	STATS_GGU_POLICIES,
+
+	/* CPS block. */
+	STATS_CPS_PKTS_TO_KNI,
+	STATS_CPS_PKTS_FROM_KNI,
+
+	STATS_NUM_COUNTERS
+};
+
+enum stats_hist_id {
+	/* From the arrival of a request at GK to the Solicitor. */
+	STATS_HIST_GK_TO_SOL = 0,
+	/* Time that a request waits in the queue of the Solicitor. */
+	STATS_HIST_SOL_QUEUE,
+	/*
+	 * From the arrival of a request at GK to its transmission
+	 * by the Solicitor, i.e. the TX burst that the NIC accepted.
+	 */
+	STATS_HIST_REQ_TOTAL,
+	/* Time that GT takes to look up a policy decision. */
+	STATS_HIST_GT_POLICY,
+
+	STATS_NUM_HISTS
+};
+
+#define STATS_HIST_SUB_BITS (3)
+#define STATS_HIST_SUB_BUCKETS (1 << STATS_HIST_SUB_BITS)
+
+/* Durations longer than 2^STATS_HIST_MAX_BITS cycles share the last bucket. */
+#define STATS_HIST_MAX_BITS (36)
+
+#define STATS_HIST_NUM_BUCKETS \
+	((STATS_HIST_MAX_BITS - STATS_HIST_SUB_BITS + 1) * STATS_HIST_SUB_BUCKETS)
+
+struct stats_hist {
+	volatile uint64_t count;
+	volatile uint64_t sum;
+	/* Longest duration since start up, not reset by stats_hist_sub(). */
+	volatile uint64_t max;
+	volatile uint64_t buckets[STATS_HIST_NUM_BUCKETS];
+};
+
+enum stats_phase {
+	/* Polls of the RX queues that received no packet. */
+	STATS_PHASE_IDLE = 0,
+	/* Work that does not belong to the phases below. */
+	STATS_PHASE_OTHER,
+
+	/* GK block. */
+	STATS_PHASE_GK_FRONT,
+	STATS_PHASE_GK_BACK,
+	STATS_PHASE_GK_MAILBOX,
+	STATS_PHASE_GK_FLOW_SCAN,
+
+	/* GT block. */
+	STATS_PHASE_GT_RX,
+	STATS_PHASE_GT_PARSE,
+	STATS_PHASE_GT_REASSEMBLY,
+	STATS_PHASE_GT_POLICY,
+	STATS_PHASE_GT_TX,
+	STATS_PHASE_GT_FRAG_SCAN,
+
+	STATS_NUM_PHASES
+};
+
+/*
+ * The cost of a phase. The PMU counters stay at zero unless
+ * the hardware counters of the lcore could be opened.
+ */
+struct stats_phase_cost {
+	/* Number of times that the phase ran. */
+	volatile uint64_t calls;
+	/* Cycles of the TSC. */
+	volatile uint64_t tsc_cycles;
+	/* Core cycles, instructions retired and cache misses. */
+	volatile uint64_t core_cycles;
+	volatile uint64_t instructions;
+	volatile uint64_t cache_misses;
+};
+
+struct stats_counter_desc {
+	const char *name;
+
+	/*
+	 * Whether the counter holds the current value of
+	 * a quantity, instead of counting events.
+	 */
+	bool       gauge;
+};
+
+extern const struct stats_counter_desc stats_counters[STATS_NUM_COUNTERS];
+extern const char *stats_block_names[STATS_NUM_BLOCKS];
+extern const char *stats_hist_names[STATS_NUM_HISTS];
+extern const char *stats_phase_names[STATS_NUM_PHASES];
+
+struct stats_lcore {
+	/* The functional block running at the lcore. */
+	volatile uint32_t block;
+
+	volatile uint64_t counters[STATS_NUM_COUNTERS];
+
+	struct stats_hist hists[STATS_NUM_HISTS];
+
+	struct stats_phase_cost phases[STATS_NUM_PHASES];
+} __rte_cache_aligned;
+
+struct stats_shm {
+	uint32_t           magic;
+	uint32_t           num_counters;
+	uint32_t           num_hists;
+	uint32_t           num_phases;
+
+	/* Frequency of the TSC of the primary process. */
+	uint64_t           tsc_hz;
+
+	struct stats_lcore lcores[RTE_MAX_LCORE];
+};
+
+int stats_init(void);
+struct stats_lcore *stats_register(unsigned int lcore_id,
+	enum stats_block block);
+const struct stats_shm *stats_attach(void);
+uint64_t stats_hist_bucket_value(unsigned int bucket);
+void stats_hist_add(struct stats_hist *dst, const struct stats_hist *src);
+void stats_hist_sub(struct stats_hist *dst, const struct stats_hist *src);
+uint64_t stats_hist_percentile(const struct stats_hist *hist,
+	double percentile);
+
+static inline unsigned int
+stats_hist_bucket(uint64_t cycles)
+{
+	unsigned int msb;
+
+	if (cycles < STATS_HIST_SUB_BUCKETS)
+		return cycles;
+
+	msb = 63 - __builtin_clzll(cycles);
+	if (msb >= STATS_HIST_MAX_BITS)
+		return STATS_HIST_NUM_BUCKETS - 1;
+
+	return (msb - STATS_HIST_SUB_BITS + 1) * STATS_HIST_SUB_BUCKETS +
+		((cycles >> (msb - STATS_HIST_SUB_BITS)) &
+		(STATS_HIST_SUB_BUCKETS - 1));
+}
+
+/* Only the lcore that owns @stats may call the functions below. */
+
+static inline void
+stats_add(struct stats_lcore *stats, enum stats_counter counter,
+	uint64_t n)
+{
+	stats->counters[counter] += n;
+}
+
+static inline void
+stats_inc(struct stats_lcore *stats, enum stats_counter counter)
+{
+	stats->counters[counter]++;
+}
+
+static inline void
+stats_dec(struct stats_lcore *stats, enum stats_counter counter)
+{
+	stats->counters[counter]--;
+}
+
+static inline void
+stats_set(struct stats_lcore *stats, enum stats_counter counter,
+	uint64_t value)
+{
+	stats->counters[counter] = value;
+}
+
+static inline void
+stats_hist_record(struct stats_lcore *stats, enum stats_hist_id id,
+	uint64_t cycles)
+{
+	struct stats_hist *hist = &stats->hists[id];
+
+	hist->count++;
+	hist->sum += cycles;
+	if (cycles > hist->max)
+		hist->max = cycles;
+	hist->buckets[stats_hist_bucket(cycles)]++;
+}
+
+/*
+ * Whether to sample the next event, taking one in @period events.
+ * A @period of zero disables sampling.
+ */
+static inline bool
+stats_sample(uint32_t *countdown, uint32_t period)
+{
+	if (period == 0)
+		return false;
+
+	if (*countdown > 1) {
+		(*countdown)--;
+		return false;
+	}
+
+	*countdown = period;
+	return true;
+}
+
+#endif /* _GATEKEEPER_STATS_H_ */
@@ -0,0 +1,75 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GATEKEEPER_TIMER_WHEEL_H_
+#define _GATEKEEPER_TIMER_WHEEL_H_
+
+#include <stdint.h>
+
+#include "gatekeeper_index_list.h"
+
+/*
+ * A hierarchical timing wheel whose nodes live in an array,
+ * for example, the flow entries of a GK instance.
+ *
+ * Each node embeds a struct index_link. Timing wheels are not
+ * thread safe; each one is meant to be used by a single lcore.
+ */
+
+#define TW_LEVEL_BITS (8)
+#define TW_LEVEL_SIZE (1 << TW_LEVEL_BITS)
+#define TW_LEVEL_MASK (TW_LEVEL_SIZE - 1)
+#define TW_NUM_LEVELS (4)
+#define TW_NUM_SLOTS  (TW_NUM_LEVELS * TW_LEVEL_SIZE)
+
+struct timer_wheel {
+	/* Number of cycles of each tick of the timing wheel. */
+	uint64_t          cycles_per_tick;
+
+	/* All ticks up to @cur_tick have been processed. */
+	uint64_t          cur_tick;
+
+	/*
+	 * The lists of the slots of each level, followed by
+	 * the list of nodes whose ticks have passed.
+	 */
+	struct index_lists lists;
+	struct index_link heads[TW_NUM_SLOTS + 1];
+};
+
+int tw_init(struct timer_wheel *tw, void *nodes, uint32_t num_nodes,
+	size_t node_size, size_t link_offset, uint64_t cycles_per_tick,
+	uint64_t now);
+void tw_schedule(struct timer_wheel *tw, uint32_t index, uint64_t expire_at);
+void tw_advance(struct timer_wheel *tw, uint64_t now);
+int tw_pop_expired(struct timer_wheel *tw);
+
+static inline bool
+tw_is_scheduled(struct timer_wheel *tw, uint32_t index)
+{
+	return il_is_linked(&tw->lists, index);
+}
+
+static inline void
+tw_cancel(struct timer_wheel *tw, uint32_t index)
+{
+	if (tw_is_scheduled(tw, index))
+		il_del(&tw->lists, index);
+}
+
+#endif /* _GATEKEEPER_TIMER_WHEEL_H_ */
@@ -0,0 +1,105 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GATEKEEPER_TX_BUFFER_H_
+#define _GATEKEEPER_TX_BUFFER_H_
+
+#include <stdint.h>
+
+#include <rte_mbuf.h>
+#include <rte_branch_prediction.h>
+
+#include "gatekeeper_main.h"
+
+/*
+ * Buffer of the packets to be transmitted on a TX queue.
+ *
+ * Packets that the NIC does not accept are kept in the buffer
+ * and sent again at the next flush instead of being dropped,
+ * so that micro-bursts do not turn into packet loss. Packets are
+ * only dropped when the backlog of the buffer is full.
+ *
+ * A TX buffer is meant to be used by the single lcore that owns
+ * its TX queue. The lcore should flush the buffer after processing
+ * each burst of packets, and call txb_drain() in its main loop,
+ * so that the backlog is sent even when no new packets arrive.
+ */
+
+/* The maximum number of packets that a TX buffer holds. */
+#define TX_BUFFER_SIZE (4 * GATEKEEPER_MAX_PKT_BURST)
+
+/* Time in microseconds that packets wait in a TX buffer before a drain. */
+#define TX_BUFFER_DRAIN_US (100)
+
+struct tx_buffer {
+	uint16_t        port;
+	uint16_t        queue;
+
+	/* Number of packets in @pkts. */
+	uint16_t        len;
+
+	/* The buffer is flushed once it holds this many packets. */
+	uint16_t        flush_threshold;
+
+	/* Cycles that packets can wait in the buffer before a drain. */
+	uint64_t        drain_cycles;
+
+	/* When the buffer was last flushed, in cycles. */
+	uint64_t        last_flush_at;
+
+	/* Number of packets accepted by the NIC. */
+	uint64_t        num_sent;
+
+	/* Number of packets dropped because the buffer was full. */
+	uint64_t        num_dropped;
+
+	/* Number of flushes that left packets in the buffer. */
+	uint64_t        num_retries;
+
+	struct rte_mbuf *pkts[TX_BUFFER_SIZE];
+};
+
+void txb_init(struct tx_buffer *txb, uint16_t port, uint16_t queue);
+uint16_t txb_flush(struct tx_buffer *txb);
+void txb_add_bulk(struct tx_buffer *txb, struct rte_mbuf **pkts,
+	uint16_t num_pkts);
+void txb_free(struct tx_buffer *txb, const char *block);
+
+/* Number of packets that can be added before the buffer is full. */
+static inline uint16_t
+txb_room(const struct tx_buffer *txb)
+{
+	return TX_BUFFER_SIZE - txb->len;
+}
+
+static inline void
+txb_add(struct tx_buffer *txb, struct rte_mbuf *pkt)
+{
+	txb_add_bulk(txb, &pkt, 1);
+}
+
+/* Flush the buffer if its packets have waited long enough. */
+static inline void
+txb_drain(struct tx_buffer *txb, uint64_t now)
+{
+	if (unlikely(txb->len > 0 &&
+			now - txb->last_flush_at >= txb->drain_cycles))
+		txb_flush(txb);
+}
+
+#endif /* _GATEKEEPER_TX_BUFFER_H_ */
@@ -16,8 +16,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include <arpa/inet.h>
 
+#include <rte_log.h>
 #include <rte_thash.h>
 #include <rte_debug.h>
 #include <rte_ether.h>
@@ -26,53 +28,80 @@
 #include "gatekeeper_flow.h"
 #include "gatekeeper_main.h"
 
+/* The longest input of the RSS hash: an IPv6 <Src, Dst> pair. */
+#define RSS_MAX_INPUT_LEN (32)
+
 /*
- * Optimized generic implementation of RSS hash function.
- * If you want the calculated hash value matches NIC RSS value,
- * you have to use special converted key with rte_convert_rss_key() fn.
- * @param input_tuple
- *   Pointer to input tuple with network order.
- * @param input_len
- *   Length of input_tuple in 4-bytes chunks.
- * @param *rss_key
- *   Pointer to RSS hash key.
- * @return
- *   Calculated hash value.
+ * Lookup table of the RSS hash: @rss_lut[i][v] is the hash of
+ * an input whose byte @i is @v and whose other bytes are zero.
+ *
+ * As the Toeplitz hash is linear over XOR, the hash of an input
+ * is the XOR of the entries of its bytes, so computing it takes
+ * one table lookup per byte instead of one step per bit.
  */
-static inline uint32_t
-gk_softrss_be(const uint32_t *input_tuple, uint32_t input_len,
-		const uint8_t *rss_key)
+static uint32_t rss_lut[RSS_MAX_INPUT_LEN][256];
+
+/*
+ * Returns the 32 bits of @rss_key that start at bit @bit,
+ * which is what an input bit at position @bit contributes
+ * to the Toeplitz hash.
+ */
+static uint32_t
+rss_key_window(const uint8_t *rss_key, unsigned int bit)
 {
-	uint32_t i;
-	uint32_t j;
-	uint32_t ret = 0;
+	unsigned int byte = bit / 8;
+	uint64_t v = (uint64_t)rss_key[byte] << 32 |
+		(uint64_t)rss_key[byte + 1] << 24 |
+		(uint64_t)rss_key[byte + 2] << 16 |
+		(uint64_t)rss_key[byte + 3] << 8 |
+		(uint64_t)rss_key[byte + 4];
+
+	return (uint32_t)(v >> (8 - bit % 8));
+}
+
+/*
+ * Build the lookup table of rss_ip_flow_hf() from the RSS key,
+ * which must have already been initialized.
+ *
+ * gatekeeper-bench -x softrss checks the table against rte_softrss(),
+ * which gives the same values as the NIC.
+ */
+void
+rss_ip_flow_hf_init(void)
+{
+	unsigned int i, j, v;
+
+	RTE_BUILD_BUG_ON(sizeof(((struct ip_flow *)0)->f.v6) !=
+		RSS_MAX_INPUT_LEN);
+	/* The windows of the last input bits must fit in the key. */
+	RTE_BUILD_BUG_ON(RSS_MAX_INPUT_LEN + sizeof(uint32_t) >
+		sizeof(default_rss_key));
 
-	for (j = 0; j < input_len; j++) {
-		/*
-		 * Need to use little endian,
-		 * since it takes ordering as little endian in both bytes and bits.
-		 */
-		uint32_t val = rte_be_to_cpu_32(input_tuple[j]);
-		for (i = 0; i < 32; i++)
-			if (val & (1 << (31 - i))) {
-				/*
-				 * The cast (uint64_t) is needed because when
-				 * @i == 0, the expression requires a 32-bit
-				 * shift of a 32-bit unsigned integer,
-				 * what is undefined.
-				 * The C standard only defines bit shifting
-				 * up to the bit-size of the integer minus one.
-				 * Finally, the cast (uint32_t) avoid promoting
-				 * the expression before the bit-or (i.e. `|`)
-				 * to uint64_t.
-				 */
-				ret ^= ((const uint32_t *)rss_key)[j] << i |
-					(uint32_t)((uint64_t)
-						(((const uint32_t *)rss_key)
-							[j + 1])
-						>> (32 - i));
+	for (i = 0; i < RSS_MAX_INPUT_LEN; i++) {
+		uint32_t windows[8];
+
+		for (j = 0; j < 8; j++)
+			windows[j] = rss_key_window(default_rss_key, i * 8 + j);
+
+		for (v = 0; v < 256; v++) {
+			uint32_t hash = 0;
+			for (j = 0; j < 8; j++) {
+				if (v & (0x80 >> j))
+					hash ^= windows[j];
 			}
+			rss_lut[i][v] = hash;
+		}
 	}
+}
+
+static inline uint32_t
+softrss_lut(const uint8_t *input, unsigned int input_len)
+{
+	unsigned int i;
+	uint32_t ret = 0;
+
+	for (i = 0; i < input_len; i++)
+		ret ^= rss_lut[i][input[i]];
 
 	return ret;
 }
@@ -85,11 +114,11 @@ rss_ip_flow_hf(const void *data,
 	const struct ip_flow *flow = (const struct ip_flow *)data;
 
 	if (flow->proto == ETHER_TYPE_IPv4)
-		return gk_softrss_be((const uint32_t *)&flow->f,
-				(sizeof(flow->f.v4)/sizeof(uint32_t)), rss_key_be);
+		return softrss_lut((const uint8_t *)&flow->f,
+			sizeof(flow->f.v4));
 	else if (flow->proto == ETHER_TYPE_IPv6)
-		return gk_softrss_be((const uint32_t *)&flow->f,
-				(sizeof(flow->f.v6)/sizeof(uint32_t)), rss_key_be);
+		return softrss_lut((const uint8_t *)&flow->f,
+			sizeof(flow->f.v6));
 	else
 		rte_panic("Unexpected protocol: %i\n", flow->proto);
 
@@ -114,7 +143,7 @@ ip_flow_cmp_eq(const void *key1, const void *key2,
 }
 
 void
-print_flow_err_msg(struct ip_flow *flow, const char *err_msg)
+print_flow_err_msg(const struct ip_flow *flow, const char *err_msg)
 {
 	char src[128];
 	char dst[128];
@@ -0,0 +1,216 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <rte_atomic.h>
+#include <rte_cycles.h>
+#include <rte_malloc.h>
+#include <rte_spinlock.h>
+#include <rte_branch_prediction.h>
+
+#include "gatekeeper_main.h"
+#include "gatekeeper_log_ratelimit.h"
+
+struct log_ratelimit_state {
+	/* Number of messages that can be emitted now. */
+	uint32_t                        tokens;
+
+	/* When the tokens were last refilled, in cycles. */
+	uint64_t                        refilled_at;
+
+	/* Number of messages suppressed since they were last reported. */
+	uint64_t                        num_suppressed;
+
+	/* The site of the bucket, to report the suppressed messages. */
+	const struct log_ratelimit_site *site;
+};
+
+struct log_ratelimit_lcore {
+	/* When log_ratelimit_flush() next reports suppressed messages. */
+	uint64_t                   next_flush_at;
+
+	struct log_ratelimit_state states[LOG_RATELIMIT_MAX_SITES];
+};
+
+/* The last entry is for threads that are not EAL lcores. */
+static struct log_ratelimit_lcore *lcores[RTE_MAX_LCORE + 1];
+
+/* Serializes the allocation of the entries of @lcores. */
+static rte_spinlock_t lcores_lock = RTE_SPINLOCK_INITIALIZER;
+
+/* Number of sites that have been given an id. */
+static rte_atomic32_t num_sites = RTE_ATOMIC32_INIT(0);
+
+static inline unsigned int
+log_ratelimit_lcore_id(void)
+{
+	unsigned int lcore_id = rte_lcore_id();
+	return lcore_id < RTE_MAX_LCORE ? lcore_id : RTE_MAX_LCORE;
+}
+
+static struct log_ratelimit_lcore *
+get_lcore_states(unsigned int lcore_id)
+{
+	struct log_ratelimit_lcore *lc = lcores[lcore_id];
+
+	if (likely(lc != NULL))
+		return lc;
+
+	rte_spinlock_lock(&lcores_lock);
+	lc = lcores[lcore_id];
+	if (lc == NULL) {
+		lc = rte_zmalloc("log_ratelimit", sizeof(*lc), 0);
+		lcores[lcore_id] = lc;
+	}
+	rte_spinlock_unlock(&lcores_lock);
+	return lc;
+}
+
+static inline uint32_t
+get_site_index(struct log_ratelimit_site *site)
+{
+	uint32_t id = site->id;
+
+	if (unlikely(id == 0)) {
+		/* Ids lost to concurrent first calls are not reused. */
+		id = rte_atomic32_add_return(&num_sites, 1);
+		if (!rte_atomic32_cmpset(&site->id, 0, id))
+			id = site->id;
+		else if (id == LOG_RATELIMIT_MAX_SITES + 1)
+			RTE_LOG(WARNING, GATEKEEPER,
+				"log_ratelimit: more than %d call sites, %s:%d and the next ones share a bucket\n",
+				LOG_RATELIMIT_MAX_SITES, site->file,
+				site->line);
+	}
+
+	return RTE_MIN(id - 1, (uint32_t)LOG_RATELIMIT_MAX_SITES - 1);
+}
+
+/* Whether more than one site uses the bucket @index. */
+static inline bool
+is_shared_bucket(uint32_t index)
+{
+	return index == LOG_RATELIMIT_MAX_SITES - 1 &&
+		(uint32_t)rte_atomic32_read(&num_sites) >
+		LOG_RATELIMIT_MAX_SITES;
+}
+
+static void
+report_suppressed(const struct log_ratelimit_site *site, uint32_t index,
+	uint64_t num_suppressed)
+{
+	if (is_shared_bucket(index)) {
+		/* The messages may come from any of the sites. */
+		RTE_LOG(NOTICE, GATEKEEPER,
+			"%" PRIu64 " messages suppressed at the call sites that share the last rate-limit bucket\n",
+			num_suppressed);
+		return;
+	}
+
+	rte_log(site->level, site->logtype,
+		"%s%" PRIu64 " messages suppressed at %s:%d\n",
+		site->prefix, num_suppressed, site->file, site->line);
+}
+
+/*
+ * Take a token from the bucket of the calling lcore at @site.
+ *
+ * Returns true if the message should be emitted. In that case,
+ * the messages suppressed at the site by the lcore since they
+ * were last reported are reported first.
+ *
+ * If the buckets of the lcore cannot be allocated, messages are
+ * suppressed, so a flood cannot get through.
+ */
+bool
+log_ratelimit_allow(struct log_ratelimit_site *site)
+{
+	struct log_ratelimit_lcore *lc =
+		get_lcore_states(log_ratelimit_lcore_id());
+	struct log_ratelimit_state *state;
+	uint32_t index;
+	uint64_t cycles_per_token =
+		LOG_RATELIMIT_INTERVAL_MS * cycles_per_ms / LOG_RATELIMIT_BURST;
+	uint64_t now = rte_rdtsc();
+
+	if (unlikely(lc == NULL))
+		return false;
+	index = get_site_index(site);
+	state = &lc->states[index];
+
+	if (unlikely(state->refilled_at == 0)) {
+		/* First call of the site at this lcore. */
+		state->tokens = LOG_RATELIMIT_BURST;
+		state->refilled_at = now;
+		state->site = site;
+	} else if (cycles_per_token > 0 &&
+			now - state->refilled_at >= cycles_per_token) {
+		uint64_t new_tokens =
+			(now - state->refilled_at) / cycles_per_token;
+		if (state->tokens + new_tokens >= LOG_RATELIMIT_BURST) {
+			state->tokens = LOG_RATELIMIT_BURST;
+			state->refilled_at = now;
+		} else {
+			state->tokens += new_tokens;
+			state->refilled_at += new_tokens * cycles_per_token;
+		}
+	}
+
+	if (state->tokens == 0) {
+		state->num_suppressed++;
+		return false;
+	}
+
+	state->tokens--;
+	if (state->num_suppressed > 0) {
+		report_suppressed(site, index, state->num_suppressed);
+		state->num_suppressed = 0;
+	}
+	return true;
+}
+
+/*
+ * Report the messages suppressed at the calling lcore that have
+ * not been reported yet. It does so at most once every
+ * LOG_RATELIMIT_INTERVAL_MS, so the main loops of the blocks
+ * call it at every iteration.
+ */
+void
+log_ratelimit_flush(uint64_t now)
+{
+	struct log_ratelimit_lcore *lc = lcores[log_ratelimit_lcore_id()];
+	uint32_t num_states;
+	uint32_t i;
+
+	/* Nothing has been logged at this lcore yet. */
+	if (lc == NULL || now < lc->next_flush_at)
+		return;
+	lc->next_flush_at = now + LOG_RATELIMIT_INTERVAL_MS * cycles_per_ms;
+
+	num_states = RTE_MIN((uint32_t)rte_atomic32_read(&num_sites),
+		(uint32_t)LOG_RATELIMIT_MAX_SITES);
+	for (i = 0; i < num_states; i++) {
+		struct log_ratelimit_state *state = &lc->states[i];
+		const struct log_ratelimit_site *site = state->site;
+
+		if (state->num_suppressed == 0 || site == NULL)
+			continue;
+
+		report_suppressed(site, i, state->num_suppressed);
+		state->num_suppressed = 0;
+	}
+}
@@ -20,6 +20,7 @@
 
 #include <rte_log.h>
 #include <rte_debug.h>
+#include <rte_common.h>
 
 #include "gatekeeper_lpm.h"
 #include "gatekeeper_main.h"
@@ -73,6 +74,53 @@ out:
 	return ret;
 }
 
+/* The next hop of the entries returned by rte_lpm_lookup_bulk(). */
+#define LPM_NEXT_HOP_MASK (0x00FFFFFF)
+
+/* The number of IPv4 addresses looked up by each call of DPDK. */
+#define LPM_LOOKUP_BULK_SIZE (64)
+
+/*
+ * Look up @n IPv4 addresses at once, which amortizes the accesses
+ * to the LPM table over the addresses.
+ *
+ * @ips should be in network order. @next_hops[i] receives the
+ * next hop of @ips[i], or a negative number if @ips[i] misses.
+ * Misses are not logged, since they are expected under attack.
+ */
+void
+lpm_lookup_ipv4_bulk(struct rte_lpm *lpm, const uint32_t *ips,
+	int32_t *next_hops, unsigned int n)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < n; i += LPM_LOOKUP_BULK_SIZE) {
+		uint32_t host_ips[LPM_LOOKUP_BULK_SIZE];
+		uint32_t hops[LPM_LOOKUP_BULK_SIZE];
+		unsigned int num = RTE_MIN(n - i,
+			(unsigned int)LPM_LOOKUP_BULK_SIZE);
+		int ret;
+
+		for (j = 0; j < num; j++)
+			host_ips[j] = ntohl(ips[i + j]);
+
+		ret = rte_lpm_lookup_bulk(lpm, host_ips, hops, num);
+		if (unlikely(ret < 0)) {
+			RTE_LOG(ERR, LPM,
+				"lpm: incorrect arguments for IPv4 bulk lookup!\n");
+			for (j = 0; j < num; j++)
+				next_hops[i + j] = -1;
+			continue;
+		}
+
+		for (j = 0; j < num; j++) {
+			next_hops[i + j] =
+				(hops[j] & RTE_LPM_LOOKUP_SUCCESS) ?
+				(int32_t)(hops[j] & LPM_NEXT_HOP_MASK) : -1;
+		}
+	}
+}
+
 struct rte_lpm6 *
 init_ipv6_lpm(const char *tag,
 	const struct rte_lpm6_config *lpm6_conf,
@@ -120,3 +168,22 @@ lpm_lookup_ipv6(struct rte_lpm6 *lpm, uint8_t *ip)
 out:
 	return ret;
 }
+
+/*
+ * Similar to lpm_lookup_ipv4_bulk(), see above.
+ * @next_hops[i] receives -1 if @ips[i] misses.
+ */
+void
+lpm_lookup_ipv6_bulk(struct rte_lpm6 *lpm,
+	uint8_t ips[][RTE_LPM6_IPV6_ADDR_SIZE], int32_t *next_hops,
+	unsigned int n)
+{
+	unsigned int i;
+	int ret = rte_lpm6_lookup_bulk_func(lpm, ips, next_hops, n);
+	if (unlikely(ret < 0)) {
+		RTE_LOG(ERR, LPM,
+			"lpm: incorrect arguments for IPv6 bulk lookup!\n");
+		for (i = 0; i < n; i++)
+			next_hops[i] = -1;
+	}
+}
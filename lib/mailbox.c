@@ -23,6 +23,7 @@
 
 #include "gatekeeper_main.h"
 #include "gatekeeper_mailbox.h"
+#include "gatekeeper_log_ratelimit.h"
 
 /* XXX Sample parameters, need to be tested for better performance. */
 #define GK_MEM_CACHE_SIZE (64)
@@ -95,11 +96,11 @@ mb_send_entry(struct mailbox *mb, void *obj)
 {
 	int ret = rte_ring_mp_enqueue(mb->ring, obj);
 	if (ret == -EDQUOT) {
-		RTE_LOG(WARNING, RING,
+		LOG_RATELIMIT(WARNING, RING,
 			"mailbox: high water mark exceeded. The object has been enqueued.\n");
 		ret = 0;
 	} else if (ret == -ENOBUFS) {
-		RTE_LOG(ERR, RING,
+		LOG_RATELIMIT(ERR, RING,
 			"mailbox: quota exceeded. Not enough room in the ring to enqueue.\n");
 		mb_free_entry(mb, obj);
 	} else
@@ -16,6 +16,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <sys/socket.h>
@@ -36,6 +38,7 @@
 #include "gatekeeper_net.h"
 #include "gatekeeper_config.h"
 #include "gatekeeper_launch.h"
+#include "gatekeeper_bench.h"
 
 /* Number of attempts to wait for a link to come up. */
 #define NUM_ATTEMPTS_LINK_GET	(5)
@@ -489,14 +492,14 @@ get_ip_type(const char *ip_addr)
 	ret = getaddrinfo(ip_addr, NULL, &hint, &res);
     	if (ret) {
         	RTE_LOG(ERR, GATEKEEPER,
-			"gk: invalid ip address %s; %s\n",
+			"net: invalid ip address %s; %s\n",
 			ip_addr, gai_strerror(ret));
 		return AF_UNSPEC;
     	}
 
     	if (res->ai_family != AF_INET && res->ai_family != AF_INET6)
 		RTE_LOG(ERR, GATEKEEPER,
-			"gk: %s is an is unknown address format %d\n",
+			"net: %s is an is unknown address format %d\n",
 			ip_addr, res->ai_family);
 
 	ret = res->ai_family;
@@ -525,6 +528,85 @@ convert_str_to_ip(const char *ip_addr, struct ipaddr *res)
 	return 0;
 }
 
+/*
+ * Parse @ip_prefix, such as "10.0.0.0/8", into its address @res.
+ * Return the length of the prefix, or -1 on error.
+ */
+int
+parse_ip_prefix(const char *ip_prefix, struct ipaddr *res)
+{
+	/* Need to make copy to tokenize. */
+	size_t ip_prefix_len = ip_prefix != NULL ? strlen(ip_prefix) : 0;
+	char ip_prefix_copy[ip_prefix_len + 1];
+	char *ip_addr;
+
+	char *saveptr;
+	char *prefix_len_str;
+	char *end;
+	long prefix_len;
+	int ip_type;
+
+	if (ip_prefix == NULL)
+		return -1;
+
+	strncpy(ip_prefix_copy, ip_prefix, ip_prefix_len + 1);
+
+	ip_addr = strtok_r(ip_prefix_copy, "/", &saveptr);
+	if (ip_addr == NULL) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"net: failed to parse IP address in IP prefix %s at %s\n",
+			ip_prefix, __func__);
+		return -1;
+	}
+
+	ip_type = get_ip_type(ip_addr);
+	if (ip_type != AF_INET && ip_type != AF_INET6)
+		return -1;
+
+	prefix_len_str = strtok_r(NULL, "\0", &saveptr);
+	if (prefix_len_str == NULL) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"net: failed to parse prefix length in IP prefix %s at %s\n",
+			ip_prefix, __func__);
+		return -1;
+	}
+
+	prefix_len = strtol(prefix_len_str, &end, 10);
+	if (prefix_len_str == end || !*prefix_len_str || *end) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"net: prefix length \"%s\" is not a number\n",
+			prefix_len_str);
+		return -1;
+	}
+
+	if ((prefix_len == LONG_MAX || prefix_len == LONG_MIN) &&
+			errno == ERANGE) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"net: prefix length \"%s\" caused underflow or overflow\n",
+			prefix_len_str);
+		return -1;
+	}
+
+	if (prefix_len < 0 || prefix_len > max_prefix_len(ip_type)) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"net: prefix length \"%s\" is out of range\n",
+			prefix_len_str);
+		return -1;
+	}
+
+	if (convert_str_to_ip(ip_addr, res) < 0) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"net: the IP address part of the IP prefix %s is not valid\n",
+			ip_prefix);
+		return -1;
+	}
+
+	RTE_VERIFY((ip_type == AF_INET && res->proto == ETHER_TYPE_IPv4) ||
+		(ip_type == AF_INET6 && res->proto == ETHER_TYPE_IPv6));
+
+	return prefix_len;
+}
+
 int
 lua_init_iface(struct gatekeeper_if *iface, const char *iface_name,
 	const char **pci_addrs, uint8_t num_pci_addrs,
@@ -707,6 +789,9 @@ gatekeeper_setup_rss(uint16_t port_id, uint16_t *queues, uint16_t num_queues)
 	/* Get RSS redirection table (RETA) information. */
 	memset(&dev_info, 0, sizeof(dev_info));
 	rte_eth_dev_info_get(port_id, &dev_info);
+	/* The virtual devices of the benchmark have no RETA. */
+	if (dev_info.reta_size == 0 && bench_hooks != NULL)
+		return bench_hooks->setup_soft_rss(port_id, queues, num_queues);
 	if (dev_info.reta_size == 0) {
 		RTE_LOG(ERR, PORT,
 			"Failed to setup RSS at port %hhu (invalid RETA size = 0)!\n",
@@ -783,6 +868,8 @@ gatekeeper_get_rss_config(uint16_t port_id,
 	/* Get RSS redirection table (RETA) information. */
 	memset(&dev_info, 0, sizeof(dev_info));
 	rte_eth_dev_info_get(port_id, &dev_info);
+	if (dev_info.reta_size == 0 && bench_hooks != NULL)
+		return bench_hooks->get_soft_rss(port_id, rss_conf);
 	rss_conf->reta_size = dev_info.reta_size;
 	if (rss_conf->reta_size == 0 ||
 			rss_conf->reta_size > ETH_RSS_RETA_SIZE_512) {
@@ -1264,6 +1351,8 @@ gatekeeper_init_network(struct net_config *net_conf)
 	rte_convert_rss_key((uint32_t *)&default_rss_key,
 		(uint32_t *)rss_key_be, RTE_DIM(default_rss_key));
 
+	rss_ip_flow_hf_init();
+
 	/* Check port limits. */
 	num_ports = net_conf->front.num_ports +
 		(net_conf->back_iface_enabled ? net_conf->back.num_ports : 0);
@@ -0,0 +1,134 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <rte_log.h>
+#include <rte_lcore.h>
+#include <rte_cycles.h>
+
+#include "gatekeeper_main.h"
+#include "gatekeeper_profile.h"
+
+#ifdef GATEKEEPER_PROFILE_PMU
+static const uint64_t pmu_configs[PROFILE_NUM_PMU_EVENTS] = {
+	[PROFILE_PMU_CORE_CYCLES]  = PERF_COUNT_HW_CPU_CYCLES,
+	[PROFILE_PMU_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+	[PROFILE_PMU_CACHE_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+};
+
+/*
+ * Open the hardware counters of the calling thread, and map
+ * their pages so that profile_read_pmu() can read them.
+ */
+static int
+open_pmu(struct profile *prof)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	unsigned int i;
+
+	for (i = 0; i < PROFILE_NUM_PMU_EVENTS; i++) {
+		struct perf_event_attr attr;
+		struct perf_event_mmap_page *page;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = pmu_configs[i];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		prof->pmu_fds[i] = syscall(__NR_perf_event_open, &attr,
+			0, -1, -1, 0);
+		if (prof->pmu_fds[i] < 0) {
+			RTE_LOG(WARNING, GATEKEEPER,
+				"profile: cannot open hardware counter %u at lcore %u (errno=%i: %s)\n",
+				i, rte_lcore_id(), errno, strerror(errno));
+			return -1;
+		}
+
+		page = mmap(NULL, page_size, PROT_READ, MAP_SHARED,
+			prof->pmu_fds[i], 0);
+		if (page == MAP_FAILED) {
+			RTE_LOG(WARNING, GATEKEEPER,
+				"profile: cannot map hardware counter %u at lcore %u (errno=%i: %s)\n",
+				i, rte_lcore_id(), errno, strerror(errno));
+			return -1;
+		}
+		prof->pmu_pages[i] = page;
+
+		if (!page->cap_user_rdpmc) {
+			RTE_LOG(WARNING, GATEKEEPER,
+				"profile: user space cannot read hardware counter %u at lcore %u; check /sys/bus/event_source/devices/cpu/rdpmc\n",
+				i, rte_lcore_id());
+			return -1;
+		}
+
+		prof->pmu_marks[i] = profile_read_pmu(page);
+	}
+
+	return 0;
+}
+#endif
+
+/*
+ * Start the accounting of the calling lcore, which charges its
+ * phases in @stats. The hardware counters are only used when
+ * they can be opened; otherwise, only cycles are accounted.
+ */
+void
+profile_init(struct profile *prof, struct stats_lcore *stats)
+{
+	unsigned int i;
+
+	memset(prof, 0, sizeof(*prof));
+	prof->stats = stats;
+	for (i = 0; i < PROFILE_NUM_PMU_EVENTS; i++)
+		prof->pmu_fds[i] = -1;
+
+#ifdef GATEKEEPER_PROFILE_PMU
+	prof->pmu = open_pmu(prof) == 0;
+	if (!prof->pmu)
+		profile_free(prof);
+#endif
+
+	prof->mark = rte_rdtsc();
+}
+
+void
+profile_free(struct profile *prof)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	unsigned int i;
+
+	for (i = 0; i < PROFILE_NUM_PMU_EVENTS; i++) {
+		if (prof->pmu_pages[i] != NULL) {
+			munmap(prof->pmu_pages[i], page_size);
+			prof->pmu_pages[i] = NULL;
+		}
+		if (prof->pmu_fds[i] >= 0) {
+			close(prof->pmu_fds[i]);
+			prof->pmu_fds[i] = -1;
+		}
+	}
+	prof->pmu = false;
+}
@@ -0,0 +1,176 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+
+#include <rte_log.h>
+#include <rte_malloc.h>
+
+#include "gatekeeper_main.h"
+#include "gatekeeper_qsbr.h"
+
+struct qsbr_deferred {
+	struct list_head list;
+
+	/* The callback can run once all readers have seen @epoch. */
+	uint64_t         epoch;
+
+	qsbr_free_cb     cb;
+	void             *arg;
+};
+
+void
+qsbr_init(struct qsbr *qs)
+{
+	unsigned int i;
+
+	rte_atomic64_init(&qs->epoch);
+	rte_atomic64_set(&qs->epoch, 1);
+
+	for (i = 0; i < RTE_MAX_LCORE; i++)
+		qs->readers[i].epoch = 0;
+
+	rte_spinlock_init(&qs->lock);
+	INIT_LIST_HEAD(&qs->deferred);
+	qs->num_deferred = 0;
+}
+
+/*
+ * Call @cb with @arg once all readers online have gone through
+ * a quiescent state. The object must already be unreachable
+ * by readers when this function is called.
+ */
+int
+qsbr_defer(struct qsbr *qs, qsbr_free_cb cb, void *arg)
+{
+	struct qsbr_deferred *d = rte_malloc("qsbr_deferred", sizeof(*d), 0);
+	if (d == NULL) {
+		RTE_LOG(ERR, MALLOC,
+			"qsbr: failed to allocate a deferred callback at %s\n",
+			__func__);
+		return -ENOMEM;
+	}
+
+	d->cb = cb;
+	d->arg = arg;
+
+	rte_spinlock_lock(&qs->lock);
+	/*
+	 * Readers that report a quiescent state from now on
+	 * no longer hold references to the object.
+	 */
+	d->epoch = rte_atomic64_add_return(&qs->epoch, 1);
+	list_add_tail(&d->list, &qs->deferred);
+	qs->num_deferred++;
+	rte_spinlock_unlock(&qs->lock);
+
+	return 0;
+}
+
+/*
+ * Run the deferred callbacks whose grace periods are over.
+ * This function never waits for readers.
+ *
+ * The callbacks run without @qs->lock held, so they may call
+ * qsbr_defer(). Callbacks that return -EAGAIN go back to the front
+ * of the deferred callbacks, since they are older than the others.
+ *
+ * Returns the number of callbacks that are still deferred.
+ */
+unsigned int
+qsbr_reclaim(struct qsbr *qs)
+{
+	unsigned int i;
+	unsigned int num_deferred;
+	unsigned int num_freed = 0;
+	uint64_t min_epoch = UINT64_MAX;
+	struct qsbr_deferred *d, *next;
+	struct list_head expired;
+	struct list_head retry;
+
+	INIT_LIST_HEAD(&expired);
+	INIT_LIST_HEAD(&retry);
+
+	rte_spinlock_lock(&qs->lock);
+
+	if (list_empty(&qs->deferred))
+		goto out;
+
+	rte_smp_mb();
+	for (i = 0; i < RTE_MAX_LCORE; i++) {
+		uint64_t epoch = qs->readers[i].epoch;
+		if (epoch != 0 && epoch < min_epoch)
+			min_epoch = epoch;
+	}
+	rte_smp_mb();
+
+	/*
+	 * The callbacks are in increasing order of epochs. They stay
+	 * counted in @qs->num_deferred until they are freed, so
+	 * qsbr_has_deferred() does not miss them while they run.
+	 */
+	list_for_each_entry_safe(d, next, &qs->deferred, list) {
+		if (d->epoch > min_epoch)
+			break;
+		list_del(&d->list);
+		list_add_tail(&d->list, &expired);
+	}
+
+	if (list_empty(&expired))
+		goto out;
+
+	rte_spinlock_unlock(&qs->lock);
+
+	list_for_each_entry_safe(d, next, &expired, list) {
+		list_del(&d->list);
+		if (d->cb(d->arg) == -EAGAIN) {
+			list_add_tail(&d->list, &retry);
+			continue;
+		}
+		rte_free(d);
+		num_freed++;
+	}
+
+	rte_spinlock_lock(&qs->lock);
+	while (!list_empty(&retry)) {
+		d = list_last_entry(&retry, struct qsbr_deferred, list);
+		list_del(&d->list);
+		list_add(&d->list, &qs->deferred);
+	}
+	qs->num_deferred -= num_freed;
+
+out:
+	num_deferred = qs->num_deferred;
+	rte_spinlock_unlock(&qs->lock);
+	return num_deferred;
+}
+
+/* Drop the deferred callbacks without calling them. */
+void
+qsbr_destroy(struct qsbr *qs)
+{
+	struct qsbr_deferred *d, *next;
+
+	rte_spinlock_lock(&qs->lock);
+	list_for_each_entry_safe(d, next, &qs->deferred, list) {
+		list_del(&d->list);
+		rte_free(d);
+	}
+	qs->num_deferred = 0;
+	rte_spinlock_unlock(&qs->lock);
+}
@@ -0,0 +1,218 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <rte_log.h>
+#include <rte_debug.h>
+#include <rte_atomic.h>
+#include <rte_errno.h>
+#include <rte_cycles.h>
+#include <rte_memzone.h>
+
+#include "gatekeeper_main.h"
+#include "gatekeeper_stats.h"
+
+const struct stats_counter_desc stats_counters[STATS_NUM_COUNTERS] = {
+	[STATS_PKTS_RX]             = { "pkts_rx", false },
+	[STATS_TX_DROPS]            = { "tx_drops", false },
+	[STATS_GK_PKTS_REQUEST]     = { "pkts_request", false },
+	[STATS_GK_PKTS_GRANTED]     = { "pkts_granted", false },
+	[STATS_GK_PKTS_DECLINED]    = { "pkts_declined", false },
+	[STATS_GK_FLOWS]            = { "flows", true },
+	[STATS_GK_FLOW_EXPIRATIONS] = { "flow_expirations", false },
+	[STATS_GK_FLOW_EVICTIONS]   = { "flow_evictions", false },
+	[STATS_GK_FLOW_ENOSPC]      = { "flow_table_full", false },
+	[STATS_GK_FLOW_EXPIRY_ERRORS] = { "flow_expiry_errors", false },
+	[STATS_SOL_REQS_ENQUEUED]   = { "reqs_enqueued", false },
+	[STATS_SOL_REQS_SENT]       = { "reqs_sent", false },
+	[STATS_SOL_REQS_DROPPED]    = { "reqs_dropped", false },
+	[STATS_SOL_QUEUE_LEN]       = { "queue_len", true },
+	[STATS_SOL_PRIORITY_INVERSIONS] = { "priority_inversions", false },
+	[STATS_GT_DECISIONS]        = { "decisions", false },
+	[STATS_GT_LUA_ERRORS]       = { "lua_errors", false },
+	[STATS_GT_DECISION_CACHE_HITS] = { "decision_cache_hits", false },
+	[STATS_GGU_POLICIES]        = { "policies", false },
+	[STATS_CPS_PKTS_TO_KNI]     = { "pkts_to_kni", false },
+	[STATS_CPS_PKTS_FROM_KNI]   = { "pkts_from_kni", false },
+};
+
+const char *stats_block_names[STATS_NUM_BLOCKS] = {
+	[STATS_BLOCK_NONE] = "none",
+	[STATS_BLOCK_GK]   = "gk",
+	[STATS_BLOCK_GT]   = "gt",
+	[STATS_BLOCK_SOL]  = "sol",
+	[STATS_BLOCK_GGU]  = "ggu",
+	[STATS_BLOCK_LLS]  = "lls",
+	[STATS_BLOCK_CPS]  = "cps",
+};
+
+const char *stats_hist_names[STATS_NUM_HISTS] = {
+	[STATS_HIST_GK_TO_SOL] = "gk_to_sol",
+	[STATS_HIST_SOL_QUEUE] = "sol_queue",
+	[STATS_HIST_REQ_TOTAL] = "req_total",
+	[STATS_HIST_GT_POLICY] = "gt_policy",
+};
+
+const char *stats_phase_names[STATS_NUM_PHASES] = {
+	[STATS_PHASE_IDLE]          = "idle",
+	[STATS_PHASE_OTHER]         = "other",
+	[STATS_PHASE_GK_FRONT]      = "gk_front",
+	[STATS_PHASE_GK_BACK]       = "gk_back",
+	[STATS_PHASE_GK_MAILBOX]    = "gk_mailbox",
+	[STATS_PHASE_GK_FLOW_SCAN]  = "gk_flow_scan",
+	[STATS_PHASE_GT_RX]         = "gt_rx",
+	[STATS_PHASE_GT_PARSE]      = "gt_parse",
+	[STATS_PHASE_GT_REASSEMBLY] = "gt_reassembly",
+	[STATS_PHASE_GT_POLICY]     = "gt_policy",
+	[STATS_PHASE_GT_TX]         = "gt_tx",
+	[STATS_PHASE_GT_FRAG_SCAN]  = "gt_frag_scan",
+};
+
+static struct stats_shm *stats_shm;
+
+/* Reserve the memzone of the statistics. Only the primary process calls it. */
+int
+stats_init(void)
+{
+	const struct rte_memzone *mz = rte_memzone_reserve(STATS_MEMZONE_NAME,
+		sizeof(*stats_shm), SOCKET_ID_ANY, 0);
+	if (mz == NULL) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"stats: failed to reserve the memzone of the statistics (%s)\n",
+			rte_strerror(rte_errno));
+		return -1;
+	}
+
+	stats_shm = mz->addr;
+	memset(stats_shm, 0, sizeof(*stats_shm));
+	stats_shm->num_counters = STATS_NUM_COUNTERS;
+	stats_shm->num_hists = STATS_NUM_HISTS;
+	stats_shm->num_phases = STATS_NUM_PHASES;
+	stats_shm->tsc_hz = rte_get_tsc_hz();
+	/* Readers check the magic number last. */
+	rte_smp_wmb();
+	stats_shm->magic = STATS_MAGIC;
+	return 0;
+}
+
+/* Return the counters of @lcore_id, which runs the functional block @block. */
+struct stats_lcore *
+stats_register(unsigned int lcore_id, enum stats_block block)
+{
+	struct stats_lcore *stats;
+
+	RTE_VERIFY(stats_shm != NULL && lcore_id < RTE_MAX_LCORE);
+
+	stats = &stats_shm->lcores[lcore_id];
+	stats->block = block;
+	return stats;
+}
+
+/* Find the statistics of the primary process from a secondary process. */
+const struct stats_shm *
+stats_attach(void)
+{
+	const struct stats_shm *shm;
+	const struct rte_memzone *mz = rte_memzone_lookup(STATS_MEMZONE_NAME);
+	if (mz == NULL) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"stats: the memzone %s does not exist, is Gatekeeper running?\n",
+			STATS_MEMZONE_NAME);
+		return NULL;
+	}
+
+	shm = mz->addr;
+	if (shm->magic != STATS_MAGIC ||
+			shm->num_counters != STATS_NUM_COUNTERS ||
+			shm->num_hists != STATS_NUM_HISTS ||
+			shm->num_phases != STATS_NUM_PHASES) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"stats: the layout of the statistics of the running Gatekeeper does not match this binary\n");
+		return NULL;
+	}
+
+	rte_smp_rmb();
+	return shm;
+}
+
+/* Return the smallest duration, in cycles, that falls in @bucket. */
+uint64_t
+stats_hist_bucket_value(unsigned int bucket)
+{
+	unsigned int magnitude = bucket / STATS_HIST_SUB_BUCKETS;
+
+	if (magnitude == 0)
+		return bucket;
+
+	return (uint64_t)(STATS_HIST_SUB_BUCKETS +
+		bucket % STATS_HIST_SUB_BUCKETS) << (magnitude - 1);
+}
+
+/* Merge @src into @dst. */
+void
+stats_hist_add(struct stats_hist *dst, const struct stats_hist *src)
+{
+	unsigned int i;
+
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	for (i = 0; i < STATS_HIST_NUM_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+}
+
+/*
+ * Remove the durations of @src, an earlier copy of @dst, from @dst,
+ * so that @dst only holds the durations recorded since then.
+ * The maximum of @dst is kept, since it cannot be undone.
+ */
+void
+stats_hist_sub(struct stats_hist *dst, const struct stats_hist *src)
+{
+	unsigned int i;
+
+	dst->count -= src->count;
+	dst->sum -= src->sum;
+	for (i = 0; i < STATS_HIST_NUM_BUCKETS; i++)
+		dst->buckets[i] -= src->buckets[i];
+}
+
+/*
+ * Return the smallest duration of the bucket that holds
+ * the @percentile-th percentile of @hist, or zero if @hist is empty.
+ */
+uint64_t
+stats_hist_percentile(const struct stats_hist *hist, double percentile)
+{
+	uint64_t rank, seen = 0;
+	unsigned int i;
+
+	if (hist->count == 0)
+		return 0;
+
+	rank = (uint64_t)(hist->count * percentile / 100.);
+	for (i = 0; i < STATS_HIST_NUM_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen > rank)
+			return stats_hist_bucket_value(i);
+	}
+
+	return stats_hist_bucket_value(STATS_HIST_NUM_BUCKETS - 1);
+}
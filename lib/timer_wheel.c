@@ -0,0 +1,141 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <rte_log.h>
+#include <rte_common.h>
+
+#include "gatekeeper_main.h"
+#include "gatekeeper_timer_wheel.h"
+
+#define TW_EXPIRED_HEAD (TW_NUM_SLOTS)
+
+/* The farthest in the future that a node can be scheduled, in ticks. */
+#define TW_MAX_TICKS ((1ULL << (TW_LEVEL_BITS * TW_NUM_LEVELS)) - 1)
+
+int
+tw_init(struct timer_wheel *tw, void *nodes, uint32_t num_nodes,
+	size_t node_size, size_t link_offset, uint64_t cycles_per_tick,
+	uint64_t now)
+{
+	int ret;
+
+	if (cycles_per_tick == 0) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"timer_wheel: a tick must last at least one cycle!\n");
+		return -1;
+	}
+
+	ret = il_init(&tw->lists, nodes, num_nodes, node_size, link_offset,
+		tw->heads, RTE_DIM(tw->heads));
+	if (ret < 0) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"timer_wheel: too many nodes (%u)!\n", num_nodes);
+		return -1;
+	}
+
+	tw->cycles_per_tick = cycles_per_tick;
+	tw->cur_tick = now / cycles_per_tick;
+	return 0;
+}
+
+/*
+ * Schedule the node @index to expire at @expire_at (in cycles).
+ * If the node is already scheduled, it is rescheduled.
+ *
+ * A node expires at the first tick after @expire_at, so it is never
+ * reported before its deadline. Deadlines farther in the future than
+ * the wheel covers are reported early, and callers should reschedule
+ * nodes whose deadlines have not passed yet.
+ */
+void
+tw_schedule(struct timer_wheel *tw, uint32_t index, uint64_t expire_at)
+{
+	uint64_t tick = expire_at / tw->cycles_per_tick + 1;
+	uint64_t delta;
+	unsigned int level;
+
+	tw_cancel(tw, index);
+
+	if (tick <= tw->cur_tick)
+		tick = tw->cur_tick + 1;
+
+	delta = tick - tw->cur_tick;
+	if (delta > TW_MAX_TICKS) {
+		tick = tw->cur_tick + TW_MAX_TICKS;
+		delta = TW_MAX_TICKS;
+	}
+
+	for (level = 0; level < TW_NUM_LEVELS - 1; level++) {
+		if (delta < (1ULL << (TW_LEVEL_BITS * (level + 1))))
+			break;
+	}
+
+	il_add_tail(&tw->lists, level * TW_LEVEL_SIZE +
+		((tick >> (TW_LEVEL_BITS * level)) & TW_LEVEL_MASK), index);
+}
+
+/*
+ * Advance the timing wheel up to @now, and move all nodes whose ticks
+ * have passed to the list of expired nodes. The cost is constant per tick.
+ *
+ * Nodes of the upper levels are moved to the list of expired nodes
+ * when their slots are reached as well, so callers must reschedule
+ * the nodes returned by tw_pop_expired() that have not expired yet.
+ * This way the work of cascading nodes is spread over the calls of
+ * tw_pop_expired() instead of happening all at once.
+ */
+void
+tw_advance(struct timer_wheel *tw, uint64_t now)
+{
+	uint64_t now_tick = now / tw->cycles_per_tick;
+
+	while (tw->cur_tick < now_tick) {
+		uint64_t tick = ++tw->cur_tick;
+		unsigned int level;
+
+		for (level = 1; level < TW_NUM_LEVELS; level++) {
+			if ((tick & ((1ULL << (TW_LEVEL_BITS * level)) - 1))
+					!= 0)
+				break;
+			il_splice_tail(&tw->lists, TW_EXPIRED_HEAD,
+				level * TW_LEVEL_SIZE +
+				((tick >> (TW_LEVEL_BITS * level)) &
+				TW_LEVEL_MASK));
+		}
+
+		il_splice_tail(&tw->lists, TW_EXPIRED_HEAD,
+			tick & TW_LEVEL_MASK);
+	}
+}
+
+/*
+ * Remove the first node from the list of expired nodes.
+ *
+ * Returns the index of the node, or -1 if the list is empty.
+ */
+int
+tw_pop_expired(struct timer_wheel *tw)
+{
+	int64_t index = il_first(&tw->lists, TW_EXPIRED_HEAD);
+
+	if (index < 0)
+		return -1;
+
+	il_del(&tw->lists, index);
+	return index;
+}
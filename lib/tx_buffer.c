@@ -0,0 +1,118 @@
+/*
+ * Gatekeeper - DoS protection system.
+ * Copyright (C) 2016 Digirati LTDA.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <inttypes.h>
+
+#include <rte_log.h>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+
+#include "gatekeeper_tx_buffer.h"
+
+void
+txb_init(struct tx_buffer *txb, uint16_t port, uint16_t queue)
+{
+	txb->port = port;
+	txb->queue = queue;
+	txb->len = 0;
+	txb->flush_threshold = GATEKEEPER_MAX_PKT_BURST;
+	txb->drain_cycles = TX_BUFFER_DRAIN_US * rte_get_tsc_hz() / 1000000;
+	txb->last_flush_at = rte_rdtsc();
+	txb->num_sent = 0;
+	txb->num_dropped = 0;
+	txb->num_retries = 0;
+}
+
+/*
+ * Send the packets in the buffer. The packets that the NIC
+ * does not accept stay in the buffer for the next flush.
+ *
+ * Returns the number of packets sent.
+ */
+uint16_t
+txb_flush(struct tx_buffer *txb)
+{
+	uint16_t num_sent;
+
+	txb->last_flush_at = rte_rdtsc();
+
+	if (txb->len == 0)
+		return 0;
+
+	num_sent = rte_eth_tx_burst(txb->port, txb->queue,
+		txb->pkts, txb->len);
+	txb->num_sent += num_sent;
+
+	if (unlikely(num_sent < txb->len)) {
+		txb->len -= num_sent;
+		memmove(txb->pkts, txb->pkts + num_sent,
+			txb->len * sizeof(txb->pkts[0]));
+		txb->num_retries++;
+	} else
+		txb->len = 0;
+
+	return num_sent;
+}
+
+/*
+ * Add packets to the buffer, and flush it once it reaches
+ * its threshold. When the backlog is full, and the NIC does
+ * not accept more packets, the remaining packets are dropped.
+ */
+void
+txb_add_bulk(struct tx_buffer *txb, struct rte_mbuf **pkts,
+	uint16_t num_pkts)
+{
+	uint16_t i;
+
+	for (i = 0; i < num_pkts; i++) {
+		if (unlikely(txb->len >= TX_BUFFER_SIZE)) {
+			txb_flush(txb);
+			if (txb->len >= TX_BUFFER_SIZE)
+				break;
+		}
+		txb->pkts[txb->len++] = pkts[i];
+	}
+
+	if (unlikely(i < num_pkts)) {
+		txb->num_dropped += num_pkts - i;
+		for (; i < num_pkts; i++)
+			rte_pktmbuf_free(pkts[i]);
+	}
+
+	if (txb->len >= txb->flush_threshold)
+		txb_flush(txb);
+}
+
+/* Drop the packets left in the buffer, and log its counters. */
+void
+txb_free(struct tx_buffer *txb, const char *block)
+{
+	uint16_t i;
+
+	for (i = 0; i < txb->len; i++)
+		rte_pktmbuf_free(txb->pkts[i]);
+	txb->num_dropped += txb->len;
+	txb->len = 0;
+
+	RTE_LOG(NOTICE, GATEKEEPER,
+		"%s: TX queue %hu of port %hu sent %" PRIu64 " packets, dropped %" PRIu64 " packets, and had %" PRIu64 " partial flushes\n",
+		block, txb->queue, txb->port, txb->num_sent,
+		txb->num_dropped, txb->num_retries);
+}
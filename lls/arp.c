@@ -22,6 +22,7 @@
 
 #include "arp.h"
 #include "cache.h"
+#include "gatekeeper_log_ratelimit.h"
 
 int
 iface_arp_enabled(struct net_config *net, struct gatekeeper_if *iface)
@@ -133,7 +134,7 @@ process_arp(struct lls_config *lls_conf, struct gatekeeper_if *iface,
 	int ret;
 
 	if (pkt_len < l2_len + sizeof(*arp_hdr)) {
-		RTE_LOG(ERR, GATEKEEPER, "lls: %s interface received ARP packet of size %hu bytes, but it should be at least %zu bytes\n",
+		LOG_RATELIMIT(ERR, GATEKEEPER, "lls: %s interface received ARP packet of size %hu bytes, but it should be at least %zu bytes\n",
 			iface->name, pkt_len,
 			l2_len + sizeof(*arp_hdr));
 		return -1;
@@ -210,7 +211,7 @@ process_arp(struct lls_config *lls_conf, struct gatekeeper_if *iface,
 		 */
 		return -1;
 	default:
-		RTE_LOG(NOTICE, GATEKEEPER, "lls: %s received an ARP packet with an unknown operation (%hu)\n",
+		LOG_RATELIMIT(NOTICE, GATEKEEPER, "lls: %s received an ARP packet with an unknown operation (%hu)\n",
 			__func__, rte_be_to_cpu_16(arp_hdr->arp_op));
 		return -1;
 	}
@@ -24,6 +24,7 @@
 #include "gatekeeper_config.h"
 #include "gatekeeper_launch.h"
 #include "gatekeeper_lls.h"
+#include "gatekeeper_log_ratelimit.h"
 #include "gatekeeper_varip.h"
 #include "arp.h"
 #include "cache.h"
@@ -257,7 +258,7 @@ match_nd(struct rte_mbuf *pkt, struct gatekeeper_if *iface)
 		return -ENOENT;
 
 	if (pkt->data_len < ND_NEIGH_PKT_MIN_LEN(l2_len)) {
-		RTE_LOG(NOTICE, GATEKEEPER, "lls: ND packet received is %"PRIx16" bytes but should be at least %lu bytes in %s\n",
+		LOG_RATELIMIT(NOTICE, GATEKEEPER, "lls: ND packet received is %"PRIx16" bytes but should be at least %lu bytes in %s\n",
 			pkt->data_len, ND_NEIGH_PKT_MIN_LEN(l2_len), __func__);
 		return -ENOENT;
 	}
@@ -280,7 +281,7 @@ match_nd(struct rte_mbuf *pkt, struct gatekeeper_if *iface)
 
 	if (pkt->data_len < (ND_NEIGH_PKT_MIN_LEN(l2_len) +
 			nd_offset - sizeof(*ip6hdr))) {
-		RTE_LOG(NOTICE, GATEKEEPER, "lls: ND packet received is %"PRIx16" bytes but should be at least %lu bytes in %s\n",
+		LOG_RATELIMIT(NOTICE, GATEKEEPER, "lls: ND packet received is %"PRIx16" bytes but should be at least %lu bytes in %s\n",
 			pkt->data_len, ND_NEIGH_PKT_MIN_LEN(l2_len) +
 			nd_offset - sizeof(*ip6hdr), __func__);
 		return -ENOENT;
@@ -340,6 +341,8 @@ process_pkts(struct lls_config *lls_conf, struct gatekeeper_if *iface,
 	int num_tx = 0;
 	uint16_t i;
 
+	stats_add(lls_conf->stats, STATS_PKTS_RX, num_rx);
+
 	for (i = 0; i < num_rx; i++) {
 		struct ether_hdr *eth_hdr = rte_pktmbuf_mtod(bufs[i],
 			struct ether_hdr *);
@@ -388,7 +391,7 @@ process_pkts(struct lls_config *lls_conf, struct gatekeeper_if *iface,
 			 */
 
 		default:
-			RTE_LOG(ERR, GATEKEEPER, "lls: %s interface should not be seeing a packet with EtherType 0x%04hx\n",
+			LOG_RATELIMIT(ERR, GATEKEEPER, "lls: %s interface should not be seeing a packet with EtherType 0x%04hx\n",
 				iface->name, ether_type);
 			goto free_buf;
 		}
@@ -411,7 +414,11 @@ lls_proc(void *arg)
 		"lls: the LLS block is running at lcore = %u\n",
 		lls_conf->lcore_id);
 
+	lls_conf->stats = stats_register(lls_conf->lcore_id, STATS_BLOCK_LLS);
+
 	while (likely(!exiting)) {
+		log_ratelimit_flush(rte_rdtsc());
+
 		/* Read in packets on front and back interfaces. */
 		int num_tx = process_pkts(lls_conf, front,
 			lls_conf->rx_queue_front, lls_conf->tx_queue_front);
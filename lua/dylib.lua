@@ -29,6 +29,9 @@ ffi.cdef[[
 int add_fib_entry(const char *prefix, const char *gt_ip, const char *gw_ip,
 	enum gk_fib_action action, struct gk_config *gk_conf);
 int del_fib_entry(const char *ip_prefix, struct gk_config *gk_conf);
+int begin_fib_bulk_load(struct gk_config *gk_conf);
+int commit_fib_bulk_load(struct gk_config *gk_conf);
+int abort_fib_bulk_load(struct gk_config *gk_conf);
 
 ]]
 
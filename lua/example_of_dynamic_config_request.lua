@@ -73,4 +73,24 @@ if ret < 0 then
 	return "gk: failed to delete an FIB entry\n"
 end
 
+-- Replace all FIB entries at once, for example, to load a full routing table.
+-- The GK blocks keep using the current FIB entries until the commit.
+ret = dylib.c.begin_fib_bulk_load(dyc.gk)
+if ret < 0 then
+	return "gk: failed to begin a bulk load of the FIB\n"
+end
+
+ret = dylib.c.add_fib_entry("187.73.40.0/30", "128.197.40.100",
+	"10.0.1.253", dylib.c.GK_FWD_GRANTOR, dyc.gk)
+if ret < 0 then
+	dylib.c.abort_fib_bulk_load(dyc.gk)
+	return "gk: failed to add an FIB entry\n"
+end
+
+ret = dylib.c.commit_fib_bulk_load(dyc.gk)
+if ret < 0 then
+	dylib.c.abort_fib_bulk_load(dyc.gk)
+	return "gk: failed to commit a bulk load of the FIB\n"
+end
+
 return "gk: successfully processed all the FIB entries\n"
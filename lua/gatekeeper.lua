@@ -140,7 +140,8 @@ struct gk_config {
 	unsigned int max_num_ipv6_neighbors;
 	unsigned int gk_max_num_ipv4_fib_entries;
 	unsigned int gk_max_num_ipv6_fib_entries;
-	unsigned int flow_table_full_scan_ms;
+	unsigned int flow_expiry_tick_ms;
+	unsigned int latency_sample_period;
 	/* This struct has hidden fields. */
 };
 
@@ -166,6 +167,10 @@ struct gt_config {
 	uint32_t     frag_bucket_entries;
 	uint32_t     frag_max_entries;
 	uint32_t     frag_max_flow_ttl_ms;
+	uint32_t     latency_sample_period;
+	uint32_t     notify_max_delay_us;
+	uint32_t     decision_cache_size;
+	uint32_t     decision_cache_ttl_ms;
 	/* This struct has hidden fields. */
 };
 
@@ -183,11 +188,14 @@ struct dynamic_config {
 };
 
 struct sol_config {
-	unsigned int lcore_id;
 	unsigned int pri_req_max_len;
 	double       req_bw_rate;
 	unsigned int enq_burst_size;
 	unsigned int deq_burst_size;
+	double       req_bw_rate_min;
+	double       req_bw_rate_max;
+	double       grantor_headroom_target;
+	unsigned int feedback_period_ms;
 	/* This struct has hidden fields. */
 };
 
@@ -30,16 +30,23 @@ function gatekeeper_init()
 	local gt_conf
 
 	if gatekeeper_server == true then
-		-- n_lcores + 2 on same NUMA: for GK-GT Unit and Solicitor.
+		-- n_lcores + n_sol_lcores + 1 on same NUMA:
+		-- for GK-GT Unit and Solicitor. Raise n_sol_lcores
+		-- when a single Solicitor lcore cannot keep up with
+		-- the request channel.
 		local n_lcores = 2
+		local n_sol_lcores = 1
 		local gk_lcores =
 			gatekeeper.alloc_lcores_from_same_numa(numa_table,
-				n_lcores + 2)
-		local sol_lcore = table.remove(gk_lcores)
+				n_lcores + n_sol_lcores + 1)
+		local sol_lcores = {}
+		for i = 1, n_sol_lcores do
+			table.insert(sol_lcores, table.remove(gk_lcores))
+		end
 		local ggu_lcore = table.remove(gk_lcores)
 
 		local solf = require("sol")
-		local sol_conf = solf(net_conf, sol_lcore)
+		local sol_conf = solf(net_conf, sol_lcores)
 
 		local gkf = require("gk")
 		gk_conf = gkf(net_conf, sol_conf, gk_lcores)
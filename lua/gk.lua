@@ -23,8 +23,12 @@ return function (net_conf, sol_conf, gk_lcores)
 	gk_conf.gk_max_num_ipv4_fib_entries = 256
 	gk_conf.gk_max_num_ipv6_fib_entries = 65536
 
-	-- Scan the whole flow table in 10 minutes.
-	gk_conf.flow_table_full_scan_ms = 10 * 60 * 1000
+	-- Granularity of the expiration of flow entries.
+	gk_conf.flow_expiry_tick_ms = 1
+
+	-- Sample one in this many requests for the latency
+	-- histograms of gkstat; 0 disables the sampling.
+	gk_conf.latency_sample_period = 0
 
 	--
 	-- Code below this point should not need to be changed.
@@ -26,6 +26,20 @@ return function (net_conf, numa_table)
 
 	gt_conf.max_num_ipv6_neighbors = 1024
 
+	-- Sample one in this many policy decisions for the latency
+	-- histograms of gkstat; 0 disables the sampling.
+	gt_conf.latency_sample_period = 0
+
+	-- Maximum delay of policy decisions so they are sent together
+	-- to each Gatekeeper server; 0 sends them after each burst.
+	gt_conf.notify_max_delay_us = 100
+
+	-- Cache of recent decisions of each GT instance, which answers
+	-- retransmitted requests without running the Lua policy.
+	-- The size must be a power of 2; 0 disables the cache.
+	gt_conf.decision_cache_size = 4096
+	gt_conf.decision_cache_ttl_ms = 100
+
 	-- Setup the GT functional block.
 	local ret = gatekeeper.c.run_gt(net_conf, gt_conf)
 	if ret < 0 then
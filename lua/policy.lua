@@ -1,111 +1,178 @@
 local policylib = require("policylib")
 local ffi = require("ffi")
 
-GLOBAL_POLICIES = {}
-
-local default = {
-    	["params"] = {
-        	["tx_rate_kb_sec"] = 10,
-        	["cap_expire_sec"] = 10,
-		["next_renewal_ms"] = 10,
-		["renewal_step_ms"] = 10,
-        	["action"] = policylib.c.GK_GRANTED,
-    	},
-}
-
 --[[
-The following defines the simple policies without LPM for Grantor.
-
-General format of the simple policies should be:
-	IPv4 tables.
-	IPv6 tables.
-
-Here, I assume that each group has specific capability parameters,
-including speed limit, expiration time, actions - DENY or ACCEPT, etc.
+The groups of flows of the policy. Each group has the decision
+applied to its flows, that is, an action - GK_GRANTED or GK_DECLINED -
+and its capability parameters, such as speed limit and expiration time.
 --]]
 
-local IPV4 = policylib.c.IPV4
+local DEFAULT_GROUP = 0
+local WEB_GROUP = 1
 
-local group1 = {
-    	["params"] = {
-        	["tx_rate_kb_sec"] = 20,
-        	["cap_expire_sec"] = 20,
+local groups = {
+	[DEFAULT_GROUP] = {
+		["action"] = policylib.c.GK_GRANTED,
+		["tx_rate_kb_sec"] = 10,
+		["cap_expire_sec"] = 10,
+		["next_renewal_ms"] = 10,
+		["renewal_step_ms"] = 10,
+	},
+	[WEB_GROUP] = {
+		["action"] = policylib.c.GK_GRANTED,
+		["tx_rate_kb_sec"] = 20,
+		["cap_expire_sec"] = 20,
 		["next_renewal_ms"] = 20,
 		["renewal_step_ms"] = 20,
-        	["action"] = policylib.c.GK_GRANTED,
-    	},
-}
-
-local groups = {
-	[1] = group1,
-	[255] = default,
+	},
 }
 
-local simple_policies = {
-	[IPV4] = {
-		{
-			{
-				["dest_port"] = 80,
-    				["policy_id"] = groups[1],
-			},
-		},
+--[[
+The rules that map requests to groups. A request goes to the group of:
+	1. the longest source prefix that matches it;
+	2. otherwise, the port rule of the longest destination prefix
+	   that matches it;
+	3. otherwise, that destination prefix;
+	4. otherwise, the port rule of any destination;
+	5. otherwise, DEFAULT_GROUP.
+
+Sources have the format { prefix, group }, destinations have the format
+{ prefix, group, ports }, and ports have the format { proto, port, group }.
+--]]
+local rules = {
+	["src"] = {
+	},
+	["dst"] = {
+	},
+	["ports"] = {
+		{ policylib.c.TCP, 80, WEB_GROUP },
+		{ policylib.c.UDP, 80, WEB_GROUP },
 	},
 }
 
-GLOBAL_POLICIES["simple_policy"] = simple_policies
-
--- Function that looks up the simple policy for the packet.
-local function lookup_simple_policy(policies, pkt_info)
-
-	local dest_port
-	local ph = ffi.cast("struct gt_packet_headers *", pkt_info)
-
-	-- TODO The Lua policy should be responsible for
-	-- checking the necessary space for each l4 header type.
-	if ph.l4_proto == policylib.c.TCP then
-		local tcphdr = ffi.cast("struct tcp_hdr *", fields.l4_hdr)
-		dest_port = tcphdr.dst_port
-	elseif ph.l4_proto == policylib.c.UDP then
-		local udphdr = ffi.cast("struct udp_hdr *", fields.l4_hdr)
-		dest_port = udphdr.dst_port
-	else
-		-- TODO Add support for other transport protocols.
-		return nil
+--[[
+The rules are compiled into a policy table in C, so the cost of
+looking up a request does not depend on the number of rules.
+--]]
+local function new_tbl(groups, rules)
+	local num_groups = 0
+	for id, _ in pairs(groups) do
+		num_groups = math.max(num_groups, id + 1)
+	end
+
+	local num_prefixes = #rules["src"] + #rules["dst"]
+	local num_ports = #rules["ports"]
+	for _, dst in ipairs(rules["dst"]) do
+		num_ports = num_ports + #(dst[3] or {})
 	end
 
-	for i, v in ipairs(policies[ph.inner_ip_ver]) do
-		for j, g in ipairs(v) do
-			if g["dest_port"] == dest_port then
-				return g["policy_id"]
+	local config = ffi.new("struct policy_tbl_config", {
+		lcore_id = GT_LCORE_ID,
+		max_num_ipv4_rules = math.max(num_prefixes, 1),
+		num_ipv4_tbl8s = math.max(num_prefixes, 1),
+		max_num_ipv6_rules = math.max(num_prefixes, 1),
+		num_ipv6_tbl8s = math.max(num_prefixes, 1),
+		max_num_port_rules = num_ports,
+		num_groups = num_groups,
+		default_group = DEFAULT_GROUP,
+	})
+	local tbl = policylib.new_policy_tbl(config)
+
+	for id, group in pairs(groups) do
+		local decision = ffi.new("struct ggu_policy")
+		decision.state = group["action"]
+		if decision.state == policylib.c.GK_DECLINED then
+			decision.params.u.declined.expire_sec =
+				group["expire_sec"]
+		else
+			decision.params.u.granted.tx_rate_kb_sec =
+				group["tx_rate_kb_sec"]
+			decision.params.u.granted.cap_expire_sec =
+				group["cap_expire_sec"]
+			decision.params.u.granted.next_renewal_ms =
+				group["next_renewal_ms"]
+			decision.params.u.granted.renewal_step_ms =
+				group["renewal_step_ms"]
+		end
+		if policylib.c.policy_tbl_set_group(tbl, id, decision) < 0 then
+			error("Failed to set group " .. id)
+		end
+	end
+
+	local function add_ports(dst, ports)
+		for _, p in ipairs(ports) do
+			if policylib.c.policy_tbl_add_port(tbl, dst,
+					p[1], p[2], p[3]) < 0 then
+				error("Failed to add port rule " .. p[1] ..
+					"/" .. p[2])
 			end
 		end
 	end
 
+	for _, src in ipairs(rules["src"]) do
+		if policylib.c.policy_tbl_add_src(tbl, src[1], src[2]) < 0 then
+			error("Failed to add source prefix " .. src[1])
+		end
+	end
+
+	for _, dst in ipairs(rules["dst"]) do
+		local id = policylib.c.policy_tbl_add_dst(tbl, dst[1], dst[2])
+		if id < 0 then
+			error("Failed to add destination prefix " .. dst[1])
+		end
+		add_ports(id, dst[3] or {})
+	end
+
+	add_ports(policylib.POLICY_TBL_ANY_DST, rules["ports"])
+
+	return tbl
+end
+
+local tbl = new_tbl(groups, rules)
+
+--[[
+Hook for logic that rules cannot express. It returns the group of
+the request, or nil to look the request up in the policy table.
+The flow of the request is in ph.flow, with its fields in host order;
+for example, ph.flow.tcp_flags and ph.flow.l3_len.
+--]]
+local function lookup_custom_group(ph)
 	return nil
 end
 
+local function decide_policy(ph, pl)
+	local group = lookup_custom_group(ph)
+	if group == nil then
+		group = policylib.c.policy_tbl_lookup(tbl, ph)
+	end
+
+	if group < 0 or policylib.c.policy_tbl_fill(tbl, group, pl) < 0 then
+		if policylib.c.policy_tbl_fill(tbl, DEFAULT_GROUP, pl) < 0 then
+			-- Leave the request undecided; GT drops it.
+			pl.state = policylib.c.GK_REQUEST
+		end
+	end
+end
+
 function lookup_policy(pkt_info, policy)
 	local ph = ffi.cast("struct gt_packet_headers *",pkt_info)
 	local pl = ffi.cast("struct ggu_policy *", policy)
+	decide_policy(ph, pl)
+end
+
+--[[
+When this function is defined, GT calls it once per burst of packets
+instead of calling lookup_policy() once per packet. It receives arrays
+of @num_pkts packet headers and policies, indexed from 0, and decides
+each policy. Policies left in state GK_REQUEST are not decided, and
+their packets are dropped.
+--]]
+function lookup_policy_burst(pkt_infos, policies, num_pkts)
+	local phs = ffi.cast("struct gt_packet_headers *", pkt_infos)
+	local pls = ffi.cast("struct ggu_policy *", policies)
 
-	-- Lookup the simple policy.
-	local group = lookup_simple_policy(GLOBAL_POLICIES["simple_policy"], ph)
-	if group == nil then group = default end
-
-	pl.state = group["params"]["action"]
-
-	if pl.state == policylib.c.GK_DECLINED then
-		pl.params.u.declined.expire_sec =
-			group["params"]["expire_sec"]
-	else
-		pl.params.u.granted.tx_rate_kb_sec =
-			group["params"]["tx_rate_kb_sec"]
-		pl.params.u.granted.cap_expire_sec =
-			group["params"]["cap_expire_sec"]
-		pl.params.u.granted.next_renewal_ms =
-			group["params"]["next_renewal_ms"]
-		pl.params.u.granted.renewal_step_ms =
-			group["params"]["renewal_step_ms"]
+	for i = 0, num_pkts - 1 do
+		decide_policy(phs + i, pls + i)
 	end
 end
 
@@ -63,16 +63,52 @@ struct udp_hdr {
 	uint16_t dgram_cksum;
 } __attribute__((__packed__));
 
+struct gt_flow_desc {
+	union {
+		struct {
+			uint32_t src;
+			uint32_t dst;
+		} v4;
+
+		struct {
+			uint8_t src[16];
+			uint8_t dst[16];
+		} v6;
+	} addr;
+
+	uint16_t src_port;
+	uint16_t dst_port;
+	uint16_t l3_len;
+	uint16_t l4_len;
+	uint8_t proto;
+	uint8_t tcp_flags;
+	uint8_t dscp;
+	uint8_t reserved;
+};
+
 struct gt_packet_headers {
 	uint16_t outer_ethertype;
 	uint16_t inner_ip_ver;
 	uint8_t l4_proto;
+	uint8_t priority;
+	uint8_t outer_ecn;
 
 	void *l2_hdr;
 	void *outer_l3_hdr;
 	void *inner_l3_hdr;
 	void *l4_hdr;
-	/* This struct has hidden fields. */
+
+	/* Flow of the request, in host order. */
+	struct gt_flow_desc flow;
+
+	/*
+	 * The fields below are for internal use. They are declared
+	 * so that lookup_policy_burst() can index arrays of headers.
+	 */
+	bool frag;
+	uint32_t l2_outer_l3_len;
+	uint32_t inner_l3_len;
+	void *frag_hdr;
 };
 
 struct ip_flow {
@@ -111,6 +147,50 @@ struct ggu_policy {
 	}__attribute__((packed)) params;
 };
 
+struct policy_tbl_config {
+	unsigned int lcore_id;
+	uint32_t     max_num_ipv4_rules;
+	uint32_t     num_ipv4_tbl8s;
+	uint32_t     max_num_ipv6_rules;
+	uint32_t     num_ipv6_tbl8s;
+	uint32_t     max_num_port_rules;
+	uint32_t     num_groups;
+	uint32_t     default_group;
+};
+
+struct policy_tbl;
+
+]]
+
+-- Functions and wrappers
+ffi.cdef[[
+
+struct policy_tbl *policy_tbl_create(const struct policy_tbl_config *config);
+void policy_tbl_destroy(struct policy_tbl *tbl);
+int policy_tbl_set_group(struct policy_tbl *tbl, uint32_t group,
+	const struct ggu_policy *decision);
+int policy_tbl_add_src(struct policy_tbl *tbl, const char *prefix,
+	uint32_t group);
+int policy_tbl_add_dst(struct policy_tbl *tbl, const char *prefix,
+	uint32_t group);
+int policy_tbl_add_port(struct policy_tbl *tbl, int dst, uint8_t proto,
+	uint16_t port, uint32_t group);
+int policy_tbl_lookup(const struct policy_tbl *tbl,
+	const struct gt_packet_headers *pkt_info);
+int policy_tbl_fill(const struct policy_tbl *tbl, uint32_t group,
+	struct ggu_policy *policy);
+
 ]]
 
 c = ffi.C
+
+POLICY_TBL_ANY_DST = 0
+
+-- Create a policy table that is destroyed when it is garbage collected.
+function new_policy_tbl(config)
+	local tbl = c.policy_tbl_create(config)
+	if tbl == nil then
+		error("Failed to create a policy table")
+	end
+	return ffi.gc(tbl, c.policy_tbl_destroy)
+end
@@ -1,4 +1,4 @@
-return function (net_conf, lcore)
+return function (net_conf, sol_lcores)
 
 	-- Init the Solicitor configuration structure.
 	local sol_conf = gatekeeper.c.alloc_sol_conf()
@@ -6,9 +6,21 @@ return function (net_conf, lcore)
 		error("Failed to allocate sol_conf")
 	end
 
-	sol_conf.lcore_id = lcore
+	gatekeeper.sol_assign_lcores(sol_conf, sol_lcores)
+
+	-- Each Solicitor instance has its own priority queue of
+	-- this length, and the request bandwidth is split among
+	-- the instances.
 	sol_conf.pri_req_max_len = 1024
 	sol_conf.req_bw_rate = 0.05
+	-- The request bandwidth of each Grantor follows the headroom
+	-- that the Grantor reports within these bounds, which cannot
+	-- exceed req_bw_rate. Set both bounds to zero to give every
+	-- Grantor the whole request bandwidth.
+	sol_conf.req_bw_rate_min = 0.005
+	sol_conf.req_bw_rate_max = 0.05
+	sol_conf.grantor_headroom_target = 0.2
+	sol_conf.feedback_period_ms = 10
 	-- These values should likely be set in accordance with
 	-- GATEKEEPER_MAX_PKT_BURST and should be tested to find
 	-- optimal values.
@@ -33,10 +33,15 @@
 #include "gatekeeper_config.h"
 #include "gatekeeper_net.h"
 #include "gatekeeper_launch.h"
+#include "gatekeeper_stats.h"
+#include "gatekeeper_bench.h"
 
 /* Indicates whether the program needs to exit or not. */
 volatile int exiting = false;
 
+/* Set by bench/bench.c when Gatekeeper runs as the benchmark. */
+const struct bench_hooks *bench_hooks;
+
 /*
  * These metrics are system dependent, and 
  * initialized via time_resolution_init() function.
@@ -134,6 +139,8 @@ main(int argc, char **argv)
 	int ret = rte_eal_init(argc, argv);
 	if (ret < 0)
 		rte_exit(EXIT_FAILURE, "Error with EAL initialization!\n");
+	argc -= ret;
+	argv += ret;
 
 	/* XXX Set the global log level. Change it as needed. */
 	rte_log_set_global_level(RTE_LOG_DEBUG);
@@ -154,6 +161,18 @@ main(int argc, char **argv)
 	if (ret < 0)
 		goto out;
 
+	/* The statistics are kept until the process exits. */
+	ret = stats_init();
+	if (ret < 0)
+		goto out;
+
+	/* The devices of the benchmark must exist before the network. */
+	if (bench_hooks != NULL) {
+		ret = bench_hooks->init(argc, argv);
+		if (ret < 0)
+			goto out;
+	}
+
 	ret = config_gatekeeper();
 	if (ret < 0) {
 		RTE_LOG(ERR, GATEKEEPER, "Failed to configure Gatekeeper!\n");
@@ -174,7 +193,16 @@ main(int argc, char **argv)
 	if (ret < 0)
 		exiting = true;
 
+	if (bench_hooks != NULL) {
+		if (ret >= 0)
+			ret = bench_hooks->run();
+		exiting = true;
+	}
+
 	rte_eal_mp_wait_lcore();
+
+	if (bench_hooks != NULL && ret >= 0)
+		bench_hooks->report();
 net:
 	gatekeeper_free_network();
 out:
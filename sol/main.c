@@ -17,146 +17,298 @@
  */
 
 #include <math.h>
+#include <arpa/inet.h>
 
+#include <rte_errno.h>
 #include <rte_sched.h>
 
+#include "gatekeeper_ggu.h"
 #include "gatekeeper_gk.h"
 #include "gatekeeper_launch.h"
 #include "gatekeeper_sol.h"
+#include "gatekeeper_log_ratelimit.h"
 
 /*
  * Gatekeeper request priority queue implementation.
  *
- * To implement the request priority queue, we maintain a linked list of
- * packets listed in order of highest priority to lowest priority. We keep
- * an array where each index represents a priority, and each element of
- * that array holds a reference to the last packet of that priority.
- * This allows us to quickly insert new packets of any priority into
- * the linked list and drop the packet of lowest priority if necessary.
+ * The requests are kept in a sub-queue per Grantor, so that a flood
+ * of requests to a Grantor cannot starve the requests to the other
+ * Grantors. The Grantors with requests are served with deficit round
+ * robin, each within its own request bandwidth, under the token bucket
+ * of the whole queue.
+ *
+ * A sub-queue keeps a FIFO of requests for each priority, and a bitmap
+ * of the priorities whose FIFOs are not empty. The highest and lowest
+ * priorities of a sub-queue are the most and least significant bits
+ * set in its bitmap, so enqueueing a request, dequeueing the request
+ * of highest priority, and dropping a request of lowest priority
+ * take constant time.
+ *
+ * The FIFOs are doubly linked lists of slots taken from a single
+ * array. Since the queue never holds more than @pri_req_max_len
+ * requests, the array has @pri_req_max_len slots.
  */
 
-static void
-insert_new_priority_req(struct req_queue *req_queue, struct priority_req *pr,
-	uint8_t priority)
+static inline uint8_t
+grantor_queue_highest_priority(const struct sol_grantor_queue *gq)
+{
+	return 63 - __builtin_clzll(gq->occupied);
+}
+
+static inline uint8_t
+grantor_queue_lowest_priority(const struct sol_grantor_queue *gq)
 {
-	uint8_t next;
+	return __builtin_ctzll(gq->occupied);
+}
 
-	/* This should be the first request of @priority. */
-	RTE_VERIFY(req_queue->priorities[priority] == NULL);
+/* Append the Grantor to the list of active Grantors. */
+static inline void
+activate_grantor(struct req_queue *req_queue, uint16_t grantor_id)
+{
+	struct sol_grantor_queue *gq = &req_queue->grantors[grantor_id];
+
+	gq->active = true;
+	gq->prev_active = req_queue->active_tail;
+	gq->next_active = SOL_GRANTOR_NONE;
+	if (req_queue->active_tail == SOL_GRANTOR_NONE)
+		req_queue->active_head = grantor_id;
+	else
+		req_queue->grantors[req_queue->active_tail].next_active =
+			grantor_id;
+	req_queue->active_tail = grantor_id;
+	req_queue->num_active++;
+}
 
-	req_queue->priorities[priority] = pr;
+/* Remove the Grantor from the list of active Grantors. */
+static inline void
+deactivate_grantor(struct req_queue *req_queue, uint16_t grantor_id)
+{
+	struct sol_grantor_queue *gq = &req_queue->grantors[grantor_id];
+
+	if (req_queue->active_head == grantor_id)
+		req_queue->turn_started = false;
+
+	if (gq->prev_active == SOL_GRANTOR_NONE)
+		req_queue->active_head = gq->next_active;
+	else
+		req_queue->grantors[gq->prev_active].next_active =
+			gq->next_active;
+
+	if (gq->next_active == SOL_GRANTOR_NONE)
+		req_queue->active_tail = gq->prev_active;
+	else
+		req_queue->grantors[gq->next_active].prev_active =
+			gq->prev_active;
+
+	/* An empty Grantor does not keep its deficit. */
+	gq->deficit_bytes = 0;
+	gq->active = false;
+	req_queue->num_active--;
+}
 
-	/* This is the first packet in the queue. */
-	if (req_queue->len == 0) {
-		list_add(&pr->list, &req_queue->head);
-		req_queue->highest_priority = priority;
-		req_queue->lowest_priority = priority;
-		return;
-	}
+/* Move the Grantor whose turn is over to the end of the round. */
+static inline void
+end_grantor_turn(struct req_queue *req_queue)
+{
+	uint16_t grantor_id = req_queue->active_head;
+	struct sol_grantor_queue *gq = &req_queue->grantors[grantor_id];
 
-	/* Not the first packet, but still insert at the head of the queue. */
-	if (priority > req_queue->highest_priority) {
-		list_add(&pr->list, &req_queue->head);
-		req_queue->highest_priority = priority;
+	req_queue->turn_started = false;
+	if (gq->next_active == SOL_GRANTOR_NONE)
 		return;
-	}
 
-	/*
-	 * Insert in middle or end of queue.
-	 */
+	req_queue->active_head = gq->next_active;
+	req_queue->grantors[req_queue->active_head].prev_active =
+		SOL_GRANTOR_NONE;
 
-	if (priority < req_queue->lowest_priority)
-		req_queue->lowest_priority = priority;
+	gq->prev_active = req_queue->active_tail;
+	gq->next_active = SOL_GRANTOR_NONE;
+	req_queue->grantors[req_queue->active_tail].next_active = grantor_id;
+	req_queue->active_tail = grantor_id;
+}
 
-	/*
-	 * This function only inserts a request for a priority that
-	 * does not currently exist, and there is at least one
-	 * request of a higher priority already in the queue.
-	 */
-	RTE_VERIFY(priority != req_queue->highest_priority);
-	for (next = priority + 1; next <= req_queue->highest_priority; next++) {
-		if (req_queue->priorities[next] != NULL) {
-			list_add(&pr->list, &req_queue->priorities[next]->list);
-			return;
-		}
-	}
+static inline void
+req_queue_push(struct req_queue *req_queue, uint16_t grantor_id,
+	uint8_t priority, struct rte_mbuf *pkt)
+{
+	struct sol_grantor_queue *gq = &req_queue->grantors[grantor_id];
+	struct req_fifo *fifo = &gq->fifos[priority];
+	uint32_t idx = req_queue->free_slot;
+	struct req_slot *slot = &req_queue->slots[idx];
+
+	req_queue->free_slot = slot->next;
+
+	slot->pkt = pkt;
+	slot->prev = fifo->tail;
+	slot->next = REQ_SLOT_NONE;
+	if (fifo->tail == REQ_SLOT_NONE)
+		fifo->head = idx;
+	else
+		req_queue->slots[fifo->tail].next = idx;
+	fifo->tail = idx;
+
+	gq->occupied |= 1ULL << priority;
+	if (++gq->len > gq->max_len)
+		gq->max_len = gq->len;
+	req_queue->pri_len[priority]++;
+	req_queue->occupied |= 1ULL << priority;
+	req_queue->len++;
 
-	rte_panic("sol: %s failed to insert a request of a new priority\n",
-		__func__);
+	if (!gq->active)
+		activate_grantor(req_queue, grantor_id);
 }
 
-static void
-drop_lowest_priority_pkt(struct sol_config *sol_conf,
-	struct req_queue *req_queue)
+/* Remove the request at slot @idx from the FIFO of @priority. */
+static inline struct rte_mbuf *
+req_queue_remove(struct req_queue *req_queue, uint16_t grantor_id,
+	uint8_t priority, uint32_t idx)
 {
-	struct priority_req *lowest_pr = list_last_entry(&req_queue->head,
-		struct priority_req, list);
-	struct priority_req *next_lowest_pr;
+	struct sol_grantor_queue *gq = &req_queue->grantors[grantor_id];
+	struct req_fifo *fifo = &gq->fifos[priority];
+	struct req_slot *slot = &req_queue->slots[idx];
+
+	if (slot->prev == REQ_SLOT_NONE)
+		fifo->head = slot->next;
+	else
+		req_queue->slots[slot->prev].next = slot->next;
+
+	if (slot->next == REQ_SLOT_NONE)
+		fifo->tail = slot->prev;
+	else
+		req_queue->slots[slot->next].prev = slot->prev;
+
+	if (fifo->head == REQ_SLOT_NONE)
+		gq->occupied &= ~(1ULL << priority);
+	if (--req_queue->pri_len[priority] == 0)
+		req_queue->occupied &= ~(1ULL << priority);
+	req_queue->len--;
 
-	RTE_VERIFY(req_queue->len > 0);
+	slot->next = req_queue->free_slot;
+	req_queue->free_slot = idx;
 
-	if (unlikely(req_queue->len == 1)) {
-		req_queue->priorities[lowest_pr->priority] = NULL;
-		req_queue->highest_priority = 0;
-		req_queue->lowest_priority = GK_MAX_REQ_PRIORITY;
-		goto drop;
-	}
+	if (--gq->len == 0)
+		deactivate_grantor(req_queue, grantor_id);
+
+	return slot->pkt;
+}
 
-	next_lowest_pr = list_prev_entry(lowest_pr, list);
+/* Remove the oldest request of @priority of the Grantor. */
+static inline struct rte_mbuf *
+req_queue_pop_head(struct req_queue *req_queue, uint16_t grantor_id,
+	uint8_t priority)
+{
+	return req_queue_remove(req_queue, grantor_id, priority,
+		req_queue->grantors[grantor_id].fifos[priority].head);
+}
+
+/* Remove the newest request of @priority of the Grantor. */
+static inline struct rte_mbuf *
+req_queue_pop_tail(struct req_queue *req_queue, uint16_t grantor_id,
+	uint8_t priority)
+{
+	return req_queue_remove(req_queue, grantor_id, priority,
+		req_queue->grantors[grantor_id].fifos[priority].tail);
+}
 
-	/* The lowest priority packet was the only one of that priority. */
-	if (lowest_pr->priority != next_lowest_pr->priority) {
-		req_queue->priorities[lowest_pr->priority] = NULL;
-		req_queue->lowest_priority = next_lowest_pr->priority;
-		goto drop;
+/*
+ * Return the Grantor with the most requests, preferring
+ * @grantor_id among the Grantors with as many requests.
+ */
+static uint16_t
+longest_grantor_queue(const struct req_queue *req_queue, uint16_t grantor_id)
+{
+	uint16_t longest = grantor_id;
+	uint16_t id;
+
+	for (id = req_queue->active_head; id != SOL_GRANTOR_NONE;
+			id = req_queue->grantors[id].next_active) {
+		if (req_queue->grantors[id].len >
+				req_queue->grantors[longest].len)
+			longest = id;
 	}
 
-	req_queue->priorities[lowest_pr->priority] = next_lowest_pr;
+	return longest;
+}
 
-drop:
-	list_del(&lowest_pr->list);
-	rte_pktmbuf_free(lowest_pr->pkt);
-	mb_free_entry(&sol_conf->mb, lowest_pr);
-	req_queue->len--;
+static int
+get_block_idx(struct sol_config *sol_conf, unsigned int lcore_id)
+{
+	int i;
+	for (i = 0; i < sol_conf->num_lcores; i++)
+		if (sol_conf->lcores[i] == lcore_id)
+			return i;
+	rte_panic("Unexpected condition: lcore %u is not running a sol block\n",
+		lcore_id);
+	return 0;
 }
 
 static void
-enqueue_req(struct sol_config *sol_conf, struct priority_req *req)
+enqueue_req(struct sol_config *sol_conf, struct sol_instance *instance,
+	struct rte_mbuf *pkt)
 {
-	struct req_queue *req_queue = &sol_conf->req_queue;
-	uint8_t priority = req->priority;
+	struct req_queue *req_queue = &instance->req_queue;
+	uint8_t priority = sol_get_req_priority(pkt);
+	uint16_t grantor_id = sol_get_req_grantor(pkt);
+	uint64_t arrived_at = sol_get_req_arrival(pkt);
+
+	req_queue->grantors[grantor_id].num_enqueued++;
+	stats_inc(instance->stats, STATS_SOL_REQS_ENQUEUED);
+
+	if (unlikely(arrived_at != 0)) {
+		uint64_t now = rte_rdtsc();
+		stats_hist_record(instance->stats, STATS_HIST_GK_TO_SOL,
+			now - arrived_at);
+		sol_set_req_enqueued_at(pkt, now);
+	}
 
 	if (req_queue->len >= sol_conf->pri_req_max_len) {
+		/*
+		 * Make room at the expense of the Grantor with the
+		 * most requests, so that a flood of requests to
+		 * a Grantor does not push out the requests to
+		 * the other Grantors.
+		 */
+		uint16_t victim_id =
+			longest_grantor_queue(req_queue, grantor_id);
+		struct sol_grantor_queue *victim =
+			&req_queue->grantors[victim_id];
+		uint8_t lowest = grantor_queue_lowest_priority(victim);
+
 		/* New packet is lowest priority, so drop it. */
-		if (req_queue->lowest_priority >= priority) {
-			rte_pktmbuf_free(req->pkt);
-			mb_free_entry(&sol_conf->mb, req);
+		stats_inc(instance->stats, STATS_SOL_REQS_DROPPED);
+		if (victim_id == grantor_id && lowest >= priority) {
+			victim->num_dropped++;
+			rte_pktmbuf_free(pkt);
 			return;
 		}
-		drop_lowest_priority_pkt(sol_conf, req_queue);
-	}
 
-	if (req_queue->priorities[priority] == NULL) {
-		/* Insert request of a priority we don't yet have. */
-		insert_new_priority_req(req_queue, req, priority);
-	} else {
-		/* Append request to end of the appropriate priority. */
-		list_add(&req->list, &req_queue->priorities[priority]->list);
-		req_queue->priorities[priority] = req;
+		/* Drop the newest packet of the lowest priority. */
+		rte_pktmbuf_free(req_queue_pop_tail(req_queue,
+			victim_id, lowest));
+		victim->num_dropped++;
 	}
 
-	req_queue->len++;
+	req_queue_push(req_queue, grantor_id, priority, pkt);
 }
 
+/* Poll the request rings of the GK instances mapped to @instance. */
 static void
-enqueue_reqs(struct sol_config *sol_conf)
+enqueue_reqs(struct sol_config *sol_conf, struct sol_instance *instance)
 {
-	struct priority_req *req_nodes[sol_conf->enq_burst_size];
-	int num_reqs = mb_dequeue_burst(&sol_conf->mb,
-		(void **)req_nodes, sol_conf->enq_burst_size);
-	int i;
-	for (i = 0; i < num_reqs; i++)
-		enqueue_req(sol_conf, req_nodes[i]);
+	struct rte_mbuf *reqs[sol_conf->enq_burst_size];
+	unsigned int i, j;
+
+	for (i = 0; i < instance->num_req_rings; i++) {
+		unsigned int num_reqs = rte_ring_sc_dequeue_burst(
+			instance->req_rings[i], (void **)reqs,
+			sol_conf->enq_burst_size, NULL);
+		for (j = 0; j < num_reqs; j++)
+			enqueue_req(sol_conf, instance, reqs[j]);
+	}
+
+	instance->published_occupied = instance->req_queue.occupied;
+	stats_set(instance->stats, STATS_SOL_QUEUE_LEN,
+		instance->req_queue.len);
 }
 
 static inline void
@@ -197,6 +349,12 @@ credits_update(struct req_queue *req_queue)
 	req_queue->time_cpu_cycles = curr_cycles - avail_bytes.rem;
 }
 
+/*
+ * The quantum of the deficit round robin, in bytes. It is larger
+ * than any request, so a Grantor sends at least a request per turn.
+ */
+#define SOL_DRR_QUANTUM_BYTES (2048)
+
 static inline int
 credits_check(struct req_queue *req_queue, struct rte_mbuf *pkt)
 {
@@ -208,61 +366,180 @@ credits_check(struct req_queue *req_queue, struct rte_mbuf *pkt)
 	return true;
 }
 
+/*
+ * Refill the credits of the Grantor, and check whether
+ * they are enough to send a request of @pkt_len bytes.
+ */
+static inline bool
+grantor_credits_check(const struct sol_instance *instance,
+	struct sol_grantor_queue *gq, uint32_t pkt_len, uint64_t now)
+{
+	double bytes_per_cycle = gq->bw_rate * instance->bytes_per_cycle;
+	/* Like the token bucket, hold up to a second of requests. */
+	double max_credit_bytes = bytes_per_cycle * cycles_per_sec;
+
+	gq->credit_bytes += (now - gq->refilled_at) * bytes_per_cycle;
+	gq->refilled_at = now;
+	if (gq->credit_bytes > max_credit_bytes)
+		gq->credit_bytes = max_credit_bytes;
+
+	if (pkt_len > gq->credit_bytes) {
+		gq->out_of_credit = true;
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Each instance only knows the priorities of its own requests, so
+ * the instances together only approximate a global priority order.
+ * Return the highest priority of the requests waiting at the other
+ * instances, or -1 if they have none, so that the requests sent out
+ * ahead of a request of higher priority can be counted.
+ */
+static int
+others_highest_priority(struct sol_config *sol_conf, int block_idx)
+{
+	uint64_t occupied = 0;
+	int i;
+
+	for (i = 0; i < sol_conf->num_lcores; i++) {
+		if (i != block_idx)
+			occupied |= sol_conf->instances[i].published_occupied;
+	}
+
+	return occupied == 0 ? -1 : 63 - __builtin_clzll(occupied);
+}
+
 static void
-dequeue_reqs(struct sol_config *sol_conf, uint8_t tx_port)
+dequeue_reqs(struct sol_config *sol_conf, struct sol_instance *instance,
+	int block_idx)
 {
-	struct req_queue *req_queue = &sol_conf->req_queue;
-	struct priority_req *entry, *next;
+	struct req_queue *req_queue = &instance->req_queue;
 
 	struct rte_mbuf *pkts_out[sol_conf->deq_burst_size];
+	uint64_t arrivals[sol_conf->deq_burst_size];
 	uint32_t nb_pkts_out = 0;
-	uint16_t total_sent = 0;
+	uint32_t max_pkts_out;
+	uint32_t nb_buffered;
+	int others_highest;
+	unsigned int idle_turns = 0;
+	uint64_t now;
+	uint32_t i;
+
+	/*
+	 * Requests cannot be dropped once dequeued, so only dequeue
+	 * as many requests as the TX buffer can hold. When the NIC
+	 * is not accepting packets, requests stay in the priority
+	 * queue, where they can be replaced by higher priority ones.
+	 */
+	txb_flush(&instance->tx_back);
+	max_pkts_out = RTE_MIN(sol_conf->deq_burst_size,
+		(unsigned int)txb_room(&instance->tx_back));
+	if (unlikely(max_pkts_out == 0))
+		return;
 
 	/* Get an up-to-date view of our credits. */
 	credits_update(req_queue);
+	now = rte_rdtsc();
 
-	list_for_each_entry_safe(entry, next, &req_queue->head, list) {
-		struct rte_mbuf *pkt = entry->pkt;
+	others_highest = others_highest_priority(sol_conf, block_idx);
 
-		if (!credits_check(req_queue, pkt)) {
+	/*
+	 * Deficit round robin: at the start of its turn, a Grantor
+	 * gets a quantum of bytes, and its requests are sent, highest
+	 * priority first, while its deficit and its credits cover them.
+	 * Stop once every Grantor has had a turn without sending
+	 * any request.
+	 */
+	while (req_queue->num_active > idle_turns) {
+		uint16_t grantor_id = req_queue->active_head;
+		struct sol_grantor_queue *gq =
+			&req_queue->grantors[grantor_id];
+		uint8_t priority = grantor_queue_highest_priority(gq);
+		struct rte_mbuf *pkt = req_queue->slots[
+			gq->fifos[priority].head].pkt;
+		/* Need to include Ethernet frame overhead. */
+		uint32_t pkt_len =
+			pkt->pkt_len + RTE_SCHED_FRAME_OVERHEAD_DEFAULT;
+
+		if (!req_queue->turn_started) {
+			gq->deficit_bytes += SOL_DRR_QUANTUM_BYTES;
+			req_queue->turn_started = true;
+			gq->turn_sent = false;
+		}
+
+		if (pkt_len > gq->deficit_bytes) {
+			/* The deficit carries over to the next turn. */
+			idle_turns = gq->turn_sent ? 0 : idle_turns + 1;
+			end_grantor_turn(req_queue);
+			continue;
+		}
+
+		if (!grantor_credits_check(instance, gq, pkt_len, now)) {
 			/*
-			 * XXX When under an attack, we may not want to
-			 * log this because it could become expensive.
+			 * Like an empty Grantor, a Grantor out of credits
+			 * does not keep its deficit, so it does not get
+			 * a burst once its credits are back.
 			 */
-			RTE_LOG(NOTICE, GATEKEEPER,
+			gq->deficit_bytes = 0;
+			idle_turns = gq->turn_sent ? 0 : idle_turns + 1;
+			end_grantor_turn(req_queue);
+			continue;
+		}
+
+		if (!credits_check(req_queue, pkt)) {
+			LOG_RATELIMIT(NOTICE, GATEKEEPER,
 				"sol: out of request bandwidth\n");
-			goto out;
+			break;
 		}
 
-		if (req_queue->len == 1 || (entry->priority != next->priority))
-			req_queue->priorities[entry->priority] = NULL;
-		list_del(&entry->list);
-		mb_free_entry(&sol_conf->mb, entry);
-		req_queue->len--;
+		if (priority < others_highest) {
+			instance->num_inversions++;
+			stats_inc(instance->stats,
+				STATS_SOL_PRIORITY_INVERSIONS);
+		}
+
+		gq->credit_bytes -= pkt_len;
+		gq->deficit_bytes -= pkt_len;
+		gq->num_sent++;
+		gq->turn_sent = true;
+		idle_turns = 0;
+
+		/* The mbuf may be freed once transmitted. */
+		arrivals[nb_pkts_out] = sol_get_req_arrival(pkt);
+		if (unlikely(arrivals[nb_pkts_out] != 0)) {
+			stats_hist_record(instance->stats,
+				STATS_HIST_SOL_QUEUE,
+				now - sol_get_req_enqueued_at(pkt));
+		}
 
-		pkts_out[nb_pkts_out++] = pkt;
+		pkts_out[nb_pkts_out++] =
+			req_queue_pop_head(req_queue, grantor_id, priority);
 
-		if (nb_pkts_out >= sol_conf->deq_burst_size)
+		if (nb_pkts_out >= max_pkts_out)
 			break;
 	}
 
-out:
-	if (list_empty(&req_queue->head)) {
-		req_queue->highest_priority = 0;
-		req_queue->lowest_priority = GK_MAX_REQ_PRIORITY;
-	} else {
-		struct priority_req *first = list_first_entry(&req_queue->head,
-			struct priority_req, list);
-		req_queue->highest_priority = first->priority;
-	}
+	instance->published_occupied = req_queue->occupied;
+	instance->num_dequeued += nb_pkts_out;
+	stats_add(instance->stats, STATS_SOL_REQS_SENT, nb_pkts_out);
+
+	/* Unsent packets stay in the TX buffer until the next flush. */
+	txb_add_bulk(&instance->tx_back, pkts_out, nb_pkts_out);
+	txb_flush(&instance->tx_back);
 
-	/* We cannot drop the packets, so re-send. */
-	while (nb_pkts_out > 0) {
-		uint16_t sent = rte_eth_tx_burst(tx_port,
-			sol_conf->tx_queue_back,
-			pkts_out + total_sent, nb_pkts_out);
-		total_sent += sent;
-		nb_pkts_out -= sent;
+	/*
+	 * The TX buffer is a FIFO, and it had room for all of
+	 * the requests, so the requests that the NIC did not
+	 * accept yet are the last ones. They are not recorded.
+	 */
+	nb_buffered = RTE_MIN(instance->tx_back.len, nb_pkts_out);
+	for (i = 0; i < nb_pkts_out - nb_buffered; i++) {
+		if (likely(arrivals[i] == 0))
+			continue;
+		stats_hist_record(instance->stats, STATS_HIST_REQ_TOTAL,
+			instance->tx_back.last_flush_at - arrivals[i]);
 	}
 }
 
@@ -301,38 +578,16 @@ iface_speed_bytes(struct gatekeeper_if *iface, uint64_t *link_speed_bytes)
 #define GATEKEEPER_TB_RATE_CONFIG_ERR (1e-7)
 
 /*
- * @sol_conf is allocated using rte_calloc(), so initializations
- * to 0 are not strictly necessary in this function.
+ * Set the rate at which the token bucket of @req_queue
+ * is refilled to @bytes_per_sec.
  */
 static int
-req_queue_init(struct sol_config *sol_conf)
+req_queue_set_rate(struct req_queue *req_queue, double bytes_per_sec)
 {
-	struct req_queue *req_queue = &sol_conf->req_queue;
-	uint64_t link_speed_bytes;
-	double max_credit_bytes_precise;
 	double cycles_per_byte_precise;
 	uint32_t a, b;
 	int ret;
 
-	req_queue->len = 0;
-	req_queue->highest_priority = 0;
-	req_queue->lowest_priority = GK_MAX_REQ_PRIORITY;
-
-	/* Find link speed in bytes, even for a bonded interface. */
-	ret = iface_speed_bytes(&sol_conf->net->back, &link_speed_bytes);
-	if (ret < 0)
-		return ret;
-	RTE_LOG(NOTICE, GATEKEEPER,
-		"sol: back interface link speed: %"PRIu64" bytes per second\n",
-		link_speed_bytes);
-
-	/* Keep maximum number of bytes as a float for later calculations. */
-	max_credit_bytes_precise = sol_conf->req_bw_rate * link_speed_bytes;
-
-	/* Initialize token bucket as full. */
-	req_queue->tb_max_credit_bytes = round(max_credit_bytes_precise);
-	req_queue->tb_credit_bytes = req_queue->tb_max_credit_bytes;
-
 	/*
 	 * Compute the number of cycles needed to credit the request queue
 	 * with bytes. Represent this ratio of cycles per byte using two
@@ -343,15 +598,16 @@ req_queue_init(struct sol_config *sol_conf)
 	 * part of the cycles per byte using rte_approx(), and then add
 	 * the integer number of cycles per byte to the numerator.
 	 */
-	cycles_per_byte_precise = cycles_per_sec / max_credit_bytes_precise;
-	req_queue->cycles_per_byte_floor = cycles_per_byte_precise;
-	ret = rte_approx(
-		cycles_per_byte_precise - req_queue->cycles_per_byte_floor,
+	cycles_per_byte_precise = cycles_per_sec / bytes_per_sec;
+	ret = rte_approx(cycles_per_byte_precise -
+		(uint64_t)cycles_per_byte_precise,
 		GATEKEEPER_TB_RATE_CONFIG_ERR, &a, &b);
 	if (ret < 0) {
 		RTE_LOG(ERR, GATEKEEPER, "sol: could not approximate the request queue's allocated bandwidth\n");
 		return ret;
 	}
+
+	req_queue->cycles_per_byte_floor = cycles_per_byte_precise;
 	req_queue->cycles_per_byte_a = a;
 	req_queue->cycles_per_byte_b = b;
 
@@ -359,69 +615,327 @@ req_queue_init(struct sol_config *sol_conf)
 	req_queue->cycles_per_byte_a +=
 		req_queue->cycles_per_byte_floor * req_queue->cycles_per_byte_b;
 
-	RTE_LOG(NOTICE, GATEKEEPER, "sol: cycles per byte (%f) represented as a rational: %"PRIu64" / %"PRIu64"\n",
-		cycles_per_byte_precise,
+	/* The token bucket holds up to a second of requests. */
+	req_queue->tb_max_credit_bytes = round(bytes_per_sec);
+	if (req_queue->tb_credit_bytes > req_queue->tb_max_credit_bytes)
+		req_queue->tb_credit_bytes = req_queue->tb_max_credit_bytes;
+
+	return 0;
+}
+
+/*
+ * @instance is allocated using rte_calloc(), so initializations
+ * to 0 are not strictly necessary in this function.
+ */
+static int
+req_queue_init(struct sol_config *sol_conf, struct sol_instance *instance,
+	unsigned int lcore)
+{
+	struct req_queue *req_queue = &instance->req_queue;
+	uint32_t i;
+	int ret;
+
+	/* The bitmaps of occupied FIFOs must have a bit per priority. */
+	RTE_BUILD_BUG_ON(GK_MAX_REQ_PRIORITY >=
+		sizeof(req_queue->occupied) * 8);
+	/* Grantor ids must fit in the lists of active Grantors. */
+	RTE_BUILD_BUG_ON(SOL_MAX_GRANTORS >= SOL_GRANTOR_NONE);
+
+	req_queue->slots = rte_malloc_socket("sol_req_slots",
+		sol_conf->pri_req_max_len * sizeof(*req_queue->slots), 0,
+		rte_lcore_to_socket_id(lcore));
+	if (req_queue->slots == NULL) {
+		RTE_LOG(ERR, MALLOC,
+			"sol: could not allocate the slots of the request queue at lcore %u\n",
+			lcore);
+		return -1;
+	}
+	for (i = 0; i < sol_conf->pri_req_max_len; i++)
+		req_queue->slots[i].next = i + 1;
+	req_queue->slots[sol_conf->pri_req_max_len - 1].next = REQ_SLOT_NONE;
+	req_queue->free_slot = 0;
+
+	req_queue->len = 0;
+	req_queue->occupied = 0;
+	req_queue->active_head = SOL_GRANTOR_NONE;
+	req_queue->active_tail = SOL_GRANTOR_NONE;
+	req_queue->num_active = 0;
+	req_queue->turn_started = false;
+
+	for (i = 0; i < RTE_DIM(req_queue->grantors); i++) {
+		struct sol_grantor_queue *gq = &req_queue->grantors[i];
+		unsigned int priority;
+
+		for (priority = 0; priority <= GK_MAX_REQ_PRIORITY;
+				priority++) {
+			gq->fifos[priority].head = REQ_SLOT_NONE;
+			gq->fifos[priority].tail = REQ_SLOT_NONE;
+		}
+
+		/* The credits of the Grantor start full. */
+		gq->bw_rate = sol_conf->req_bw_rate_max;
+		gq->credit_bytes = 0;
+		gq->refilled_at = 0;
+		gq->generation = 0;
+		gq->deficit_bytes = 0;
+		gq->turn_sent = false;
+	}
+
+	/*
+	 * RSS spreads the flows evenly over the GK instances, so
+	 * each instance gets a share of the request bandwidth
+	 * proportional to the number of GK instances mapped to it.
+	 */
+	if (sol_conf->num_req_rings == 0)
+		instance->bw_share = 1.0 / sol_conf->num_lcores;
+	else if (instance->num_req_rings == 0) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"sol: the Solicitor instance at lcore %u serves no GK instance; there are more Solicitor instances than GK instances\n",
+			lcore);
+		return -1;
+	} else
+		instance->bw_share = (double)instance->num_req_rings /
+			sol_conf->num_req_rings;
+
+	/* Find link speed in bytes, even for a bonded interface. */
+	ret = iface_speed_bytes(&sol_conf->net->back,
+		&instance->link_speed_bytes);
+	if (ret < 0)
+		return ret;
+	RTE_LOG(NOTICE, GATEKEEPER,
+		"sol: back interface link speed: %"PRIu64" bytes per second\n",
+		instance->link_speed_bytes);
+
+	instance->bytes_per_cycle = instance->bw_share *
+		instance->link_speed_bytes / cycles_per_sec;
+
+	ret = req_queue_set_rate(req_queue, sol_conf->req_bw_rate *
+		instance->bw_share * instance->link_speed_bytes);
+	if (ret < 0)
+		return ret;
+
+	/* Initialize token bucket as full. */
+	req_queue->tb_credit_bytes = req_queue->tb_max_credit_bytes;
+
+	RTE_LOG(NOTICE, GATEKEEPER, "sol: instance at lcore %u has %.1f%% of the request bandwidth; cycles per byte represented as a rational: %"PRIu64" / %"PRIu64"\n",
+		lcore, instance->bw_share * 100,
 		req_queue->cycles_per_byte_a, req_queue->cycles_per_byte_b);
 
 	req_queue->time_cpu_cycles = rte_rdtsc();
+	instance->next_feedback_at =
+		req_queue->time_cpu_cycles + sol_conf->feedback_period_cycles;
 	return 0;
 }
 
+/* Multiplicative decrease of the request bandwidth. */
+#define SOL_BW_DECREASE_FACTOR (0.875)
+
+/* Additive increase, as a fraction of the range of the bandwidth. */
+#define SOL_BW_INCREASE_STEP (1. / 16)
+
+/*
+ * Adapt the request bandwidth of each Grantor to the headroom that
+ * it reports. The bandwidth of a Grantor is reduced while it is
+ * short of headroom, so it is not overloaded with requests, and it
+ * is increased while it has headroom and its requests are waiting
+ * for credits, so request capacity is not left unused. The bandwidth
+ * of Grantors that have not reported recently is left as is.
+ */
+static void
+adjust_req_bw(struct sol_config *sol_conf, struct sol_instance *instance,
+	uint64_t now)
+{
+	struct req_queue *req_queue = &instance->req_queue;
+	uint64_t since = now - SOL_FEEDBACK_TIMEOUT_MS * cycles_per_ms;
+	unsigned int num_grantors;
+	unsigned int i;
+
+	if (now < instance->next_feedback_at)
+		return;
+	instance->next_feedback_at = now + sol_conf->feedback_period_cycles;
+
+	num_grantors = sol_conf->num_grantors;
+	/* Pairs with the write barrier in sol_register_grantor(). */
+	rte_smp_rmb();
+
+	for (i = 0; i < num_grantors; i++) {
+		struct sol_grantor *grantor = &sol_conf->grantors[i];
+		struct sol_grantor_queue *gq = &req_queue->grantors[i];
+		double bw_rate;
+
+		/* The id went to another Grantor; start over. */
+		if (unlikely(gq->generation != grantor->generation)) {
+			gq->generation = grantor->generation;
+			gq->bw_rate = sol_conf->req_bw_rate_max;
+		}
+		bw_rate = gq->bw_rate;
+
+		if (grantor->reported_at >= since) {
+			if (grantor->headroom <
+					sol_conf->grantor_headroom_target *
+					GGU_MAX_HEADROOM)
+				bw_rate *= SOL_BW_DECREASE_FACTOR;
+			else if (gq->out_of_credit)
+				bw_rate += (sol_conf->req_bw_rate_max -
+					sol_conf->req_bw_rate_min) *
+					SOL_BW_INCREASE_STEP;
+
+			bw_rate = RTE_MAX(bw_rate, sol_conf->req_bw_rate_min);
+			gq->bw_rate = RTE_MIN(bw_rate,
+				sol_conf->req_bw_rate_max);
+		}
+
+		gq->out_of_credit = false;
+	}
+}
+
+/* Log the statistics of the requests bound to each Grantor. */
+static void
+log_grantor_stats(struct sol_config *sol_conf,
+	struct sol_instance *instance, unsigned int lcore)
+{
+	unsigned int num_grantors = sol_conf->num_grantors;
+	unsigned int i;
+
+	rte_smp_rmb();
+
+	for (i = 0; i < num_grantors; i++) {
+		struct sol_grantor *grantor = &sol_conf->grantors[i];
+		struct sol_grantor_queue *gq = &instance->req_queue.grantors[i];
+		char addr_str[INET6_ADDRSTRLEN];
+		const char *str = inet_ntop(
+			grantor->addr.proto == ETHER_TYPE_IPv4
+				? AF_INET : AF_INET6,
+			&grantor->addr.ip, addr_str, sizeof(addr_str));
+
+		if (gq->num_enqueued == 0)
+			continue;
+
+		RTE_LOG(NOTICE, GATEKEEPER,
+			"sol: the Solicitor block at lcore = %u received %"PRIu64" requests to Grantor %s, sent %"PRIu64", and dropped %"PRIu64"; the queue of the Grantor held up to %"PRIu32" requests, and its bandwidth was %f\n",
+			lcore, gq->num_enqueued,
+			str != NULL ? str : "(unknown)", gq->num_sent,
+			gq->num_dropped, gq->max_len, gq->bw_rate);
+	}
+}
+
+static void
+cleanup_sol_instance(struct sol_instance *instance)
+{
+	struct req_queue *req_queue = &instance->req_queue;
+	unsigned int i;
+
+	if (req_queue->slots != NULL) {
+		while (req_queue->active_head != SOL_GRANTOR_NONE) {
+			uint16_t grantor_id = req_queue->active_head;
+			struct sol_grantor_queue *gq =
+				&req_queue->grantors[grantor_id];
+			rte_pktmbuf_free(req_queue_pop_head(req_queue,
+				grantor_id,
+				grantor_queue_highest_priority(gq)));
+		}
+
+		if (req_queue->len > 0)
+			RTE_LOG(NOTICE, GATEKEEPER, "sol: bug: removing all requests from the priority queue on cleanup leaves the queue length at %"PRIu32"\n",
+				req_queue->len);
+
+		rte_free(req_queue->slots);
+		req_queue->slots = NULL;
+	}
+
+	for (i = 0; i < instance->num_req_rings; i++) {
+		struct rte_mbuf *pkt;
+		while (rte_ring_sc_dequeue(instance->req_rings[i],
+				(void **)&pkt) == 0)
+			rte_pktmbuf_free(pkt);
+		rte_ring_free(instance->req_rings[i]);
+	}
+	instance->num_req_rings = 0;
+}
+
 static int
 cleanup_sol(struct sol_config *sol_conf)
 {
-	struct req_queue *req_queue = &sol_conf->req_queue;
-	struct priority_req *entry, *next;
+	int i;
 
-	list_for_each_entry_safe(entry, next, &req_queue->head, list) {
-		rte_pktmbuf_free(entry->pkt);
-		list_del(&entry->list);
-		mb_free_entry(&sol_conf->mb, entry);
-		req_queue->len--;
+	if (sol_conf->instances != NULL) {
+		for (i = 0; i < sol_conf->num_lcores; i++)
+			cleanup_sol_instance(&sol_conf->instances[i]);
+		rte_free(sol_conf->instances);
 	}
 
-	if (req_queue->len > 0)
-		RTE_LOG(NOTICE, GATEKEEPER, "sol: bug: removing all requests from the priority queue on cleanup leaves the queue length at %"PRIu32"\n",
-			req_queue->len);
-
-	destroy_mailbox(&sol_conf->mb);
+	rte_free(sol_conf->lcores);
 	rte_free(sol_conf);
 	return 0;
 }
 
+int
+sol_conf_put(struct sol_config *sol_conf)
+{
+	if (rte_atomic32_dec_and_test(&sol_conf->ref_cnt))
+		return cleanup_sol(sol_conf);
+
+	return 0;
+}
+
 static int
 sol_proc(void *arg)
 {
+	unsigned int lcore = rte_lcore_id();
 	struct sol_config *sol_conf = (struct sol_config *)arg;
-	unsigned int lcore = sol_conf->lcore_id;
-	uint8_t tx_port_back = sol_conf->net->back.id;
+	int block_idx = get_block_idx(sol_conf, lcore);
+	struct sol_instance *instance = &sol_conf->instances[block_idx];
 
 	RTE_LOG(NOTICE, GATEKEEPER,
 		"sol: the Solicitor block is running at lcore = %u\n", lcore);
 
+	txb_init(&instance->tx_back, sol_conf->net->back.id,
+		instance->tx_queue_back);
+	instance->stats = stats_register(lcore, STATS_BLOCK_SOL);
+
+	sol_conf_hold(sol_conf);
+
 	while (likely(!exiting)) {
-		enqueue_reqs(sol_conf);
-		dequeue_reqs(sol_conf, tx_port_back);
+		enqueue_reqs(sol_conf, instance);
+		dequeue_reqs(sol_conf, instance, block_idx);
+		stats_set(instance->stats, STATS_TX_DROPS,
+			instance->tx_back.num_dropped);
+		if (sol_conf->req_bw_rate_min < sol_conf->req_bw_rate_max)
+			adjust_req_bw(sol_conf, instance, rte_rdtsc());
+		log_ratelimit_flush(rte_rdtsc());
 	}
 
+	txb_free(&instance->tx_back, "sol");
+
+	log_grantor_stats(sol_conf, instance, lcore);
+
+	RTE_LOG(NOTICE, GATEKEEPER,
+		"sol: the Solicitor block at lcore = %u sent out %"PRIu64" requests, %"PRIu64" of them while another instance had a request of higher priority\n",
+		lcore, instance->num_dequeued, instance->num_inversions);
+
 	RTE_LOG(NOTICE, GATEKEEPER,
 		"sol: the Solicitor block at lcore = %u is exiting\n", lcore);
 
-	return cleanup_sol(sol_conf);
+	return sol_conf_put(sol_conf);
 }
 
 static int
 sol_stage1(void *arg)
 {
 	struct sol_config *sol_conf = arg;
-	int ret = get_queue_id(&sol_conf->net->back, QUEUE_TYPE_TX,
-		sol_conf->lcore_id);
-	if (ret < 0) {
-		RTE_LOG(ERR, GATEKEEPER, "sol: cannot assign a TX queue for the back interface for lcore %u\n",
-			sol_conf->lcore_id);
-		goto cleanup;
+	int i;
+
+	for (i = 0; i < sol_conf->num_lcores; i++) {
+		unsigned int lcore = sol_conf->lcores[i];
+		int ret = get_queue_id(&sol_conf->net->back, QUEUE_TYPE_TX,
+			lcore);
+		if (ret < 0) {
+			RTE_LOG(ERR, GATEKEEPER, "sol: cannot assign a TX queue for the back interface for lcore %u\n",
+				lcore);
+			goto cleanup;
+		}
+		sol_conf->instances[i].tx_queue_back = ret;
 	}
-	sol_conf->tx_queue_back = ret;
 
 	return 0;
 
@@ -434,9 +948,14 @@ static int
 sol_stage2(void *arg)
 {
 	struct sol_config *sol_conf = arg;
-	int ret = req_queue_init(sol_conf);
-	if (ret < 0)
-		goto cleanup;
+	int ret, i;
+
+	for (i = 0; i < sol_conf->num_lcores; i++) {
+		ret = req_queue_init(sol_conf, &sol_conf->instances[i],
+			sol_conf->lcores[i]);
+		if (ret < 0)
+			goto cleanup;
+	}
 
 	return 0;
 
@@ -448,7 +967,7 @@ cleanup:
 int
 run_sol(struct net_config *net_conf, struct sol_config *sol_conf)
 {
-	int ret;
+	int ret, i;
 
 	if (net_conf == NULL || sol_conf == NULL) {
 		ret = -1;
@@ -461,6 +980,13 @@ run_sol(struct net_config *net_conf, struct sol_config *sol_conf)
 		goto out;
 	}
 
+	if (sol_conf->num_lcores <= 0) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"sol: at least one lcore must be assigned to the Solicitor block\n");
+		ret = -1;
+		goto out;
+	}
+
 	if (sol_conf->pri_req_max_len == 0) {
 		RTE_LOG(ERR, GATEKEEPER,
 			"sol: priority queue max len must be greater than 0\n");
@@ -489,25 +1015,72 @@ run_sol(struct net_config *net_conf, struct sol_config *sol_conf)
 		goto out;
 	}
 
-	ret = init_mailbox("sol_reqs", 2 * sol_conf->pri_req_max_len,
-		sizeof(struct priority_req), sol_conf->lcore_id,
-		&sol_conf->mb);
-	if (ret < 0)
+	if (sol_conf->req_bw_rate_min == 0 &&
+			sol_conf->req_bw_rate_max == 0) {
+		/* The request bandwidth of the Grantors is fixed. */
+		sol_conf->req_bw_rate_min = sol_conf->req_bw_rate;
+		sol_conf->req_bw_rate_max = sol_conf->req_bw_rate;
+	}
+
+	if (sol_conf->req_bw_rate_min <= 0 ||
+			sol_conf->req_bw_rate_min > sol_conf->req_bw_rate_max ||
+			sol_conf->req_bw_rate_max > sol_conf->req_bw_rate) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"sol: the bounds of the request bandwidth of the Grantors must be greater than 0 and within the request queue bandwidth (%f), but they have been specified as [%f, %f]\n",
+			sol_conf->req_bw_rate, sol_conf->req_bw_rate_min,
+			sol_conf->req_bw_rate_max);
+		ret = -1;
 		goto out;
+	}
 
-	ret = net_launch_at_stage1(net_conf, 0, 0, 0, 1, sol_stage1, sol_conf);
+	if (sol_conf->req_bw_rate_min < sol_conf->req_bw_rate_max &&
+			(sol_conf->feedback_period_ms == 0 ||
+			sol_conf->grantor_headroom_target < 0 ||
+			sol_conf->grantor_headroom_target >= 1)) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"sol: the feedback period must be greater than 0, and the headroom target of the Grantors must be in range [0, 1), but they have been specified as %u and %f\n",
+			sol_conf->feedback_period_ms,
+			sol_conf->grantor_headroom_target);
+		ret = -1;
+		goto out;
+	}
+	sol_conf->feedback_period_cycles =
+		sol_conf->feedback_period_ms * cycles_per_ms;
+
+	/*
+	 * The instances are allocated here instead of at stage 1
+	 * because the GK block creates the request rings of
+	 * the instances at its own stage 1.
+	 */
+	sol_conf->instances = rte_calloc("sol_instances", sol_conf->num_lcores,
+		sizeof(struct sol_instance), 0);
+	if (sol_conf->instances == NULL) {
+		RTE_LOG(ERR, MALLOC,
+			"sol: could not allocate the Solicitor instances\n");
+		ret = -1;
+		goto out;
+	}
+
+	ret = net_launch_at_stage1(net_conf, 0, 0, 0, sol_conf->num_lcores,
+		sol_stage1, sol_conf);
 	if (ret < 0)
-		goto mb;
+		goto instances;
 
 	ret = launch_at_stage2(sol_stage2, sol_conf);
 	if (ret < 0)
 		goto stage1;
 
-	ret = launch_at_stage3("sol", sol_proc, sol_conf, sol_conf->lcore_id);
-	if (ret < 0)
-		goto stage2;
+	for (i = 0; i < sol_conf->num_lcores; i++) {
+		unsigned int lcore = sol_conf->lcores[i];
+		ret = launch_at_stage3("sol", sol_proc, sol_conf, lcore);
+		if (ret < 0) {
+			pop_n_at_stage3(i);
+			goto stage2;
+		}
+	}
 
 	sol_conf->net = net_conf;
+	rte_atomic32_init(&sol_conf->ref_cnt);
 
 	ret = 0;
 	goto out;
@@ -516,8 +1089,9 @@ stage2:
 	pop_n_at_stage2(1);
 stage1:
 	pop_n_at_stage1(1);
-mb:
-	destroy_mailbox(&sol_conf->mb);
+instances:
+	rte_free(sol_conf->instances);
+	sol_conf->instances = NULL;
 out:
 	return ret;
 }
@@ -526,8 +1100,8 @@ out:
  * There should be only one sol_config instance.
  * Return an error if trying to allocate the second instance.
  *
- * Use rte_calloc() to zero-out the instance and initialize the
- * request queue list to guarantee that cleanup_sol() won't fail
+ * Use rte_calloc() to zero-out the instance, so that the request
+ * queue is empty, to guarantee that cleanup_sol() won't fail
  * during initialization.
  */
 struct sol_config *
@@ -540,29 +1114,219 @@ alloc_sol_conf(void)
 		return NULL;
 	}
 	sol_conf = rte_calloc("sol_config", 1, sizeof(struct sol_config), 0);
-	INIT_LIST_HEAD(&sol_conf->req_queue.head);
+	if (sol_conf != NULL)
+		rte_spinlock_init(&sol_conf->grantors_lock);
 	return sol_conf;
 }
 
+/*
+ * Create the ring through which the GK instance at @lcore_id
+ * hands its requests over to the Solicitor.
+ *
+ * The GK instances are mapped to the Solicitor instances in
+ * round-robin order. Since RSS assigns flows to GK instances by
+ * their hashes, each Solicitor instance serves a fixed share of
+ * the flows.
+ *
+ * This function must be called before the Solicitor is launched.
+ */
+struct rte_ring *
+alloc_sol_req_ring(struct sol_config *sol_conf, unsigned int lcore_id)
+{
+	char ring_name[RTE_RING_NAMESIZE];
+	unsigned int sol_idx;
+	struct sol_instance *instance;
+	struct rte_ring *ring;
+	int ret;
+
+	if (sol_conf->instances == NULL) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"sol: the Solicitor block must be set up before the request ring of lcore %u\n",
+			lcore_id);
+		return NULL;
+	}
+
+	sol_idx = sol_conf->num_req_rings % sol_conf->num_lcores;
+	instance = &sol_conf->instances[sol_idx];
+
+	if (instance->num_req_rings >= RTE_DIM(instance->req_rings)) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"sol: too many request rings for lcore %u\n", lcore_id);
+		return NULL;
+	}
+
+	ret = snprintf(ring_name, sizeof(ring_name), "sol_reqs_%u", lcore_id);
+	RTE_VERIFY(ret > 0 && ret < (int)sizeof(ring_name));
+
+	/*
+	 * Each ring holds up to a full request queue, so that a burst
+	 * from a single GK instance is never limited by its ring.
+	 */
+	ring = rte_ring_create(ring_name,
+		rte_align32pow2(sol_conf->pri_req_max_len + 1),
+		rte_lcore_to_socket_id(sol_conf->lcores[sol_idx]),
+		RING_F_SP_ENQ | RING_F_SC_DEQ);
+	if (ring == NULL) {
+		RTE_LOG(ERR, RING,
+			"sol: can't create the request ring for lcore %u (err=%d)\n",
+			lcore_id, rte_errno);
+		return NULL;
+	}
+
+	instance->req_rings[instance->num_req_rings++] = ring;
+	sol_conf->num_req_rings++;
+
+	RTE_LOG(NOTICE, GATEKEEPER,
+		"sol: the requests of the GK instance at lcore %u are serviced by the Solicitor instance at lcore %u\n",
+		lcore_id, sol_conf->lcores[sol_idx]);
+	return ring;
+}
+
+/*
+ * Hand requests over to the Solicitor. The priority of each request
+ * must have been set with sol_set_req_priority().
+ *
+ * Only the GK instance that owns @req_ring may call this function.
+ * Requests that do not fit in the ring are dropped.
+ */
+void
+gk_solicitor_enqueue_bulk(struct rte_ring *req_ring, struct rte_mbuf **pkts,
+	unsigned int num_pkts)
+{
+	unsigned int num_enq;
+	unsigned int i;
+
+	if (num_pkts == 0)
+		return;
+
+	num_enq = rte_ring_sp_enqueue_burst(req_ring, (void **)pkts,
+		num_pkts, NULL);
+	for (i = num_enq; i < num_pkts; i++)
+		rte_pktmbuf_free(pkts[i]);
+}
+
+/*
+ * Return the id of the Grantor @gt_addr, which is added
+ * to the Grantors of the Solicitor if needed, and take
+ * a reference to it; see sol_put_grantor().
+ *
+ * Once the ids of all the other Grantors are in use, new Grantors
+ * share SOL_GRANTOR_SHARED, so their requests share a queue.
+ *
+ * This function must be called before requests to the Grantor
+ * are handed over to the Solicitor.
+ */
 int
-gk_solicitor_enqueue(struct sol_config *sol_conf, struct rte_mbuf *pkt,
-	uint8_t priority)
+sol_register_grantor(struct sol_config *sol_conf,
+	const struct ipaddr *gt_addr)
 {
-	struct priority_req *req_node;
+	struct sol_grantor *grantor;
+	unsigned int free_id = SOL_GRANTOR_SHARED;
+	unsigned int i;
 
-	if (priority > GK_MAX_REQ_PRIORITY) {
-		RTE_LOG(ERR, GATEKEEPER, "sol: trying to enqueue a request with priority %hhu, but should be in range [0, %d]\n",
-			priority, GK_MAX_REQ_PRIORITY);
-		return -1;
+	rte_spinlock_lock(&sol_conf->grantors_lock);
+
+	for (i = 0; i < sol_conf->num_grantors; i++) {
+		grantor = &sol_conf->grantors[i];
+		if (ipaddr_equal(&grantor->addr, gt_addr)) {
+			grantor->ref_cnt++;
+			goto out;
+		}
+		if (grantor->ref_cnt == 0 && free_id == SOL_GRANTOR_SHARED)
+			free_id = i;
 	}
 
-	req_node = mb_alloc_entry(&sol_conf->mb);
-	if (req_node == NULL)
-		return -1;
+	if (free_id == SOL_GRANTOR_SHARED && i < SOL_GRANTOR_SHARED)
+		free_id = i;
+
+	if (free_id == SOL_GRANTOR_SHARED) {
+		RTE_LOG(WARNING, GATEKEEPER,
+			"sol: the Solicitor tells apart at most %u Grantors, so a new Grantor shares the queue of the Grantors beyond them\n",
+			SOL_GRANTOR_SHARED);
+		i = SOL_GRANTOR_SHARED;
+		goto out;
+	}
+
+	i = free_id;
+	grantor = &sol_conf->grantors[i];
 
-	INIT_LIST_HEAD(&req_node->list);
-	req_node->pkt = pkt;
-	req_node->priority = priority;
+	/*
+	 * Readers may still look the previous Grantor up. Forget its
+	 * feedback before the new address can match reports.
+	 */
+	grantor->reported_at = 0;
+	grantor->headroom = GGU_MAX_HEADROOM;
+	rte_smp_wmb();
+	grantor->addr = *gt_addr;
+	grantor->ref_cnt = 1;
+	grantor->generation++;
+
+	/* The entry must be filled before it becomes visible. */
+	rte_smp_wmb();
+	if (i >= sol_conf->num_grantors)
+		sol_conf->num_grantors = i + 1;
+
+out:
+	rte_spinlock_unlock(&sol_conf->grantors_lock);
+	return i;
+}
 
-	return mb_send_entry(&sol_conf->mb, req_node);
+/*
+ * Drop a reference that sol_register_grantor() returned. Once the
+ * Grantor has no references, its id can go to another Grantor.
+ * Requests to the Grantor still in the Solicitor are then
+ * counted as requests of the new Grantor.
+ */
+void
+sol_put_grantor(struct sol_config *sol_conf, uint16_t grantor_id)
+{
+	struct sol_grantor *grantor;
+
+	if (grantor_id == SOL_GRANTOR_SHARED)
+		return;
+
+	rte_spinlock_lock(&sol_conf->grantors_lock);
+	if (unlikely(grantor_id >= sol_conf->num_grantors ||
+			sol_conf->grantors[grantor_id].ref_cnt == 0)) {
+		RTE_LOG(ERR, GATEKEEPER,
+			"sol: put a Grantor id %hu that is not in use\n",
+			grantor_id);
+		goto out;
+	}
+
+	grantor = &sol_conf->grantors[grantor_id];
+	grantor->ref_cnt--;
+out:
+	rte_spinlock_unlock(&sol_conf->grantors_lock);
+}
+
+/*
+ * Record the headroom that an instance of the Grantor @gt_addr
+ * reported in a GGU notification. The reports of unknown
+ * Grantors are ignored.
+ *
+ * Only the GK-GT unit may call this function.
+ */
+void
+sol_report_grantor_headroom(struct sol_config *sol_conf,
+	const struct ipaddr *gt_addr, uint8_t headroom)
+{
+	unsigned int num_grantors = sol_conf->num_grantors;
+	unsigned int i;
+
+	rte_smp_rmb();
+
+	for (i = 0; i < num_grantors; i++) {
+		struct sol_grantor *grantor = &sol_conf->grantors[i];
+		if (ipaddr_equal(&grantor->addr, gt_addr)) {
+			/*
+			 * Smooth the reports, since the instances
+			 * of a Grantor report independently.
+			 */
+			grantor->headroom =
+				(3 * grantor->headroom + headroom + 2) / 4;
+			grantor->reported_at = rte_rdtsc();
+			return;
+		}
+	}
 }